@@ -0,0 +1,174 @@
+#include "CppUnitTest.h"
+#include "AvSyncEngine.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+/* Receive times are in 100 ns units */
+#define MS(ms) ((ms) * 10000LL)
+
+/* Latencies are measured against the clock, so offsets can be this far
+ * past what the test set up */
+#define OFFSET_SLOP_US 1000
+
+/* A 5 ms Opus packet */
+#define PACKET_DURATION MS(5)
+
+namespace Moonlight_common_binding_Tests
+{
+	/* Reports a frame that took latencyMs from receive to screen */
+	static void PresentFrame(AvSyncEngine &engine, int latencyMs) {
+		engine.OnVideoPresented(GetReceiveTime() - MS(latencyMs));
+	}
+
+	static void AssertOffsetNear(long long expectedUs, long long offsetUs) {
+		Assert::IsTrue(offsetUs >= expectedUs - OFFSET_SLOP_US && offsetUs <= expectedUs + OFFSET_SLOP_US);
+	}
+
+	TEST_CLASS(AvSyncEngineTests)
+	{
+	public:
+		TEST_METHOD(NothingIsCorrectedBeforeVideo)
+		{
+			AvSyncEngine engine;
+
+			engine.SetAudioOutputLatency(MS(500));
+			for (int i = 0; i < 100; i++) {
+				Assert::AreEqual((int)AvSyncPlay, (int)engine.OnAudioPacket());
+			}
+			Assert::AreEqual(0LL, engine.GetOffsetUs());
+			Assert::AreEqual(0LL, engine.GetCorrections());
+		}
+
+		/* Audio's delay is decoding plus its output queue; the offset is
+		 * how much longer that is than video's */
+		TEST_METHOD(OffsetIncludesDecodeTime)
+		{
+			AvSyncEngine engine;
+
+			PresentFrame(engine, 50);
+			engine.SetAudioOutputLatency(MS(20));
+			engine.OnAudioPacket();
+			AssertOffsetNear(-30000, engine.GetOffsetUs());
+
+			engine.OnAudioDecoded(MS(1000), MS(1005));
+			engine.OnAudioPacket();
+			AssertOffsetNear(-25000, engine.GetOffsetUs());
+		}
+
+		TEST_METHOD(LatenciesAreSmoothed)
+		{
+			AvSyncEngine engine;
+
+			/* The first sample is taken as is, later ones move it by an eighth */
+			PresentFrame(engine, 80);
+			PresentFrame(engine, 0);
+			engine.OnAudioDecoded(0, MS(16));
+			engine.OnAudioDecoded(0, 0);
+			engine.OnAudioPacket();
+
+			AssertOffsetNear(14000 - 70000, engine.GetOffsetUs());
+		}
+
+		TEST_METHOD(AudioBehindIsDropped)
+		{
+			AvSyncEngine engine;
+
+			PresentFrame(engine, 20);
+			engine.SetAudioOutputLatency(MS(100));
+
+			/* Corrections are AV_SYNC_PACKETS_PER_CORRECTION packets apart */
+			for (int correction = 0; correction < 2; correction++) {
+				for (int i = 0; i < AV_SYNC_PACKETS_PER_CORRECTION; i++) {
+					Assert::AreEqual((int)AvSyncPlay, (int)engine.OnAudioPacket());
+				}
+				Assert::AreEqual((int)AvSyncDrop, (int)engine.OnAudioPacket());
+			}
+			Assert::AreEqual(2LL, engine.GetCorrections());
+			AssertOffsetNear(80000, engine.GetOffsetUs());
+		}
+
+		TEST_METHOD(AudioAheadIsPadded)
+		{
+			AvSyncEngine engine;
+
+			PresentFrame(engine, 100);
+			engine.SetAudioOutputLatency(MS(10));
+
+			for (int i = 0; i < AV_SYNC_PACKETS_PER_CORRECTION; i++) {
+				Assert::AreEqual((int)AvSyncPlay, (int)engine.OnAudioPacket());
+			}
+			Assert::AreEqual((int)AvSyncPad, (int)engine.OnAudioPacket());
+			Assert::AreEqual(1LL, engine.GetCorrections());
+		}
+
+		TEST_METHOD(OffsetWithinToleranceIsLeftAlone)
+		{
+			AvSyncEngine engine;
+
+			engine.SetTolerance(60);
+			PresentFrame(engine, 20);
+			engine.SetAudioOutputLatency(MS(70));
+
+			for (int i = 0; i < 100; i++) {
+				Assert::AreEqual((int)AvSyncPlay, (int)engine.OnAudioPacket());
+			}
+			Assert::AreEqual(0LL, engine.GetCorrections());
+		}
+
+		/* The audio device plays slightly slower than the host sends, so its
+		 * queue grows a little with every packet. Each drop takes a packet's
+		 * worth back out, which keeps the offset near the tolerance. */
+		TEST_METHOD(DriftIsHeldNearTolerance)
+		{
+			const int packetCount = 2000;
+			const long long driftPerPacket = MS(1) / 4;
+			AvSyncEngine engine;
+			long long queued = MS(50);
+			long long drops = 0;
+			long long maxOffsetUs = 0;
+
+			PresentFrame(engine, 50);
+			for (int i = 0; i < packetCount; i++) {
+				queued += driftPerPacket;
+				engine.SetAudioOutputLatency(queued);
+
+				if (engine.OnAudioPacket() == AvSyncDrop) {
+					queued -= PACKET_DURATION;
+					drops++;
+				}
+				if (engine.GetOffsetUs() > maxOffsetUs) {
+					maxOffsetUs = engine.GetOffsetUs();
+				}
+			}
+
+			/* The first drop waits for the offset to pass the tolerance, then
+			 * the drops keep up with the drift, which can only build up while
+			 * the next correction is held back */
+			Assert::IsTrue(maxOffsetUs <= DEFAULT_AV_SYNC_TOLERANCE_MS * 1000 +
+				(AV_SYNC_PACKETS_PER_CORRECTION + 1) * driftPerPacket / 10 + OFFSET_SLOP_US);
+			Assert::IsTrue(engine.GetOffsetUs() > 0);
+			Assert::AreEqual(drops, engine.GetCorrections());
+			Assert::IsTrue(drops >= (packetCount * driftPerPacket - MS(DEFAULT_AV_SYNC_TOLERANCE_MS)) / PACKET_DURATION - 1);
+			Assert::IsTrue(drops <= packetCount * driftPerPacket / PACKET_DURATION + 1);
+		}
+
+		TEST_METHOD(ResetForgetsLatencies)
+		{
+			AvSyncEngine engine;
+
+			PresentFrame(engine, 20);
+			engine.SetAudioOutputLatency(MS(100));
+			engine.OnAudioDecoded(0, MS(10));
+			engine.Reset();
+
+			for (int i = 0; i < 100; i++) {
+				Assert::AreEqual((int)AvSyncPlay, (int)engine.OnAudioPacket());
+			}
+
+			PresentFrame(engine, 20);
+			engine.OnAudioPacket();
+			AssertOffsetNear(-20000, engine.GetOffsetUs());
+		}
+	};
+}
@@ -0,0 +1,174 @@
+#include "CppUnitTest.h"
+#include "BitrateController.hpp"
+
+#include <string.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+/* Audio packets per evaluation interval, at Opus's 5 ms frames */
+#define AUDIO_PACKETS_PER_INTERVAL 200
+
+namespace Moonlight_common_binding_Tests
+{
+	TEST_CLASS(BitrateControllerTests)
+	{
+	public:
+		TEST_METHOD_INITIALIZE(Initialize)
+		{
+			StreamMode mode = { 1920, 1080, 60, 10000 };
+
+			m_Controller.Reset(mode, 1000, 20000);
+			memset(&m_Snapshot, 0, sizeof(m_Snapshot));
+			m_Snapshot.receivedFps = 60;
+		}
+
+		TEST_METHOD(BaselineIntervalDecidesNothing)
+		{
+			StreamMode nextMode;
+
+			AddAudio(0, AUDIO_PACKETS_PER_INTERVAL);
+			Assert::IsFalse(m_Controller.Evaluate(m_Snapshot, nextMode));
+		}
+
+		TEST_METHOD(AudioLossBacksOff)
+		{
+			StreamMode nextMode;
+
+			Assert::IsFalse(Interval(10, nextMode));
+			Assert::IsFalse(Interval(10, nextMode));
+
+			/* Two congested intervals in a row */
+			Assert::IsTrue(Interval(10, nextMode));
+			Assert::AreEqual(7000, nextMode.bitrateKbps);
+			Assert::AreEqual(60, nextMode.fps);
+		}
+
+		TEST_METHOD(QueueingDelayBacksOff)
+		{
+			StreamMode nextMode;
+
+			m_Snapshot.queueingDelayUs = ABR_CONGESTED_QUEUEING_DELAY_MS * 1000;
+			Assert::IsFalse(Interval(0, nextMode));
+			Assert::IsFalse(Interval(0, nextMode));
+			Assert::IsTrue(Interval(0, nextMode));
+		}
+
+		/* A game menu rendering at 10 FPS isn't a congested link */
+		TEST_METHOD(LowFrameRateIsNotLoss)
+		{
+			StreamMode nextMode;
+
+			m_Snapshot.receivedFps = 10;
+			for (int i = 0; i < ABR_CLEAN_INTERVALS_TO_INCREASE; i++) {
+				Assert::IsFalse(Interval(0, nextMode));
+			}
+
+			/* Clean, so it probes upward instead */
+			Assert::IsTrue(Interval(0, nextMode));
+			Assert::AreEqual(12000, nextMode.bitrateKbps);
+		}
+
+		/* Frames dropped by the binding and the IDR requests after them mean
+		 * the decoder is behind, which a lower bitrate won't fix */
+		TEST_METHOD(LocalDropsAreNotLoss)
+		{
+			StreamMode nextMode;
+
+			for (int i = 0; i < ABR_CLEAN_INTERVALS_TO_INCREASE * 2; i++) {
+				m_Snapshot.framesDropped += 30;
+				m_Snapshot.idrRequests += 5;
+				if (Interval(0, nextMode)) {
+					Assert::IsTrue(nextMode.bitrateKbps > 10000);
+				}
+			}
+		}
+
+		TEST_METHOD(CleanIntervalsProbeUpToTheMax)
+		{
+			StreamMode nextMode;
+			StreamMode mode = { 1920, 1080, 60, 19000 };
+
+			m_Controller.Reset(mode, 1000, 20000);
+			Interval(0, nextMode);
+			for (int i = 0; i < ABR_CLEAN_INTERVALS_TO_INCREASE - 1; i++) {
+				Assert::IsFalse(Interval(0, nextMode));
+			}
+			Assert::IsTrue(Interval(0, nextMode));
+			Assert::AreEqual(20000, nextMode.bitrateKbps);
+			m_Controller.Commit(nextMode);
+
+			/* Already at the max, so nothing more to do */
+			for (int i = 0; i < ABR_SETTLE_INTERVALS + ABR_CLEAN_INTERVALS_TO_INCREASE * 2; i++) {
+				Assert::IsFalse(Interval(0, nextMode));
+			}
+		}
+
+		TEST_METHOD(CommitWaitsForTheStreamToSettle)
+		{
+			StreamMode nextMode;
+
+			Interval(10, nextMode);
+			Interval(10, nextMode);
+			Assert::IsTrue(Interval(10, nextMode));
+			m_Controller.Commit(nextMode);
+
+			/* A new baseline, then the settle intervals */
+			for (int i = 0; i < 1 + ABR_SETTLE_INTERVALS; i++) {
+				Assert::IsFalse(Interval(10, nextMode));
+			}
+			Assert::IsFalse(Interval(10, nextMode));
+			Assert::IsTrue(Interval(10, nextMode));
+			Assert::AreEqual(4900, nextMode.bitrateKbps);
+		}
+
+		TEST_METHOD(StepsDownTheLadder)
+		{
+			StreamMode nextMode;
+			int expectedBitrates[] = { 7000, 4900, 3430, 2401 };
+			int expectedFps[] = { 60, 30, 30, 30 };
+			int expectedHeights[] = { 1080, 1080, 1080, 720 };
+
+			Interval(10, nextMode);
+			for (int step = 0; step < 4; step++) {
+				while (!Interval(10, nextMode));
+
+				Assert::AreEqual(expectedBitrates[step], nextMode.bitrateKbps);
+				Assert::AreEqual(expectedFps[step], nextMode.fps);
+				Assert::AreEqual(expectedHeights[step], nextMode.height);
+				m_Controller.Commit(nextMode);
+			}
+
+			Assert::AreEqual(1280, m_Controller.GetCurrentMode().width);
+		}
+
+		TEST_METHOD(ModeForBitrate)
+		{
+			Assert::AreEqual(60, m_Controller.GetModeForBitrate(8000).fps);
+			Assert::AreEqual(30, m_Controller.GetModeForBitrate(4000).fps);
+			Assert::AreEqual(1080, m_Controller.GetModeForBitrate(4000).height);
+			Assert::AreEqual(720, m_Controller.GetModeForBitrate(2000).height);
+
+			/* Clamped to the configured range */
+			Assert::AreEqual(1000, m_Controller.GetModeForBitrate(10).bitrateKbps);
+			Assert::AreEqual(20000, m_Controller.GetModeForBitrate(50000).bitrateKbps);
+		}
+
+	private:
+		void AddAudio(int lossPercent, int packets) {
+			int lost = packets * lossPercent / 100;
+
+			m_Snapshot.audioPacketsLost += lost;
+			m_Snapshot.audioPacketsDecoded += packets - lost;
+		}
+
+		/* Advances the counters by one interval with the given audio loss */
+		bool Interval(int lossPercent, StreamMode &nextMode) {
+			AddAudio(lossPercent, AUDIO_PACKETS_PER_INTERVAL);
+			return m_Controller.Evaluate(m_Snapshot, nextMode);
+		}
+
+		BitrateController m_Controller;
+		StatisticsSnapshot m_Snapshot;
+	};
+}
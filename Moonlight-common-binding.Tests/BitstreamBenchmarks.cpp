@@ -0,0 +1,288 @@
+#include "CppUnitTest.h"
+#include "LengthPrefixWriter.hpp"
+#include "NalParser.hpp"
+#include "PacketizationStatistics.hpp"
+#include "ParameterSetCache.hpp"
+#include "TestBitstream.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+/* Roughly a 1080p IDR frame and a P frame at 20 Mbps */
+#define BENCHMARK_IDR_FRAME_SIZE (256 * 1024)
+#define BENCHMARK_P_FRAME_SIZE (40 * 1024)
+#define BENCHMARK_ITERATIONS 200
+
+/* A full video packet at the largest packet size */
+#define BENCHMARK_FRAGMENT_SIZE 1392
+
+/* A 4K IDR frame, which is what streaming stores were meant to help */
+#define BENCHMARK_4K_IDR_FRAME_SIZE (1024 * 1024)
+
+/* Received packets are spread over more memory than the caches hold, so
+ * assembly reads them cold the way it does during a stream */
+#define BENCHMARK_PACKET_POOL_SIZE (32 * 1024 * 1024)
+#define BENCHMARK_PACKET_HEADER_SIZE 16
+
+/* Covers every NAL unit in front of the slice in the test frames */
+#define BENCHMARK_HEADER_BYTES 64
+
+namespace Moonlight_common_binding_Tests
+{
+	static std::vector<unsigned char> BuildIdrFrame(NalFormat format, NalPacking packing, int size) {
+		if (format == NalFormatHevc) {
+			return BuildFrame(packing, { HevcAud, HevcVps, HevcSps, HevcPps, BuildSlice(HevcIdrSlice, size, 1) });
+		}
+		return BuildFrame(packing, { H264Aud, H264Sps, H264Pps, BuildSlice(H264IdrSlice, size, 1) });
+	}
+
+#if defined(_M_IX86) || defined(_M_X64)
+	/* The non-temporal copy frames used to be assembled with, kept here to
+	 * show why they aren't any more */
+	static void StreamingCopy(unsigned char *destination, const unsigned char *source, int length) {
+		int head = (int)((16 - ((uintptr_t)destination & 15)) & 15);
+
+		if (head > length) {
+			head = length;
+		}
+		memcpy(destination, source, head);
+		destination += head;
+		source += head;
+		length -= head;
+
+		while (length >= 16) {
+			_mm_stream_si128((__m128i*)destination, _mm_loadu_si128((const __m128i*)source));
+			source += 16;
+			destination += 16;
+			length -= 16;
+		}
+
+		memcpy(destination, source, length);
+	}
+#endif
+
+	/* Times fn over BENCHMARK_ITERATIONS runs and logs the per-run cost,
+	 * and the scan rate if it reads scannedBytes. These report numbers
+	 * rather than assert them, since they run on whatever machine builds
+	 * the tests. */
+	template <typename Fn> static void Measure(const char *name, int scannedBytes, Fn fn) {
+		char message[256];
+		long long ns;
+
+		/* Warm up the caches */
+		fn();
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+			fn();
+		}
+		ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() /
+			BENCHMARK_ITERATIONS;
+
+		if (scannedBytes > 0 && ns > 0) {
+			sprintf(message, "%s: %lld ns per frame, %.0f MB/s", name, ns, scannedBytes * 1000.0 / ns);
+		}
+		else {
+			sprintf(message, "%s: %lld ns per frame", name, ns);
+		}
+		Logger::WriteMessage(message);
+	}
+
+	TEST_CLASS(BitstreamBenchmarks)
+	{
+	public:
+		/* Only the headers are read, so this shouldn't grow with the frame */
+		TEST_METHOD(ClassifyFrame)
+		{
+			for (int format = NalFormatH264; format <= NalFormatHevc; format++) {
+				std::vector<unsigned char> frame = BuildIdrFrame((NalFormat)format, NalPackingAnnexB, BENCHMARK_IDR_FRAME_SIZE);
+				FrameClass frameClass = FrameClassReference;
+
+				Measure(format == NalFormatHevc ? "HEVC ClassifyFrame" : "H.264 ClassifyFrame", 0, [&] {
+					frameClass = Moonlight_common_binding::ClassifyFrame((NalFormat)format, NalPackingAnnexB, frame.data(), (int)frame.size());
+				});
+				Assert::AreEqual((int)FrameClassIdr, (int)frameClass);
+			}
+		}
+
+		/* Walking every NAL unit has to scan the whole frame for start codes */
+		TEST_METHOD(ReadNalUnit)
+		{
+			std::vector<unsigned char> frame = BuildIdrFrame(NalFormatH264, NalPackingAnnexB, BENCHMARK_IDR_FRAME_SIZE);
+			int count = 0;
+
+			Measure("Annex B ReadNalUnit", (int)frame.size(), [&] {
+				NalUnit nal;
+				int offset = 0;
+
+				count = 0;
+				while (Moonlight_common_binding::ReadNalUnit(frame.data(), (int)frame.size(), NalPackingAnnexB, offset, nal)) {
+					count++;
+				}
+			});
+			Assert::AreEqual(4, count);
+		}
+
+		/* The strip path, which runs on every IDR frame once the sets are cached */
+		TEST_METHOD(ParameterSetCacheProcess)
+		{
+			for (int format = NalFormatH264; format <= NalFormatHevc; format++) {
+				for (int packing = NalPackingAnnexB; packing <= NalPackingLengthPrefixed; packing++) {
+					std::vector<unsigned char> frame = BuildIdrFrame((NalFormat)format, (NalPacking)packing, BENCHMARK_IDR_FRAME_SIZE);
+					std::vector<unsigned char> buffer(PARAMETER_SET_HEADROOM + frame.size());
+					ParameterSetCache cache;
+					char name[64];
+					int stripped = 0;
+
+					cache.Reset((NalFormat)format, (NalPacking)packing);
+					sprintf(name, "%s %s Process", format == NalFormatHevc ? "HEVC" : "H.264",
+						packing == NalPackingLengthPrefixed ? "length-prefixed" : "Annex B");
+
+					std::copy(frame.begin(), frame.end(), buffer.begin() + PARAMETER_SET_HEADROOM);
+					Measure(name, 0, [&] {
+						int offset = PARAMETER_SET_HEADROOM;
+						int length = (int)frame.size();
+
+						/* Stripping only moves what's in front of the slice, so
+						 * only that needs putting back */
+						std::copy(frame.begin(), frame.begin() + BENCHMARK_HEADER_BYTES, buffer.begin() + offset);
+						stripped = cache.Process(buffer.data(), offset, length);
+					});
+					Assert::AreEqual(format == NalFormatHevc ? 3 : 2, stripped);
+				}
+			}
+		}
+
+		/* Converting while the fragments are copied in, against copying
+		 * them and then converting the assembled frame */
+		TEST_METHOD(LengthPrefixedAssembly)
+		{
+			std::vector<unsigned char> frame = BuildIdrFrame(NalFormatH264, NalPackingAnnexB, BENCHMARK_IDR_FRAME_SIZE);
+			std::vector<unsigned char> assembled(frame.size());
+			std::vector<unsigned char> direct(GetLengthPrefixedBound((int)frame.size()));
+			std::vector<unsigned char> postHoc(GetLengthPrefixedBound((int)frame.size()));
+			LengthPrefixWriter writer;
+			int directLength = 0;
+			int postHocLength = 0;
+
+			Measure("Annex B assembly", (int)frame.size(), [&] {
+				for (size_t offset = 0; offset < frame.size(); offset += BENCHMARK_FRAGMENT_SIZE) {
+					memcpy(&assembled[offset], &frame[offset], std::min((size_t)BENCHMARK_FRAGMENT_SIZE, frame.size() - offset));
+				}
+			});
+
+			Measure("LengthPrefixWriter assembly", (int)frame.size(), [&] {
+				writer.Begin(direct.data());
+				for (size_t offset = 0; offset < frame.size(); offset += BENCHMARK_FRAGMENT_SIZE) {
+					writer.Append(&frame[offset], (int)std::min((size_t)BENCHMARK_FRAGMENT_SIZE, frame.size() - offset));
+				}
+				directLength = writer.Finish();
+			});
+
+			Measure("Annex B assembly then conversion", (int)frame.size(), [&] {
+				for (size_t offset = 0; offset < frame.size(); offset += BENCHMARK_FRAGMENT_SIZE) {
+					memcpy(&assembled[offset], &frame[offset], std::min((size_t)BENCHMARK_FRAGMENT_SIZE, frame.size() - offset));
+				}
+				postHocLength = ConvertToLengthPrefixed(assembled.data(), (int)assembled.size(), postHoc.data());
+			});
+
+			Assert::AreEqual(postHocLength, directLength);
+			Assert::IsTrue(memcmp(direct.data(), postHoc.data(), directLength) == 0);
+		}
+
+		/* Assembles frames of each size from packets of each size, then
+		 * copies the frame again the way the frame pacer and the managed
+		 * renderer do straight away. The copy back is why assembly uses
+		 * memcpy: streaming stores push the frame out to memory, only for
+		 * it to be read straight back. */
+		TEST_METHOD(FrameAssembly)
+		{
+			static const int frameSizes[] = { BENCHMARK_P_FRAME_SIZE, BENCHMARK_IDR_FRAME_SIZE, BENCHMARK_4K_IDR_FRAME_SIZE };
+			static const int packetSizes[] = { PACKET_SIZE_MIN, PACKET_SIZE_DEFAULT, PACKET_SIZE_MAX };
+			std::vector<unsigned char> pool(BENCHMARK_PACKET_POOL_SIZE, 0x5A);
+			std::vector<unsigned char> assembled(BENCHMARK_4K_IDR_FRAME_SIZE);
+			std::vector<unsigned char> consumer(BENCHMARK_4K_IDR_FRAME_SIZE);
+			size_t poolOffset = 0;
+
+			for (int frameSize : frameSizes) {
+				for (int packetSize : packetSizes) {
+					std::vector<const unsigned char*> fragments;
+					std::vector<int> lengths;
+					char name[128];
+
+					/* Full packets with a partial one at the end, each behind
+					 * its header in the next packet buffer of the pool */
+					auto nextFrame = [&] {
+						fragments.clear();
+						lengths.clear();
+						for (int offset = 0; offset < frameSize; offset += packetSize) {
+							if (poolOffset + BENCHMARK_PACKET_HEADER_SIZE + packetSize > pool.size()) {
+								poolOffset = 0;
+							}
+							fragments.push_back(&pool[poolOffset + BENCHMARK_PACKET_HEADER_SIZE]);
+							lengths.push_back(std::min(packetSize, frameSize - offset));
+							poolOffset += BENCHMARK_PACKET_HEADER_SIZE + packetSize;
+						}
+					};
+
+					sprintf(name, "%d KB frame from %d byte packets, memcpy", frameSize / 1024, packetSize);
+					Measure(name, frameSize, [&] {
+						int offset = 0;
+
+						nextFrame();
+						for (size_t i = 0; i < fragments.size(); i++) {
+							memcpy(&assembled[offset], fragments[i], lengths[i]);
+							offset += lengths[i];
+						}
+						memcpy(consumer.data(), assembled.data(), frameSize);
+					});
+
+#if defined(_M_IX86) || defined(_M_X64)
+					sprintf(name, "%d KB frame from %d byte packets, streaming", frameSize / 1024, packetSize);
+					Measure(name, frameSize, [&] {
+						int offset = 0;
+
+						nextFrame();
+						for (size_t i = 0; i < fragments.size(); i++) {
+							StreamingCopy(&assembled[offset], fragments[i], lengths[i]);
+							offset += lengths[i];
+						}
+						_mm_sfence();
+						memcpy(consumer.data(), assembled.data(), frameSize);
+					});
+#endif
+
+					Assert::IsTrue(memcmp(consumer.data(), assembled.data(), frameSize) == 0);
+				}
+			}
+		}
+
+		/* Frames with no parameter sets stop at the first slice */
+		TEST_METHOD(ParameterSetCacheProcessPFrame)
+		{
+			std::vector<unsigned char> frame = BuildFrame(NalPackingAnnexB, { H264Aud, BuildSlice(H264PSlice, BENCHMARK_P_FRAME_SIZE, 2) });
+			std::vector<unsigned char> buffer(PARAMETER_SET_HEADROOM + frame.size());
+			ParameterSetCache cache;
+			int stripped = -1;
+
+			std::copy(frame.begin(), frame.end(), buffer.begin() + PARAMETER_SET_HEADROOM);
+			Measure("H.264 P frame Process", 0, [&] {
+				int offset = PARAMETER_SET_HEADROOM;
+				int length = (int)frame.size();
+
+				stripped = cache.Process(buffer.data(), offset, length);
+			});
+			Assert::AreEqual(0, stripped);
+		}
+	};
+}
@@ -0,0 +1,131 @@
+/* Stand-ins for Common's input functions */
+#include "FakeLimelight.hpp"
+
+#include <Limelight.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string.h>
+#include <thread>
+
+using namespace Moonlight_common_binding_Tests;
+
+static std::mutex s_Lock;
+static std::condition_variable s_SentCond;
+static std::vector<SentInput> s_Sent;
+static std::atomic<int> s_SendDelayMs;
+static std::function<void(const SentInput &input)> s_SendHook;
+
+static void Record(SentInput &input) {
+	if (s_SendDelayMs != 0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(s_SendDelayMs));
+	}
+	if (s_SendHook) {
+		s_SendHook(input);
+	}
+
+	std::lock_guard<std::mutex> lock(s_Lock);
+	s_Sent.push_back(input);
+	s_SentCond.notify_all();
+}
+
+static SentInput MakeInput(SentInputType type) {
+	SentInput input;
+
+	memset(&input, 0, sizeof(input));
+	input.type = type;
+	return input;
+}
+
+void FakeLimelight::Reset(void) {
+	std::lock_guard<std::mutex> lock(s_Lock);
+	s_Sent.clear();
+	s_SendDelayMs = 0;
+	s_SendHook = nullptr;
+}
+
+void FakeLimelight::SetSendHook(std::function<void(const SentInput &input)> hook) {
+	s_SendHook = hook;
+}
+
+void FakeLimelight::SetSendDelay(int delayMs) {
+	s_SendDelayMs = delayMs;
+}
+
+std::vector<SentInput> FakeLimelight::GetSent(void) {
+	std::lock_guard<std::mutex> lock(s_Lock);
+	return s_Sent;
+}
+
+bool FakeLimelight::WaitForSent(size_t count, int timeoutMs) {
+	std::unique_lock<std::mutex> lock(s_Lock);
+	return s_SentCond.wait_for(lock, std::chrono::milliseconds(timeoutMs), [count] { return s_Sent.size() >= count; });
+}
+
+int LiSendMouseMoveEvent(short deltaX, short deltaY) {
+	SentInput input = MakeInput(SentMouseMove);
+
+	input.deltaX = deltaX;
+	input.deltaY = deltaY;
+	Record(input);
+	return 0;
+}
+
+int LiSendMouseButtonEvent(char action, int button) {
+	SentInput input = MakeInput(SentMouseButton);
+
+	input.action = action;
+	input.button = button;
+	Record(input);
+	return 0;
+}
+
+int LiSendKeyboardEvent(short keyCode, char keyAction, char modifiers) {
+	SentInput input = MakeInput(SentKeyboard);
+
+	input.keyCode = keyCode;
+	input.action = keyAction;
+	input.modifiers = modifiers;
+	Record(input);
+	return 0;
+}
+
+int LiSendControllerEvent(short buttonFlags, unsigned char leftTrigger, unsigned char rightTrigger,
+	short leftStickX, short leftStickY, short rightStickX, short rightStickY) {
+	SentInput input = MakeInput(SentController);
+
+	input.buttonFlags = buttonFlags;
+	input.leftTrigger = leftTrigger;
+	input.rightTrigger = rightTrigger;
+	input.leftStickX = leftStickX;
+	input.leftStickY = leftStickY;
+	input.rightStickX = rightStickX;
+	input.rightStickY = rightStickY;
+	Record(input);
+	return 0;
+}
+
+int LiSendMultiControllerEvent(short controllerNumber, short buttonFlags, unsigned char leftTrigger, unsigned char rightTrigger,
+	short leftStickX, short leftStickY, short rightStickX, short rightStickY) {
+	SentInput input = MakeInput(SentMultiController);
+
+	input.controllerNumber = controllerNumber;
+	input.buttonFlags = buttonFlags;
+	input.leftTrigger = leftTrigger;
+	input.rightTrigger = rightTrigger;
+	input.leftStickX = leftStickX;
+	input.leftStickY = leftStickY;
+	input.rightStickX = rightStickX;
+	input.rightStickY = rightStickY;
+	Record(input);
+	return 0;
+}
+
+int LiSendScrollEvent(signed char scrollClicks) {
+	SentInput input = MakeInput(SentScroll);
+
+	input.scrollClicks = scrollClicks;
+	Record(input);
+	return 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+#include <vector>
+
+namespace Moonlight_common_binding_Tests
+{
+	enum SentInputType {
+		SentMouseMove,
+		SentMouseButton,
+		SentKeyboard,
+		SentController,
+		SentMultiController,
+		SentScroll
+	};
+
+	/* One call the binding made into Common's input API */
+	struct SentInput
+	{
+		SentInputType type;
+		short controllerNumber;
+		short buttonFlags;
+		unsigned char leftTrigger;
+		unsigned char rightTrigger;
+		short leftStickX;
+		short leftStickY;
+		short rightStickX;
+		short rightStickY;
+		short deltaX;
+		short deltaY;
+		char action;
+		int button;
+		short keyCode;
+		char modifiers;
+		signed char scrollClicks;
+	};
+
+	/* The test DLL links these in place of Common's input functions so
+	 * tests can see what would have gone to the host */
+	namespace FakeLimelight
+	{
+		void Reset(void);
+
+		/* Makes each call block for a while, like a slow send */
+		void SetSendDelay(int delayMs);
+
+		/* Called on the sending thread for each call, after the delay, to
+		 * hand the input on to a stand-in host. Set it only while nothing
+		 * is sending. */
+		void SetSendHook(std::function<void(const SentInput &input)> hook);
+
+		std::vector<SentInput> GetSent(void);
+
+		/* Waits until at least count calls have been made. Returns false
+		 * if that didn't happen within the timeout. */
+		bool WaitForSent(size_t count, int timeoutMs);
+	}
+}
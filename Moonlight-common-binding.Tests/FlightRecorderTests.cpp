@@ -0,0 +1,261 @@
+#include "CppUnitTest.h"
+#include "FlightRecorder.hpp"
+
+#include <Windows.h>
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+#define DUMP_HEADER_SIZE 20
+#define DUMP_RECORD_SIZE 20
+
+namespace Moonlight_common_binding_Tests
+{
+	struct DumpedRecord
+	{
+		long long time;
+		long long value;
+		int type;
+		int detail;
+	};
+
+	static unsigned long long ReadLittleEndian(const std::vector<unsigned char> &dump, size_t offset, int size) {
+		unsigned long long value = 0;
+
+		for (int i = 0; i < size; i++) {
+			value |= (unsigned long long)dump[offset + i] << (i * 8);
+		}
+		return value;
+	}
+
+	/* Checks the header and returns the records that follow it */
+	static std::vector<DumpedRecord> ParseDump(const std::vector<unsigned char> &dump) {
+		std::vector<DumpedRecord> records;
+		LARGE_INTEGER frequency;
+		unsigned int count;
+		size_t offset;
+
+		QueryPerformanceFrequency(&frequency);
+
+		Assert::IsTrue(dump.size() >= DUMP_HEADER_SIZE);
+		Assert::AreEqual(0, memcmp(dump.data(), FLIGHT_RECORDER_DUMP_MAGIC, 4));
+		Assert::AreEqual((unsigned long long)FLIGHT_RECORDER_DUMP_VERSION, ReadLittleEndian(dump, 4, 4));
+		Assert::AreEqual((unsigned long long)frequency.QuadPart, ReadLittleEndian(dump, 8, 8));
+
+		count = (unsigned int)ReadLittleEndian(dump, 16, 4);
+		Assert::AreEqual((size_t)DUMP_HEADER_SIZE + (size_t)count * DUMP_RECORD_SIZE, dump.size());
+
+		for (unsigned int i = 0; i < count; i++) {
+			DumpedRecord record;
+
+			offset = DUMP_HEADER_SIZE + (size_t)i * DUMP_RECORD_SIZE;
+			record.time = (long long)ReadLittleEndian(dump, offset, 8);
+			record.value = (long long)ReadLittleEndian(dump, offset + 8, 8);
+			record.type = (int)ReadLittleEndian(dump, offset + 16, 2);
+			record.detail = (int)ReadLittleEndian(dump, offset + 18, 2);
+			records.push_back(record);
+		}
+		return records;
+	}
+
+	/* Waits for the background writer to finish the file at path. It's
+	 * whole once it holds as many records as its header says. */
+	static std::vector<unsigned char> ReadTerminationDump(const char *path) {
+		std::vector<unsigned char> dump;
+		unsigned char buffer[4096];
+		size_t length;
+		FILE *file;
+
+		for (int i = 0; i < 5000; i++, Sleep(1)) {
+			file = fopen(path, "rb");
+			if (file == NULL) {
+				continue;
+			}
+
+			dump.clear();
+			while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+				dump.insert(dump.end(), buffer, buffer + length);
+			}
+			fclose(file);
+
+			if (dump.size() >= DUMP_HEADER_SIZE &&
+				dump.size() == DUMP_HEADER_SIZE + ReadLittleEndian(dump, 16, 4) * DUMP_RECORD_SIZE) {
+				return dump;
+			}
+		}
+
+		Assert::Fail(L"Termination dump was never written");
+		return dump;
+	}
+
+	/* The ring is shared by the whole process, so each test starts by
+	 * overwriting whatever other tests left in it */
+	static void FillRing(void) {
+		for (int i = 0; i < FLIGHT_RECORDER_CAPACITY; i++) {
+			RecordFlightEvent(FlightReconnecting, 0, 0);
+		}
+	}
+
+	TEST_CLASS(FlightRecorderTests)
+	{
+	public:
+		TEST_METHOD_INITIALIZE(Initialize)
+		{
+			SetFlightRecorderEnabled(true);
+			FillRing();
+		}
+
+		TEST_METHOD(DumpKeepsFieldsAndOrder)
+		{
+			std::vector<DumpedRecord> records;
+			size_t last;
+
+			RecordFlightEvent(FlightFrameReceived, 12, 40000);
+			RecordFlightEvent(FlightConnectionTerminated, 0, -1);
+			RecordFlightEvent(FlightStageFailed, 0xFFFF, 0x123456789ALL);
+
+			records = ParseDump(DumpFlightRecorder(60));
+			Assert::AreEqual((size_t)FLIGHT_RECORDER_CAPACITY, records.size());
+
+			last = records.size() - 1;
+			Assert::AreEqual((int)FlightFrameReceived, records[last - 2].type);
+			Assert::AreEqual(12, records[last - 2].detail);
+			Assert::AreEqual(40000LL, records[last - 2].value);
+			Assert::AreEqual((int)FlightConnectionTerminated, records[last - 1].type);
+			Assert::AreEqual(-1LL, records[last - 1].value);
+			Assert::AreEqual((int)FlightStageFailed, records[last].type);
+			Assert::AreEqual(0xFFFF, records[last].detail);
+			Assert::AreEqual(0x123456789ALL, records[last].value);
+
+			for (size_t i = 1; i < records.size(); i++) {
+				Assert::IsTrue(records[i].time >= records[i - 1].time);
+			}
+		}
+
+		TEST_METHOD(OldestRecordsAreOverwritten)
+		{
+			std::vector<DumpedRecord> records;
+
+			for (int i = 0; i < FLIGHT_RECORDER_CAPACITY + 100; i++) {
+				RecordFlightEvent(FlightInputSent, 0, i);
+			}
+
+			records = ParseDump(DumpFlightRecorder(60));
+			Assert::AreEqual((size_t)FLIGHT_RECORDER_CAPACITY, records.size());
+			for (size_t i = 0; i < records.size(); i++) {
+				Assert::AreEqual((long long)(100 + i), records[i].value);
+			}
+		}
+
+		TEST_METHOD(DisabledRecorderRecordsNothing)
+		{
+			std::vector<DumpedRecord> records;
+
+			SetFlightRecorderEnabled(false);
+			RecordFlightEvent(FlightDecoderReset, 0, 1);
+			SetFlightRecorderEnabled(true);
+
+			records = ParseDump(DumpFlightRecorder(60));
+			for (size_t i = 0; i < records.size(); i++) {
+				Assert::AreNotEqual((int)FlightDecoderReset, records[i].type);
+			}
+		}
+
+		TEST_METHOD(DumpLeavesOutOlderRecords)
+		{
+			std::vector<DumpedRecord> records;
+
+			Sleep(1100);
+			RecordFlightEvent(FlightIdrRequested, 0, 1);
+			RecordFlightEvent(FlightIdrRequested, 0, 2);
+
+			records = ParseDump(DumpFlightRecorder(1));
+			Assert::AreEqual((size_t)2, records.size());
+			Assert::AreEqual(1LL, records[0].value);
+			Assert::AreEqual(2LL, records[1].value);
+		}
+
+		/* The dump is written in the background, but ends where it was
+		 * asked for, so what's recorded after that isn't in it */
+		TEST_METHOD(TerminationDumpEndsWhenRequested)
+		{
+			std::vector<DumpedRecord> records;
+
+			remove("flight-recorder-test.mlfr");
+			SetFlightRecorderTerminationPath(L"flight-recorder-test.mlfr");
+
+			RecordFlightEvent(FlightConnectionTerminated, 0, 1);
+			WriteFlightRecorderTerminationDump();
+			for (int i = 0; i < 100; i++) {
+				RecordFlightEvent(FlightReconnecting, 0, 2);
+			}
+
+			records = ParseDump(ReadTerminationDump("flight-recorder-test.mlfr"));
+			SetFlightRecorderTerminationPath(L"");
+			remove("flight-recorder-test.mlfr");
+
+			/* The later records may have overwritten the oldest ones first */
+			Assert::IsTrue(records.size() >= FLIGHT_RECORDER_CAPACITY - 100);
+			Assert::AreEqual((int)FlightConnectionTerminated, records.back().type);
+			Assert::AreEqual(1LL, records.back().value);
+		}
+
+		/* Records are written without a lock while a dump runs. Every record
+		 * that makes it into a dump must be whole, so its detail has to
+		 * match its value, and each thread's records keep their order. */
+		TEST_METHOD(DumpWhileRecordingHasNoTornRecords)
+		{
+			const int threadCount = 4;
+			const int dumpCount = 20;
+			std::vector<std::thread> threads;
+			std::atomic<bool> stop(false);
+			std::vector<std::vector<unsigned char>> dumps;
+			std::vector<DumpedRecord> records;
+			long long lastValue[threadCount];
+			int thread;
+
+			for (int i = 0; i < threadCount; i++) {
+				threads.push_back(std::thread([i, &stop] {
+					for (long long n = 0; !stop; n++) {
+						RecordFlightEvent(FlightInputSent, i, ((long long)i << 32) | n);
+					}
+				}));
+			}
+
+			for (int i = 0; i < dumpCount; i++) {
+				dumps.push_back(DumpFlightRecorder(60));
+			}
+
+			/* Checked once the writers are stopped, so a failure can't leave them running */
+			stop = true;
+			for (size_t i = 0; i < threads.size(); i++) {
+				threads[i].join();
+			}
+
+			for (size_t dump = 0; dump < dumps.size(); dump++) {
+				records = ParseDump(dumps[dump]);
+				for (int i = 0; i < threadCount; i++) {
+					lastValue[i] = -1;
+				}
+
+				for (size_t i = 0; i < records.size(); i++) {
+					if (records[i].type != FlightInputSent) {
+						Assert::AreEqual((int)FlightReconnecting, records[i].type);
+						continue;
+					}
+
+					thread = (int)(records[i].value >> 32);
+					Assert::IsTrue(thread >= 0 && thread < threadCount);
+					Assert::AreEqual(records[i].detail, thread);
+					Assert::IsTrue(records[i].value > lastValue[thread]);
+					lastValue[thread] = records[i].value;
+				}
+			}
+		}
+	};
+}
@@ -0,0 +1,83 @@
+#include "CppUnitTest.h"
+#include "FrameDropPolicy.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+#define TEST_FRAME_RATE 60
+
+namespace Moonlight_common_binding_Tests
+{
+	TEST_CLASS(FrameDropPolicyTests)
+	{
+	public:
+		TEST_METHOD_INITIALIZE(Initialize)
+		{
+			LARGE_INTEGER frequency;
+
+			QueryPerformanceFrequency(&frequency);
+			m_Interval = frequency.QuadPart / TEST_FRAME_RATE;
+			m_Policy.Reset(TEST_FRAME_RATE);
+		}
+
+		TEST_METHOD(KeepsUpWithoutDropping)
+		{
+			m_Policy.OnFrameSubmitted(m_Interval / 2);
+			Assert::AreEqual((int)FrameSubmit, (int)m_Policy.Decide(FrameClassNonReference));
+			Assert::AreEqual((int)FrameSubmit, (int)m_Policy.Decide(FrameClassReference));
+		}
+
+		/* Each dropped non-reference frame wins back one interval */
+		TEST_METHOD(DropsNonReferenceFramesFirst)
+		{
+			m_Policy.OnFrameSubmitted(m_Interval * 3);
+			Assert::AreEqual((int)FrameSubmit, (int)m_Policy.Decide(FrameClassReference));
+			Assert::AreEqual((int)FrameDrop, (int)m_Policy.Decide(FrameClassNonReference));
+			Assert::AreEqual((int)FrameDrop, (int)m_Policy.Decide(FrameClassNonReference));
+			Assert::AreEqual((int)FrameSubmit, (int)m_Policy.Decide(FrameClassNonReference));
+		}
+
+		TEST_METHOD(DeepBacklogSkipsToNextIdr)
+		{
+			m_Policy.OnFrameSubmitted(m_Interval * (DROP_REFERENCE_BACKLOG_FRAMES + 1));
+			Assert::AreEqual((int)FrameDropAndRequestIdr, (int)m_Policy.Decide(FrameClassReference));
+
+			/* Nothing can be decoded until the IDR frame */
+			Assert::AreEqual((int)FrameDrop, (int)m_Policy.Decide(FrameClassReference));
+			Assert::AreEqual((int)FrameDrop, (int)m_Policy.Decide(FrameClassNonReference));
+			Assert::AreEqual((int)FrameSubmit, (int)m_Policy.Decide(FrameClassIdr));
+
+			m_Policy.OnFrameSubmitted(0);
+			Assert::AreEqual((int)FrameSubmit, (int)m_Policy.Decide(FrameClassReference));
+			Assert::AreEqual((int)FrameSubmit, (int)m_Policy.Decide(FrameClassNonReference));
+		}
+
+		TEST_METHOD(IdrFrameIsNeverDropped)
+		{
+			m_Policy.OnFrameSubmitted(m_Interval * (DROP_REFERENCE_BACKLOG_FRAMES + 1));
+			Assert::AreEqual((int)FrameSubmit, (int)m_Policy.Decide(FrameClassIdr));
+		}
+
+		TEST_METHOD(ResetForgetsBacklog)
+		{
+			m_Policy.OnFrameSubmitted(m_Interval * (DROP_REFERENCE_BACKLOG_FRAMES + 1));
+			Assert::AreEqual((int)FrameDropAndRequestIdr, (int)m_Policy.Decide(FrameClassReference));
+
+			m_Policy.Reset(TEST_FRAME_RATE);
+			Assert::AreEqual((int)FrameSubmit, (int)m_Policy.Decide(FrameClassNonReference));
+		}
+
+		/* Without a frame rate there's no interval to measure the backlog in */
+		TEST_METHOD(UnknownFrameRateNeverDrops)
+		{
+			m_Policy.Reset(0);
+			m_Policy.OnFrameSubmitted(m_Interval * (DROP_REFERENCE_BACKLOG_FRAMES + 1));
+			Assert::AreEqual((int)FrameSubmit, (int)m_Policy.Decide(FrameClassNonReference));
+			Assert::AreEqual((int)FrameSubmit, (int)m_Policy.Decide(FrameClassReference));
+		}
+
+	private:
+		FrameDropPolicy m_Policy;
+		LONGLONG m_Interval;
+	};
+}
@@ -0,0 +1,259 @@
+#include "CppUnitTest.h"
+#include "FramePacer.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <stdlib.h>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+#define TEST_REFRESH_RATE_HZ 60
+
+namespace Moonlight_common_binding_Tests
+{
+	/* A simulated display that remembers when its last refresh was */
+	class RecordingVsyncSource final : public IVsyncSource
+	{
+	public:
+		RecordingVsyncSource() :
+			m_Source(TEST_REFRESH_RATE_HZ), m_LastVsync(0)
+		{
+		}
+
+		bool WaitForVsync(LONGLONG &vsyncTime) override {
+			if (!m_Source.WaitForVsync(vsyncTime)) {
+				return false;
+			}
+			m_LastVsync = vsyncTime;
+			return true;
+		}
+
+		LONGLONG GetLastVsync(void) {
+			return m_LastVsync;
+		}
+
+	private:
+		SimulatedVsyncSource m_Source;
+		std::atomic<LONGLONG> m_LastVsync;
+	};
+
+	struct ReleasedFrame
+	{
+		const unsigned char *data;
+		int length;
+		unsigned char id;
+		LONGLONG releaseTime;
+		LONGLONG lastVsync;
+	};
+
+	/* Records which frames the pacer released and when */
+	class RecordingRenderer final : public IVideoRenderer
+	{
+	public:
+		RecordingRenderer(RecordingVsyncSource *vsyncSource) :
+			m_VsyncSource(vsyncSource)
+		{
+		}
+
+		void Setup(int width, int height, int redrawRate, int drFlags) override {
+		}
+
+		void Cleanup(void) override {
+		}
+
+		int SubmitDecodeUnit(const unsigned char *data, int length, long long receiveTime) override {
+			ReleasedFrame frame;
+			LARGE_INTEGER now;
+
+			QueryPerformanceCounter(&now);
+			frame.data = data;
+			frame.length = length;
+			frame.id = data[0];
+			frame.releaseTime = now.QuadPart;
+			frame.lastVsync = m_VsyncSource->GetLastVsync();
+
+			std::lock_guard<std::mutex> lock(m_Lock);
+			m_Released.push_back(frame);
+			return DR_OK;
+		}
+
+		std::vector<ReleasedFrame> GetReleased(void) {
+			std::lock_guard<std::mutex> lock(m_Lock);
+			return m_Released;
+		}
+
+		bool WaitForReleased(size_t count, int timeoutMs) {
+			for (int waited = 0; waited < timeoutMs; waited++) {
+				if (GetReleased().size() >= count) {
+					return true;
+				}
+				Sleep(1);
+			}
+			return GetReleased().size() >= count;
+		}
+
+	private:
+		RecordingVsyncSource *m_VsyncSource;
+		std::mutex m_Lock;
+		std::vector<ReleasedFrame> m_Released;
+	};
+
+	static void SubmitFrame(FramePacer &pacer, unsigned char id) {
+		char *buffer = (char*)calloc(1, 16);
+		int bufferSize = 16;
+		LARGE_INTEGER now;
+
+		buffer[0] = id;
+		QueryPerformanceCounter(&now);
+		pacer.Submit(buffer, bufferSize, 0, 16, now.QuadPart);
+
+		/* Whatever buffer came back is ours */
+		free(buffer);
+	}
+
+	TEST_CLASS(FramePacerTests)
+	{
+	public:
+		TEST_METHOD(LatencyFirstReleasesEverythingPending)
+		{
+			RecordingVsyncSource vsyncSource;
+			RecordingRenderer renderer(&vsyncSource);
+			FramePacer pacer;
+			std::vector<ReleasedFrame> released;
+
+			pacer.Start(&renderer, &vsyncSource, PacingLatencyFirst);
+			for (int i = 0; i < FRAME_PACER_QUEUE_DEPTH; i++) {
+				SubmitFrame(pacer, (unsigned char)i);
+			}
+			Assert::IsTrue(renderer.WaitForReleased(FRAME_PACER_QUEUE_DEPTH, 1000));
+			pacer.Stop();
+
+			released = renderer.GetReleased();
+			for (int i = 0; i < FRAME_PACER_QUEUE_DEPTH; i++) {
+				Assert::AreEqual(i, (int)released[i].id);
+			}
+		}
+
+		/* A stream that stops after one frame must still get that frame
+		 * on screen rather than keeping it in reserve */
+		TEST_METHOD(SmoothnessFirstReleasesLoneFrame)
+		{
+			RecordingVsyncSource vsyncSource;
+			RecordingRenderer renderer(&vsyncSource);
+			FramePacer pacer;
+
+			pacer.Start(&renderer, &vsyncSource, PacingSmoothnessFirst);
+			SubmitFrame(pacer, 7);
+
+			/* Held for a refresh, then released before the one after */
+			Assert::IsTrue(renderer.WaitForReleased(1, 1000 * (FRAME_PACER_MAX_HOLD_REFRESHES + 3) / TEST_REFRESH_RATE_HZ + 100));
+			pacer.Stop();
+
+			Assert::AreEqual(7, (int)renderer.GetReleased()[0].id);
+		}
+
+		TEST_METHOD(SmoothnessFirstKeepsOrder)
+		{
+			const int count = 30;
+			RecordingVsyncSource vsyncSource;
+			RecordingRenderer renderer(&vsyncSource);
+			FramePacer pacer;
+			std::vector<ReleasedFrame> released;
+
+			pacer.Start(&renderer, &vsyncSource, PacingSmoothnessFirst);
+			for (int i = 0; i < count; i++) {
+				SubmitFrame(pacer, (unsigned char)i);
+			}
+			Assert::IsTrue(renderer.WaitForReleased(count, 5000));
+			pacer.Stop();
+
+			released = renderer.GetReleased();
+			for (int i = 0; i < count; i++) {
+				Assert::AreEqual(i, (int)released[i].id);
+			}
+		}
+
+		/* The renderer gets the submitted buffer itself, and each Submit
+		 * hands back the buffer of a frame that has been released */
+		TEST_METHOD(SubmitSwapsBuffersInsteadOfCopying)
+		{
+			const int count = FRAME_PACER_QUEUE_DEPTH + 1;
+			RecordingVsyncSource vsyncSource;
+			RecordingRenderer renderer(&vsyncSource);
+			FramePacer pacer;
+			std::vector<ReleasedFrame> released;
+			char *buffers[count];
+			char *buffer;
+			int bufferSize;
+			LARGE_INTEGER now;
+
+			pacer.Start(&renderer, &vsyncSource, PacingLatencyFirst);
+			for (int i = 0; i < count; i++) {
+				buffer = (char*)calloc(1, 64);
+				bufferSize = 64;
+				buffer[8] = (char)i;
+				buffers[i] = buffer;
+
+				QueryPerformanceCounter(&now);
+				pacer.Submit(buffer, bufferSize, 8, 16, now.QuadPart);
+
+				/* Until every slot has had a frame there's nothing to give back */
+				if (i < FRAME_PACER_QUEUE_DEPTH) {
+					Assert::IsTrue(buffer == NULL);
+					Assert::AreEqual(0, bufferSize);
+				}
+				else {
+					Assert::IsTrue(buffer == buffers[0]);
+					Assert::AreEqual(64, bufferSize);
+				}
+			}
+			Assert::IsTrue(renderer.WaitForReleased(count, 1000));
+			pacer.Stop();
+
+			released = renderer.GetReleased();
+			for (int i = 0; i < count; i++) {
+				Assert::IsTrue(released[i].data == (const unsigned char*)buffers[i] + 8);
+				Assert::AreEqual(16, released[i].length);
+			}
+
+			/* The pacer freed the rest when it stopped */
+			free(buffer);
+		}
+
+		/* Frames fed at the refresh rate go out ahead of the vsync they're
+		 * meant for. A few may miss on a busy machine. */
+		TEST_METHOD(ReleasesLandBeforeNextVsync)
+		{
+			const int count = TEST_REFRESH_RATE_HZ;
+			RecordingVsyncSource vsyncSource;
+			RecordingRenderer renderer(&vsyncSource);
+			FramePacer pacer;
+			std::vector<ReleasedFrame> released;
+			LARGE_INTEGER frequency;
+			LONGLONG interval;
+			int late = 0;
+
+			QueryPerformanceFrequency(&frequency);
+			interval = frequency.QuadPart / TEST_REFRESH_RATE_HZ;
+
+			pacer.Start(&renderer, &vsyncSource, PacingLatencyFirst);
+			for (int i = 0; i < count; i++) {
+				SubmitFrame(pacer, (unsigned char)i);
+				Sleep(1000 / TEST_REFRESH_RATE_HZ);
+			}
+			Assert::IsTrue(renderer.WaitForReleased(count, 1000));
+			pacer.Stop();
+
+			released = renderer.GetReleased();
+			for (size_t i = 0; i < released.size(); i++) {
+				if (released[i].releaseTime >= released[i].lastVsync + interval) {
+					late++;
+				}
+			}
+
+			Assert::IsTrue(late <= count / 10);
+		}
+	};
+}
@@ -0,0 +1,225 @@
+#include "CppUnitTest.h"
+#include "FakeLimelight.hpp"
+#include "GamepadPoller.hpp"
+
+#include <Limelight.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+namespace Moonlight_common_binding_Tests
+{
+	/* A controller source the test drives by hand */
+	class ScriptedControllerSource final : public IControllerSource
+	{
+	public:
+		ScriptedControllerSource() {
+			memset(m_States, 0, sizeof(m_States));
+			memset(m_Connected, 0, sizeof(m_Connected));
+			memset(m_Polls, 0, sizeof(m_Polls));
+		}
+
+		bool GetState(int index, ControllerState &state) override {
+			std::lock_guard<std::mutex> lock(m_Lock);
+
+			m_Polls[index]++;
+			m_PollCond.notify_all();
+
+			if (!m_Connected[index]) {
+				return false;
+			}
+
+			state = m_States[index];
+			return true;
+		}
+
+		void Connect(int index) {
+			std::lock_guard<std::mutex> lock(m_Lock);
+			m_Connected[index] = true;
+		}
+
+		void Disconnect(int index) {
+			std::lock_guard<std::mutex> lock(m_Lock);
+			m_Connected[index] = false;
+		}
+
+		void SetButtons(int index, short buttonFlags) {
+			std::lock_guard<std::mutex> lock(m_Lock);
+			m_States[index].buttonFlags = buttonFlags;
+		}
+
+		void SetLeftStick(int index, short x, short y) {
+			std::lock_guard<std::mutex> lock(m_Lock);
+			m_States[index].leftStickX = x;
+			m_States[index].leftStickY = y;
+		}
+
+		long long GetPolls(int index) {
+			std::lock_guard<std::mutex> lock(m_Lock);
+			return m_Polls[index];
+		}
+
+		/* Waits for the poller to read the controller a few more times, so
+		 * whatever it was going to send about the current state is queued */
+		bool WaitForPolls(int index, int count) {
+			std::unique_lock<std::mutex> lock(m_Lock);
+			long long target = m_Polls[index] + count;
+
+			return m_PollCond.wait_for(lock, std::chrono::seconds(5), [this, index, target] { return m_Polls[index] >= target; });
+		}
+
+	private:
+		std::mutex m_Lock;
+		std::condition_variable m_PollCond;
+		ControllerState m_States[MAX_GAMEPADS];
+		bool m_Connected[MAX_GAMEPADS];
+		long long m_Polls[MAX_GAMEPADS];
+	};
+
+	TEST_CLASS(GamepadPollerTests)
+	{
+	public:
+		TEST_METHOD_INITIALIZE(Initialize)
+		{
+			FakeLimelight::Reset();
+			m_Sender = new InputSender();
+			m_Poller = new GamepadPoller(m_Sender);
+			m_Sender->Start();
+		}
+
+		TEST_METHOD_CLEANUP(Cleanup)
+		{
+			delete m_Poller;
+			m_Sender->Stop();
+			delete m_Sender;
+		}
+
+		TEST_METHOD(ControllerAtRestSendsNothing)
+		{
+			ScriptedControllerSource source;
+
+			source.Connect(0);
+			m_Poller->Start(&source);
+			Assert::IsTrue(source.WaitForPolls(0, 10));
+			m_Poller->Stop();
+
+			Assert::AreEqual(0LL, m_Poller->GetPacketsQueued());
+		}
+
+		TEST_METHOD(ButtonPressSentOnce)
+		{
+			ScriptedControllerSource source;
+			std::vector<SentInput> sent;
+
+			source.Connect(0);
+			m_Poller->Start(&source);
+			Assert::IsTrue(source.WaitForPolls(0, 2));
+
+			source.SetButtons(0, A_FLAG);
+			Assert::IsTrue(FakeLimelight::WaitForSent(1, 5000));
+
+			/* Holding the button doesn't repeat it */
+			Assert::IsTrue(source.WaitForPolls(0, 20));
+			m_Poller->Stop();
+
+			sent = FakeLimelight::GetSent();
+			Assert::AreEqual((size_t)1, sent.size());
+			Assert::AreEqual((int)SentMultiController, (int)sent[0].type);
+			Assert::AreEqual((short)0, sent[0].controllerNumber);
+			Assert::AreEqual((short)A_FLAG, sent[0].buttonFlags);
+		}
+
+		TEST_METHOD(StickInsideDeadzoneReadsCentered)
+		{
+			ScriptedControllerSource source;
+
+			source.Connect(0);
+			m_Poller->SetStickFilter(DEFAULT_STICK_DEADZONE, DEFAULT_STICK_NOISE_THRESHOLD);
+			m_Poller->Start(&source);
+
+			source.SetLeftStick(0, DEFAULT_STICK_DEADZONE / 2, -DEFAULT_STICK_DEADZONE / 2);
+			Assert::IsTrue(source.WaitForPolls(0, 20));
+			m_Poller->Stop();
+
+			Assert::AreEqual(0LL, m_Poller->GetPacketsQueued());
+		}
+
+		TEST_METHOD(StickNoiseIsFiltered)
+		{
+			ScriptedControllerSource source;
+			std::vector<SentInput> sent;
+
+			source.Connect(0);
+			m_Poller->Start(&source);
+
+			source.SetLeftStick(0, 20000, 0);
+			Assert::IsTrue(FakeLimelight::WaitForSent(1, 5000));
+
+			/* Jitter well under the noise threshold */
+			for (int i = 0; i < 10; i++) {
+				source.SetLeftStick(0, 20000 + (i % 2 ? 1 : -1) * DEFAULT_STICK_NOISE_THRESHOLD / 4, DEFAULT_STICK_NOISE_THRESHOLD / 4);
+				Assert::IsTrue(source.WaitForPolls(0, 2));
+			}
+
+			/* A real movement still gets through */
+			source.SetLeftStick(0, 30000, 0);
+			Assert::IsTrue(FakeLimelight::WaitForSent(2, 5000));
+			Assert::IsTrue(source.WaitForPolls(0, 5));
+			m_Poller->Stop();
+
+			sent = FakeLimelight::GetSent();
+			Assert::AreEqual((size_t)2, sent.size());
+			Assert::IsTrue(sent[1].leftStickX > sent[0].leftStickX);
+			Assert::AreEqual((short)0, sent[1].leftStickY);
+		}
+
+		TEST_METHOD(DisconnectReleasesEverything)
+		{
+			ScriptedControllerSource source;
+			std::vector<SentInput> sent;
+
+			source.Connect(1);
+			m_Poller->Start(&source);
+
+			source.SetButtons(1, B_FLAG);
+			source.SetLeftStick(1, 0, 25000);
+			Assert::IsTrue(FakeLimelight::WaitForSent(1, 5000));
+
+			source.Disconnect(1);
+			Assert::IsTrue(FakeLimelight::WaitForSent(2, 5000));
+			m_Poller->Stop();
+
+			sent = FakeLimelight::GetSent();
+			Assert::AreEqual((size_t)2, sent.size());
+			Assert::AreEqual((short)1, sent[1].controllerNumber);
+			Assert::AreEqual((short)0, sent[1].buttonFlags);
+			Assert::AreEqual((short)0, sent[1].leftStickX);
+			Assert::AreEqual((short)0, sent[1].leftStickY);
+		}
+
+		TEST_METHOD(PollsAtTheConfiguredRate)
+		{
+			ScriptedControllerSource source;
+			long long polls;
+
+			source.Connect(0);
+			m_Poller->SetPollRate(100);
+			m_Poller->Start(&source);
+			Sleep(500);
+			m_Poller->Stop();
+
+			/* 50 polls expected. The bounds are loose since the wait is only
+			 * as precise as the system timer on a loaded test machine. */
+			polls = source.GetPolls(0);
+			Assert::IsTrue(polls >= 25 && polls <= 75);
+		}
+
+	private:
+		InputSender *m_Sender;
+		GamepadPoller *m_Poller;
+	};
+}
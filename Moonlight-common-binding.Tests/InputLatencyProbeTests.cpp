@@ -0,0 +1,264 @@
+#include "CppUnitTest.h"
+#include "FakeLimelight.hpp"
+#include "InputSender.hpp"
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <Limelight.h>
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+#define STAND_IN_HOST_MAX_PACKETS 1024
+
+namespace Moonlight_common_binding_Tests
+{
+	/* A host on loopback that notes when each input packet arrives. Each
+	 * packet is the index of the input followed by the input itself. */
+	class StandInHost
+	{
+	public:
+		StandInHost()
+			: m_Stop(false), m_Received(0), m_ArrivalTimes(STAND_IN_HOST_MAX_PACKETS)
+		{
+			struct sockaddr_in address;
+			int addressLength = sizeof(address);
+			WSADATA wsaData;
+
+			WSAStartup(MAKEWORD(2, 2), &wsaData);
+			m_HostSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+			m_ClientSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+			Assert::IsTrue(m_HostSocket != INVALID_SOCKET && m_ClientSocket != INVALID_SOCKET);
+
+			ZeroMemory(&address, sizeof(address));
+			address.sin_family = AF_INET;
+			address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			Assert::IsTrue(bind(m_HostSocket, (struct sockaddr*)&address, sizeof(address)) != SOCKET_ERROR);
+			Assert::IsTrue(getsockname(m_HostSocket, (struct sockaddr*)&address, &addressLength) != SOCKET_ERROR);
+			Assert::IsTrue(connect(m_ClientSocket, (struct sockaddr*)&address, sizeof(address)) != SOCKET_ERROR);
+
+			m_Thread = std::thread(&StandInHost::ThreadProc, this);
+		}
+
+		~StandInHost() {
+			m_Stop = true;
+			m_Thread.join();
+			closesocket(m_ClientSocket);
+			closesocket(m_HostSocket);
+			WSACleanup();
+		}
+
+		/* Runs on the sender thread in place of Common's send. A packet
+		 * that fails to go out is caught by WaitForPackets. */
+		void Send(unsigned int index, const SentInput &input) {
+			char packet[sizeof(index) + sizeof(input)];
+
+			memcpy(packet, &index, sizeof(index));
+			memcpy(packet + sizeof(index), &input, sizeof(input));
+			send(m_ClientSocket, packet, sizeof(packet), 0);
+		}
+
+		bool WaitForPackets(int count, int timeoutMs) {
+			for (int i = 0; m_Received < count; i++) {
+				if (i == timeoutMs) {
+					return false;
+				}
+				Sleep(1);
+			}
+			return true;
+		}
+
+		/* QPC time the index'th input arrived, or 0 if it didn't */
+		LONGLONG GetArrivalTime(unsigned int index) {
+			return m_ArrivalTimes[index];
+		}
+
+	private:
+		void ThreadProc(void) {
+			char packet[sizeof(unsigned int) + sizeof(SentInput)];
+			struct timeval timeout;
+			fd_set readFds;
+			unsigned int index;
+			LARGE_INTEGER now;
+
+			while (!m_Stop) {
+				FD_ZERO(&readFds);
+				FD_SET(m_HostSocket, &readFds);
+				timeout.tv_sec = 0;
+				timeout.tv_usec = 500;
+				if (select(0, &readFds, NULL, NULL, &timeout) <= 0) {
+					continue;
+				}
+
+				if (recv(m_HostSocket, packet, sizeof(packet), 0) != sizeof(packet)) {
+					continue;
+				}
+				QueryPerformanceCounter(&now);
+
+				memcpy(&index, packet, sizeof(index));
+				if (index < STAND_IN_HOST_MAX_PACKETS) {
+					m_ArrivalTimes[index] = now.QuadPart;
+					m_Received++;
+				}
+			}
+		}
+
+		std::atomic<bool> m_Stop;
+		std::atomic<int> m_Received;
+		std::vector<std::atomic<LONGLONG>> m_ArrivalTimes;
+		SOCKET m_HostSocket;
+		SOCKET m_ClientSocket;
+		std::thread m_Thread;
+	};
+
+	static InputEvent MakeProbeKeyEvent(short keyCode) {
+		InputEvent event;
+
+		memset(&event, 0, sizeof(event));
+		event.type = InputKeyboard;
+		event.keyboard.keyCode = keyCode;
+		event.keyboard.keyAction = KEY_ACTION_DOWN;
+		return event;
+	}
+
+	static long long GetHistogramCount(LatencyHistogram &histogram) {
+		long long count = 0;
+
+		for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+			count += histogram.GetBucketCount(i);
+		}
+		return count;
+	}
+
+	static void LogPercentiles(const char *name, LatencyHistogram &histogram) {
+		char message[128];
+
+		sprintf(message, "%s: p50 %lld us, p99 %lld us", name, histogram.GetPercentileUs(50),
+			histogram.GetPercentileUs(99));
+		Logger::WriteMessage(message);
+	}
+
+	TEST_CLASS(InputLatencyProbeTests)
+	{
+	public:
+		TEST_METHOD_INITIALIZE(Initialize)
+		{
+			FakeLimelight::Reset();
+		}
+
+		TEST_METHOD_CLEANUP(Cleanup)
+		{
+			FakeLimelight::Reset();
+		}
+
+		/* Every input goes over a real socket to the stand-in host, so each
+		 * stage gets one sample per input, and the host sees each input no
+		 * earlier than it was queued */
+		TEST_METHOD(HistogramsFillFromStandInHost)
+		{
+			const int eventCount = 200;
+			StandInHost host;
+			InputSender sender;
+			InputEvent event;
+			std::atomic<unsigned int> nextIndex(0);
+			std::vector<LONGLONG> queueTimes(eventCount);
+			LatencyHistogram delivery;
+			LARGE_INTEGER frequency;
+			LARGE_INTEGER now;
+
+			QueryPerformanceFrequency(&frequency);
+			FakeLimelight::SetSendHook([&](const SentInput &input) {
+				host.Send(nextIndex++, input);
+			});
+
+			sender.SetLatencyProbeEnabled(true);
+			sender.Start();
+			for (int i = 0; i < eventCount; i++) {
+				event = MakeProbeKeyEvent((short)(0x41 + i % 26));
+				QueryPerformanceCounter(&now);
+				queueTimes[i] = now.QuadPart;
+				Assert::IsTrue(sender.Enqueue(event));
+
+				/* Let the queue drain now and then so not every sample is a backlog */
+				if (i % 10 == 9) {
+					Sleep(1);
+				}
+			}
+			Assert::IsTrue(host.WaitForPackets(eventCount, 5000));
+			sender.Stop();
+
+			for (int i = 0; i < LatencyStageCount; i++) {
+				Assert::AreEqual((long long)eventCount, GetHistogramCount(sender.GetLatencyHistogram((LatencyStage)i)));
+			}
+			Assert::IsTrue(sender.GetSlowestEventSequence() < (unsigned int)eventCount);
+
+			for (int i = 0; i < eventCount; i++) {
+				Assert::IsTrue(host.GetArrivalTime(i) >= queueTimes[i]);
+				delivery.Record((host.GetArrivalTime(i) - queueTimes[i]) * 1000000 / frequency.QuadPart);
+			}
+
+			LogPercentiles("Queueing", sender.GetLatencyHistogram(LatencyQueueing));
+			LogPercentiles("Send", sender.GetLatencyHistogram(LatencySend));
+			LogPercentiles("Total", sender.GetLatencyHistogram(LatencyTotal));
+			LogPercentiles("Arrival at host", delivery);
+		}
+
+		/* A slow send shows up in the send stage, and the inputs stuck behind
+		 * it show up in the queueing stage */
+		TEST_METHOD(SlowSendShowsInSendAndQueueing)
+		{
+			const int eventCount = 50;
+			StandInHost host;
+			InputSender sender;
+			InputEvent event;
+			std::atomic<unsigned int> nextIndex(0);
+
+			FakeLimelight::SetSendDelay(1);
+			FakeLimelight::SetSendHook([&](const SentInput &input) {
+				host.Send(nextIndex++, input);
+			});
+
+			sender.SetLatencyProbeEnabled(true);
+			sender.Start();
+			for (int i = 0; i < eventCount; i++) {
+				event = MakeProbeKeyEvent(0x41);
+				Assert::IsTrue(sender.Enqueue(event));
+			}
+			Assert::IsTrue(host.WaitForPackets(eventCount, 5000));
+			sender.Stop();
+
+			Assert::IsTrue(sender.GetLatencyHistogram(LatencySend).GetPercentileUs(50) >= 1024);
+
+			/* The last input waited behind 49 sends of at least 1 ms each */
+			Assert::IsTrue(sender.GetLatencyHistogram(LatencyQueueing).GetPercentileUs(100) >= 32768);
+			Assert::AreEqual((unsigned int)(eventCount - 1), sender.GetSlowestEventSequence());
+			Assert::IsTrue(sender.GetSlowestEventLatencyUs() >= eventCount * 1000);
+		}
+
+		TEST_METHOD(DisabledProbeRecordsNothing)
+		{
+			StandInHost host;
+			InputSender sender;
+			InputEvent event = MakeProbeKeyEvent(0x41);
+			std::atomic<unsigned int> nextIndex(0);
+
+			FakeLimelight::SetSendHook([&](const SentInput &input) {
+				host.Send(nextIndex++, input);
+			});
+
+			sender.Start();
+			Assert::IsTrue(sender.Enqueue(event));
+			Assert::IsTrue(host.WaitForPackets(1, 5000));
+			sender.Stop();
+
+			for (int i = 0; i < LatencyStageCount; i++) {
+				Assert::AreEqual(0LL, GetHistogramCount(sender.GetLatencyHistogram((LatencyStage)i)));
+			}
+		}
+	};
+}
@@ -0,0 +1,411 @@
+#include "CppUnitTest.h"
+#include "FakeLimelight.hpp"
+#include "InputSender.hpp"
+
+#include <Limelight.h>
+#include <chrono>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+namespace Moonlight_common_binding_Tests
+{
+	static InputEvent MakeKeyEvent(short keyCode) {
+		InputEvent event;
+
+		memset(&event, 0, sizeof(event));
+		event.type = InputKeyboard;
+		event.keyboard.keyCode = keyCode;
+		event.keyboard.keyAction = KEY_ACTION_DOWN;
+		return event;
+	}
+
+	static InputEvent MakeMoveEvent(short deltaX, short deltaY) {
+		InputEvent event;
+
+		memset(&event, 0, sizeof(event));
+		event.type = InputMouseMove;
+		event.mouseMove.deltaX = deltaX;
+		event.mouseMove.deltaY = deltaY;
+		return event;
+	}
+
+	static InputEvent MakeScrollEvent(short delta, bool horizontal, bool shiftHeld) {
+		InputEvent event;
+
+		memset(&event, 0, sizeof(event));
+		event.type = InputScrollDelta;
+		event.scrollDelta.delta = delta;
+		event.scrollDelta.horizontal = horizontal;
+		event.scrollDelta.shiftHeld = shiftHeld;
+		return event;
+	}
+
+	/* Queues the events and then a key press, which flushes whatever was
+	 * coalesced ahead of it, and returns everything sent up to the key */
+	static std::vector<SentInput> SendAndFlush(InputSender &sender, std::vector<InputEvent> events) {
+		InputEvent key = MakeKeyEvent(0x41);
+		std::vector<SentInput> sent;
+
+		for (size_t i = 0; i < events.size(); i++) {
+			Assert::IsTrue(sender.Enqueue(events[i]));
+		}
+		Assert::IsTrue(sender.Enqueue(key));
+
+		for (;;) {
+			sent = FakeLimelight::GetSent();
+			if (!sent.empty() && sent.back().type == SentKeyboard && sent.back().keyCode == 0x41) {
+				sent.pop_back();
+				return sent;
+			}
+			Assert::IsTrue(FakeLimelight::WaitForSent(sent.size() + 1, 5000));
+		}
+	}
+
+	static void WaitForDrain(InputSender &sender) {
+		while (sender.GetQueueDepth() != 0) {
+			Sleep(1);
+		}
+	}
+
+	TEST_CLASS(InputSenderTests)
+	{
+	public:
+		TEST_METHOD_INITIALIZE(Initialize)
+		{
+			FakeLimelight::Reset();
+		}
+
+		TEST_METHOD(ScheduledEventWaitsForItsDelay)
+		{
+			InputSender sender;
+			InputEvent event = MakeKeyEvent(0x41);
+			auto start = std::chrono::steady_clock::now();
+			long long elapsedMs;
+
+			sender.Start();
+			Assert::IsTrue(sender.Schedule(event, 50));
+			Assert::IsTrue(FakeLimelight::WaitForSent(1, 5000));
+			elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+			sender.Stop();
+
+			/* The wheel has 1 ms slots */
+			Assert::IsTrue(elapsedMs >= 49);
+			Assert::AreEqual((short)0x41, FakeLimelight::GetSent()[0].keyCode);
+		}
+
+		TEST_METHOD(ScheduledEventsKeepTheirOrder)
+		{
+			InputSender sender;
+			InputEvent event;
+			std::vector<SentInput> sent;
+
+			sender.Start();
+			for (short i = 0; i < 8; i++) {
+				event = MakeKeyEvent(0x41 + i);
+				Assert::IsTrue(sender.Schedule(event, 20));
+			}
+			Assert::IsTrue(FakeLimelight::WaitForSent(8, 5000));
+			sender.Stop();
+
+			sent = FakeLimelight::GetSent();
+			for (short i = 0; i < 8; i++) {
+				Assert::AreEqual((short)(0x41 + i), sent[i].keyCode);
+			}
+		}
+
+		TEST_METHOD(MaxLatencyKeptUntilReset)
+		{
+			InputSender sender;
+			InputEvent event = MakeKeyEvent(0x41);
+			long long maxLatencyUs;
+
+			FakeLimelight::SetSendDelay(5);
+			sender.Start();
+			Assert::IsTrue(sender.Enqueue(event));
+			Assert::IsTrue(FakeLimelight::WaitForSent(1, 5000));
+			sender.Stop();
+
+			/* Reading it leaves it alone */
+			maxLatencyUs = sender.GetMaxLatencyUs();
+			Assert::IsTrue(maxLatencyUs >= 5000);
+			Assert::AreEqual(maxLatencyUs, sender.GetMaxLatencyUs());
+
+			sender.ResetMaxLatency();
+			Assert::AreEqual(0LL, sender.GetMaxLatencyUs());
+		}
+
+		/* With the sender not yet running, nothing drains the queue until
+		 * the starter thread starts it */
+		TEST_METHOD(EnqueueWhenRoomWaitsForTheQueueToDrain)
+		{
+			InputSender sender;
+			InputEvent event = MakeKeyEvent(0x41);
+			std::thread starter;
+			int queued = 0;
+
+			while (sender.Enqueue(event)) {
+				queued++;
+			}
+			Assert::AreEqual(1LL, sender.GetEventsDropped());
+
+			event = MakeKeyEvent(0x42);
+			Assert::IsFalse(sender.EnqueueWhenRoom(event, 20));
+			Assert::AreEqual(2LL, sender.GetEventsDropped());
+
+			starter = std::thread([&sender] {
+				Sleep(20);
+				sender.Start();
+			});
+			event = MakeKeyEvent(0x43);
+			Assert::IsTrue(sender.EnqueueWhenRoom(event, 5000));
+			starter.join();
+
+			Assert::IsTrue(FakeLimelight::WaitForSent(queued + 1, 5000));
+			sender.Stop();
+
+			Assert::AreEqual(2LL, sender.GetEventsDropped());
+			Assert::AreEqual((short)0x43, FakeLimelight::GetSent()[queued].keyCode);
+		}
+
+		TEST_METHOD(MotionIsCoalescedUntilTheNextEvent)
+		{
+			InputSender sender;
+			std::vector<SentInput> sent;
+
+			/* Long enough that only the key press flushes it */
+			sender.SetMouseFlushRate(1);
+			sender.Start();
+			sent = SendAndFlush(sender, { MakeMoveEvent(3, -2), MakeMoveEvent(3, -2), MakeMoveEvent(3, -2),
+				MakeMoveEvent(3, -2), MakeMoveEvent(3, -2) });
+			sender.Stop();
+
+			Assert::AreEqual(1, (int)sent.size());
+			Assert::AreEqual((int)SentMouseMove, (int)sent[0].type);
+			Assert::AreEqual((short)15, sent[0].deltaX);
+			Assert::AreEqual((short)-10, sent[0].deltaY);
+			Assert::AreEqual(4LL, sender.GetMouseEventsCoalesced());
+		}
+
+		/* The sum can outgrow the 16-bit packet fields */
+		TEST_METHOD(CoalescedMotionIsSplitAcrossPackets)
+		{
+			InputSender sender;
+			std::vector<SentInput> sent;
+
+			sender.SetMouseFlushRate(1);
+			sender.Start();
+			sent = SendAndFlush(sender, { MakeMoveEvent(20000, -20000), MakeMoveEvent(20000, -20000),
+				MakeMoveEvent(20000, -20000) });
+			sender.Stop();
+
+			Assert::AreEqual(2, (int)sent.size());
+			Assert::AreEqual((short)SHRT_MAX, sent[0].deltaX);
+			Assert::AreEqual((short)SHRT_MIN, sent[0].deltaY);
+			Assert::AreEqual(60000, sent[0].deltaX + sent[1].deltaX);
+			Assert::AreEqual(-60000, sent[0].deltaY + sent[1].deltaY);
+		}
+
+		TEST_METHOD(CoalescedMotionIsFlushedOnTime)
+		{
+			InputSender sender;
+			InputEvent event = MakeMoveEvent(1, 1);
+
+			sender.SetMouseFlushRate(100);
+			sender.Start();
+			Assert::IsTrue(sender.Enqueue(event));
+			Assert::IsTrue(FakeLimelight::WaitForSent(1, 1000));
+			sender.Stop();
+		}
+
+		TEST_METHOD(ZeroFlushRateSendsEveryMove)
+		{
+			InputSender sender;
+			std::vector<SentInput> sent;
+
+			sender.SetMouseFlushRate(0);
+			sender.Start();
+			sent = SendAndFlush(sender, { MakeMoveEvent(1, 0), MakeMoveEvent(2, 0), MakeMoveEvent(3, 0) });
+			sender.Stop();
+
+			Assert::AreEqual(3, (int)sent.size());
+			Assert::AreEqual((short)3, sent[2].deltaX);
+			Assert::AreEqual(0LL, sender.GetMouseEventsCoalesced());
+		}
+
+		/* Small touchpad deltas add up to clicks, and what's short of a
+		 * click carries over to the next flush */
+		TEST_METHOD(ScrollDeltasAccumulateIntoClicks)
+		{
+			InputSender sender;
+			std::vector<SentInput> sent;
+
+			sender.SetMouseFlushRate(1);
+			sender.Start();
+			sent = SendAndFlush(sender, { MakeScrollEvent(40, false, false), MakeScrollEvent(40, false, false),
+				MakeScrollEvent(40, false, false), MakeScrollEvent(40, false, false) });
+			Assert::AreEqual(1, (int)sent.size());
+			Assert::AreEqual((int)SentScroll, (int)sent[0].type);
+			Assert::AreEqual((signed char)1, sent[0].scrollClicks);
+
+			FakeLimelight::Reset();
+			sent = SendAndFlush(sender, { MakeScrollEvent(80, false, false) });
+			sender.Stop();
+
+			Assert::AreEqual(1, (int)sent.size());
+			Assert::AreEqual((signed char)1, sent[0].scrollClicks);
+			Assert::AreEqual(5LL, sender.GetScrollEventsReceived());
+			Assert::AreEqual(2LL, sender.GetScrollPacketsSent());
+		}
+
+		/* A leftover from scrolling down doesn't eat into scrolling back up */
+		TEST_METHOD(ScrollReversalDropsTheRemainder)
+		{
+			InputSender sender;
+			std::vector<SentInput> sent;
+
+			sender.SetMouseFlushRate(1);
+			sender.Start();
+			sent = SendAndFlush(sender, { MakeScrollEvent(100, false, false), MakeScrollEvent(-120, false, false) });
+			sender.Stop();
+
+			Assert::AreEqual(1, (int)sent.size());
+			Assert::AreEqual((signed char)-1, sent[0].scrollClicks);
+		}
+
+		TEST_METHOD(FastWheelIsSplitAcrossPackets)
+		{
+			InputSender sender;
+			std::vector<InputEvent> events;
+			std::vector<SentInput> sent;
+
+			for (int i = 0; i < 10; i++) {
+				events.push_back(MakeScrollEvent(30 * SCROLL_UNITS_PER_CLICK, false, false));
+			}
+
+			sender.SetMouseFlushRate(1);
+			sender.Start();
+			sent = SendAndFlush(sender, events);
+			sender.Stop();
+
+			Assert::AreEqual(3, (int)sent.size());
+			Assert::AreEqual((signed char)SCHAR_MAX, sent[0].scrollClicks);
+			Assert::AreEqual(300, sent[0].scrollClicks + sent[1].scrollClicks + sent[2].scrollClicks);
+		}
+
+		/* Horizontal scrolling is wheel clicks with Shift held, and Shift is
+		 * only pressed for the user if that was asked for */
+		TEST_METHOD(HorizontalScrollNeedsShift)
+		{
+			InputSender sender;
+			std::vector<SentInput> sent;
+
+			sender.SetMouseFlushRate(1);
+			sender.Start();
+
+			sent = SendAndFlush(sender, { MakeScrollEvent(SCROLL_UNITS_PER_CLICK, true, false) });
+			Assert::AreEqual(0, (int)sent.size());
+
+			FakeLimelight::Reset();
+			sent = SendAndFlush(sender, { MakeScrollEvent(SCROLL_UNITS_PER_CLICK, true, true) });
+			Assert::AreEqual(1, (int)sent.size());
+			Assert::AreEqual((signed char)-1, sent[0].scrollClicks);
+
+			FakeLimelight::Reset();
+			sender.SetHorizontalScrollShift(true);
+			sent = SendAndFlush(sender, { MakeScrollEvent(SCROLL_UNITS_PER_CLICK, true, false) });
+			sender.Stop();
+
+			Assert::AreEqual(3, (int)sent.size());
+			Assert::AreEqual((int)SentKeyboard, (int)sent[0].type);
+			Assert::AreEqual((char)KEY_ACTION_DOWN, sent[0].action);
+			Assert::AreEqual((signed char)-1, sent[1].scrollClicks);
+			Assert::AreEqual((int)SentKeyboard, (int)sent[2].type);
+			Assert::AreEqual((char)KEY_ACTION_UP, sent[2].action);
+		}
+
+		TEST_METHOD(MousePacketRateCoversTheTimeSinceLastCall)
+		{
+			InputSender sender;
+			std::vector<InputEvent> events;
+			int rate;
+
+			for (int i = 0; i < 10; i++) {
+				events.push_back(MakeMoveEvent(1, 0));
+			}
+
+			sender.SetMouseFlushRate(0);
+			sender.Start();
+
+			/* The first call only starts the clock */
+			Assert::AreEqual(0, sender.TakeMousePacketRate());
+			SendAndFlush(sender, events);
+			Sleep(100);
+			rate = sender.TakeMousePacketRate();
+
+			/* Nothing was sent since */
+			Assert::AreEqual(0, sender.TakeMousePacketRate());
+			sender.Stop();
+
+			/* 10 packets over at least 100 ms, and generously less than 200 ms */
+			Assert::IsTrue(rate >= 50 && rate <= 100);
+		}
+
+		/* Schedule is called from the UI thread, so it must cost the same
+		 * however many events are already waiting and however far out they
+		 * are. The best of several runs is compared to keep scheduler noise
+		 * out of it. */
+		TEST_METHOD(ScheduleCostIsConstant)
+		{
+			const int batchSize = 8;
+			const int batchCount = MAX_SCHEDULED_INPUT_EVENTS / batchSize;
+			const int runs = 20;
+			long long bestNs[batchCount];
+			char message[128];
+
+			for (int i = 0; i < batchCount; i++) {
+				bestNs[i] = LLONG_MAX;
+			}
+
+			for (int run = 0; run < runs; run++) {
+				InputSender sender;
+
+				sender.Start();
+				for (int batch = 0; batch < batchCount; batch++) {
+					auto start = std::chrono::steady_clock::now();
+					long long ns;
+
+					for (int i = 0; i < batchSize; i++) {
+						InputEvent event = MakeKeyEvent(0x41);
+
+						/* Far enough out that nothing fires during the test */
+						Assert::IsTrue(sender.Schedule(event, 60000 + i * 100));
+					}
+
+					ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+					if (ns < bestNs[batch]) {
+						bestNs[batch] = ns;
+					}
+
+					/* Let the sender file them so the next batch finds them on the wheel */
+					WaitForDrain(sender);
+				}
+				sender.Stop();
+			}
+
+			for (int i = 0; i < batchCount; i++) {
+				sprintf(message, "%d already scheduled: %lld ns per Schedule", i * batchSize, bestNs[i] / batchSize);
+				Logger::WriteMessage(message);
+			}
+
+			Assert::AreEqual(0, (int)FakeLimelight::GetSent().size());
+
+			/* Generous, since a single preemption can dominate a batch this small */
+			Assert::IsTrue(bestNs[batchCount - 1] <= bestNs[0] * 4 + 20000);
+		}
+	};
+}
@@ -0,0 +1,186 @@
+#include "CppUnitTest.h"
+#include "FakeLimelight.hpp"
+#include "InputSender.hpp"
+#include "InputTrace.hpp"
+
+#include <Limelight.h>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+namespace Moonlight_common_binding_Tests
+{
+	static std::vector<unsigned char> RecordKeyTrace(int count) {
+		InputTraceRecorder recorder;
+		LARGE_INTEGER now;
+		InputEvent event;
+
+		recorder.Start();
+		for (int i = 0; i < count; i++) {
+			memset(&event, 0, sizeof(event));
+			QueryPerformanceCounter(&now);
+			event.type = InputKeyboard;
+			event.captureTime = now.QuadPart;
+			event.keyboard.keyCode = (short)(0x8041 + i % 26);
+			event.keyboard.keyAction = i % 2 ? KEY_ACTION_UP : KEY_ACTION_DOWN;
+			recorder.Record(event, 0);
+		}
+
+		return recorder.Stop();
+	}
+
+	/* Key presses intervalUs apart, as if typed at a steady rate */
+	static std::vector<unsigned char> RecordSpacedKeyTrace(int count, int intervalUs) {
+		InputTraceRecorder recorder;
+		LARGE_INTEGER frequency;
+		LARGE_INTEGER now;
+		InputEvent event;
+
+		QueryPerformanceFrequency(&frequency);
+		QueryPerformanceCounter(&now);
+
+		recorder.Start();
+		for (int i = 0; i < count; i++) {
+			memset(&event, 0, sizeof(event));
+			event.type = InputKeyboard;
+			event.captureTime = now.QuadPart + (LONGLONG)i * intervalUs * frequency.QuadPart / 1000000;
+			event.keyboard.keyCode = 0x41;
+			event.keyboard.keyAction = KEY_ACTION_DOWN;
+			recorder.Record(event, 0);
+		}
+
+		return recorder.Stop();
+	}
+
+	TEST_CLASS(InputTraceTests)
+	{
+	public:
+		TEST_METHOD_INITIALIZE(Initialize)
+		{
+			FakeLimelight::Reset();
+		}
+
+		/* A flat-out replay of more events than the queue holds, into a slow
+		 * sender, waits for room rather than dropping */
+		TEST_METHOD(FlatOutReplayWaitsForRoom)
+		{
+			const int count = INPUT_QUEUE_SIZE + 64;
+			std::vector<unsigned char> trace = RecordKeyTrace(count);
+			InputSender sender;
+			InputTraceReplayer replayer(&sender);
+			std::vector<SentInput> sent;
+
+			FakeLimelight::SetSendDelay(1);
+			sender.Start();
+			Assert::IsTrue(replayer.Start(trace.data(), trace.size(), 0));
+			Assert::IsTrue(FakeLimelight::WaitForSent(count, 30000));
+			replayer.Stop();
+			sender.Stop();
+
+			Assert::AreEqual(0LL, sender.GetEventsDropped());
+
+			sent = FakeLimelight::GetSent();
+			Assert::AreEqual((size_t)count, sent.size());
+			for (int i = 0; i < count; i++) {
+				Assert::AreEqual((short)(0x8041 + i % 26), sent[i].keyCode);
+			}
+		}
+
+		TEST_METHOD(StoppingReplayWhileWaitingForRoom)
+		{
+			std::vector<unsigned char> trace = RecordKeyTrace(INPUT_QUEUE_SIZE * 4);
+			InputSender sender;
+			InputTraceReplayer replayer(&sender);
+
+			/* The sender never drains the queue */
+			Assert::IsTrue(replayer.Start(trace.data(), trace.size(), 0));
+			Sleep(50);
+			replayer.Stop();
+
+			Assert::AreEqual(0LL, sender.GetEventsDropped());
+			Assert::AreEqual(INPUT_QUEUE_SIZE, sender.GetQueueDepth());
+		}
+
+		TEST_METHOD(ReplayIsNotRecorded)
+		{
+			std::vector<unsigned char> trace = RecordKeyTrace(16);
+			std::vector<unsigned char> recorded;
+			InputTraceRecorder emptyRecorder;
+			InputSender sender;
+			InputTraceReplayer replayer(&sender);
+
+			emptyRecorder.Start();
+			sender.Start();
+			sender.GetTraceRecorder().Start();
+			Assert::IsTrue(replayer.Start(trace.data(), trace.size(), 0));
+			Assert::IsTrue(FakeLimelight::WaitForSent(16, 5000));
+			replayer.Stop();
+			recorded = sender.GetTraceRecorder().Stop();
+			sender.Stop();
+
+			/* Nothing but the header */
+			Assert::AreEqual(emptyRecorder.Stop().size(), recorded.size());
+		}
+
+		/* Replays events 1.5 ms apart, which a wait rounded to whole
+		 * milliseconds can't hit, and logs how late each one reached Common.
+		 * Only going early is asserted, since lateness depends on the
+		 * machine running the tests. */
+		TEST_METHOD(ReplayTimingAccuracy)
+		{
+			const int count = 200;
+			const int intervalUs = 1500;
+			std::vector<unsigned char> trace = RecordSpacedKeyTrace(count, intervalUs);
+			InputSender sender;
+			InputTraceReplayer replayer(&sender);
+			std::vector<LONGLONG> sendTimes;
+			std::vector<long long> lateUs;
+			LARGE_INTEGER frequency;
+			LARGE_INTEGER start;
+			long long totalLateUs = 0;
+			char message[128];
+
+			QueryPerformanceFrequency(&frequency);
+			FakeLimelight::SetSendHook([&](const SentInput &input) {
+				LARGE_INTEGER now;
+
+				QueryPerformanceCounter(&now);
+				sendTimes.push_back(now.QuadPart);
+			});
+
+			sender.Start();
+			QueryPerformanceCounter(&start);
+			Assert::IsTrue(replayer.Start(trace.data(), trace.size(), 1));
+			Assert::IsTrue(FakeLimelight::WaitForSent(count, 5000));
+			replayer.Stop();
+			sender.Stop();
+			FakeLimelight::SetSendHook(nullptr);
+
+			for (int i = 0; i < count; i++) {
+				long long offsetUs = (sendTimes[i] - start.QuadPart) * 1000000 / frequency.QuadPart;
+
+				Assert::IsTrue(offsetUs >= (long long)i * intervalUs);
+				lateUs.push_back(offsetUs - (long long)i * intervalUs);
+				totalLateUs += lateUs.back();
+			}
+
+			std::sort(lateUs.begin(), lateUs.end());
+			sprintf(message, "Late by %lld us on average, %lld us at p99, %lld us at most",
+				totalLateUs / count, lateUs[count * 99 / 100], lateUs.back());
+			Logger::WriteMessage(message);
+		}
+
+		TEST_METHOD(RejectsMalformedTrace)
+		{
+			std::vector<unsigned char> trace = RecordKeyTrace(4);
+			InputSender sender;
+			InputTraceReplayer replayer(&sender);
+
+			Assert::IsFalse(replayer.Start(trace.data(), trace.size() - 1, 1));
+			Assert::IsFalse(replayer.Start(trace.data() + 1, trace.size() - 1, 1));
+		}
+	};
+}
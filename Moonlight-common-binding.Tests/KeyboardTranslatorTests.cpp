@@ -0,0 +1,109 @@
+#include "CppUnitTest.h"
+#include "KeyboardTranslator.hpp"
+
+#include <Limelight.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+#define VIRTUAL_KEY_SHIFT 0x10
+#define VIRTUAL_KEY_CONTROL 0x11
+#define VIRTUAL_KEY_MENU 0x12
+#define VIRTUAL_KEY_LEFT_SHIFT 0xA0
+#define VIRTUAL_KEY_RIGHT_SHIFT 0xA1
+#define VIRTUAL_KEY_LEFT_CONTROL 0xA2
+#define VIRTUAL_KEY_RIGHT_MENU 0xA5
+
+namespace Moonlight_common_binding_Tests
+{
+	TEST_CLASS(KeyboardTranslatorTests)
+	{
+	public:
+		TEST_METHOD(RangesPassThrough)
+		{
+			Assert::AreEqual((short)0x8030, TranslateVirtualKey('0'));
+			Assert::AreEqual((short)0x8039, TranslateVirtualKey('9'));
+			Assert::AreEqual((short)0x8041, TranslateVirtualKey('A'));
+			Assert::AreEqual((short)0x805A, TranslateVirtualKey('Z'));
+			Assert::AreEqual((short)0x8060, TranslateVirtualKey(0x60));
+			Assert::AreEqual((short)0x8070, TranslateVirtualKey(0x70));
+			Assert::AreEqual((short)0x807B, TranslateVirtualKey(0x7B));
+		}
+
+		TEST_METHOD(NamedKeysAreRemapped)
+		{
+			Assert::AreEqual((short)0x800D, TranslateVirtualKey(0x0D));
+			Assert::AreEqual((short)0x802E, TranslateVirtualKey(0x2E));
+			Assert::AreEqual((short)0x803D, TranslateVirtualKey(0xBB));
+			Assert::AreEqual((short)0x802C, TranslateVirtualKey(0xBC));
+			Assert::AreEqual((short)0x805C, TranslateVirtualKey(0xDC));
+			Assert::AreEqual(TranslateVirtualKey(0x5B), TranslateVirtualKey(0x5C));
+		}
+
+		TEST_METHOD(SidedModifiersCollapse)
+		{
+			Assert::AreEqual((short)0x8010, TranslateVirtualKey(VIRTUAL_KEY_LEFT_SHIFT));
+			Assert::AreEqual((short)0x8010, TranslateVirtualKey(VIRTUAL_KEY_RIGHT_SHIFT));
+			Assert::AreEqual((short)0x8011, TranslateVirtualKey(VIRTUAL_KEY_LEFT_CONTROL));
+			Assert::AreEqual((short)0x8012, TranslateVirtualKey(VIRTUAL_KEY_RIGHT_MENU));
+		}
+
+		TEST_METHOD(UnsupportedKeysTranslateToZero)
+		{
+			Assert::AreEqual((short)0, TranslateVirtualKey(0x08));
+			Assert::AreEqual((short)0, TranslateVirtualKey(0x07));
+			Assert::AreEqual((short)0, TranslateVirtualKey(0x7C));
+			Assert::AreEqual((short)0, TranslateVirtualKey(-1));
+			Assert::AreEqual((short)0, TranslateVirtualKey(256));
+		}
+
+		TEST_METHOD(ModifiersFollowKeyEvents)
+		{
+			ModifierTracker tracker;
+
+			Assert::AreEqual((int)MODIFIER_SHIFT, (int)tracker.Update(VIRTUAL_KEY_LEFT_SHIFT, true));
+			Assert::AreEqual((int)(MODIFIER_SHIFT | MODIFIER_CTRL), (int)tracker.Update(VIRTUAL_KEY_LEFT_CONTROL, true));
+			Assert::AreEqual((int)(MODIFIER_SHIFT | MODIFIER_CTRL | MODIFIER_ALT), (int)tracker.Update(VIRTUAL_KEY_RIGHT_MENU, true));
+
+			/* Other keys don't change anything */
+			Assert::AreEqual((int)(MODIFIER_SHIFT | MODIFIER_CTRL | MODIFIER_ALT), (int)tracker.Update('A', true));
+
+			Assert::AreEqual((int)(MODIFIER_CTRL | MODIFIER_ALT), (int)tracker.Update(VIRTUAL_KEY_LEFT_SHIFT, false));
+			Assert::AreEqual((int)MODIFIER_ALT, (int)tracker.Update(VIRTUAL_KEY_LEFT_CONTROL, false));
+			Assert::AreEqual(0, (int)tracker.Update(VIRTUAL_KEY_RIGHT_MENU, false));
+		}
+
+		TEST_METHOD(OtherSideKeepsModifierHeld)
+		{
+			ModifierTracker tracker;
+
+			tracker.Update(VIRTUAL_KEY_LEFT_SHIFT, true);
+			tracker.Update(VIRTUAL_KEY_RIGHT_SHIFT, true);
+			Assert::AreEqual((int)MODIFIER_SHIFT, (int)tracker.Update(VIRTUAL_KEY_LEFT_SHIFT, false));
+			Assert::AreEqual(0, (int)tracker.Update(VIRTUAL_KEY_RIGHT_SHIFT, false));
+		}
+
+		TEST_METHOD(GenericKeyUpReleasesBothSides)
+		{
+			ModifierTracker tracker;
+
+			tracker.Update(VIRTUAL_KEY_LEFT_SHIFT, true);
+			tracker.Update(VIRTUAL_KEY_RIGHT_SHIFT, true);
+			tracker.Update(VIRTUAL_KEY_CONTROL, true);
+			Assert::AreEqual((int)MODIFIER_CTRL, (int)tracker.Update(VIRTUAL_KEY_SHIFT, false));
+
+			/* A sided key up also releases a generic down */
+			Assert::AreEqual(0, (int)tracker.Update(VIRTUAL_KEY_LEFT_CONTROL, false));
+		}
+
+		TEST_METHOD(ResetForgetsHeldKeys)
+		{
+			ModifierTracker tracker;
+
+			tracker.Update(VIRTUAL_KEY_MENU, true);
+			tracker.Update(VIRTUAL_KEY_LEFT_SHIFT, true);
+			tracker.Reset();
+			Assert::AreEqual(0, (int)tracker.GetModifiers());
+		}
+	};
+}
@@ -0,0 +1,140 @@
+#include "CppUnitTest.h"
+#include "LengthPrefixWriter.hpp"
+#include "TestBitstream.hpp"
+
+#include <stdlib.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+#define RANDOM_FRAME_TRIALS 2000
+
+namespace Moonlight_common_binding_Tests
+{
+	/* Feeds the frame to the writer split at the given fragment sizes */
+	static std::vector<unsigned char> WriteFragments(const std::vector<unsigned char> &frame,
+		const std::vector<int> &fragments) {
+		std::vector<unsigned char> output(GetLengthPrefixedBound((int)frame.size()));
+		LengthPrefixWriter writer;
+		int offset = 0;
+
+		writer.Begin(output.data());
+		for (size_t i = 0; i < fragments.size(); i++) {
+			writer.Append(&frame[offset], fragments[i]);
+			offset += fragments[i];
+		}
+		output.resize(writer.Finish());
+		return output;
+	}
+
+	static std::vector<unsigned char> ConvertWhole(const std::vector<unsigned char> &frame) {
+		std::vector<unsigned char> output(GetLengthPrefixedBound((int)frame.size()));
+
+		output.resize(ConvertToLengthPrefixed(frame.data(), (int)frame.size(), output.data()));
+		return output;
+	}
+
+	TEST_CLASS(LengthPrefixWriterTests)
+	{
+	public:
+		TEST_METHOD(ConvertsWholeFrame)
+		{
+			std::vector<unsigned char> frame;
+
+			AppendAnnexBNalUnit(frame, H264Sps, 4);
+			AppendAnnexBNalUnit(frame, H264Pps, 3);
+			AppendAnnexBNalUnit(frame, H264IdrSlice, 3);
+
+			Assert::IsTrue(WriteFragments(frame, { (int)frame.size() }) ==
+				BuildFrame(NalPackingLengthPrefixed, { H264Sps, H264Pps, H264IdrSlice }));
+		}
+
+		TEST_METHOD(StartCodeSplitAcrossFragments)
+		{
+			std::vector<unsigned char> frame = BuildFrame(NalPackingAnnexB, { H264Sps, H264Pps, H264IdrSlice });
+			std::vector<unsigned char> expected = BuildFrame(NalPackingLengthPrefixed, { H264Sps, H264Pps, H264IdrSlice });
+			int ppsStartCode = 4 + (int)H264Sps.size();
+
+			/* Every split through the PPS start code, including one that
+			 * leaves a fragment of nothing but zeros */
+			for (int split = 1; split <= 4; split++) {
+				Assert::IsTrue(WriteFragments(frame, { ppsStartCode + split, (int)frame.size() - ppsStartCode - split }) == expected);
+			}
+			Assert::IsTrue(WriteFragments(frame, { ppsStartCode + 1, 1, 1, 1, (int)frame.size() - ppsStartCode - 4 }) == expected);
+		}
+
+		/* Bytes before the first start code, empty NAL units and
+		 * trailing_zero_8bits aren't part of any NAL unit */
+		TEST_METHOD(DropsBytesOutsideNalUnits)
+		{
+			std::vector<unsigned char> frame = { 0x12, 0x34 };
+			std::vector<unsigned char> empty;
+
+			AppendAnnexBNalUnit(frame, H264Sps, 4);
+			frame.push_back(0);
+			frame.push_back(0);
+			AppendAnnexBNalUnit(frame, empty, 3);
+			AppendAnnexBNalUnit(frame, H264IdrSlice, 4);
+
+			Assert::IsTrue(WriteFragments(frame, { (int)frame.size() }) ==
+				BuildFrame(NalPackingLengthPrefixed, { H264Sps, H264IdrSlice }));
+		}
+
+		TEST_METHOD(FrameWithoutStartCodeIsEmpty)
+		{
+			std::vector<unsigned char> frame = { 0x65, 0x88, 0x84 };
+
+			Assert::AreEqual(0, (int)WriteFragments(frame, { (int)frame.size() }).size());
+		}
+
+		/* Random frames split at random points, many of them inside start
+		 * codes, must come out the same as converting the whole frame */
+		TEST_METHOD(RandomFragmentationMatchesReadNalUnit)
+		{
+			srand(1);
+			for (int trial = 0; trial < RANDOM_FRAME_TRIALS; trial++) {
+				std::vector<unsigned char> frame = BuildRandomFrame();
+				std::vector<int> fragments;
+				int remaining = (int)frame.size();
+
+				while (remaining > 0) {
+					int size = rand() % 2 ? 1 + rand() % 4 : 1 + rand() % 1500;
+
+					if (size > remaining) {
+						size = remaining;
+					}
+					fragments.push_back(size);
+					remaining -= size;
+				}
+
+				Assert::IsTrue(WriteFragments(frame, fragments) == ConvertWhole(frame));
+			}
+		}
+
+	private:
+		static std::vector<unsigned char> BuildRandomFrame(void) {
+			std::vector<unsigned char> frame;
+			std::vector<unsigned char> empty;
+			int nalCount = 1 + rand() % 8;
+
+			if (rand() % 8 == 0) {
+				frame = BuildSlice({ 0x80 }, 1 + rand() % 16, rand());
+			}
+
+			for (int i = 0; i < nalCount; i++) {
+				if (rand() % 16 == 0) {
+					AppendAnnexBNalUnit(frame, empty, 3 + rand() % 2);
+				}
+
+				AppendAnnexBNalUnit(frame, BuildSlice({ (unsigned char)(0x21 + rand() % 0x5E) }, 1 + rand() % 3000, rand()),
+					3 + rand() % 2);
+
+				for (int zeros = rand() % 4 == 0 ? rand() % 3 : 0; zeros > 0; zeros--) {
+					frame.push_back(0);
+				}
+			}
+
+			return frame;
+		}
+	};
+}
@@ -0,0 +1,214 @@
+#include "CppUnitTest.h"
+#include "LinkProbe.hpp"
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <stdio.h>
+#include <string>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+/* Echoes held back by the shaper past this many bytes are dropped, like a
+ * router queue overflowing */
+#define SHAPED_ECHO_QUEUE_BYTES (64 * 1024)
+
+namespace Moonlight_common_binding_Tests
+{
+	/* A UDP echo service on loopback that sends its echoes no faster than
+	 * rateKbps, standing in for a host behind a slow link. Datagrams bigger
+	 * than maxEchoSize aren't echoed at all. */
+	class ShapedEchoServer
+	{
+	public:
+		ShapedEchoServer(int rateKbps, int maxEchoSize)
+			: m_RateKbps(rateKbps), m_MaxEchoSize(maxEchoSize), m_Stop(false), m_Port(0)
+		{
+			struct sockaddr_in address;
+			int addressLength = sizeof(address);
+			WSADATA wsaData;
+
+			WSAStartup(MAKEWORD(2, 2), &wsaData);
+			m_Socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+			Assert::IsTrue(m_Socket != INVALID_SOCKET);
+
+			ZeroMemory(&address, sizeof(address));
+			address.sin_family = AF_INET;
+			address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			Assert::IsTrue(bind(m_Socket, (struct sockaddr*)&address, sizeof(address)) != SOCKET_ERROR);
+			Assert::IsTrue(getsockname(m_Socket, (struct sockaddr*)&address, &addressLength) != SOCKET_ERROR);
+			m_Port = ntohs(address.sin_port);
+
+			m_Thread = std::thread(&ShapedEchoServer::ThreadProc, this);
+		}
+
+		~ShapedEchoServer() {
+			m_Stop = true;
+			m_Thread.join();
+			closesocket(m_Socket);
+			WSACleanup();
+		}
+
+		int GetPort(void) {
+			return m_Port;
+		}
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		struct Echo
+		{
+			Clock::time_point sendTime;
+			struct sockaddr_in to;
+			std::string data;
+		};
+
+		void ThreadProc(void) {
+			std::deque<Echo> queue;
+			Clock::time_point linkFree = Clock::now();
+			size_t queuedBytes = 0;
+			char buffer[2048];
+			struct sockaddr_in from;
+			struct timeval timeout;
+			fd_set readFds;
+			int fromLength;
+			int length;
+
+			while (!m_Stop) {
+				while (!queue.empty() && queue.front().sendTime <= Clock::now()) {
+					Echo &echo = queue.front();
+
+					sendto(m_Socket, echo.data.data(), (int)echo.data.size(), 0, (struct sockaddr*)&echo.to, sizeof(echo.to));
+					queuedBytes -= echo.data.size();
+					queue.pop_front();
+				}
+
+				FD_ZERO(&readFds);
+				FD_SET(m_Socket, &readFds);
+				timeout.tv_sec = 0;
+				timeout.tv_usec = 500;
+				if (select(0, &readFds, NULL, NULL, &timeout) <= 0) {
+					continue;
+				}
+
+				fromLength = sizeof(from);
+				length = recvfrom(m_Socket, buffer, sizeof(buffer), 0, (struct sockaddr*)&from, &fromLength);
+				if (length == SOCKET_ERROR || length > m_MaxEchoSize ||
+					queuedBytes + length > SHAPED_ECHO_QUEUE_BYTES) {
+					continue;
+				}
+
+				/* Each echo holds the link for as long as its bits take to send */
+				Echo echo;
+				echo.sendTime = linkFree > Clock::now() ? linkFree : Clock::now();
+				echo.to = from;
+				echo.data.assign(buffer, length);
+				linkFree = echo.sendTime + std::chrono::microseconds((long long)length * 8 * 1000 / m_RateKbps);
+				queuedBytes += length;
+				queue.push_back(echo);
+			}
+		}
+
+		int m_RateKbps;
+		int m_MaxEchoSize;
+		std::atomic<bool> m_Stop;
+		SOCKET m_Socket;
+		int m_Port;
+		std::thread m_Thread;
+	};
+
+	TEST_CLASS(LinkProbeTests)
+	{
+	public:
+		TEST_METHOD(MeasuresShapedLink)
+		{
+			ShapedEchoServer server(8000, 2048);
+			LinkProbeResult result;
+			char message[128];
+
+			Assert::IsTrue(ProbeLink("127.0.0.1", server.GetPort(), 20000, result));
+
+			sprintf(message, "rtt %d us, jitter %d us, %d kbps, %d%% loss", result.rttUs, result.jitterUs,
+				result.throughputKbps, result.lossPercent);
+			Logger::WriteMessage(message);
+
+			Assert::AreEqual(30000, result.burstRateKbps);
+			Assert::IsTrue(result.rttUs > 0);
+			Assert::IsTrue(result.throughputKbps >= 6000 && result.throughputKbps <= 10000);
+
+			/* The burst overflowed the shaper's queue */
+			Assert::IsTrue(result.lossPercent > 0);
+		}
+
+		/* Pings come back but the burst doesn't, which is no measurement at
+		 * all rather than a link with no throughput */
+		TEST_METHOD(BurstThatDoesNotComeBackFails)
+		{
+			ShapedEchoServer server(8000, LINK_PROBE_PING_SIZE);
+			LinkProbeResult result;
+
+			Assert::IsFalse(ProbeLink("127.0.0.1", server.GetPort(), 20000, result));
+		}
+
+		TEST_METHOD(NoEchoServiceFails)
+		{
+			int port;
+			LinkProbeResult result;
+
+			/* Find a port nothing listens on */
+			{
+				ShapedEchoServer server(8000, 0);
+				port = server.GetPort();
+			}
+
+			Assert::IsFalse(ProbeLink("127.0.0.1", port, 20000, result));
+		}
+
+		TEST_METHOD(SlowLinkGetsLowerMode)
+		{
+			StreamMode maxMode = { 1920, 1080, 60, 20000 };
+			LinkProbeResult result = {};
+			StreamMode mode;
+
+			result.rttUs = 1000;
+			result.throughputKbps = 4000;
+			result.burstRateKbps = 30000;
+			result.lossPercent = 50;
+			mode = SuggestStreamMode(result, maxMode);
+
+			/* A full link's loss is the burst overflowing a queue, so it's ignored */
+			Assert::AreEqual(4000 * LINK_PROBE_USABLE_PERCENT / 100, mode.bitrateKbps);
+			Assert::IsTrue(mode.height < maxMode.height);
+		}
+
+		/* A link that kept up with the burst lost packets on its own */
+		TEST_METHOD(LossOnLinkThatKeptUpCostsBitrate)
+		{
+			StreamMode maxMode = { 1920, 1080, 60, 20000 };
+			LinkProbeResult result = {};
+
+			result.throughputKbps = 28000;
+			result.burstRateKbps = 30000;
+			result.lossPercent = 10;
+
+			Assert::AreEqual(28000 * LINK_PROBE_USABLE_PERCENT / 100 * 90 / 100,
+				SuggestStreamMode(result, maxMode).bitrateKbps);
+		}
+
+		TEST_METHOD(JitteryLinkFallsBackInFrameRate)
+		{
+			StreamMode maxMode = { 1920, 1080, 60, 20000 };
+			LinkProbeResult result = {};
+
+			result.jitterUs = 10000;
+			result.throughputKbps = 40000;
+			result.burstRateKbps = 30000;
+
+			Assert::AreEqual(LINK_PROBE_FALLBACK_FPS, SuggestStreamMode(result, maxMode).fps);
+		}
+	};
+}
@@ -0,0 +1,116 @@
+#include "CppUnitTest.h"
+#include "LockFreeQueue.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+namespace Moonlight_common_binding_Tests
+{
+	TEST_CLASS(LockFreeQueueTests)
+	{
+	public:
+		TEST_METHOD(DequeuesInOrder)
+		{
+			LockFreeQueue<int, 8> queue;
+			int value;
+
+			for (int i = 0; i < 5; i++) {
+				Assert::IsTrue(queue.TryEnqueue(i));
+			}
+			Assert::AreEqual((size_t)5, queue.GetDepth());
+
+			for (int i = 0; i < 5; i++) {
+				Assert::IsTrue(queue.TryDequeue(value));
+				Assert::AreEqual(i, value);
+			}
+			Assert::IsFalse(queue.TryDequeue(value));
+			Assert::AreEqual((size_t)0, queue.GetDepth());
+		}
+
+		TEST_METHOD(EnqueueFailsWhenFull)
+		{
+			LockFreeQueue<int, 4> queue;
+			int value;
+
+			for (int i = 0; i < 4; i++) {
+				Assert::IsTrue(queue.TryEnqueue(i));
+			}
+			Assert::IsFalse(queue.TryEnqueue(4));
+
+			/* Freeing one slot makes room for exactly one more */
+			Assert::IsTrue(queue.TryDequeue(value));
+			Assert::AreEqual(0, value);
+			Assert::IsTrue(queue.TryEnqueue(4));
+			Assert::IsFalse(queue.TryEnqueue(5));
+		}
+
+		TEST_METHOD(WrapsAroundManyTimes)
+		{
+			LockFreeQueue<int, 4> queue;
+			int value;
+
+			for (int i = 0; i < 1000; i++) {
+				Assert::IsTrue(queue.TryEnqueue(i));
+				Assert::IsTrue(queue.TryEnqueue(i + 1));
+				Assert::IsTrue(queue.TryDequeue(value));
+				Assert::AreEqual(i, value);
+				Assert::IsTrue(queue.TryDequeue(value));
+				Assert::AreEqual(i + 1, value);
+			}
+			Assert::AreEqual((size_t)0, queue.GetDepth());
+		}
+
+		TEST_METHOD(EveryElementDequeuedOnceUnderContention)
+		{
+			const int producerCount = 4;
+			const int consumerCount = 4;
+			const int perProducer = 20000;
+			LockFreeQueue<int, 64> queue;
+			std::vector<std::atomic<int>> seen(producerCount * perProducer);
+			std::atomic<int> consumed(0);
+			std::vector<std::thread> threads;
+
+			for (auto &count : seen) {
+				count = 0;
+			}
+
+			for (int p = 0; p < producerCount; p++) {
+				threads.push_back(std::thread([&queue, p, perProducer] {
+					for (int i = 0; i < perProducer; i++) {
+						while (!queue.TryEnqueue(p * perProducer + i)) {
+							std::this_thread::yield();
+						}
+					}
+				}));
+			}
+
+			for (int c = 0; c < consumerCount; c++) {
+				threads.push_back(std::thread([&queue, &seen, &consumed, producerCount, perProducer] {
+					int value;
+
+					while (consumed < producerCount * perProducer) {
+						if (queue.TryDequeue(value)) {
+							seen[value]++;
+							consumed++;
+						}
+						else {
+							std::this_thread::yield();
+						}
+					}
+				}));
+			}
+
+			for (auto &thread : threads) {
+				thread.join();
+			}
+
+			for (size_t i = 0; i < seen.size(); i++) {
+				Assert::AreEqual(1, seen[i].load());
+			}
+		}
+	};
+}
@@ -0,0 +1,129 @@
+#include "CppUnitTest.h"
+#include "NalParser.hpp"
+#include "TestBitstream.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+namespace Moonlight_common_binding_Tests
+{
+	TEST_CLASS(NalParserTests)
+	{
+	public:
+		TEST_METHOD(FindsThreeAndFourByteStartCodes)
+		{
+			const unsigned char data[] = { 0x00, 0x00, 0x01, 0x09, 0xF0, 0x00, 0x00, 0x00, 0x01, 0x65, 0x88 };
+			int startCodeLength;
+
+			Assert::AreEqual(0, FindStartCode(data, sizeof(data), 0, startCodeLength));
+			Assert::AreEqual(3, startCodeLength);
+
+			Assert::AreEqual(5, FindStartCode(data, sizeof(data), 3, startCodeLength));
+			Assert::AreEqual(4, startCodeLength);
+		}
+
+		TEST_METHOD(NoStartCodeReturnsLength)
+		{
+			const unsigned char data[] = { 0x65, 0x00, 0x00, 0x03, 0x01, 0x00, 0x00 };
+			int startCodeLength;
+
+			Assert::AreEqual((int)sizeof(data), FindStartCode(data, sizeof(data), 0, startCodeLength));
+			Assert::AreEqual(0, startCodeLength);
+		}
+
+		TEST_METHOD(ReadsAnnexBUnits)
+		{
+			std::vector<unsigned char> frame;
+			NalUnit nal;
+			int offset = 0;
+
+			AppendAnnexBNalUnit(frame, H264Sps, 4);
+			AppendAnnexBNalUnit(frame, H264Pps, 3);
+			AppendAnnexBNalUnit(frame, H264IdrSlice, 3);
+
+			Assert::IsTrue(ReadNalUnit(frame.data(), (int)frame.size(), NalPackingAnnexB, offset, nal));
+			Assert::AreEqual(0, nal.startCodeOffset);
+			Assert::AreEqual(4, nal.headerOffset);
+			Assert::AreEqual(4 + (int)H264Sps.size(), nal.end);
+
+			Assert::IsTrue(ReadNalUnit(frame.data(), (int)frame.size(), NalPackingAnnexB, offset, nal));
+			Assert::AreEqual(3, nal.headerOffset - nal.startCodeOffset);
+			Assert::AreEqual((int)H264Pps.size(), nal.end - nal.headerOffset);
+
+			Assert::IsTrue(ReadNalUnit(frame.data(), (int)frame.size(), NalPackingAnnexB, offset, nal));
+			Assert::AreEqual((int)H264IdrSlice.size(), nal.end - nal.headerOffset);
+			Assert::AreEqual((int)frame.size(), nal.end);
+
+			Assert::IsFalse(ReadNalUnit(frame.data(), (int)frame.size(), NalPackingAnnexB, offset, nal));
+		}
+
+		TEST_METHOD(ReadsLengthPrefixedUnits)
+		{
+			std::vector<unsigned char> frame = BuildFrame(NalPackingLengthPrefixed, { HevcVps, HevcSps, HevcIdrSlice });
+			NalUnit nal;
+			int offset = 0;
+
+			Assert::IsTrue(ReadNalUnit(frame.data(), (int)frame.size(), NalPackingLengthPrefixed, offset, nal));
+			Assert::AreEqual(NAL_LENGTH_PREFIX_SIZE, nal.headerOffset);
+			Assert::AreEqual(HEVC_NAL_TYPE_VPS, GetNalType(NalFormatHevc, frame[nal.headerOffset]));
+
+			Assert::IsTrue(ReadNalUnit(frame.data(), (int)frame.size(), NalPackingLengthPrefixed, offset, nal));
+			Assert::AreEqual(HEVC_NAL_TYPE_SPS, GetNalType(NalFormatHevc, frame[nal.headerOffset]));
+
+			/* The SPS contains 00 00 03, which must not be mistaken for anything */
+			Assert::AreEqual((int)HevcSps.size(), nal.end - nal.headerOffset);
+
+			Assert::IsTrue(ReadNalUnit(frame.data(), (int)frame.size(), NalPackingLengthPrefixed, offset, nal));
+			Assert::AreEqual((int)frame.size(), nal.end);
+			Assert::IsFalse(ReadNalUnit(frame.data(), (int)frame.size(), NalPackingLengthPrefixed, offset, nal));
+		}
+
+		TEST_METHOD(RejectsLengthPrefixPastEndOfFrame)
+		{
+			std::vector<unsigned char> frame = BuildFrame(NalPackingLengthPrefixed, { H264IdrSlice });
+			NalUnit nal;
+			int offset = 0;
+
+			frame.pop_back();
+			Assert::IsFalse(ReadNalUnit(frame.data(), (int)frame.size(), NalPackingLengthPrefixed, offset, nal));
+			Assert::AreEqual((int)frame.size(), offset);
+		}
+
+		TEST_METHOD(ClassifiesH264Frames)
+		{
+			Assert::AreEqual((int)FrameClassIdr, (int)Classify(NalFormatH264, { H264Aud, H264Sps, H264Pps, H264IdrSlice }));
+			Assert::AreEqual((int)FrameClassReference, (int)Classify(NalFormatH264, { H264Aud, H264PSlice }));
+			Assert::AreEqual((int)FrameClassNonReference, (int)Classify(NalFormatH264, { H264Aud, H264BSlice }));
+		}
+
+		TEST_METHOD(ClassifiesHevcFrames)
+		{
+			Assert::AreEqual((int)FrameClassIdr, (int)Classify(NalFormatHevc, { HevcAud, HevcVps, HevcSps, HevcPps, HevcIdrSlice }));
+			Assert::AreEqual((int)FrameClassIdr, (int)Classify(NalFormatHevc, { HevcCraSlice }));
+			Assert::AreEqual((int)FrameClassReference, (int)Classify(NalFormatHevc, { HevcAud, HevcTrailRSlice }));
+			Assert::AreEqual((int)FrameClassNonReference, (int)Classify(NalFormatHevc, { HevcAud, HevcTrailNSlice }));
+		}
+
+		/* Dropping a frame that can't be classified is never safe */
+		TEST_METHOD(FrameWithoutSliceIsReference)
+		{
+			std::vector<unsigned char> garbage = { 0x12, 0x34, 0x56 };
+
+			Assert::AreEqual((int)FrameClassReference, (int)Classify(NalFormatH264, { H264Aud, H264Sps }));
+			Assert::AreEqual((int)FrameClassReference, (int)ClassifyFrame(NalFormatH264, NalPackingAnnexB,
+				garbage.data(), (int)garbage.size()));
+		}
+
+	private:
+		/* Classifies the frame both ways it can be packed, which must agree */
+		static FrameClass Classify(NalFormat format, const std::vector<std::vector<unsigned char>> &nals) {
+			std::vector<unsigned char> annexB = BuildFrame(NalPackingAnnexB, nals);
+			std::vector<unsigned char> lengthPrefixed = BuildFrame(NalPackingLengthPrefixed, nals);
+			FrameClass frameClass = ClassifyFrame(format, NalPackingAnnexB, annexB.data(), (int)annexB.size());
+
+			Assert::AreEqual((int)frameClass, (int)ClassifyFrame(format, NalPackingLengthPrefixed,
+				lengthPrefixed.data(), (int)lengthPrefixed.size()));
+			return frameClass;
+		}
+	};
+}
@@ -0,0 +1,122 @@
+#include "CppUnitTest.h"
+#include "PacketizationStatistics.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+namespace Moonlight_common_binding_Tests
+{
+	TEST_CLASS(PacketizationStatisticsTests)
+	{
+	public:
+		TEST_METHOD(UnknownPathUsesDefault)
+		{
+			PacketizationStatistics statistics;
+
+			Assert::AreEqual(PACKET_SIZE_DEFAULT, statistics.RecommendPacketSize(0));
+		}
+
+		TEST_METHOD(PathLimitIsClampedAndAligned)
+		{
+			PacketizationStatistics statistics;
+
+			Assert::AreEqual(PACKET_SIZE_MAX, statistics.RecommendPacketSize(1456));
+			Assert::AreEqual(1200, statistics.RecommendPacketSize(1207));
+			Assert::AreEqual(PACKET_SIZE_MIN, statistics.RecommendPacketSize(300));
+		}
+
+		/* The IDR frame a connection starts with, and ones the binding
+		 * asked for, aren't loss */
+		TEST_METHOD(ExpectedIdrFramesAreNotLoss)
+		{
+			PacketizationStatistics statistics;
+
+			statistics.BeginStream(PACKET_SIZE_MAX);
+			Stream(statistics, PACKETIZATION_MIN_CLASS_FRAMES, 0);
+			statistics.OnIdrRequested();
+			statistics.RecordFrame(8, true);
+
+			Assert::AreEqual(0, statistics.GetLossPermille(PACKET_SIZE_MAX / PACKET_SIZE_CLASS_BYTES));
+		}
+
+		TEST_METHOD(UnrequestedIdrFramesAreLoss)
+		{
+			PacketizationStatistics statistics;
+
+			statistics.BeginStream(PACKET_SIZE_MAX);
+			Stream(statistics, PACKETIZATION_MIN_CLASS_FRAMES, 180);
+
+			/* 9 losses in 1800 frames */
+			Assert::AreEqual(5, statistics.GetLossPermille(PACKET_SIZE_MAX / PACKET_SIZE_CLASS_BYTES));
+		}
+
+		TEST_METHOD(TooFewFramesToTell)
+		{
+			PacketizationStatistics statistics;
+
+			statistics.BeginStream(PACKET_SIZE_MAX);
+			Stream(statistics, PACKETIZATION_MIN_CLASS_FRAMES - 1, 180);
+
+			Assert::AreEqual(-1, statistics.GetLossPermille(PACKET_SIZE_MAX / PACKET_SIZE_CLASS_BYTES));
+			Assert::AreEqual(PACKET_SIZE_MAX, statistics.RecommendPacketSize(PACKET_SIZE_MAX));
+		}
+
+		/* A lossy size is stepped down from, into the next class below */
+		TEST_METHOD(StepsBelowLossyPacketSize)
+		{
+			PacketizationStatistics statistics;
+
+			statistics.BeginStream(PACKET_SIZE_DEFAULT);
+			Stream(statistics, PACKETIZATION_MIN_CLASS_FRAMES, 0);
+			statistics.BeginStream(PACKET_SIZE_MAX);
+			Stream(statistics, PACKETIZATION_MIN_CLASS_FRAMES, 90);
+
+			Assert::AreEqual((PACKET_SIZE_MAX / PACKET_SIZE_CLASS_BYTES) * PACKET_SIZE_CLASS_BYTES - PACKET_SIZE_ALIGNMENT,
+				statistics.RecommendPacketSize(PACKET_SIZE_MAX));
+		}
+
+		/* Loss within the margin of the best size isn't blamed on the size */
+		TEST_METHOD(KeepsSizeWithinLossMargin)
+		{
+			PacketizationStatistics statistics;
+
+			statistics.BeginStream(PACKET_SIZE_DEFAULT);
+			Stream(statistics, PACKETIZATION_MIN_CLASS_FRAMES, 900);
+			statistics.BeginStream(PACKET_SIZE_MAX);
+			Stream(statistics, PACKETIZATION_MIN_CLASS_FRAMES, 600);
+
+			Assert::AreEqual(PACKET_SIZE_MAX, statistics.RecommendPacketSize(PACKET_SIZE_MAX));
+		}
+
+		TEST_METHOD(FragmentHistograms)
+		{
+			PacketizationStatistics statistics;
+
+			statistics.RecordFragment(100);
+			statistics.RecordFragment(1392);
+			statistics.RecordFragment(5000);
+			statistics.RecordFrame(1, false);
+			statistics.RecordFrame(3, false);
+			statistics.RecordFrame(100000, false);
+
+			Assert::AreEqual(1LL, statistics.GetFragmentSizeBucket(0));
+			Assert::AreEqual(1LL, statistics.GetFragmentSizeBucket(1392 / PACKET_SIZE_CLASS_BYTES));
+			Assert::AreEqual(1LL, statistics.GetFragmentSizeBucket(PACKET_SIZE_CLASSES - 1));
+			Assert::AreEqual(5000, statistics.GetMaxFragmentSize());
+
+			Assert::AreEqual(1LL, statistics.GetFragmentCountBucket(1));
+			Assert::AreEqual(1LL, statistics.GetFragmentCountBucket(2));
+			Assert::AreEqual(1LL, statistics.GetFragmentCountBucket(FRAGMENT_COUNT_BUCKETS - 1));
+		}
+
+	private:
+		/* Records frames after the IDR frame the stream starts with, making
+		 * every lossInterval-th frame an IDR frame nobody asked for */
+		static void Stream(PacketizationStatistics &statistics, int frames, int lossInterval) {
+			statistics.RecordFrame(20, true);
+			for (int i = 1; i < frames; i++) {
+				statistics.RecordFrame(4, lossInterval > 0 && i % lossInterval == 0);
+			}
+		}
+	};
+}
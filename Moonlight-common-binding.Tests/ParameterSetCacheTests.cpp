@@ -0,0 +1,224 @@
+#include "CppUnitTest.h"
+#include "ParameterSetCache.hpp"
+#include "TestBitstream.hpp"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+namespace Moonlight_common_binding_Tests
+{
+	/* Runs a frame through the cache with the headroom it expects in front */
+	static int ProcessFrame(ParameterSetCache &cache, const std::vector<unsigned char> &frame,
+		std::vector<unsigned char> &output) {
+		std::vector<unsigned char> buffer(PARAMETER_SET_HEADROOM + frame.size());
+		int offset = PARAMETER_SET_HEADROOM;
+		int length = (int)frame.size();
+		int stripped;
+
+		std::copy(frame.begin(), frame.end(), buffer.begin() + offset);
+		stripped = cache.Process(buffer.data(), offset, length);
+		output.assign(buffer.begin() + offset, buffer.begin() + offset + length);
+		return stripped;
+	}
+
+	TEST_CLASS(ParameterSetCacheTests)
+	{
+	public:
+		TEST_METHOD_INITIALIZE(Initialize)
+		{
+			m_Cache.Reset(NalFormatH264, NalPackingAnnexB);
+		}
+
+		TEST_METHOD(FirstParameterSetsPassThrough)
+		{
+			std::vector<unsigned char> frame = BuildFrame(NalPackingAnnexB, { H264Aud, H264Sps, H264Pps, H264IdrSlice });
+			std::vector<unsigned char> output;
+
+			Assert::AreEqual(0, ProcessFrame(m_Cache, frame, output));
+			Assert::IsTrue(output == frame);
+		}
+
+		TEST_METHOD(UnchangedParameterSetsAreStripped)
+		{
+			std::vector<unsigned char> frame = BuildFrame(NalPackingAnnexB, { H264Aud, H264Sps, H264Pps, H264IdrSlice });
+			std::vector<unsigned char> output;
+
+			ProcessFrame(m_Cache, frame, output);
+			Assert::AreEqual(2, ProcessFrame(m_Cache, frame, output));
+			Assert::IsTrue(output == BuildFrame(NalPackingAnnexB, { H264Aud, H264IdrSlice }));
+		}
+
+		/* The decoder drops the PPS along with the SPS it replaces, so the
+		 * unchanged PPS has to come with the new SPS */
+		TEST_METHOD(ChangedSpsKeepsUnchangedPps)
+		{
+			std::vector<unsigned char> output;
+
+			ProcessFrame(m_Cache, BuildFrame(NalPackingAnnexB, { H264Sps, H264Pps, H264IdrSlice }), output);
+			Assert::AreEqual(0, ProcessFrame(m_Cache,
+				BuildFrame(NalPackingAnnexB, { H264SpsChanged, H264Pps, H264IdrSlice }), output));
+			Assert::IsTrue(output == BuildFrame(NalPackingAnnexB, { H264SpsChanged, H264Pps, H264IdrSlice }));
+
+			/* The changed one is now the active one */
+			Assert::AreEqual(2, ProcessFrame(m_Cache,
+				BuildFrame(NalPackingAnnexB, { H264SpsChanged, H264Pps, H264IdrSlice }), output));
+		}
+
+		/* Nothing depends on a PPS, so the SPS in front of a new one is still stripped */
+		TEST_METHOD(ChangedPpsPassesThrough)
+		{
+			std::vector<unsigned char> ppsChanged = H264Pps;
+			std::vector<unsigned char> output;
+
+			ppsChanged.back() ^= 0x55;
+			ProcessFrame(m_Cache, BuildFrame(NalPackingAnnexB, { H264Sps, H264Pps, H264IdrSlice }), output);
+			Assert::AreEqual(1, ProcessFrame(m_Cache,
+				BuildFrame(NalPackingAnnexB, { H264Sps, ppsChanged, H264IdrSlice }), output));
+			Assert::IsTrue(output == BuildFrame(NalPackingAnnexB, { ppsChanged, H264IdrSlice }));
+		}
+
+		TEST_METHOD(FramesWithoutParameterSetsAreUntouched)
+		{
+			std::vector<unsigned char> frame = BuildFrame(NalPackingAnnexB, { H264Aud, H264PSlice });
+			std::vector<unsigned char> output;
+
+			ProcessFrame(m_Cache, BuildFrame(NalPackingAnnexB, { H264Sps, H264Pps, H264IdrSlice }), output);
+			Assert::AreEqual(0, ProcessFrame(m_Cache, frame, output));
+			Assert::IsTrue(output == frame);
+		}
+
+		/* After a decoder reset the next IDR frame gets the sets back, in
+		 * front of its first slice, even if the host left them out */
+		TEST_METHOD(ReinjectsAfterDecoderReset)
+		{
+			std::vector<unsigned char> output;
+
+			ProcessFrame(m_Cache, BuildFrame(NalPackingAnnexB, { H264Sps, H264Pps, H264IdrSlice }), output);
+			m_Cache.OnDecoderReset();
+
+			/* Only an IDR frame can carry them */
+			ProcessFrame(m_Cache, BuildFrame(NalPackingAnnexB, { H264PSlice }), output);
+			Assert::IsTrue(output == BuildFrame(NalPackingAnnexB, { H264PSlice }));
+
+			ProcessFrame(m_Cache, BuildFrame(NalPackingAnnexB, { H264Aud, H264IdrSlice }), output);
+			Assert::IsTrue(output == BuildFrame(NalPackingAnnexB, { H264Aud, H264Sps, H264Pps, H264IdrSlice }));
+
+			/* And they're stripped again once the decoder has them */
+			Assert::AreEqual(2, ProcessFrame(m_Cache,
+				BuildFrame(NalPackingAnnexB, { H264Sps, H264Pps, H264IdrSlice }), output));
+		}
+
+		/* Sets the host did resend aren't injected a second time */
+		TEST_METHOD(ReinjectsOnlyMissingSets)
+		{
+			std::vector<unsigned char> output;
+
+			ProcessFrame(m_Cache, BuildFrame(NalPackingAnnexB, { H264Sps, H264Pps, H264IdrSlice }), output);
+			m_Cache.OnDecoderReset();
+
+			Assert::AreEqual(0, ProcessFrame(m_Cache, BuildFrame(NalPackingAnnexB, { H264Pps, H264IdrSlice }), output));
+			Assert::IsTrue(output == BuildFrame(NalPackingAnnexB, { H264Sps, H264Pps, H264IdrSlice }));
+		}
+
+		TEST_METHOD(ReinjectsWithLengthPrefixes)
+		{
+			std::vector<unsigned char> output;
+
+			m_Cache.Reset(NalFormatH264, NalPackingLengthPrefixed);
+			ProcessFrame(m_Cache, BuildFrame(NalPackingLengthPrefixed, { H264Sps, H264Pps, H264IdrSlice }), output);
+			m_Cache.OnDecoderReset();
+
+			ProcessFrame(m_Cache, BuildFrame(NalPackingLengthPrefixed, { H264IdrSlice }), output);
+			Assert::IsTrue(output == BuildFrame(NalPackingLengthPrefixed, { H264Sps, H264Pps, H264IdrSlice }));
+
+			Assert::AreEqual(2, ProcessFrame(m_Cache,
+				BuildFrame(NalPackingLengthPrefixed, { H264Sps, H264Pps, H264IdrSlice }), output));
+			Assert::IsTrue(output == BuildFrame(NalPackingLengthPrefixed, { H264IdrSlice }));
+		}
+
+		TEST_METHOD(OversizedParameterSetIsNeverStripped)
+		{
+			std::vector<unsigned char> bigPps(PARAMETER_SET_MAX_SIZE + 1, 0x5A);
+			std::vector<unsigned char> frame;
+			std::vector<unsigned char> output;
+
+			bigPps[0] = H264Pps[0];
+			frame = BuildFrame(NalPackingAnnexB, { H264Sps, bigPps, H264IdrSlice });
+
+			ProcessFrame(m_Cache, frame, output);
+			Assert::AreEqual(1, ProcessFrame(m_Cache, frame, output));
+			Assert::IsTrue(output == BuildFrame(NalPackingAnnexB, { bigPps, H264IdrSlice }));
+		}
+
+		/* Bytes before the first start code can't be moved around safely */
+		TEST_METHOD(LeadingGarbageLeavesFrameAlone)
+		{
+			std::vector<unsigned char> frame = BuildFrame(NalPackingAnnexB, { H264Sps, H264Pps, H264IdrSlice });
+			std::vector<unsigned char> output;
+
+			ProcessFrame(m_Cache, frame, output);
+			frame.insert(frame.begin(), 0x42);
+			Assert::AreEqual(0, ProcessFrame(m_Cache, frame, output));
+			Assert::IsTrue(output == frame);
+		}
+
+		TEST_METHOD(HevcUnchangedParameterSetsAreStripped)
+		{
+			std::vector<unsigned char> frame = BuildFrame(NalPackingAnnexB, { HevcAud, HevcVps, HevcSps, HevcPps, HevcIdrSlice });
+			std::vector<unsigned char> output;
+
+			m_Cache.Reset(NalFormatHevc, NalPackingAnnexB);
+			Assert::AreEqual(0, ProcessFrame(m_Cache, frame, output));
+			Assert::IsTrue(output == frame);
+
+			Assert::AreEqual(3, ProcessFrame(m_Cache, frame, output));
+			Assert::IsTrue(output == BuildFrame(NalPackingAnnexB, { HevcAud, HevcIdrSlice }));
+		}
+
+		/* The VPS is still stripped in front of a changed SPS, but the PPS isn't */
+		TEST_METHOD(HevcChangedSpsKeepsUnchangedPps)
+		{
+			std::vector<unsigned char> spsChanged = HevcSps;
+			std::vector<unsigned char> output;
+
+			spsChanged.back() ^= 0x55;
+			m_Cache.Reset(NalFormatHevc, NalPackingAnnexB);
+			ProcessFrame(m_Cache, BuildFrame(NalPackingAnnexB, { HevcVps, HevcSps, HevcPps, HevcIdrSlice }), output);
+			Assert::AreEqual(1, ProcessFrame(m_Cache,
+				BuildFrame(NalPackingAnnexB, { HevcVps, spsChanged, HevcPps, HevcIdrSlice }), output));
+			Assert::IsTrue(output == BuildFrame(NalPackingAnnexB, { spsChanged, HevcPps, HevcIdrSlice }));
+		}
+
+		/* Any IRAP picture, not just IDR, can carry the sets after a reset */
+		TEST_METHOD(HevcReinjectsAtCra)
+		{
+			std::vector<unsigned char> output;
+
+			m_Cache.Reset(NalFormatHevc, NalPackingLengthPrefixed);
+			ProcessFrame(m_Cache, BuildFrame(NalPackingLengthPrefixed, { HevcVps, HevcSps, HevcPps, HevcIdrSlice }), output);
+			m_Cache.OnDecoderReset();
+
+			ProcessFrame(m_Cache, BuildFrame(NalPackingLengthPrefixed, { HevcTrailRSlice }), output);
+			Assert::IsTrue(output == BuildFrame(NalPackingLengthPrefixed, { HevcTrailRSlice }));
+
+			ProcessFrame(m_Cache, BuildFrame(NalPackingLengthPrefixed, { HevcCraSlice }), output);
+			Assert::IsTrue(output == BuildFrame(NalPackingLengthPrefixed, { HevcVps, HevcSps, HevcPps, HevcCraSlice }));
+		}
+
+		/* A missing SPS goes between the VPS and PPS the host did send */
+		TEST_METHOD(HevcReinjectsMissingSetInOrder)
+		{
+			std::vector<unsigned char> output;
+
+			m_Cache.Reset(NalFormatHevc, NalPackingAnnexB);
+			ProcessFrame(m_Cache, BuildFrame(NalPackingAnnexB, { HevcVps, HevcSps, HevcPps, HevcIdrSlice }), output);
+			m_Cache.OnDecoderReset();
+
+			ProcessFrame(m_Cache, BuildFrame(NalPackingAnnexB, { HevcAud, HevcVps, HevcPps, HevcIdrSlice }), output);
+			Assert::IsTrue(output == BuildFrame(NalPackingAnnexB, { HevcAud, HevcVps, HevcSps, HevcPps, HevcIdrSlice }));
+		}
+
+	private:
+		ParameterSetCache m_Cache;
+	};
+}
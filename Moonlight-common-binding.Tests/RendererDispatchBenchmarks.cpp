@@ -0,0 +1,91 @@
+#include "CppUnitTest.h"
+#include "RendererInterfaces.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+/* A P frame at 20 Mbps, so the call does about what a real sink's first
+ * touch of the frame would */
+#define DISPATCH_BENCHMARK_FRAME_SIZE (40 * 1024)
+#define DISPATCH_BENCHMARK_CALLS 10000000
+#define DISPATCH_BENCHMARK_FPS 60
+
+namespace Moonlight_common_binding_Tests
+{
+	/* Reads the start of each frame like a decoder looking at its header */
+	class PeekingVideoRenderer final : public IVideoRenderer
+	{
+	public:
+		PeekingVideoRenderer() : m_Checksum(0) {}
+
+		void Setup(int width, int height, int redrawRate, int drFlags) override {}
+		void Cleanup(void) override {}
+		int SubmitDecodeUnit(const unsigned char *data, int length, long long receiveTime) override {
+			m_Checksum += data[0] + data[length - 1] + receiveTime;
+			return 0;
+		}
+
+		long long m_Checksum;
+	};
+
+	/* A second sink type, so the compiler can't tell which one a pointer holds */
+	class IgnoringVideoRenderer final : public IVideoRenderer
+	{
+	public:
+		void Setup(int width, int height, int redrawRate, int drFlags) override {}
+		void Cleanup(void) override {}
+		int SubmitDecodeUnit(const unsigned char *data, int length, long long receiveTime) override {
+			return 0;
+		}
+	};
+
+	TEST_CLASS(RendererDispatchBenchmarks)
+	{
+	public:
+		/* Compares handing frames to the renderer through its concrete type,
+		 * the way StreamSession::WithVideoRenderer does, with going through
+		 * IVideoRenderer, the way FramePacer does. Logs the time per call and
+		 * the difference as a share of a 60 FPS frame interval. These report
+		 * numbers rather than assert them, since they run on whatever machine
+		 * builds the tests. */
+		TEST_METHOD(SubmitDecodeUnitDispatch)
+		{
+			std::vector<unsigned char> frame(DISPATCH_BENCHMARK_FRAME_SIZE, 0x5A);
+			PeekingVideoRenderer peeking;
+			IgnoringVideoRenderer ignoring;
+			IVideoRenderer *renderers[] = { &ignoring, &peeking };
+			volatile int selected = 1;
+			IVideoRenderer *renderer = renderers[selected];
+			long long staticNs, virtualNs;
+			long long staticChecksum;
+			char message[256];
+
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < DISPATCH_BENCHMARK_CALLS; i++) {
+				peeking.SubmitDecodeUnit(frame.data(), (int)frame.size(), i);
+			}
+			staticNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			staticChecksum = peeking.m_Checksum;
+
+			peeking.m_Checksum = 0;
+			start = std::chrono::steady_clock::now();
+			for (int i = 0; i < DISPATCH_BENCHMARK_CALLS; i++) {
+				renderer->SubmitDecodeUnit(frame.data(), (int)frame.size(), i);
+			}
+			virtualNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+			/* Both loops did the same work */
+			Assert::AreEqual(staticChecksum, peeking.m_Checksum);
+
+			sprintf(message, "Static: %.2f ns per frame, virtual: %.2f ns per frame, difference %.6f%% of a %d FPS frame",
+				(double)staticNs / DISPATCH_BENCHMARK_CALLS, (double)virtualNs / DISPATCH_BENCHMARK_CALLS,
+				(double)(virtualNs - staticNs) / DISPATCH_BENCHMARK_CALLS * DISPATCH_BENCHMARK_FPS / 1e9 * 100,
+				DISPATCH_BENCHMARK_FPS);
+			Logger::WriteMessage(message);
+		}
+	};
+}
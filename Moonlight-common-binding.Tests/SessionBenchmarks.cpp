@@ -0,0 +1,186 @@
+#include "CppUnitTest.h"
+#include "FlightRecorder.hpp"
+#include "FrameDropPolicy.hpp"
+#include "LengthPrefixWriter.hpp"
+#include "NalParser.hpp"
+#include "PacketizationStatistics.hpp"
+#include "ParameterSetCache.hpp"
+#include "TestBitstream.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+/* Ten seconds of a 60 FPS stream at 20 Mbps with an IDR frame every second */
+#define SESSION_BENCHMARK_FRAMES 600
+#define SESSION_BENCHMARK_FPS 60
+#define SESSION_BENCHMARK_P_FRAME_SIZE (40 * 1024)
+#define SESSION_BENCHMARK_IDR_FRAME_SIZE (256 * 1024)
+#define SESSION_BENCHMARK_MAX_SESSIONS 8
+
+namespace Moonlight_common_binding_Tests
+{
+	/* The decode unit path each StreamSession owns, from the packets Common
+	 * hands over to the frame the renderer gets. Common itself keeps its
+	 * connection in globals, so only one real session can run per process;
+	 * this measures what every extra session would cost the binding. */
+	class BenchmarkSession
+	{
+	public:
+		BenchmarkSession(NalPacking packing)
+			: m_Packing(packing)
+		{
+			std::vector<unsigned char> idr = BuildFrame(NalPackingAnnexB, { H264Aud, H264Sps, H264Pps,
+				BuildSlice(H264IdrSlice, SESSION_BENCHMARK_IDR_FRAME_SIZE, 1) });
+			std::vector<unsigned char> p = BuildFrame(NalPackingAnnexB, { H264Aud,
+				BuildSlice(H264PSlice, SESSION_BENCHMARK_P_FRAME_SIZE, 2) });
+
+			Packetize(idr, m_IdrPackets);
+			Packetize(p, m_PPackets);
+			m_FrameBuffer.resize(PARAMETER_SET_HEADROOM + GetLengthPrefixedBound((int)idr.size()));
+
+			m_DropPolicy.Reset(SESSION_BENCHMARK_FPS);
+			m_ParameterSetCache.Reset(NalFormatH264, packing);
+			m_Packetization.BeginStream(PACKET_SIZE_MAX);
+		}
+
+		/* Returns how many frames made it to the renderer */
+		int Run(int frames) {
+			int submitted = 0;
+
+			for (int i = 0; i < frames; i++) {
+				submitted += SubmitFrame(i % SESSION_BENCHMARK_FPS == 0 ? m_IdrPackets : m_PPackets);
+			}
+			return submitted;
+		}
+
+		/* What the session holds, leaving out the test's own packets */
+		size_t GetMemoryUsage(void) {
+			return sizeof(m_LengthPrefixWriter) + sizeof(m_DropPolicy) + sizeof(m_ParameterSetCache) +
+				sizeof(m_Packetization) + m_FrameBuffer.capacity();
+		}
+
+	private:
+		static void Packetize(const std::vector<unsigned char> &frame, std::vector<std::vector<unsigned char>> &packets) {
+			for (size_t offset = 0; offset < frame.size(); offset += PACKET_SIZE_MAX) {
+				packets.push_back(std::vector<unsigned char>(frame.begin() + offset,
+					frame.begin() + std::min(offset + PACKET_SIZE_MAX, frame.size())));
+			}
+		}
+
+		/* Follows StreamSession::DrShimSubmitDecodeUnit */
+		int SubmitFrame(const std::vector<std::vector<unsigned char>> &packets) {
+			unsigned char *frame = &m_FrameBuffer[PARAMETER_SET_HEADROOM];
+			int frameOffset = PARAMETER_SET_HEADROOM;
+			int frameLength = 0;
+			int fullLength = 0;
+			FrameClass frameClass;
+
+			if (m_Packing == NalPackingLengthPrefixed) {
+				m_LengthPrefixWriter.Begin(frame);
+				for (size_t i = 0; i < packets.size(); i++) {
+					m_LengthPrefixWriter.Append(packets[i].data(), (int)packets[i].size());
+					m_Packetization.RecordFragment((int)packets[i].size());
+					fullLength += (int)packets[i].size();
+				}
+				frameLength = m_LengthPrefixWriter.Finish();
+			}
+			else {
+				for (size_t i = 0; i < packets.size(); i++) {
+					memcpy(frame + frameLength, packets[i].data(), packets[i].size());
+					frameLength += (int)packets[i].size();
+					m_Packetization.RecordFragment((int)packets[i].size());
+				}
+				fullLength = frameLength;
+			}
+			RecordFlightEvent(FlightFrameReceived, (int)packets.size(), fullLength);
+
+			frameClass = ClassifyFrame(NalFormatH264, m_Packing, frame, frameLength);
+			m_Packetization.RecordFrame((int)packets.size(), frameClass == FrameClassIdr);
+			if (m_DropPolicy.Decide(frameClass) != FrameSubmit) {
+				return 0;
+			}
+
+			m_ParameterSetCache.Process(m_FrameBuffer.data(), frameOffset, frameLength);
+
+			/* The renderer takes the frame straight away */
+			m_DropPolicy.OnFrameSubmitted(0);
+			RecordFlightEvent(FlightFrameSubmitted, 0, 0);
+			return 1;
+		}
+
+		NalPacking m_Packing;
+		std::vector<std::vector<unsigned char>> m_IdrPackets;
+		std::vector<std::vector<unsigned char>> m_PPackets;
+		std::vector<unsigned char> m_FrameBuffer;
+		LengthPrefixWriter m_LengthPrefixWriter;
+		FrameDropPolicy m_DropPolicy;
+		ParameterSetCache m_ParameterSetCache;
+		PacketizationStatistics m_Packetization;
+	};
+
+	TEST_CLASS(SessionBenchmarks)
+	{
+	public:
+		/* Runs 1 to SESSION_BENCHMARK_MAX_SESSIONS sessions at once, each on
+		 * its own thread like Common's decoder threads, and logs the slowest
+		 * session's time per frame, the share of a core a 60 FPS stream would
+		 * take at that rate, and the memory each session holds. Past the
+		 * core count the time includes waiting for a core. These report
+		 * numbers rather than assert them, since they run on whatever
+		 * machine builds the tests. */
+		TEST_METHOD(ConcurrentSessions)
+		{
+			static const NalPacking packings[] = { NalPackingAnnexB, NalPackingLengthPrefixed };
+
+			for (NalPacking packing : packings) {
+				for (int sessionCount = 1; sessionCount <= SESSION_BENCHMARK_MAX_SESSIONS; sessionCount *= 2) {
+					std::vector<std::unique_ptr<BenchmarkSession>> sessions;
+					std::vector<std::thread> threads;
+					std::vector<long long> elapsedNs(sessionCount);
+					std::vector<int> submitted(sessionCount);
+					long long worstNs = 0;
+					char message[256];
+
+					for (int i = 0; i < sessionCount; i++) {
+						sessions.push_back(std::unique_ptr<BenchmarkSession>(new BenchmarkSession(packing)));
+
+						/* Warm up the caches */
+						sessions[i]->Run(SESSION_BENCHMARK_FPS);
+					}
+
+					for (int i = 0; i < sessionCount; i++) {
+						threads.push_back(std::thread([&, i] {
+							auto start = std::chrono::steady_clock::now();
+
+							submitted[i] = sessions[i]->Run(SESSION_BENCHMARK_FRAMES);
+							elapsedNs[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+								std::chrono::steady_clock::now() - start).count();
+						}));
+					}
+					for (size_t i = 0; i < threads.size(); i++) {
+						threads[i].join();
+					}
+
+					for (int i = 0; i < sessionCount; i++) {
+						Assert::AreEqual(SESSION_BENCHMARK_FRAMES, submitted[i]);
+						worstNs = std::max(worstNs, elapsedNs[i]);
+					}
+
+					sprintf(message, "%s, %d sessions: %lld ns per frame, %.2f%% of a core per session, %zu KB per session",
+						packing == NalPackingAnnexB ? "Annex B" : "length-prefixed", sessionCount,
+						worstNs / SESSION_BENCHMARK_FRAMES,
+						worstNs * 100.0 * SESSION_BENCHMARK_FPS / SESSION_BENCHMARK_FRAMES / 1e9,
+						sessions[0]->GetMemoryUsage() / 1024);
+					Logger::WriteMessage(message);
+				}
+			}
+		}
+	};
+}
@@ -0,0 +1,120 @@
+#include "CppUnitTest.h"
+#include "StreamStatistics.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+namespace Moonlight_common_binding_Tests
+{
+	TEST_CLASS(StreamStatisticsTests)
+	{
+	public:
+		TEST_METHOD(SnapshotCountsEveryRecord)
+		{
+			StreamStatistics statistics;
+			StatisticsSnapshot snapshot;
+
+			statistics.SetStreamMode(60, 20000);
+			statistics.RecordFrame(1000);
+			statistics.RecordFrame(3000);
+			statistics.RecordFrameDropped(FrameClassNonReference);
+			statistics.RecordFrameDropped(FrameClassIdr);
+			statistics.RecordIdrRequest();
+			statistics.RecordDecoderReset();
+			statistics.RecordParameterSetsStripped(2);
+			statistics.RecordAudioPacket(true);
+			statistics.RecordAudioPacket(false);
+			statistics.GetSnapshot(snapshot);
+
+			Assert::AreEqual(2LL, snapshot.framesReceived);
+			Assert::AreEqual(3000, snapshot.maxFrameSize);
+			Assert::AreEqual(2LL, snapshot.framesDropped);
+			Assert::AreEqual(1LL, snapshot.framesDroppedReference);
+			Assert::AreEqual(1LL, snapshot.framesDroppedNonReference);
+			Assert::AreEqual(1LL, snapshot.idrRequests);
+			Assert::AreEqual(1LL, snapshot.decoderResets);
+			Assert::AreEqual(2LL, snapshot.parameterSetsStripped);
+			Assert::AreEqual(1LL, snapshot.audioPacketsDecoded);
+			Assert::AreEqual(1LL, snapshot.audioPacketsLost);
+			Assert::AreEqual(60, snapshot.frameRate);
+			Assert::AreEqual(20000, snapshot.targetBitrateKbps);
+		}
+
+		/* Rates only count buckets that have finished */
+		TEST_METHOD(RatesCoverCompletedBuckets)
+		{
+			StreamStatistics statistics;
+			StatisticsSnapshot snapshot;
+
+			for (int i = 0; i < 10; i++) {
+				statistics.RecordFrame(1000);
+			}
+			Sleep(STATISTICS_BUCKET_MS * 2);
+			statistics.GetSnapshot(snapshot);
+
+			Assert::AreEqual(10.0, snapshot.receivedFps);
+			Assert::AreEqual(80LL, snapshot.receivedBitrateKbps);
+			Assert::AreEqual(1000, snapshot.averageFrameSize);
+		}
+
+		/* The decoder and audio threads write flat out while another thread
+		 * takes snapshots. The decoder thread only drops non-reference frames,
+		 * which bumps two counters in one write, so a snapshot torn between
+		 * them would show a reference frame drop. It also receives a frame
+		 * after each drop, so a whole snapshot is never more than one drop
+		 * ahead. Counters never go backwards from one snapshot to the next,
+		 * and the last one sees every write. */
+		TEST_METHOD(SnapshotsAreConsistentWhileWriting)
+		{
+			const int writeCount = 200000;
+			StreamStatistics statistics;
+			StatisticsSnapshot snapshot;
+			StatisticsSnapshot previous = {};
+			std::atomic<int> writersDone(0);
+			std::thread videoWriter([&] {
+				for (int i = 0; i < writeCount; i++) {
+					statistics.RecordFrameDropped(FrameClassNonReference);
+					statistics.RecordFrame(i % 4096);
+				}
+				writersDone++;
+			});
+			std::thread audioWriter([&] {
+				for (int i = 0; i < writeCount; i++) {
+					statistics.RecordAudioPacket(i % 2 == 0);
+				}
+				writersDone++;
+			});
+			std::vector<StatisticsSnapshot> snapshots;
+
+			/* Checked once the writers are done, so a failure can't leave them running */
+			while (writersDone != 2) {
+				statistics.GetSnapshot(snapshot);
+				snapshots.push_back(snapshot);
+			}
+			videoWriter.join();
+			audioWriter.join();
+
+			for (size_t i = 0; i < snapshots.size(); i++) {
+				Assert::AreEqual(0LL, snapshots[i].framesDroppedReference);
+				Assert::IsTrue(snapshots[i].framesDropped - snapshots[i].framesReceived == 0 ||
+					snapshots[i].framesDropped - snapshots[i].framesReceived == 1);
+				Assert::IsTrue(snapshots[i].framesDropped >= previous.framesDropped);
+				Assert::IsTrue(snapshots[i].framesReceived >= previous.framesReceived);
+				Assert::IsTrue(snapshots[i].audioPacketsDecoded >= previous.audioPacketsDecoded);
+				Assert::IsTrue(snapshots[i].audioPacketsLost >= previous.audioPacketsLost);
+				previous = snapshots[i];
+			}
+
+			statistics.GetSnapshot(snapshot);
+			Assert::AreEqual((long long)writeCount, snapshot.framesDropped);
+			Assert::AreEqual((long long)writeCount, snapshot.framesReceived);
+			Assert::AreEqual(4095, snapshot.maxFrameSize);
+			Assert::AreEqual((long long)writeCount / 2, snapshot.audioPacketsDecoded);
+			Assert::AreEqual((long long)writeCount / 2, snapshot.audioPacketsLost);
+		}
+	};
+}
@@ -0,0 +1,115 @@
+/* Test frame construction */
+#include "TestBitstream.hpp"
+
+#include <string.h>
+
+using namespace Moonlight_common_binding;
+using namespace Moonlight_common_binding_Tests;
+
+const std::vector<unsigned char> Moonlight_common_binding_Tests::H264Aud = { 0x09, 0xF0 };
+const std::vector<unsigned char> Moonlight_common_binding_Tests::H264Sps = { 0x67, 0x42, 0xC0, 0x28, 0xDA, 0x01, 0xE0, 0x08, 0x9F, 0x96 };
+const std::vector<unsigned char> Moonlight_common_binding_Tests::H264SpsChanged = { 0x67, 0x42, 0xC0, 0x32, 0xDA, 0x01, 0xE0, 0x08, 0x9F, 0x96 };
+const std::vector<unsigned char> Moonlight_common_binding_Tests::H264Pps = { 0x68, 0xCE, 0x3C, 0x80 };
+const std::vector<unsigned char> Moonlight_common_binding_Tests::H264IdrSlice = { 0x65, 0x88, 0x84, 0x00, 0x33, 0xFF, 0x12, 0x34, 0x56 };
+const std::vector<unsigned char> Moonlight_common_binding_Tests::H264PSlice = { 0x41, 0x9A, 0x02, 0x04, 0x06, 0x08 };
+const std::vector<unsigned char> Moonlight_common_binding_Tests::H264BSlice = { 0x01, 0x9E, 0x04, 0x0A, 0x0C, 0x0E };
+
+const std::vector<unsigned char> Moonlight_common_binding_Tests::HevcAud = { 0x46, 0x01, 0x50 };
+const std::vector<unsigned char> Moonlight_common_binding_Tests::HevcVps = { 0x40, 0x01, 0x0C, 0x01, 0xFF, 0xFF, 0x01, 0x60 };
+const std::vector<unsigned char> Moonlight_common_binding_Tests::HevcSps = { 0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90 };
+const std::vector<unsigned char> Moonlight_common_binding_Tests::HevcPps = { 0x44, 0x01, 0xC1, 0x72, 0xB4, 0x62, 0x40 };
+const std::vector<unsigned char> Moonlight_common_binding_Tests::HevcIdrSlice = { 0x26, 0x01, 0xAF, 0x08, 0x40, 0x12, 0x34 };
+const std::vector<unsigned char> Moonlight_common_binding_Tests::HevcCraSlice = { 0x2A, 0x01, 0xAF, 0x08, 0x40, 0x56, 0x78 };
+const std::vector<unsigned char> Moonlight_common_binding_Tests::HevcTrailRSlice = { 0x02, 0x01, 0xD0, 0x12, 0x40, 0x9A };
+const std::vector<unsigned char> Moonlight_common_binding_Tests::HevcTrailNSlice = { 0x00, 0x01, 0xD0, 0x14, 0x40, 0xBC };
+
+void Moonlight_common_binding_Tests::AppendNalUnit(std::vector<unsigned char> &frame, NalPacking packing,
+	const std::vector<unsigned char> &payload) {
+	unsigned char prefix[NAL_LENGTH_PREFIX_SIZE];
+
+	if (packing == NalPackingAnnexB) {
+		AppendAnnexBNalUnit(frame, payload, 4);
+		return;
+	}
+
+	WriteNalLengthPrefix(prefix, (int)payload.size());
+	frame.insert(frame.end(), prefix, prefix + sizeof(prefix));
+	frame.insert(frame.end(), payload.begin(), payload.end());
+}
+
+void Moonlight_common_binding_Tests::AppendAnnexBNalUnit(std::vector<unsigned char> &frame,
+	const std::vector<unsigned char> &payload, int startCodeLength) {
+	if (startCodeLength == 4) {
+		frame.push_back(0);
+	}
+	frame.push_back(0);
+	frame.push_back(0);
+	frame.push_back(1);
+	frame.insert(frame.end(), payload.begin(), payload.end());
+}
+
+std::vector<unsigned char> Moonlight_common_binding_Tests::BuildFrame(NalPacking packing,
+	const std::vector<std::vector<unsigned char>> &nals) {
+	std::vector<unsigned char> frame;
+
+	for (size_t i = 0; i < nals.size(); i++) {
+		AppendNalUnit(frame, packing, nals[i]);
+	}
+
+	return frame;
+}
+
+int Moonlight_common_binding_Tests::ConvertToLengthPrefixed(const unsigned char *data, int length,
+	unsigned char *output) {
+	NalUnit nal;
+	int offset = 0;
+	int position = 0;
+	int end;
+
+	while (ReadNalUnit(data, length, NalPackingAnnexB, offset, nal)) {
+		end = nal.end;
+		while (end > nal.headerOffset && data[end - 1] == 0) {
+			end--;
+		}
+		if (end == nal.headerOffset) {
+			continue;
+		}
+
+		WriteNalLengthPrefix(&output[position], end - nal.headerOffset);
+		memcpy(&output[position + NAL_LENGTH_PREFIX_SIZE], &data[nal.headerOffset], end - nal.headerOffset);
+		position += NAL_LENGTH_PREFIX_SIZE + end - nal.headerOffset;
+	}
+
+	return position;
+}
+
+std::vector<unsigned char> Moonlight_common_binding_Tests::BuildSlice(const std::vector<unsigned char> &header, int size,
+	unsigned int seed) {
+	std::vector<unsigned char> slice(header);
+	int zeros = 0;
+
+	slice.reserve(size);
+	while ((int)slice.size() < size) {
+		unsigned char byte;
+
+		/* A small LCG is plenty. Zero bytes are several times as common as
+		 * in real slice data, so zero runs needing emulation prevention
+		 * still come up in short slices. */
+		seed = seed * 1103515245 + 12345;
+		byte = (seed >> 16) % 16 == 0 ? 0 : (unsigned char)(seed >> 24);
+
+		if (zeros == 2 && byte <= 3) {
+			slice.push_back(3);
+			zeros = 0;
+		}
+		slice.push_back(byte);
+		zeros = byte == 0 ? zeros + 1 : 0;
+	}
+
+	/* A slice can't end in a zero byte */
+	if (slice.back() == 0) {
+		slice.back() = 0x80;
+	}
+
+	return slice;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "NalParser.hpp"
+
+#include <stddef.h>
+#include <vector>
+
+namespace Moonlight_common_binding_Tests
+{
+	/* Sample NAL units, header included */
+	extern const std::vector<unsigned char> H264Aud;
+	extern const std::vector<unsigned char> H264Sps;
+	extern const std::vector<unsigned char> H264SpsChanged;
+	extern const std::vector<unsigned char> H264Pps;
+	extern const std::vector<unsigned char> H264IdrSlice;
+	extern const std::vector<unsigned char> H264PSlice;
+	extern const std::vector<unsigned char> H264BSlice;
+
+	extern const std::vector<unsigned char> HevcAud;
+	extern const std::vector<unsigned char> HevcVps;
+	extern const std::vector<unsigned char> HevcSps;
+	extern const std::vector<unsigned char> HevcPps;
+	extern const std::vector<unsigned char> HevcIdrSlice;
+	extern const std::vector<unsigned char> HevcCraSlice;
+	extern const std::vector<unsigned char> HevcTrailRSlice;
+	extern const std::vector<unsigned char> HevcTrailNSlice;
+
+	/* Appends a NAL unit with a 4-byte start code or a length prefix */
+	void AppendNalUnit(std::vector<unsigned char> &frame, Moonlight_common_binding::NalPacking packing,
+		const std::vector<unsigned char> &payload);
+
+	/* Appends a NAL unit with a 3 or 4 byte start code */
+	void AppendAnnexBNalUnit(std::vector<unsigned char> &frame, const std::vector<unsigned char> &payload,
+		int startCodeLength);
+
+	std::vector<unsigned char> BuildFrame(Moonlight_common_binding::NalPacking packing,
+		const std::vector<std::vector<unsigned char>> &nals);
+
+	/* Converts a whole Annex B frame to length-prefixed form by walking it
+	 * with ReadNalUnit. Trailing zeros and empty NAL units are dropped.
+	 * Returns the converted length. */
+	int ConvertToLengthPrefixed(const unsigned char *data, int length, unsigned char *output);
+
+	/* A slice of the given size that starts with header and is followed by
+	 * pseudo-random data with emulation prevention, so it never contains
+	 * a start code */
+	std::vector<unsigned char> BuildSlice(const std::vector<unsigned char> &header, int size, unsigned int seed);
+}
@@ -0,0 +1,137 @@
+#include "CppUnitTest.h"
+#include "TimerWheel.hpp"
+
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Moonlight_common_binding;
+
+namespace Moonlight_common_binding_Tests
+{
+	TEST_CLASS(TimerWheelTests)
+	{
+	public:
+		TEST_METHOD(FiresInTickOrder)
+		{
+			TimerWheel<int, 16, 8> wheel;
+			std::vector<int> fired;
+
+			wheel.Reset(100);
+			wheel.Add(3, 103);
+			wheel.Add(1, 101);
+			wheel.Add(2, 102);
+
+			wheel.Advance(101, [&fired](int item) { fired.push_back(item); });
+			Assert::AreEqual((size_t)1, fired.size());
+
+			wheel.Advance(110, [&fired](int item) { fired.push_back(item); });
+			Assert::AreEqual((size_t)3, fired.size());
+			for (int i = 0; i < 3; i++) {
+				Assert::AreEqual(i + 1, fired[i]);
+			}
+			Assert::AreEqual((size_t)0, wheel.GetCount());
+		}
+
+		TEST_METHOD(SameTickFiresInAddOrder)
+		{
+			TimerWheel<int, 16, 8> wheel;
+			std::vector<int> fired;
+
+			for (int i = 0; i < 5; i++) {
+				wheel.Add(i, 4);
+			}
+			wheel.Advance(4, [&fired](int item) { fired.push_back(item); });
+
+			Assert::AreEqual((size_t)5, fired.size());
+			for (int i = 0; i < 5; i++) {
+				Assert::AreEqual(i, fired[i]);
+			}
+		}
+
+		TEST_METHOD(PastDueFiresOnNextAdvance)
+		{
+			TimerWheel<int, 16, 8> wheel;
+			int fired = 0;
+
+			wheel.Reset(50);
+			wheel.Add(1, 10);
+			wheel.Advance(50, [&fired](int) { fired++; });
+			Assert::AreEqual(0, fired);
+
+			wheel.Advance(51, [&fired](int) { fired++; });
+			Assert::AreEqual(1, fired);
+		}
+
+		TEST_METHOD(ItemsPastOneRevolutionWaitForTheirTick)
+		{
+			TimerWheel<int, 16, 8> wheel;
+			std::vector<int> fired;
+
+			/* Both land in slot 5, a revolution apart */
+			wheel.Add(1, 5);
+			wheel.Add(2, 5 + 16);
+
+			wheel.Advance(5, [&fired](int item) { fired.push_back(item); });
+			Assert::AreEqual((size_t)1, fired.size());
+			Assert::AreEqual(1, fired[0]);
+
+			wheel.Advance(20, [&fired](int item) { fired.push_back(item); });
+			Assert::AreEqual((size_t)1, fired.size());
+
+			wheel.Advance(21, [&fired](int item) { fired.push_back(item); });
+			Assert::AreEqual((size_t)2, fired.size());
+			Assert::AreEqual(2, fired[1]);
+		}
+
+		TEST_METHOD(LongJumpFiresEverything)
+		{
+			TimerWheel<int, 16, 8> wheel;
+			int fired = 0;
+
+			wheel.Add(1, 3);
+			wheel.Add(2, 12);
+			wheel.Add(3, 40);
+			wheel.Advance(1000, [&fired](int) { fired++; });
+
+			Assert::AreEqual(3, fired);
+			Assert::AreEqual((size_t)0, wheel.GetCount());
+		}
+
+		TEST_METHOD(AddFailsWhenPoolExhausted)
+		{
+			TimerWheel<int, 16, 4> wheel;
+
+			for (int i = 0; i < 4; i++) {
+				Assert::IsTrue(wheel.Add(i, i + 1));
+			}
+			Assert::IsFalse(wheel.Add(4, 5));
+
+			/* Firing returns entries to the pool */
+			wheel.Advance(2, [](int) {});
+			Assert::AreEqual((size_t)2, wheel.GetCount());
+			Assert::IsTrue(wheel.Add(4, 5));
+			Assert::IsTrue(wheel.Add(5, 6));
+			Assert::IsFalse(wheel.Add(6, 7));
+		}
+
+		TEST_METHOD(NextDueTick)
+		{
+			TimerWheel<int, 16, 8> wheel;
+			unsigned long long dueTick;
+
+			Assert::IsFalse(wheel.GetNextDueTick(dueTick));
+
+			wheel.Add(1, 9);
+			wheel.Add(2, 7);
+			Assert::IsTrue(wheel.GetNextDueTick(dueTick));
+			Assert::AreEqual(7ULL, dueTick);
+
+			/* Only a far item left, so the caller is told to check back at
+			 * the end of the revolution */
+			wheel.Advance(9, [](int) {});
+			wheel.Add(3, 100);
+			Assert::IsTrue(wheel.GetNextDueTick(dueTick));
+			Assert::AreEqual(9ULL + 16, dueTick);
+		}
+	};
+}
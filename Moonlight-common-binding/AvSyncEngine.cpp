@@ -0,0 +1,99 @@
+/* Audio/video synchronization */
+#include "AvSyncEngine.hpp"
+
+/* Set while no video has been presented yet */
+#define UNKNOWN_LATENCY -1
+
+using namespace Moonlight_common_binding;
+
+AvSyncEngine::AvSyncEngine() :
+	m_ToleranceUs(DEFAULT_AV_SYNC_TOLERANCE_MS * 1000), m_VideoLatency(UNKNOWN_LATENCY), m_AudioOutputLatency(0),
+	m_OffsetUs(0), m_Corrections(0), m_PacketsSinceCorrection(0), m_DecodeLatency(UNKNOWN_LATENCY)
+{
+}
+
+void AvSyncEngine::Reset(void) {
+	m_VideoLatency.store(UNKNOWN_LATENCY, std::memory_order_relaxed);
+	m_AudioOutputLatency.store(0, std::memory_order_relaxed);
+	m_OffsetUs.store(0, std::memory_order_relaxed);
+	m_PacketsSinceCorrection = 0;
+	m_DecodeLatency = UNKNOWN_LATENCY;
+}
+
+void AvSyncEngine::SetTolerance(int toleranceMs) {
+	m_ToleranceUs.store(toleranceMs > 0 ? toleranceMs * 1000LL : 0, std::memory_order_relaxed);
+}
+
+void AvSyncEngine::OnVideoPresented(long long receiveTime) {
+	long long latency = GetReceiveTime() - receiveTime;
+	long long smoothed = m_VideoLatency.load(std::memory_order_relaxed);
+
+	if (latency < 0) {
+		return;
+	}
+
+	if (smoothed == UNKNOWN_LATENCY) {
+		smoothed = latency;
+	}
+	else {
+		smoothed += (latency - smoothed) >> AV_SYNC_SMOOTHING_SHIFT;
+	}
+
+	m_VideoLatency.store(smoothed, std::memory_order_relaxed);
+}
+
+void AvSyncEngine::SetAudioOutputLatency(long long latency) {
+	m_AudioOutputLatency.store(latency, std::memory_order_relaxed);
+}
+
+void AvSyncEngine::OnAudioDecoded(long long receiveTime, long long decodedTime) {
+	long long latency = decodedTime - receiveTime;
+
+	if (latency < 0) {
+		return;
+	}
+
+	if (m_DecodeLatency == UNKNOWN_LATENCY) {
+		m_DecodeLatency = latency;
+	}
+	else {
+		m_DecodeLatency += (latency - m_DecodeLatency) >> AV_SYNC_SMOOTHING_SHIFT;
+	}
+}
+
+AvSyncAction AvSyncEngine::OnAudioPacket(void) {
+	long long videoLatency = m_VideoLatency.load(std::memory_order_relaxed);
+	long long audioLatency;
+	long long offsetUs;
+	long long toleranceUs = m_ToleranceUs.load(std::memory_order_relaxed);
+
+	if (videoLatency == UNKNOWN_LATENCY) {
+		return AvSyncPlay;
+	}
+
+	/* The time decoding takes plus what's already queued ahead of this packet */
+	audioLatency = (m_DecodeLatency != UNKNOWN_LATENCY ? m_DecodeLatency : 0) +
+		m_AudioOutputLatency.load(std::memory_order_relaxed);
+	offsetUs = (audioLatency - videoLatency) / 10;
+	m_OffsetUs.store(offsetUs, std::memory_order_relaxed);
+
+	if (m_PacketsSinceCorrection < AV_SYNC_PACKETS_PER_CORRECTION) {
+		m_PacketsSinceCorrection++;
+		return AvSyncPlay;
+	}
+
+	if (offsetUs > toleranceUs) {
+		/* Audio is behind, so shorten its queue */
+		m_PacketsSinceCorrection = 0;
+		m_Corrections.fetch_add(1, std::memory_order_relaxed);
+		return AvSyncDrop;
+	}
+	else if (offsetUs < -toleranceUs) {
+		/* Audio is ahead, so let it fall back a packet */
+		m_PacketsSinceCorrection = 0;
+		m_Corrections.fetch_add(1, std::memory_order_relaxed);
+		return AvSyncPad;
+	}
+
+	return AvSyncPlay;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Windows.h>
+#include <atomic>
+
+/* How far audio may drift from video before it is corrected */
+#define DEFAULT_AV_SYNC_TOLERANCE_MS 40
+
+/* Corrections are spread out so each one is a single inaudible step */
+#define AV_SYNC_PACKETS_PER_CORRECTION 8
+
+/* Latencies are smoothed as 1/2^shift of each new sample */
+#define AV_SYNC_SMOOTHING_SHIFT 3
+
+namespace Moonlight_common_binding
+{
+	/* Receive timestamps are QPC time in 100 ns units, the same units as a
+	 * TimeSpan, so renderers can use differences as presentation times */
+	inline long long GetReceiveTime(void) {
+		LARGE_INTEGER now, frequency;
+
+		QueryPerformanceCounter(&now);
+		QueryPerformanceFrequency(&frequency);
+
+		/* Split to avoid overflowing after a day of uptime */
+		return (now.QuadPart / frequency.QuadPart) * 10000000 +
+			((now.QuadPart % frequency.QuadPart) * 10000000) / frequency.QuadPart;
+	}
+
+	enum AvSyncAction
+	{
+		AvSyncPlay,
+		AvSyncDrop,
+		AvSyncPad,
+	};
+
+	/* Keeps audio lined up with video. The app reports when each frame
+	 * reaches the screen and the audio renderer reports how much audio
+	 * it has queued, which gives each stream's delay from receive to output.
+	 * The difference between them is the A/V offset. Audio is the stream
+	 * that gets corrected, by dropping or padding a packet at a time, since
+	 * that's far less noticeable than holding or skipping frames. */
+	class AvSyncEngine
+	{
+	public:
+		AvSyncEngine();
+
+		void Reset(void);
+		void SetTolerance(int toleranceMs);
+
+		/* Called once the frame received at receiveTime is on screen, not when
+		 * it's handed to the decoder, so the latency includes decoding and
+		 * waiting for the display */
+		void OnVideoPresented(long long receiveTime);
+
+		/* Called from the audio renderer's thread with the audio it has
+		 * queued but not yet played, in 100 ns units */
+		void SetAudioOutputLatency(long long latency);
+
+		/* Audio thread only. Decides what to do with a packet before it's
+		 * decoded. Padding plays a concealment packet before it. */
+		AvSyncAction OnAudioPacket(void);
+
+		/* Audio thread only. Called once the packet received at receiveTime
+		 * has been decoded, with GetReceiveTime at that point. The packets
+		 * that follow are judged by how long decoding has been taking. */
+		void OnAudioDecoded(long long receiveTime, long long decodedTime);
+
+		/* Positive when audio is behind video */
+		long long GetOffsetUs(void) {
+			return m_OffsetUs.load(std::memory_order_relaxed);
+		}
+		long long GetCorrections(void) {
+			return m_Corrections.load(std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<long long> m_ToleranceUs;
+		std::atomic<long long> m_VideoLatency;
+		std::atomic<long long> m_AudioOutputLatency;
+		std::atomic<long long> m_OffsetUs;
+		std::atomic<long long> m_Corrections;
+
+		/* Audio thread only */
+		int m_PacketsSinceCorrection;
+		long long m_DecodeLatency;
+	};
+}
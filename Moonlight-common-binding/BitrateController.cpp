@@ -0,0 +1,170 @@
+/* Adaptive bitrate decisions */
+#include "BitrateController.hpp"
+
+/* The ladder steps down to these before giving up on quality */
+#define FALLBACK_FPS 30
+#define FALLBACK_HEIGHT 720
+
+using namespace Moonlight_common_binding;
+
+BitrateController::BitrateController() :
+	m_ModeCount(0), m_ModeIndex(0), m_BitrateKbps(0), m_MinBitrateKbps(0), m_MaxBitrateKbps(0),
+	m_CongestedIntervals(0), m_CleanIntervals(0), m_SettleIntervals(0), m_HavePrevious(false),
+	m_PreviousAudioPacketsDecoded(0), m_PreviousAudioPacketsLost(0)
+{
+}
+
+void BitrateController::Reset(const StreamMode &configuredMode, int minBitrateKbps, int maxBitrateKbps) {
+	StreamMode mode = configuredMode;
+
+	m_MinBitrateKbps = minBitrateKbps;
+	m_MaxBitrateKbps = maxBitrateKbps > minBitrateKbps ? maxBitrateKbps : minBitrateKbps;
+
+	m_ModeCount = 0;
+	m_Modes[m_ModeCount++] = mode;
+	if (mode.fps > FALLBACK_FPS) {
+		mode.fps = FALLBACK_FPS;
+		m_Modes[m_ModeCount++] = mode;
+	}
+	if (mode.height > FALLBACK_HEIGHT) {
+		mode.width = (mode.width * FALLBACK_HEIGHT / mode.height) & ~1;
+		mode.height = FALLBACK_HEIGHT;
+		m_Modes[m_ModeCount++] = mode;
+	}
+
+	m_ModeIndex = 0;
+	m_BitrateKbps = ClampBitrate(configuredMode.bitrateKbps);
+	m_CongestedIntervals = 0;
+	m_CleanIntervals = 0;
+	m_SettleIntervals = 0;
+	m_HavePrevious = false;
+}
+
+int BitrateController::GetModeFloorKbps(int modeIndex) {
+	const StreamMode &mode = m_Modes[modeIndex];
+
+	return (int)((long long)mode.width * mode.height * mode.fps * ABR_MIN_MILLIBITS_PER_PIXEL / 1000000);
+}
+
+int BitrateController::ClampBitrate(int bitrateKbps) {
+	if (bitrateKbps < m_MinBitrateKbps) {
+		return m_MinBitrateKbps;
+	}
+	else if (bitrateKbps > m_MaxBitrateKbps) {
+		return m_MaxBitrateKbps;
+	}
+
+	return bitrateKbps;
+}
+
+/* Returns false if the target doesn't change anything */
+bool BitrateController::BuildNextMode(int bitrateKbps, StreamMode &nextMode) {
+	int modeIndex = m_ModeIndex;
+
+	bitrateKbps = ClampBitrate(bitrateKbps);
+	m_CongestedIntervals = 0;
+	m_CleanIntervals = 0;
+
+	while (modeIndex < m_ModeCount - 1 && bitrateKbps < GetModeFloorKbps(modeIndex)) {
+		modeIndex++;
+	}
+	while (modeIndex > 0 &&
+		bitrateKbps >= GetModeFloorKbps(modeIndex - 1) * ABR_MODE_UPGRADE_HEADROOM_PERCENT / 100) {
+		modeIndex--;
+	}
+
+	if (bitrateKbps == m_BitrateKbps && modeIndex == m_ModeIndex) {
+		return false;
+	}
+
+	nextMode = m_Modes[modeIndex];
+	nextMode.bitrateKbps = bitrateKbps;
+	return true;
+}
+
+bool BitrateController::Evaluate(const StatisticsSnapshot &snapshot, StreamMode &nextMode) {
+	long long audioPacketsDecoded = snapshot.audioPacketsDecoded - m_PreviousAudioPacketsDecoded;
+	long long audioPacketsLost = snapshot.audioPacketsLost - m_PreviousAudioPacketsLost;
+	int lossPercent = 0;
+	bool congested, clean;
+
+	m_PreviousAudioPacketsDecoded = snapshot.audioPacketsDecoded;
+	m_PreviousAudioPacketsLost = snapshot.audioPacketsLost;
+
+	/* The first interval only establishes the counter baselines, and the
+	 * intervals right after a change still show the restart */
+	if (!m_HavePrevious) {
+		m_HavePrevious = true;
+		return false;
+	}
+	if (m_SettleIntervals > 0) {
+		m_SettleIntervals--;
+		return false;
+	}
+
+	/* Common drops damaged video frames before we see them, but it reports
+	 * every audio packet it had to conceal. Audio is sent at a constant
+	 * rate whatever is on screen, so its loss is a clean sample of the link. */
+	if (audioPacketsDecoded + audioPacketsLost > 0) {
+		lossPercent = (int)(audioPacketsLost * 100 / (audioPacketsDecoded + audioPacketsLost));
+	}
+
+	congested = lossPercent >= ABR_CONGESTED_LOSS_PERCENT ||
+		snapshot.queueingDelayUs >= ABR_CONGESTED_QUEUEING_DELAY_MS * 1000 ||
+		snapshot.arrivalJitterUs >= ABR_CONGESTED_JITTER_MS * 1000;
+	clean = !congested && lossPercent <= ABR_CLEAN_LOSS_PERCENT &&
+		snapshot.queueingDelayUs <= ABR_CLEAN_QUEUEING_DELAY_MS * 1000 &&
+		snapshot.arrivalJitterUs <= ABR_CLEAN_JITTER_MS * 1000;
+
+	/* Intervals between the two thresholds hold the current rate */
+	if (congested) {
+		m_CongestedIntervals++;
+		m_CleanIntervals = 0;
+	}
+	else if (clean) {
+		m_CleanIntervals++;
+		m_CongestedIntervals = 0;
+	}
+	else {
+		m_CongestedIntervals = 0;
+		m_CleanIntervals = 0;
+	}
+
+	if (m_CongestedIntervals >= ABR_CONGESTED_INTERVALS_TO_DECREASE) {
+		return BuildNextMode((int)((long long)m_BitrateKbps * ABR_DECREASE_PERCENT / 100), nextMode);
+	}
+	else if (m_CleanIntervals >= ABR_CLEAN_INTERVALS_TO_INCREASE) {
+		return BuildNextMode((int)((long long)m_BitrateKbps * ABR_INCREASE_PERCENT / 100), nextMode);
+	}
+
+	return false;
+}
+
+void BitrateController::Commit(const StreamMode &mode) {
+	for (int i = 0; i < m_ModeCount; i++) {
+		if (m_Modes[i].width == mode.width && m_Modes[i].height == mode.height && m_Modes[i].fps == mode.fps) {
+			m_ModeIndex = i;
+			break;
+		}
+	}
+
+	m_BitrateKbps = mode.bitrateKbps;
+	m_CongestedIntervals = 0;
+	m_CleanIntervals = 0;
+	m_SettleIntervals = ABR_SETTLE_INTERVALS;
+	m_HavePrevious = false;
+}
+
+StreamMode BitrateController::GetModeForBitrate(int bitrateKbps) {
+	StreamMode mode;
+	int modeIndex = 0;
+
+	bitrateKbps = ClampBitrate(bitrateKbps);
+	while (modeIndex < m_ModeCount - 1 && bitrateKbps < GetModeFloorKbps(modeIndex)) {
+		modeIndex++;
+	}
+
+	mode = m_Modes[modeIndex];
+	mode.bitrateKbps = bitrateKbps;
+	return mode;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "StreamStatistics.hpp"
+
+/* The controller is evaluated once per interval */
+#define ABR_EVALUATION_INTERVAL_MS 1000
+
+/* An interval is congested if any of these is reached */
+#define ABR_CONGESTED_LOSS_PERCENT 5
+#define ABR_CONGESTED_QUEUEING_DELAY_MS 50
+#define ABR_CONGESTED_JITTER_MS 20
+
+/* An interval is clean only if all of these hold */
+#define ABR_CLEAN_LOSS_PERCENT 1
+#define ABR_CLEAN_QUEUEING_DELAY_MS 15
+#define ABR_CLEAN_JITTER_MS 5
+
+/* Hysteresis: back off quickly, probe upward slowly, and give each change
+ * time to settle since changing the mode restarts the stream */
+#define ABR_CONGESTED_INTERVALS_TO_DECREASE 2
+#define ABR_CLEAN_INTERVALS_TO_INCREASE 10
+#define ABR_SETTLE_INTERVALS 5
+#define ABR_DECREASE_PERCENT 70
+#define ABR_INCREASE_PERCENT 120
+
+/* The lowest bitrate a mode is worth streaming at, in thousandths of a
+ * bit per pixel. A mode is only stepped back up to with headroom. */
+#define ABR_MIN_MILLIBITS_PER_PIXEL 50
+#define ABR_MODE_UPGRADE_HEADROOM_PERCENT 150
+
+#define ABR_MAX_MODES 3
+
+namespace Moonlight_common_binding
+{
+	struct StreamMode
+	{
+		int width;
+		int height;
+		int fps;
+		int bitrateKbps;
+	};
+
+	/* Picks a target bitrate from audio packet loss, queueing delay and
+	 * arrival jitter. Only signals from the network count: frames the
+	 * binding drops itself, and the IDR requests that follow, say the
+	 * decoder is behind rather than the link, and a low frame rate may
+	 * just be the content. When the bitrate falls below what the current
+	 * mode can use, it steps down a ladder of cheaper modes: first 30 FPS,
+	 * then 720p. The controller only makes decisions; the caller applies
+	 * them. */
+	class BitrateController
+	{
+	public:
+		BitrateController();
+
+		void Reset(const StreamMode &configuredMode, int minBitrateKbps, int maxBitrateKbps);
+
+		/* Called once per evaluation interval. Returns true and fills
+		 * nextMode if the bitrate or the mode should change. */
+		bool Evaluate(const StatisticsSnapshot &snapshot, StreamMode &nextMode);
+
+		/* Called once the mode from Evaluate has been applied */
+		void Commit(const StreamMode &mode);
+
+		/* The highest mode on the ladder worth streaming at this bitrate,
+		 * for picking where to start before there are statistics */
+		StreamMode GetModeForBitrate(int bitrateKbps);
+
+		StreamMode GetCurrentMode(void) {
+			return m_Modes[m_ModeIndex];
+		}
+
+	private:
+		int GetModeFloorKbps(int modeIndex);
+		int ClampBitrate(int bitrateKbps);
+		bool BuildNextMode(int bitrateKbps, StreamMode &nextMode);
+
+		StreamMode m_Modes[ABR_MAX_MODES];
+		int m_ModeCount;
+		int m_ModeIndex;
+		int m_BitrateKbps;
+		int m_MinBitrateKbps;
+		int m_MaxBitrateKbps;
+
+		int m_CongestedIntervals;
+		int m_CleanIntervals;
+		int m_SettleIntervals;
+		bool m_HavePrevious;
+		long long m_PreviousAudioPacketsDecoded;
+		long long m_PreviousAudioPacketsLost;
+	};
+}
@@ -0,0 +1,221 @@
+/* Asynchronous delivery of connection listener events */
+#include "ConnectionEventDispatcher.hpp"
+
+#include <string.h>
+
+using namespace Moonlight_common_binding;
+
+ConnectionEventDispatcher::DispatcherState::DispatcherState(MoonlightConnectionListener ^listener) :
+	listener(listener), wakeEvent(CreateEventEx(NULL, NULL, 0, EVENT_ALL_ACCESS)), stopping(false),
+	terminationPending(false), terminationError(0), postedCount(0), deliveredCount(0)
+{
+	for (int i = 0; i < TRANSIENT_MESSAGE_HISTORY; i++) {
+		recentTransientMessages[i].time = 0;
+	}
+}
+
+ConnectionEventDispatcher::DispatcherState::~DispatcherState()
+{
+	CloseHandle(wakeEvent);
+}
+
+ConnectionEventDispatcher::ConnectionEventDispatcher(MoonlightConnectionListener ^listener) :
+	m_Listener(listener), m_State(std::make_shared<DispatcherState>(listener))
+{
+}
+
+ConnectionEventDispatcher::~ConnectionEventDispatcher()
+{
+	Stop();
+}
+
+void ConnectionEventDispatcher::Start(void) {
+	if (m_Thread.joinable()) {
+		return;
+	}
+
+	m_Thread = std::thread(&ConnectionEventDispatcher::ThreadProc, m_State);
+}
+
+void ConnectionEventDispatcher::Stop(void) {
+	if (!m_Thread.joinable()) {
+		return;
+	}
+
+	m_State->stopping = true;
+	SetEvent(m_State->wakeEvent);
+
+	/* A listener callback may stop the connection from our own thread, which
+	 * then finishes on its own with the old state. We may be destroyed before
+	 * it gets there, so anything posted from now on goes to new state. */
+	if (m_Thread.get_id() == std::this_thread::get_id()) {
+		m_Thread.detach();
+		m_State = std::make_shared<DispatcherState>(m_Listener);
+		return;
+	}
+
+	m_Thread.join();
+	m_State->stopping = false;
+}
+
+void ConnectionEventDispatcher::Flush(void) {
+	DispatcherState *state = m_State.get();
+	unsigned long long target = state->postedCount;
+	std::unique_lock<std::mutex> lock(state->flushLock);
+
+	if (!m_Thread.joinable() || m_Thread.get_id() == std::this_thread::get_id()) {
+		return;
+	}
+
+	state->flushCond.wait(lock, [state, target] { return state->deliveredCount >= target; });
+}
+
+void ConnectionEventDispatcher::Post(const ConnectionEvent &event) {
+	m_State->postedCount++;
+	if (!m_State->queue.TryEnqueue(event)) {
+		/* We'd rather lose an event than stall a stream thread */
+		m_State->MarkDelivered();
+		return;
+	}
+
+	SetEvent(m_State->wakeEvent);
+}
+
+void ConnectionEventDispatcher::PostTextEvent(EventType type, const char *message) {
+	ConnectionEvent event;
+
+	event.type = type;
+	event.stage = 0;
+	event.errorCode = 0;
+	strncpy(event.message, message, sizeof(event.message) - 1);
+	event.message[sizeof(event.message) - 1] = 0;
+
+	Post(event);
+}
+
+void ConnectionEventDispatcher::PostStageStarting(int stage) {
+	ConnectionEvent event = { StageStarting, stage, 0 };
+	Post(event);
+}
+
+void ConnectionEventDispatcher::PostStageComplete(int stage) {
+	ConnectionEvent event = { StageComplete, stage, 0 };
+	Post(event);
+}
+
+void ConnectionEventDispatcher::PostStageFailed(int stage, long errorCode) {
+	ConnectionEvent event = { StageFailed, stage, errorCode };
+	Post(event);
+}
+
+void ConnectionEventDispatcher::PostConnectionStarted(void) {
+	ConnectionEvent event = { ConnectionStarted, 0, 0 };
+	Post(event);
+}
+
+void ConnectionEventDispatcher::PostConnectionTerminated(long errorCode) {
+	m_State->terminationError = errorCode;
+	m_State->postedCount++;
+	m_State->terminationPending = true;
+	SetEvent(m_State->wakeEvent);
+}
+
+void ConnectionEventDispatcher::PostDisplayMessage(const char *message) {
+	PostTextEvent(DisplayMessage, message);
+}
+
+void ConnectionEventDispatcher::PostDisplayTransientMessage(const char *message) {
+	/* Transient messages are the least important, so leave room for the rest */
+	if (m_State->queue.GetDepth() >= m_State->queue.GetCapacity() / 2) {
+		m_State->postedCount++;
+		m_State->MarkDelivered();
+		return;
+	}
+
+	PostTextEvent(DisplayTransientMessage, message);
+}
+
+void ConnectionEventDispatcher::DispatcherState::MarkDelivered(void) {
+	std::lock_guard<std::mutex> lock(flushLock);
+
+	deliveredCount++;
+	flushCond.notify_all();
+}
+
+/* Coalesces repeats of the same warning, even with other warnings
+ * in between. A message not seen lately takes the entry shown longest ago. */
+bool ConnectionEventDispatcher::DispatcherState::ShouldShowTransientMessage(const char *message) {
+	ULONGLONG now = GetTickCount64();
+	int entry = 0;
+
+	for (int i = 0; i < TRANSIENT_MESSAGE_HISTORY; i++) {
+		if (recentTransientMessages[i].time != 0 && recentTransientMessages[i].text == message) {
+			if (now - recentTransientMessages[i].time < TRANSIENT_MESSAGE_INTERVAL_MS) {
+				return false;
+			}
+			entry = i;
+			break;
+		}
+		if (recentTransientMessages[i].time < recentTransientMessages[entry].time) {
+			entry = i;
+		}
+	}
+
+	recentTransientMessages[entry].text = message;
+	recentTransientMessages[entry].time = now;
+	return true;
+}
+
+static Platform::String^ ToPlatformString(const char *message) {
+	std::wstring wStr(message, message + strlen(message));
+
+	return ref new Platform::String(wStr.c_str(), (unsigned int)wStr.length());
+}
+
+void ConnectionEventDispatcher::DispatcherState::Deliver(const ConnectionEvent &event) {
+	switch (event.type) {
+	case StageStarting:
+		listener->StageStarting(event.stage);
+		break;
+	case StageComplete:
+		listener->StageComplete(event.stage);
+		break;
+	case StageFailed:
+		listener->StageFailed(event.stage, event.errorCode);
+		break;
+	case ConnectionStarted:
+		listener->ConnectionStarted();
+		break;
+	case DisplayMessage:
+		listener->DisplayMessage(ToPlatformString(event.message));
+		break;
+	case DisplayTransientMessage:
+		if (ShouldShowTransientMessage(event.message)) {
+			listener->DisplayTransientMessage(ToPlatformString(event.message));
+		}
+		break;
+	}
+}
+
+void ConnectionEventDispatcher::ThreadProc(std::shared_ptr<DispatcherState> state) {
+	ConnectionEvent event;
+
+	for (;;) {
+		WaitForSingleObjectEx(state->wakeEvent, INFINITE, FALSE);
+
+		while (state->queue.TryDequeue(event)) {
+			state->Deliver(event);
+			state->MarkDelivered();
+		}
+
+		/* Termination is always delivered after the events that preceded it */
+		if (state->terminationPending.exchange(false)) {
+			state->listener->ConnectionTerminated(state->terminationError);
+			state->MarkDelivered();
+		}
+
+		if (state->stopping) {
+			break;
+		}
+	}
+}
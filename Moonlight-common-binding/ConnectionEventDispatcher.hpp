@@ -0,0 +1,110 @@
+#pragma once
+#include "Moonlight-common-binding.hpp"
+#include "LockFreeQueue.hpp"
+
+#include <Windows.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <string>
+
+#define CONNECTION_EVENT_QUEUE_SIZE 64
+#define CONNECTION_EVENT_MESSAGE_LENGTH 128
+
+/* Identical transient messages are delivered at most once per interval */
+#define TRANSIENT_MESSAGE_INTERVAL_MS 3000
+
+/* How many different transient messages are remembered for that. Common
+ * tends to alternate a few warnings while a connection is poor. */
+#define TRANSIENT_MESSAGE_HISTORY 8
+
+namespace Moonlight_common_binding
+{
+	/* Delivers connection listener events to managed code from a dedicated
+	 * thread. Common's network, video and audio threads only copy the event
+	 * into a lock-free queue, so they never wait on UI code. */
+	class ConnectionEventDispatcher
+	{
+	public:
+		ConnectionEventDispatcher(MoonlightConnectionListener ^listener);
+		~ConnectionEventDispatcher();
+
+		void Start(void);
+		void Stop(void);
+
+		/* Blocks until everything posted so far has been delivered */
+		void Flush(void);
+
+		void PostStageStarting(int stage);
+		void PostStageComplete(int stage);
+		void PostStageFailed(int stage, long errorCode);
+		void PostConnectionStarted(void);
+		void PostConnectionTerminated(long errorCode);
+		void PostDisplayMessage(const char *message);
+		void PostDisplayTransientMessage(const char *message);
+
+	private:
+		enum EventType {
+			StageStarting,
+			StageComplete,
+			StageFailed,
+			ConnectionStarted,
+			DisplayMessage,
+			DisplayTransientMessage
+		};
+
+		struct ConnectionEvent
+		{
+			EventType type;
+			int stage;
+			long errorCode;
+			char message[CONNECTION_EVENT_MESSAGE_LENGTH];
+		};
+
+		struct RecentMessage
+		{
+			std::string text;
+			ULONGLONG time;
+		};
+
+		/* Everything the dispatcher thread touches. The thread holds its own
+		 * reference, so a listener that stops the dispatcher from inside a
+		 * callback doesn't free the state out from under it. */
+		struct DispatcherState
+		{
+			DispatcherState(MoonlightConnectionListener ^listener);
+			~DispatcherState();
+
+			void Deliver(const ConnectionEvent &event);
+			bool ShouldShowTransientMessage(const char *message);
+			void MarkDelivered(void);
+
+			MoonlightConnectionListener ^listener;
+			LockFreeQueue<ConnectionEvent, CONNECTION_EVENT_QUEUE_SIZE> queue;
+			HANDLE wakeEvent;
+			std::atomic<bool> stopping;
+
+			/* Termination bypasses the queue so it can never be dropped */
+			std::atomic<bool> terminationPending;
+			std::atomic<long> terminationError;
+
+			std::atomic<unsigned long long> postedCount;
+			unsigned long long deliveredCount;
+			std::mutex flushLock;
+			std::condition_variable flushCond;
+
+			/* Only touched by the dispatcher thread */
+			RecentMessage recentTransientMessages[TRANSIENT_MESSAGE_HISTORY];
+		};
+
+		void Post(const ConnectionEvent &event);
+		void PostTextEvent(EventType type, const char *message);
+		static void ThreadProc(std::shared_ptr<DispatcherState> state);
+
+		MoonlightConnectionListener ^m_Listener;
+		std::shared_ptr<DispatcherState> m_State;
+		std::thread m_Thread;
+	};
+}
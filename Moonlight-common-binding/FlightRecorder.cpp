@@ -0,0 +1,168 @@
+/* Ring buffer of recent stream events for post-mortems */
+#include "FlightRecorder.hpp"
+
+#include <Windows.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#define FLIGHT_RECORDER_HEADER_SIZE 20
+#define FLIGHT_RECORDER_RECORD_SIZE 20
+
+static_assert((FLIGHT_RECORDER_CAPACITY & (FLIGHT_RECORDER_CAPACITY - 1)) == 0, "Capacity must be a power of 2");
+
+using namespace Moonlight_common_binding;
+
+/* Each slot's sequence is its position in the stream of events plus one,
+ * or 0 while it's being written, so a reader can tell a finished record
+ * from one that's torn or from a lap ago. The fields are relaxed atomics
+ * so that a torn read is only wrong, not undefined. */
+struct FlightRecord
+{
+	std::atomic<unsigned int> sequence;
+	std::atomic<unsigned int> typeAndDetail;
+	std::atomic<long long> time;
+	std::atomic<long long> value;
+};
+
+static FlightRecord s_Records[FLIGHT_RECORDER_CAPACITY];
+static std::atomic<unsigned long long> s_NextPosition;
+static std::atomic<bool> s_Enabled(true);
+
+static std::mutex s_TerminationPathLock;
+static std::wstring s_TerminationPath;
+
+/* Held while a termination dump is written so two don't interleave */
+static std::mutex s_TerminationWriteLock;
+
+void Moonlight_common_binding::RecordFlightEvent(FlightEventType type, int detail, long long value) {
+	FlightRecord *record;
+	unsigned long long position;
+	LARGE_INTEGER now;
+
+	if (!s_Enabled.load(std::memory_order_relaxed)) {
+		return;
+	}
+
+	QueryPerformanceCounter(&now);
+	position = s_NextPosition.fetch_add(1, std::memory_order_relaxed);
+	record = &s_Records[position & (FLIGHT_RECORDER_CAPACITY - 1)];
+
+	record->sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	record->typeAndDetail.store(((unsigned int)type << 16) | (unsigned short)detail, std::memory_order_relaxed);
+	record->time.store(now.QuadPart, std::memory_order_relaxed);
+	record->value.store(value, std::memory_order_relaxed);
+	record->sequence.store((unsigned int)(position + 1), std::memory_order_release);
+}
+
+void Moonlight_common_binding::SetFlightRecorderEnabled(bool enabled) {
+	s_Enabled = enabled;
+}
+
+static void AppendBytes(std::vector<unsigned char> &dump, unsigned long long value, int size) {
+	for (int i = 0; i < size; i++) {
+		dump.push_back((unsigned char)(value >> (i * 8)));
+	}
+}
+
+/* The events before position end from the seconds before now. Events
+ * overwritten since end was taken are left out. */
+static std::vector<unsigned char> DumpRecords(unsigned long long end, LONGLONG now, int seconds) {
+	std::vector<unsigned char> dump;
+	unsigned long long position = end > FLIGHT_RECORDER_CAPACITY ? end - FLIGHT_RECORDER_CAPACITY : 0;
+	LARGE_INTEGER frequency;
+	LONGLONG oldest;
+	FlightRecord *record;
+	unsigned int sequence;
+	unsigned int typeAndDetail;
+	long long time;
+	long long value;
+	unsigned int count = 0;
+
+	QueryPerformanceFrequency(&frequency);
+	oldest = now - frequency.QuadPart * seconds;
+
+	dump.reserve(FLIGHT_RECORDER_HEADER_SIZE + (size_t)(end - position) * FLIGHT_RECORDER_RECORD_SIZE);
+	dump.insert(dump.end(), FLIGHT_RECORDER_DUMP_MAGIC, FLIGHT_RECORDER_DUMP_MAGIC + 4);
+	AppendBytes(dump, FLIGHT_RECORDER_DUMP_VERSION, 4);
+	AppendBytes(dump, frequency.QuadPart, 8);
+	AppendBytes(dump, 0, 4);
+
+	for (; position < end; position++) {
+		record = &s_Records[position & (FLIGHT_RECORDER_CAPACITY - 1)];
+
+		sequence = record->sequence.load(std::memory_order_acquire);
+		if (sequence != (unsigned int)(position + 1)) {
+			continue;
+		}
+		typeAndDetail = record->typeAndDetail.load(std::memory_order_relaxed);
+		time = record->time.load(std::memory_order_relaxed);
+		value = record->value.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (record->sequence.load(std::memory_order_relaxed) != sequence || time < oldest) {
+			continue;
+		}
+
+		AppendBytes(dump, time, 8);
+		AppendBytes(dump, value, 8);
+		AppendBytes(dump, typeAndDetail >> 16, 2);
+		AppendBytes(dump, typeAndDetail & 0xFFFF, 2);
+		count++;
+	}
+
+	/* Fill in the record count */
+	for (int i = 0; i < 4; i++) {
+		dump[16 + i] = (unsigned char)(count >> (i * 8));
+	}
+
+	return dump;
+}
+
+std::vector<unsigned char> Moonlight_common_binding::DumpFlightRecorder(int seconds) {
+	unsigned long long end = s_NextPosition.load(std::memory_order_acquire);
+	LARGE_INTEGER now;
+
+	QueryPerformanceCounter(&now);
+	return DumpRecords(end, now.QuadPart, seconds);
+}
+
+static void WriteTerminationDump(std::wstring path, unsigned long long end, LONGLONG now) {
+	std::lock_guard<std::mutex> lock(s_TerminationWriteLock);
+	std::vector<unsigned char> dump = DumpRecords(end, now, FLIGHT_RECORDER_TERMINATION_SECONDS);
+	HANDLE file;
+	DWORD written;
+
+	file = CreateFile2(path.c_str(), GENERIC_WRITE, 0, CREATE_ALWAYS, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return;
+	}
+
+	WriteFile(file, dump.data(), (DWORD)dump.size(), &written, NULL);
+	CloseHandle(file);
+}
+
+void Moonlight_common_binding::SetFlightRecorderTerminationPath(const std::wstring &path) {
+	std::lock_guard<std::mutex> lock(s_TerminationPathLock);
+	s_TerminationPath = path;
+}
+
+void Moonlight_common_binding::WriteFlightRecorderTerminationDump(void) {
+	std::wstring path;
+	LARGE_INTEGER now;
+
+	{
+		std::lock_guard<std::mutex> lock(s_TerminationPathLock);
+		path = s_TerminationPath;
+	}
+
+	if (path.empty()) {
+		return;
+	}
+
+	/* Only where the dump ends is taken here. Building and writing over a
+	 * megabyte happens on its own thread, since the caller is usually one
+	 * of Common's. */
+	QueryPerformanceCounter(&now);
+	std::thread(WriteTerminationDump, path, s_NextPosition.load(std::memory_order_acquire), now.QuadPart).detach();
+}
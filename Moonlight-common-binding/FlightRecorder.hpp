@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/* Events are kept in a ring this many records long, which holds about a
+ * minute of a 60 FPS stream with the mouse moving */
+#define FLIGHT_RECORDER_CAPACITY 65536
+
+/* How much is written when the connection terminates */
+#define FLIGHT_RECORDER_TERMINATION_SECONDS 30
+
+/* A dump is a header of
+ *     "MLFR", version (u32), QPC frequency (i64), record count (u32)
+ * followed by records of
+ *     QPC time (i64), value (i64), type (u16), detail (u16)
+ * oldest first, all little-endian */
+#define FLIGHT_RECORDER_DUMP_MAGIC "MLFR"
+#define FLIGHT_RECORDER_DUMP_VERSION 1
+
+namespace Moonlight_common_binding
+{
+	/* The numbers are part of the dump format */
+	enum FlightEventType
+	{
+		/* detail is the fragment count, value the frame size */
+		FlightFrameReceived = 1,
+		/* detail is the renderer's result, value the QPC ticks it blocked */
+		FlightFrameSubmitted = 2,
+		/* detail is the frame class */
+		FlightFrameDropped = 3,
+		FlightIdrRequested = 4,
+		FlightDecoderReset = 5,
+		/* An audio packet Common lost, played as concealment */
+		FlightAudioConcealed = 6,
+		/* detail is the A/V sync action, drop or pad */
+		FlightAvSyncAdjusted = 7,
+		/* detail is the input event type, value its sequence number */
+		FlightInputSent = 8,
+		/* detail is the stage, and value the error for failures */
+		FlightStageStarting = 9,
+		FlightStageComplete = 10,
+		FlightStageFailed = 11,
+		FlightConnectionStarted = 12,
+		/* value is the error */
+		FlightConnectionTerminated = 13,
+		FlightReconnecting = 14,
+	};
+
+	/* Records an event into the ring. Safe from any thread, takes no lock
+	 * and doesn't allocate. Old events are overwritten. */
+	void RecordFlightEvent(FlightEventType type, int detail, long long value);
+
+	void SetFlightRecorderEnabled(bool enabled);
+
+	/* The events from the last few seconds, in the dump format. Events
+	 * being written while this runs are left out. */
+	std::vector<unsigned char> DumpFlightRecorder(int seconds);
+
+	/* Where to write a dump when the connection terminates, or empty to
+	 * not write one */
+	void SetFlightRecorderTerminationPath(const std::wstring &path);
+
+	/* Writes the events recorded up to now to the termination path on a
+	 * background thread, and returns without waiting for it */
+	void WriteFlightRecorderTerminationDump(void);
+}
@@ -0,0 +1,50 @@
+/* Frame dropping under decoder backpressure */
+#include "FrameDropPolicy.hpp"
+
+using namespace Moonlight_common_binding;
+
+FrameDropPolicy::FrameDropPolicy() :
+	m_FrameInterval(0), m_Backlog(0), m_WaitingForIdr(false)
+{
+	QueryPerformanceFrequency(&m_QpcFrequency);
+}
+
+void FrameDropPolicy::Reset(int frameRate) {
+	m_FrameInterval = frameRate > 0 ? m_QpcFrequency.QuadPart / frameRate : 0;
+	m_Backlog = 0;
+	m_WaitingForIdr = false;
+}
+
+FrameDropDecision FrameDropPolicy::Decide(FrameClass frameClass) {
+	if (frameClass == FrameClassIdr) {
+		m_WaitingForIdr = false;
+		return FrameSubmit;
+	}
+
+	if (m_WaitingForIdr) {
+		return FrameDrop;
+	}
+
+	if (m_FrameInterval == 0) {
+		return FrameSubmit;
+	}
+
+	if (m_Backlog > m_FrameInterval * DROP_REFERENCE_BACKLOG_FRAMES) {
+		/* Everything queued behind this frame is dropped too, so the backlog clears */
+		m_WaitingForIdr = true;
+		m_Backlog = 0;
+		return FrameDropAndRequestIdr;
+	}
+
+	if (frameClass == FrameClassNonReference && m_Backlog > m_FrameInterval * DROP_NON_REFERENCE_BACKLOG_FRAMES) {
+		/* Skipping this frame wins back one interval */
+		m_Backlog -= m_FrameInterval;
+		return FrameDrop;
+	}
+
+	return FrameSubmit;
+}
+
+void FrameDropPolicy::OnFrameSubmitted(LONGLONG blockedTime) {
+	m_Backlog = blockedTime;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "NalParser.hpp"
+
+#include <Windows.h>
+
+/* Backlog, in frame intervals, at which non-reference frames start being
+ * dropped, and at which reference frames go too and the decoder skips to
+ * the next IDR frame */
+#define DROP_NON_REFERENCE_BACKLOG_FRAMES 1
+#define DROP_REFERENCE_BACKLOG_FRAMES 4
+
+namespace Moonlight_common_binding
+{
+	enum FrameDropDecision
+	{
+		FrameSubmit,
+		FrameDrop,
+		FrameDropAndRequestIdr,
+	};
+
+	/* Decides which frames to give up on when the renderer falls behind.
+	 * The backlog is measured by how long the renderer blocked on the last
+	 * frame, since every frame interval it blocks for is another frame
+	 * waiting in Common's queue. Non-reference frames are dropped first
+	 * because nothing decodes from them. Once the backlog is too deep for
+	 * that, every frame is dropped until the next IDR frame, which is the
+	 * only way to drop reference frames without corrupting the picture. */
+	class FrameDropPolicy
+	{
+	public:
+		FrameDropPolicy();
+
+		void Reset(int frameRate);
+
+		/* Decoder thread only */
+		FrameDropDecision Decide(FrameClass frameClass);
+		/* blockedTime is how long the renderer took to accept the frame */
+		void OnFrameSubmitted(LONGLONG blockedTime);
+
+	private:
+		LARGE_INTEGER m_QpcFrequency;
+		LONGLONG m_FrameInterval;
+		LONGLONG m_Backlog;
+		bool m_WaitingForIdr;
+	};
+}
@@ -0,0 +1,391 @@
+/* Display-synchronized frame pacing */
+#include "FramePacer.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+#include <memory>
+
+/* Vsync gaps further than this from the estimate are missed or spurious
+ * vsyncs and don't update it */
+#define VSYNC_OUTLIER_PERCENT 50
+
+#define VSYNC_SMOOTHING_SHIFT 3
+#define LEAD_TIME_SMOOTHING_SHIFT 3
+#define FRAME_TIME_SMOOTHING_SHIFT 4
+
+using namespace Moonlight_common_binding;
+
+DxgiVsyncSource::DxgiVsyncSource() :
+	m_Output(NULL)
+{
+}
+
+DxgiVsyncSource::~DxgiVsyncSource()
+{
+	if (m_Output != NULL) {
+		m_Output->Release();
+	}
+}
+
+bool DxgiVsyncSource::Initialize(void) {
+	IDXGIFactory1 *factory;
+	IDXGIAdapter1 *adapter;
+	HRESULT hr;
+
+	if (FAILED(CreateDXGIFactory1(__uuidof(IDXGIFactory1), (void**)&factory))) {
+		return false;
+	}
+
+	hr = factory->EnumAdapters1(0, &adapter);
+	factory->Release();
+	if (FAILED(hr)) {
+		return false;
+	}
+
+	hr = adapter->EnumOutputs(0, &m_Output);
+	adapter->Release();
+	if (FAILED(hr)) {
+		m_Output = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+bool DxgiVsyncSource::WaitForVsync(LONGLONG &vsyncTime) {
+	LARGE_INTEGER now;
+
+	if (m_Output == NULL || FAILED(m_Output->WaitForVBlank())) {
+		return false;
+	}
+
+	QueryPerformanceCounter(&now);
+	vsyncTime = now.QuadPart;
+	return true;
+}
+
+SimulatedVsyncSource::SimulatedVsyncSource(int refreshRateHz) :
+	m_NextVsync(0)
+{
+	QueryPerformanceFrequency(&m_QpcFrequency);
+	m_Interval = m_QpcFrequency.QuadPart / (refreshRateHz > 0 ? refreshRateHz : DEFAULT_REFRESH_RATE_HZ);
+
+	/* Never signaled. It just gives us a timed wait. */
+	m_WaitEvent = CreateEventEx(NULL, NULL, CREATE_EVENT_MANUAL_RESET, EVENT_ALL_ACCESS);
+}
+
+SimulatedVsyncSource::~SimulatedVsyncSource()
+{
+	CloseHandle(m_WaitEvent);
+}
+
+bool SimulatedVsyncSource::WaitForVsync(LONGLONG &vsyncTime) {
+	LARGE_INTEGER now;
+
+	QueryPerformanceCounter(&now);
+
+	/* Start the refresh clock on the first call, and skip ahead rather
+	 * than firing a burst of vsyncs if the caller fell behind */
+	if (m_NextVsync == 0 || now.QuadPart > m_NextVsync + m_Interval) {
+		m_NextVsync = now.QuadPart + m_Interval;
+	}
+
+	if (m_NextVsync > now.QuadPart) {
+		WaitForSingleObjectEx(m_WaitEvent,
+			(DWORD)(((m_NextVsync - now.QuadPart) * 1000 + m_QpcFrequency.QuadPart - 1) / m_QpcFrequency.QuadPart),
+			FALSE);
+	}
+
+	vsyncTime = m_NextVsync;
+	m_NextVsync += m_Interval;
+	return true;
+}
+
+FramePacer::FramePacer() :
+	m_Renderer(NULL), m_VsyncSource(NULL), m_Mode(PacingLatencyFirst), m_StopEvent(NULL),
+	m_Head(0), m_Count(0), m_Stopping(false), m_NeedIdr(false), m_LastVsync(0), m_LastShown(0), m_HeldRefreshes(0),
+	m_VsyncInterval(0), m_LeadTime(0), m_LastReleasedReceiveTime(0), m_LastReleaseTime(0),
+	m_FrameTimeMeanUs(0), m_FrameTimeVariance(0)
+{
+	QueryPerformanceFrequency(&m_QpcFrequency);
+
+	for (int i = 0; i < FRAME_PACER_QUEUE_DEPTH; i++) {
+		m_Frames[i].buffer = NULL;
+		m_Frames[i].bufferSize = 0;
+	}
+}
+
+FramePacer::~FramePacer()
+{
+	Stop();
+}
+
+void FramePacer::Start(IVideoRenderer *renderer, IVsyncSource *vsyncSource, PacingMode mode) {
+	Stop();
+
+	m_Renderer = renderer;
+	m_VsyncSource = vsyncSource;
+	m_Mode = mode;
+
+	m_Head = 0;
+	m_Count = 0;
+	m_Stopping = false;
+	m_NeedIdr = false;
+	m_LastVsync = 0;
+	m_LastShown = 0;
+	m_HeldRefreshes = 0;
+	m_VsyncInterval = m_QpcFrequency.QuadPart / DEFAULT_REFRESH_RATE_HZ;
+	m_LeadTime = m_QpcFrequency.QuadPart * FRAME_PACER_MIN_LEAD_US / 1000000;
+	m_LastReleasedReceiveTime = 0;
+	m_FrameTimeMeanUs = 0;
+	m_FrameTimeVariance = 0;
+
+	m_StopEvent = CreateEventEx(NULL, NULL, CREATE_EVENT_MANUAL_RESET, EVENT_ALL_ACCESS);
+	m_Thread = std::thread(&FramePacer::ThreadProc, this);
+}
+
+/* Frames still queued are discarded, and the buffers they were in freed */
+void FramePacer::Stop(void) {
+	if (!m_Thread.joinable()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		m_Stopping = true;
+	}
+	m_SpaceAvailable.notify_all();
+
+	SetEvent(m_StopEvent);
+	m_Thread.join();
+
+	CloseHandle(m_StopEvent);
+	m_StopEvent = NULL;
+
+	for (int i = 0; i < FRAME_PACER_QUEUE_DEPTH; i++) {
+		free(m_Frames[i].buffer);
+		m_Frames[i].buffer = NULL;
+		m_Frames[i].bufferSize = 0;
+	}
+}
+
+int FramePacer::Submit(char *&buffer, int &bufferSize, int offset, int length, long long receiveTime) {
+	std::unique_lock<std::mutex> lock(m_Lock);
+	char *freeBuffer;
+	int freeBufferSize;
+
+	m_SpaceAvailable.wait(lock, [this] { return m_Count < FRAME_PACER_QUEUE_DEPTH || m_Stopping; });
+	if (m_Stopping) {
+		return DR_OK;
+	}
+
+	/* A free slot still holds the buffer of the frame last released from it */
+	PacedFrame &frame = m_Frames[(m_Head + m_Count) % FRAME_PACER_QUEUE_DEPTH];
+	freeBuffer = frame.buffer;
+	freeBufferSize = frame.bufferSize;
+	frame.buffer = buffer;
+	frame.bufferSize = bufferSize;
+	frame.offset = offset;
+	frame.length = length;
+	frame.receiveTime = receiveTime;
+	buffer = freeBuffer;
+	bufferSize = freeBufferSize;
+	m_Count++;
+	lock.unlock();
+
+	return m_NeedIdr.exchange(false) ? DR_NEED_IDR : DR_OK;
+}
+
+void FramePacer::OnFramePresented(long long receiveTime) {
+	LARGE_INTEGER now;
+	LONGLONG latency;
+	LONGLONG lead = m_LeadTime.load(std::memory_order_relaxed);
+	LONGLONG minLead = m_QpcFrequency.QuadPart * FRAME_PACER_MIN_LEAD_US / 1000000;
+	LONGLONG maxLead = m_VsyncInterval.load(std::memory_order_relaxed) * FRAME_PACER_MAX_LEAD_PERCENT / 100;
+
+	/* Only the frame that was meant for the coming vsync tells us anything */
+	if (receiveTime != m_LastReleasedReceiveTime.load(std::memory_order_relaxed)) {
+		return;
+	}
+
+	QueryPerformanceCounter(&now);
+	latency = now.QuadPart - m_LastReleaseTime.load(std::memory_order_relaxed);
+
+	lead += (latency - lead) >> LEAD_TIME_SMOOTHING_SHIFT;
+	if (lead < minLead) {
+		lead = minLead;
+	}
+	else if (lead > maxLead) {
+		lead = maxLead;
+	}
+
+	m_LeadTime.store(lead, std::memory_order_relaxed);
+}
+
+void FramePacer::UpdateVsyncInterval(LONGLONG vsyncTime) {
+	LONGLONG interval = m_VsyncInterval.load(std::memory_order_relaxed);
+	LONGLONG gap = vsyncTime - m_LastVsync;
+
+	if (m_LastVsync != 0 &&
+		gap > interval * (100 - VSYNC_OUTLIER_PERCENT) / 100 &&
+		gap < interval * (100 + VSYNC_OUTLIER_PERCENT) / 100) {
+		m_VsyncInterval.store(interval + ((gap - interval) >> VSYNC_SMOOTHING_SHIFT), std::memory_order_relaxed);
+	}
+
+	m_LastVsync = vsyncTime;
+}
+
+/* Returns false if the pacer was stopped while waiting */
+bool FramePacer::WaitUntil(LONGLONG deadline) {
+	LARGE_INTEGER now;
+	LONGLONG wakeTime = deadline - m_QpcFrequency.QuadPart * FRAME_PACER_SPIN_US / 1000000;
+	DWORD timeout = 0;
+
+	/* Round down, since waking late would miss the vsync */
+	QueryPerformanceCounter(&now);
+	if (wakeTime > now.QuadPart) {
+		timeout = (DWORD)(((wakeTime - now.QuadPart) * 1000) / m_QpcFrequency.QuadPart);
+	}
+
+	if (WaitForSingleObjectEx(m_StopEvent, timeout, FALSE) == WAIT_OBJECT_0) {
+		return false;
+	}
+
+	for (;;) {
+		QueryPerformanceCounter(&now);
+		if (now.QuadPart >= deadline) {
+			return true;
+		}
+		YieldProcessor();
+	}
+}
+
+void FramePacer::RecordFrameTime(LONGLONG now) {
+	long long frameTimeUs, mean, variance, deviation;
+
+	if (m_LastShown != 0) {
+		frameTimeUs = ((now - m_LastShown) * 1000000) / m_QpcFrequency.QuadPart;
+		mean = m_FrameTimeMeanUs.load(std::memory_order_relaxed);
+		variance = m_FrameTimeVariance.load(std::memory_order_relaxed);
+
+		deviation = frameTimeUs - mean;
+		mean += deviation >> FRAME_TIME_SMOOTHING_SHIFT;
+		variance += (deviation * deviation - variance) >> FRAME_TIME_SMOOTHING_SHIFT;
+
+		m_FrameTimeMeanUs.store(mean, std::memory_order_relaxed);
+		m_FrameTimeVariance.store(variance, std::memory_order_relaxed);
+	}
+
+	m_LastShown = now;
+}
+
+void FramePacer::ReleaseFrames(int count) {
+	LARGE_INTEGER now;
+
+	for (int i = 0; i < count; i++) {
+		PacedFrame *frame;
+
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			frame = &m_Frames[m_Head];
+		}
+
+		/* The decoder thread only fills slots past the tail, so this one
+		 * is ours until we advance the head */
+		QueryPerformanceCounter(&now);
+		m_LastReleaseTime.store(now.QuadPart, std::memory_order_relaxed);
+		m_LastReleasedReceiveTime.store(frame->receiveTime, std::memory_order_relaxed);
+
+		if (m_Renderer->SubmitDecodeUnit((const unsigned char*)frame->buffer + frame->offset, frame->length,
+			frame->receiveTime) == DR_NEED_IDR) {
+			m_NeedIdr = true;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			m_Head = (m_Head + 1) % FRAME_PACER_QUEUE_DEPTH;
+			m_Count--;
+		}
+		m_SpaceAvailable.notify_one();
+	}
+
+	/* Only the last frame released is shown at this refresh */
+	if (count > 0) {
+		RecordFrameTime(now.QuadPart);
+	}
+}
+
+void FramePacer::ThreadProc(void) {
+	IVsyncSource *vsyncSource = m_VsyncSource;
+	std::unique_ptr<SimulatedVsyncSource> fallbackSource;
+
+	for (;;) {
+		LONGLONG vsyncTime;
+		int pending;
+		int release;
+
+		/* If the display goes away, keep pacing at the last refresh rate
+		 * rather than stalling the decoder thread */
+		if (!vsyncSource->WaitForVsync(vsyncTime)) {
+			if (fallbackSource != nullptr) {
+				break;
+			}
+			fallbackSource.reset(new SimulatedVsyncSource(
+				(int)(m_QpcFrequency.QuadPart / m_VsyncInterval.load(std::memory_order_relaxed))));
+			vsyncSource = fallbackSource.get();
+			continue;
+		}
+
+		if (WaitForSingleObjectEx(m_StopEvent, 0, FALSE) == WAIT_OBJECT_0) {
+			break;
+		}
+		UpdateVsyncInterval(vsyncTime);
+
+		/* Release just early enough for the frame to make the next vsync */
+		if (!WaitUntil(vsyncTime + m_VsyncInterval.load(std::memory_order_relaxed) -
+			m_LeadTime.load(std::memory_order_relaxed))) {
+			break;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			pending = m_Count;
+		}
+
+		if (m_Mode == PacingSmoothnessFirst) {
+			if (pending > FRAME_PACER_SMOOTH_BUFFER_FRAMES) {
+				release = pending - FRAME_PACER_SMOOTH_BUFFER_FRAMES;
+				m_HeldRefreshes = 0;
+			}
+			else if (pending > 0 && m_HeldRefreshes++ >= FRAME_PACER_MAX_HOLD_REFRESHES) {
+				/* Nothing came in behind the reserve, so the stream has
+				 * paused or slowed. Show what we have. */
+				release = pending;
+				m_HeldRefreshes = 0;
+			}
+			else {
+				if (pending == 0) {
+					m_HeldRefreshes = 0;
+				}
+				release = 0;
+			}
+		}
+		else {
+			release = pending;
+		}
+
+		ReleaseFrames(release);
+	}
+}
+
+long long FramePacer::GetVsyncIntervalUs(void) {
+	return (m_VsyncInterval.load(std::memory_order_relaxed) * 1000000) / m_QpcFrequency.QuadPart;
+}
+
+long long FramePacer::GetFrameTimeMeanUs(void) {
+	return m_FrameTimeMeanUs.load(std::memory_order_relaxed);
+}
+
+long long FramePacer::GetFrameTimeStdDevUs(void) {
+	return (long long)sqrt((double)m_FrameTimeVariance.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,176 @@
+#pragma once
+#include "RendererInterfaces.hpp"
+
+#include <Limelight.h>
+#include <Windows.h>
+#include <dxgi.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/* Frames waiting for a refresh. The decoder thread blocks once all are
+ * full, which pushes back on Common like the renderer always has. */
+#define FRAME_PACER_QUEUE_DEPTH 3
+
+/* Smoothness-first mode holds this many frames back to absorb jitter */
+#define FRAME_PACER_SMOOTH_BUFFER_FRAMES 1
+
+/* A frame held in reserve with nothing behind it is released after
+ * this many refreshes, so a stream that pauses doesn't hide its last frame */
+#define FRAME_PACER_MAX_HOLD_REFRESHES 1
+
+/* Limits on how early before vsync a frame is released */
+#define FRAME_PACER_MIN_LEAD_US 1000
+#define FRAME_PACER_MAX_LEAD_PERCENT 50
+
+/* The timed wait for a release can overshoot by a timer tick, so it
+ * ends this far ahead of the deadline and spins on the clock after that */
+#define FRAME_PACER_SPIN_US 2000
+
+/* Used when the display's refresh can't be measured yet */
+#define DEFAULT_REFRESH_RATE_HZ 60
+
+namespace Moonlight_common_binding
+{
+	enum PacingMode
+	{
+		PacingLatencyFirst,
+		PacingSmoothnessFirst,
+	};
+
+	/* Where the pacer gets display refreshes from. Implementations other
+	 * than DXGI can drive the pacer from a simulated display. */
+	class IVsyncSource
+	{
+	public:
+		virtual ~IVsyncSource() {}
+
+		/* Blocks until the next vertical blank and returns its QPC time.
+		 * Returns false if vsync isn't available. */
+		virtual bool WaitForVsync(LONGLONG &vsyncTime) = 0;
+	};
+
+	/* Waits on the vertical blank of the primary output */
+	class DxgiVsyncSource final : public IVsyncSource
+	{
+	public:
+		DxgiVsyncSource();
+		~DxgiVsyncSource();
+
+		/* Returns false if there is no output to wait on */
+		bool Initialize(void);
+		bool WaitForVsync(LONGLONG &vsyncTime) override;
+
+	private:
+		IDXGIOutput *m_Output;
+	};
+
+	/* Produces vsyncs at a fixed rate from the clock */
+	class SimulatedVsyncSource final : public IVsyncSource
+	{
+	public:
+		SimulatedVsyncSource(int refreshRateHz);
+		~SimulatedVsyncSource();
+
+		bool WaitForVsync(LONGLONG &vsyncTime) override;
+
+	private:
+		HANDLE m_WaitEvent;
+		LONGLONG m_Interval;
+		LONGLONG m_NextVsync;
+		LARGE_INTEGER m_QpcFrequency;
+	};
+
+	/* Releases frames to the renderer in step with the display so the
+	 * stream doesn't judder when its frame rate and the refresh rate
+	 * don't divide evenly. Frames are released shortly before each vsync,
+	 * early enough to be ready for it, with the lead time learned from
+	 * how long presented frames took to show up.
+	 *
+	 * H.264 frames can't be skipped before decoding, so "newest frame"
+	 * means that when frames pile up they're all released in one refresh
+	 * and only the last one is shown. Latency-first mode does this on
+	 * every refresh. Smoothness-first mode holds a frame in reserve and
+	 * releases one per refresh, only catching up when the backlog grows.
+	 * The reserve frame goes out on its own if nothing follows it for a
+	 * refresh. */
+	class FramePacer
+	{
+	public:
+		FramePacer();
+		~FramePacer();
+
+		/* The renderer and vsync source are not owned and must outlive the pacer.
+		 * Released frames go through the IVideoRenderer vtable in both modes.
+		 * That is one indirect call per frame next to a vsync wait, which
+		 * RendererDispatchBenchmarks puts at a few nanoseconds, so the pacer
+		 * isn't templated on the renderer type like the unpaced path. */
+		void Start(IVideoRenderer *renderer, IVsyncSource *vsyncSource, PacingMode mode);
+		void Stop(void);
+
+		bool IsActive(void) {
+			return m_Thread.joinable();
+		}
+
+		/* Decoder thread only. Queues the frame at buffer + offset, blocking
+		 * if the queue is full. Rather than copying the frame, the pacer takes
+		 * the malloc'd buffer and hands back one it has finished with, which
+		 * is NULL until every slot has been used. bufferSize is the caller's
+		 * record of the buffer's size and is swapped along with it. Returns
+		 * DR_NEED_IDR if a released frame failed. */
+		int Submit(char *&buffer, int &bufferSize, int offset, int length, long long receiveTime);
+
+		/* Latency feedback once a frame is on screen */
+		void OnFramePresented(long long receiveTime);
+
+		long long GetVsyncIntervalUs(void);
+		long long GetFrameTimeMeanUs(void);
+		long long GetFrameTimeStdDevUs(void);
+
+	private:
+		struct PacedFrame
+		{
+			char *buffer;
+			int bufferSize;
+			int offset;
+			int length;
+			long long receiveTime;
+		};
+
+		void ThreadProc(void);
+		void UpdateVsyncInterval(LONGLONG vsyncTime);
+		bool WaitUntil(LONGLONG deadline);
+		void ReleaseFrames(int count);
+		void RecordFrameTime(LONGLONG now);
+
+		IVideoRenderer *m_Renderer;
+		IVsyncSource *m_VsyncSource;
+		PacingMode m_Mode;
+		HANDLE m_StopEvent;
+		std::thread m_Thread;
+		LARGE_INTEGER m_QpcFrequency;
+
+		std::mutex m_Lock;
+		std::condition_variable m_SpaceAvailable;
+		PacedFrame m_Frames[FRAME_PACER_QUEUE_DEPTH];
+		int m_Head;
+		int m_Count;
+		bool m_Stopping;
+		std::atomic<bool> m_NeedIdr;
+
+		/* Pacer thread only */
+		LONGLONG m_LastVsync;
+		LONGLONG m_LastShown;
+		int m_HeldRefreshes;
+
+		std::atomic<LONGLONG> m_VsyncInterval;
+		std::atomic<LONGLONG> m_LeadTime;
+		std::atomic<long long> m_LastReleasedReceiveTime;
+		std::atomic<LONGLONG> m_LastReleaseTime;
+		std::atomic<long long> m_FrameTimeMeanUs;
+
+		/* In square microseconds */
+		std::atomic<long long> m_FrameTimeVariance;
+	};
+}
@@ -0,0 +1,226 @@
+﻿/* Native gamepad polling */
+#include "GamepadPoller.hpp"
+
+#include <Xinput.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* XInput's button bits line up with the protocol's, minus the two it leaves unused */
+#define XINPUT_BUTTON_MASK 0xF3FF
+
+using namespace Moonlight_common_binding;
+
+bool XInputControllerSource::GetState(int index, ControllerState &state) {
+	XINPUT_STATE xinputState;
+
+	if (XInputGetState(index, &xinputState) != ERROR_SUCCESS) {
+		return false;
+	}
+
+	state.buttonFlags = (short)(xinputState.Gamepad.wButtons & XINPUT_BUTTON_MASK);
+	state.leftTrigger = xinputState.Gamepad.bLeftTrigger;
+	state.rightTrigger = xinputState.Gamepad.bRightTrigger;
+	state.leftStickX = xinputState.Gamepad.sThumbLX;
+	state.leftStickY = xinputState.Gamepad.sThumbLY;
+	state.rightStickX = xinputState.Gamepad.sThumbRX;
+	state.rightStickY = xinputState.Gamepad.sThumbRY;
+	return true;
+}
+
+GamepadPoller::GamepadPoller(InputSender *inputSender) :
+	m_InputSender(inputSender), m_Source(NULL), m_StopEvent(NULL), m_PollRateHz(DEFAULT_GAMEPAD_POLL_RATE_HZ),
+	m_StickDeadzone(DEFAULT_STICK_DEADZONE), m_StickNoiseThreshold(DEFAULT_STICK_NOISE_THRESHOLD), m_PacketsQueued(0)
+{
+	QueryPerformanceFrequency(&m_QpcFrequency);
+}
+
+GamepadPoller::~GamepadPoller()
+{
+	Stop();
+}
+
+void GamepadPoller::Start(IControllerSource *source) {
+	if (m_Thread.joinable()) {
+		return;
+	}
+
+	memset(m_Slots, 0, sizeof(m_Slots));
+
+	m_Source = source;
+	m_StopEvent = CreateEventEx(NULL, NULL, CREATE_EVENT_MANUAL_RESET, EVENT_ALL_ACCESS);
+	m_Thread = std::thread(&GamepadPoller::ThreadProc, this);
+}
+
+void GamepadPoller::Stop(void) {
+	if (!m_Thread.joinable()) {
+		return;
+	}
+
+	SetEvent(m_StopEvent);
+	m_Thread.join();
+
+	CloseHandle(m_StopEvent);
+	m_StopEvent = NULL;
+	m_Source = NULL;
+}
+
+void GamepadPoller::SetPollRate(int rateHz) {
+	if (rateHz < 1) {
+		rateHz = 1;
+	}
+	else if (rateHz > MAX_GAMEPAD_POLL_RATE_HZ) {
+		rateHz = MAX_GAMEPAD_POLL_RATE_HZ;
+	}
+
+	m_PollRateHz = rateHz;
+}
+
+void GamepadPoller::SetStickFilter(int deadzone, int noiseThreshold) {
+	m_StickDeadzone = deadzone > 0 ? deadzone : 0;
+	m_StickNoiseThreshold = noiseThreshold > 0 ? noiseThreshold : 0;
+}
+
+long long GamepadPoller::GetPacketsQueued(void) {
+	return m_PacketsQueued;
+}
+
+static short ClampAxis(double value) {
+	if (value > SHRT_MAX) {
+		return SHRT_MAX;
+	}
+	else if (value < SHRT_MIN) {
+		return SHRT_MIN;
+	}
+
+	return (short)value;
+}
+
+/* Applies a radial deadzone, rescaling the rest of the range so there's no
+ * jump at its edge, then holds the last sent position if the stick has only
+ * moved by noise */
+void GamepadPoller::FilterStick(short &x, short &y, short lastX, short lastY) {
+	int deadzone = m_StickDeadzone;
+	int noiseThreshold = m_StickNoiseThreshold;
+	double magnitude = sqrt((double)x * x + (double)y * y);
+	double scale;
+
+	if (magnitude <= deadzone || deadzone >= SHRT_MAX) {
+		/* Always let the stick return to center */
+		x = 0;
+		y = 0;
+		return;
+	}
+
+	if (deadzone != 0) {
+		/* Diagonals can read past full scale, so cap the magnitude first */
+		double capped = magnitude < SHRT_MAX ? magnitude : SHRT_MAX;
+
+		scale = ((capped - deadzone) / (SHRT_MAX - deadzone)) * SHRT_MAX / magnitude;
+		x = ClampAxis(x * scale);
+		y = ClampAxis(y * scale);
+	}
+
+	if (abs(x - lastX) < noiseThreshold && abs(y - lastY) < noiseThreshold) {
+		x = lastX;
+		y = lastY;
+	}
+}
+
+static bool IsSameState(const ControllerState &a, const ControllerState &b) {
+	return a.buttonFlags == b.buttonFlags &&
+		a.leftTrigger == b.leftTrigger && a.rightTrigger == b.rightTrigger &&
+		a.leftStickX == b.leftStickX && a.leftStickY == b.leftStickY &&
+		a.rightStickX == b.rightStickX && a.rightStickY == b.rightStickY;
+}
+
+/* Changes found in one poll cycle go out as a single batch */
+void GamepadPoller::Poll(int index, ULONGLONG now, InputEvent &batch) {
+	GamepadSlot &slot = m_Slots[index];
+	ControllerState state;
+
+	if (!slot.connected && !slot.resend && now < slot.nextConnectCheck) {
+		return;
+	}
+
+	if (!m_Source->GetState(index, state)) {
+		if (slot.connected || slot.resend) {
+			/* Release anything the controller was holding when it went away */
+			memset(&state, 0, sizeof(state));
+			state.controllerNumber = (short)index;
+			batch.controllerBatch.states[batch.controllerBatch.count++] = state;
+			slot.connected = false;
+			slot.resend = false;
+		}
+
+		slot.nextConnectCheck = now + DISCONNECTED_GAMEPAD_CHECK_INTERVAL_MS;
+		return;
+	}
+
+	if (!slot.connected) {
+		slot.connected = true;
+		memset(&slot.lastSent, 0, sizeof(slot.lastSent));
+		slot.lastSent.controllerNumber = (short)index;
+	}
+
+	state.controllerNumber = (short)index;
+	FilterStick(state.leftStickX, state.leftStickY, slot.lastSent.leftStickX, slot.lastSent.leftStickY);
+	FilterStick(state.rightStickX, state.rightStickY, slot.lastSent.rightStickX, slot.lastSent.rightStickY);
+
+	if (slot.resend || !IsSameState(state, slot.lastSent)) {
+		slot.resend = false;
+		slot.lastSent = state;
+		batch.controllerBatch.states[batch.controllerBatch.count++] = state;
+	}
+}
+
+void GamepadPoller::ThreadProc(void) {
+	LARGE_INTEGER now;
+	LONGLONG nextPollTime;
+
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL);
+
+	QueryPerformanceCounter(&now);
+	nextPollTime = now.QuadPart;
+
+	for (;;) {
+		LONGLONG pollInterval = m_QpcFrequency.QuadPart / m_PollRateHz;
+		ULONGLONG tickCount = GetTickCount64();
+		InputEvent batch;
+		DWORD timeout;
+
+		batch.type = InputMultiControllerBatch;
+		batch.controllerBatch.count = 0;
+		for (int i = 0; i < MAX_GAMEPADS; i++) {
+			Poll(i, tickCount, batch);
+		}
+
+		if (batch.controllerBatch.count != 0) {
+			if (m_InputSender->Enqueue(batch)) {
+				m_PacketsQueued += batch.controllerBatch.count;
+			}
+			else {
+				/* Try again next cycle rather than leave the host out of date */
+				for (int i = 0; i < batch.controllerBatch.count; i++) {
+					m_Slots[batch.controllerBatch.states[i].controllerNumber].resend = true;
+				}
+			}
+		}
+
+		/* Schedule from the previous deadline so the rate doesn't drift,
+		 * but don't try to catch up on polls we were too late for */
+		QueryPerformanceCounter(&now);
+		nextPollTime += pollInterval;
+		if (nextPollTime <= now.QuadPart) {
+			nextPollTime = now.QuadPart + pollInterval;
+		}
+
+		/* The wait is only as precise as the system timer, which is
+		 * normally raised to 1 ms while video is playing */
+		timeout = (DWORD)(((nextPollTime - now.QuadPart) * 1000 + m_QpcFrequency.QuadPart - 1) / m_QpcFrequency.QuadPart);
+		if (WaitForSingleObjectEx(m_StopEvent, timeout, FALSE) == WAIT_OBJECT_0) {
+			break;
+		}
+	}
+}
@@ -0,0 +1,87 @@
+﻿#pragma once
+#include "InputSender.hpp"
+
+#include <Windows.h>
+#include <atomic>
+#include <thread>
+
+#define DEFAULT_GAMEPAD_POLL_RATE_HZ 500
+#define MAX_GAMEPAD_POLL_RATE_HZ 1000
+
+/* Sticks within this radius of center read as centered. This is well
+ * below XInput's suggested deadzones since the game applies its own. */
+#define DEFAULT_STICK_DEADZONE 1500
+
+/* Stick movements smaller than this on both axes aren't worth a packet */
+#define DEFAULT_STICK_NOISE_THRESHOLD 256
+
+/* Looking for a controller that isn't there is expensive in XInput */
+#define DISCONNECTED_GAMEPAD_CHECK_INTERVAL_MS 1000
+
+namespace Moonlight_common_binding
+{
+	/* Where the poller reads controller state from. Implementations other
+	 * than XInput can feed the poller scripted input. */
+	class IControllerSource
+	{
+	public:
+		virtual ~IControllerSource() {}
+
+		/* Fills in the current state of the given controller. Returns false
+		 * if no controller is connected at that index. */
+		virtual bool GetState(int index, ControllerState &state) = 0;
+	};
+
+	class XInputControllerSource final : public IControllerSource
+	{
+	public:
+		bool GetState(int index, ControllerState &state) override;
+	};
+
+	/* Polls controllers from a dedicated thread at a fixed rate and queues
+	 * a packet only when a controller's filtered state actually changes. */
+	class GamepadPoller
+	{
+	public:
+		GamepadPoller(InputSender *inputSender);
+		~GamepadPoller();
+
+		/* The source is not owned and must outlive the poller */
+		void Start(IControllerSource *source);
+		void Stop(void);
+
+		void SetPollRate(int rateHz);
+		void SetStickFilter(int deadzone, int noiseThreshold);
+
+		long long GetPacketsQueued(void);
+
+	private:
+		struct GamepadSlot
+		{
+			bool connected;
+			ULONGLONG nextConnectCheck;
+			ControllerState lastSent;
+
+			/* Set when lastSent never made it into the queue */
+			bool resend;
+		};
+
+		void ThreadProc(void);
+		void Poll(int index, ULONGLONG now, InputEvent &batch);
+		void FilterStick(short &x, short &y, short lastX, short lastY);
+
+		InputSender *m_InputSender;
+		IControllerSource *m_Source;
+		HANDLE m_StopEvent;
+		std::thread m_Thread;
+		LARGE_INTEGER m_QpcFrequency;
+
+		std::atomic<int> m_PollRateHz;
+		std::atomic<int> m_StickDeadzone;
+		std::atomic<int> m_StickNoiseThreshold;
+		std::atomic<long long> m_PacketsQueued;
+
+		/* Only touched by the poller thread */
+		GamepadSlot m_Slots[MAX_GAMEPADS];
+	};
+}
@@ -0,0 +1,629 @@
+﻿/* Asynchronous input event transmission */
+#include "InputSender.hpp"
+
+#include <Limelight.h>
+#include <limits.h>
+#include <chrono>
+
+/* Key code the host expects for Shift */
+#define SHIFT_KEY_CODE ((short)0x8010)
+
+using namespace Moonlight_common_binding;
+
+InputSender::InputSender() :
+	m_WakeEvent(NULL), m_Stopping(false), m_Idle(false), m_EventsSent(0), m_EventsDropped(0),
+	m_TotalLatencyUs(0), m_MaxLatencyUs(0), m_NextSequence(0), m_ProbeEnabled(false), m_SlowestEventSequence(0),
+	m_SlowestEventLatencyUs(0), m_MouseFlushIntervalTicks(0), m_MotionPending(false), m_PendingDeltaX(0),
+	m_PendingDeltaY(0), m_PendingMotionCaptureTime(0), m_PendingMotionSequence(0), m_MotionFlushDeadline(0),
+	m_MouseEventsCoalesced(0), m_MousePacketsSent(0), m_TotalMouseDelayUs(0), m_MotionFlushes(0),
+	m_HorizontalScrollShift(false), m_ScrollPending(false), m_PendingScrollY(0), m_PendingScrollX(0),
+	m_ScrollShiftHeld(false), m_PendingScrollCaptureTime(0), m_PendingScrollSequence(0), m_ScrollFlushDeadline(0),
+	m_ScrollEventsReceived(0), m_ScrollPacketsSent(0), m_LastMousePacketsSent(0), m_LastMousePacketRateTime(0)
+{
+	QueryPerformanceFrequency(&m_QpcFrequency);
+	SetMouseFlushRate(DEFAULT_MOUSE_FLUSH_RATE_HZ);
+}
+
+InputSender::~InputSender()
+{
+	Stop();
+}
+
+void InputSender::Start(void) {
+	if (m_Thread.joinable()) {
+		return;
+	}
+
+	LARGE_INTEGER now;
+
+	m_Stopping = false;
+	m_Idle = false;
+
+	QueryPerformanceCounter(&now);
+	m_Timers.Clear();
+	m_Timers.Reset(GetTimerTick(now.QuadPart));
+
+	m_WakeEvent = CreateEventEx(NULL, NULL, 0, EVENT_ALL_ACCESS);
+	m_Thread = std::thread(&InputSender::ThreadProc, this);
+}
+
+void InputSender::Stop(void) {
+	InputEvent event;
+
+	if (!m_Thread.joinable()) {
+		return;
+	}
+
+	m_Stopping = true;
+	SetEvent(m_WakeEvent);
+	m_Thread.join();
+
+	CloseHandle(m_WakeEvent);
+	m_WakeEvent = NULL;
+
+	/* Anything left over was meant for the old connection */
+	while (m_Queue.TryDequeue(event));
+	m_Timers.Clear();
+	m_MotionPending = false;
+	m_ScrollPending = false;
+	m_PendingScrollY = 0;
+	m_PendingScrollX = 0;
+}
+
+bool InputSender::Enqueue(InputEvent &event) {
+	event.sequence = m_NextSequence++;
+	StampTimes(event, 0);
+
+	m_TraceRecorder.Record(event, 0);
+	return Push(event);
+}
+
+bool InputSender::EnqueueWhenRoom(InputEvent &event, int timeoutMs) {
+	event.sequence = m_NextSequence++;
+	StampTimes(event, 0);
+
+	m_TraceRecorder.Record(event, 0);
+	for (int waited = 0; !TryPush(event); waited++) {
+		if (waited >= timeoutMs) {
+			m_EventsDropped++;
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		/* Time spent waiting for room isn't the sender's latency */
+		StampTimes(event, 0);
+	}
+
+	return true;
+}
+
+bool InputSender::Schedule(InputEvent &event, int delayMs) {
+	event.sequence = m_NextSequence++;
+	StampTimes(event, delayMs);
+
+	m_TraceRecorder.Record(event, delayMs);
+	return Push(event);
+}
+
+bool InputSender::Replay(InputEvent &event, int delayMs, HANDLE cancelEvent) {
+	event.sequence = m_NextSequence++;
+	StampTimes(event, delayMs);
+
+	/* Recording a replay would only copy the trace being played back */
+	if (cancelEvent == NULL) {
+		return Push(event);
+	}
+
+	while (!TryPush(event)) {
+		if (WaitForSingleObjectEx(cancelEvent, 1, FALSE) == WAIT_OBJECT_0) {
+			return false;
+		}
+
+		/* Time spent waiting for room isn't the sender's latency */
+		StampTimes(event, delayMs);
+	}
+
+	return true;
+}
+
+void InputSender::StampTimes(InputEvent &event, int delayMs) {
+	LARGE_INTEGER now;
+
+	QueryPerformanceCounter(&now);
+	event.captureTime = now.QuadPart;
+	event.sendTime = delayMs > 0 ? now.QuadPart + (delayMs * m_QpcFrequency.QuadPart) / 1000 : 0;
+}
+
+bool InputSender::TryPush(const InputEvent &event) {
+	if (!m_Queue.TryEnqueue(event)) {
+		return false;
+	}
+
+	/* Only pay for the wakeup if the sender is actually asleep */
+	if (m_Idle.exchange(false)) {
+		SetEvent(m_WakeEvent);
+	}
+
+	return true;
+}
+
+bool InputSender::Push(const InputEvent &event) {
+	if (!TryPush(event)) {
+		m_EventsDropped++;
+		return false;
+	}
+
+	return true;
+}
+
+long long InputSender::TicksToUs(LONGLONG ticks) {
+	return (ticks * 1000000) / m_QpcFrequency.QuadPart;
+}
+
+void InputSender::SetMouseFlushRate(int rateHz) {
+	m_MouseFlushIntervalTicks = rateHz > 0 ? m_QpcFrequency.QuadPart / rateHz : 0;
+}
+
+void InputSender::SetHorizontalScrollShift(bool enabled) {
+	m_HorizontalScrollShift = enabled;
+}
+
+/* sendStart is 0 if the probe was off when the send began */
+void InputSender::RecordLatency(LONGLONG captureTime, LONGLONG sendStart, LONGLONG now, unsigned int sequence) {
+	long long latencyUs = TicksToUs(now - captureTime);
+	long long maxLatencyUs;
+
+	m_EventsSent++;
+	m_TotalLatencyUs += latencyUs;
+
+	maxLatencyUs = m_MaxLatencyUs;
+	while (latencyUs > maxLatencyUs && !m_MaxLatencyUs.compare_exchange_weak(maxLatencyUs, latencyUs));
+
+	if (sendStart != 0) {
+		m_LatencyHistograms[LatencyQueueing].Record(TicksToUs(sendStart - captureTime));
+		m_LatencyHistograms[LatencySend].Record(TicksToUs(now - sendStart));
+		m_LatencyHistograms[LatencyTotal].Record(latencyUs);
+
+		/* Only the sender thread writes these */
+		if (latencyUs > m_SlowestEventLatencyUs) {
+			m_SlowestEventLatencyUs = latencyUs;
+			m_SlowestEventSequence = sequence;
+		}
+	}
+}
+
+void InputSender::SendNow(const InputEvent &event) {
+	LARGE_INTEGER sendStart;
+	LARGE_INTEGER now;
+
+	sendStart.QuadPart = 0;
+	if (m_ProbeEnabled) {
+		QueryPerformanceCounter(&sendStart);
+	}
+
+	switch (event.type) {
+	case InputMouseMove:
+		LiSendMouseMoveEvent(event.mouseMove.deltaX, event.mouseMove.deltaY);
+		break;
+	case InputMouseButton:
+		LiSendMouseButtonEvent(event.mouseButton.action, event.mouseButton.button);
+		break;
+	case InputKeyboard:
+		LiSendKeyboardEvent(event.keyboard.keyCode, event.keyboard.keyAction, event.keyboard.modifiers);
+		break;
+	case InputController:
+		LiSendControllerEvent(event.controller.buttonFlags, event.controller.leftTrigger, event.controller.rightTrigger,
+			event.controller.leftStickX, event.controller.leftStickY, event.controller.rightStickX, event.controller.rightStickY);
+		break;
+	case InputMultiController:
+		LiSendMultiControllerEvent(event.controller.controllerNumber, event.controller.buttonFlags,
+			event.controller.leftTrigger, event.controller.rightTrigger, event.controller.leftStickX,
+			event.controller.leftStickY, event.controller.rightStickX, event.controller.rightStickY);
+		break;
+	case InputMultiControllerBatch:
+		/* The protocol has no combined packet, but sending these together
+		 * keeps the whole batch in one burst on the wire */
+		for (int i = 0; i < event.controllerBatch.count; i++) {
+			const ControllerState &state = event.controllerBatch.states[i];
+
+			LiSendMultiControllerEvent(state.controllerNumber, state.buttonFlags, state.leftTrigger,
+				state.rightTrigger, state.leftStickX, state.leftStickY, state.rightStickX, state.rightStickY);
+		}
+		break;
+	case InputScroll:
+		LiSendScrollEvent(event.scroll.clicks);
+		break;
+	case InputScrollDelta:
+		/* Always accumulated by Send */
+		break;
+	}
+
+	QueryPerformanceCounter(&now);
+	RecordLatency(event.captureTime, sendStart.QuadPart, now.QuadPart, event.sequence);
+	RecordFlightEvent(FlightInputSent, event.type, event.sequence);
+}
+
+void InputSender::AccumulateMotion(const InputEvent &event) {
+	LONGLONG flushInterval = m_MouseFlushIntervalTicks;
+
+	if (!m_MotionPending) {
+		m_MotionPending = true;
+		m_PendingDeltaX = 0;
+		m_PendingDeltaY = 0;
+		m_PendingMotionCaptureTime = event.captureTime;
+		m_PendingMotionSequence = event.sequence;
+		m_MotionFlushDeadline = event.captureTime + flushInterval;
+	}
+	else {
+		m_MouseEventsCoalesced++;
+	}
+
+	m_PendingDeltaX += event.mouseMove.deltaX;
+	m_PendingDeltaY += event.mouseMove.deltaY;
+}
+
+static short ClampToShort(int value) {
+	if (value > SHRT_MAX) {
+		return SHRT_MAX;
+	}
+	else if (value < SHRT_MIN) {
+		return SHRT_MIN;
+	}
+
+	return (short)value;
+}
+
+/* Sends the accumulated motion, split into as few packets as the
+ * 16-bit delta fields allow */
+void InputSender::FlushMotion(void) {
+	LARGE_INTEGER sendStart;
+	LARGE_INTEGER now;
+
+	if (!m_MotionPending) {
+		return;
+	}
+
+	m_MotionPending = false;
+
+	/* Time spent coalescing counts as queueing */
+	sendStart.QuadPart = 0;
+	if (m_ProbeEnabled) {
+		QueryPerformanceCounter(&sendStart);
+	}
+
+	do {
+		short deltaX = ClampToShort(m_PendingDeltaX);
+		short deltaY = ClampToShort(m_PendingDeltaY);
+
+		LiSendMouseMoveEvent(deltaX, deltaY);
+		m_PendingDeltaX -= deltaX;
+		m_PendingDeltaY -= deltaY;
+		m_MousePacketsSent++;
+	} while (m_PendingDeltaX != 0 || m_PendingDeltaY != 0);
+
+	QueryPerformanceCounter(&now);
+	RecordLatency(m_PendingMotionCaptureTime, sendStart.QuadPart, now.QuadPart, m_PendingMotionSequence);
+	RecordFlightEvent(FlightInputSent, InputMouseMove, m_PendingMotionSequence);
+	m_TotalMouseDelayUs += TicksToUs(now.QuadPart - m_PendingMotionCaptureTime);
+	m_MotionFlushes++;
+}
+
+void InputSender::AccumulateScroll(const InputEvent &event) {
+	int &pending = event.scrollDelta.horizontal ? m_PendingScrollX : m_PendingScrollY;
+	short delta = event.scrollDelta.delta;
+
+	m_ScrollEventsReceived++;
+
+	/* A leftover from one direction shouldn't eat into a reversal */
+	if ((pending > 0 && delta < 0) || (pending < 0 && delta > 0)) {
+		pending = 0;
+	}
+
+	pending += delta;
+	if (event.scrollDelta.horizontal) {
+		m_ScrollShiftHeld = event.scrollDelta.shiftHeld;
+	}
+
+	if (!m_ScrollPending) {
+		m_ScrollPending = true;
+		m_PendingScrollCaptureTime = event.captureTime;
+		m_PendingScrollSequence = event.sequence;
+		m_ScrollFlushDeadline = event.captureTime + m_MouseFlushIntervalTicks;
+	}
+}
+
+/* Sends the clicks in as few packets as the 8-bit click field allows */
+void InputSender::SendScrollClicks(int clicks) {
+	while (clicks != 0) {
+		signed char packetClicks = clicks > SCHAR_MAX ? SCHAR_MAX : (clicks < SCHAR_MIN ? SCHAR_MIN : (signed char)clicks);
+
+		LiSendScrollEvent(packetClicks);
+		clicks -= packetClicks;
+		m_ScrollPacketsSent++;
+	}
+}
+
+void InputSender::FlushScroll(void) {
+	LARGE_INTEGER sendStart;
+	LARGE_INTEGER now;
+	int clicks;
+	int horizontalClicks;
+	bool sendHorizontal;
+
+	if (!m_ScrollPending) {
+		return;
+	}
+
+	m_ScrollPending = false;
+
+	sendStart.QuadPart = 0;
+	if (m_ProbeEnabled) {
+		QueryPerformanceCounter(&sendStart);
+	}
+
+	clicks = m_PendingScrollY / SCROLL_UNITS_PER_CLICK;
+	m_PendingScrollY -= clicks * SCROLL_UNITS_PER_CLICK;
+	SendScrollClicks(clicks);
+
+	horizontalClicks = m_PendingScrollX / SCROLL_UNITS_PER_CLICK;
+	m_PendingScrollX -= horizontalClicks * SCROLL_UNITS_PER_CLICK;
+	sendHorizontal = horizontalClicks != 0 && (m_ScrollShiftHeld || m_HorizontalScrollShift);
+	if (sendHorizontal) {
+		/* Wheel up scrolls left with Shift held, so the direction flips */
+		if (!m_ScrollShiftHeld) {
+			LiSendKeyboardEvent(SHIFT_KEY_CODE, KEY_ACTION_DOWN, MODIFIER_SHIFT);
+		}
+		SendScrollClicks(-horizontalClicks);
+		if (!m_ScrollShiftHeld) {
+			LiSendKeyboardEvent(SHIFT_KEY_CODE, KEY_ACTION_UP, 0);
+		}
+	}
+
+	if (clicks != 0 || sendHorizontal) {
+		QueryPerformanceCounter(&now);
+		RecordLatency(m_PendingScrollCaptureTime, sendStart.QuadPart, now.QuadPart, m_PendingScrollSequence);
+		RecordFlightEvent(FlightInputSent, InputScrollDelta, m_PendingScrollSequence);
+	}
+}
+
+void InputSender::Send(const InputEvent &event) {
+	if (event.type == InputMouseMove) {
+		if (m_MouseFlushIntervalTicks != 0) {
+			AccumulateMotion(event);
+			return;
+		}
+
+		m_MousePacketsSent++;
+	}
+	else if (event.type == InputScrollDelta) {
+		/* Scroll wherever the pointer has got to */
+		FlushMotion();
+		AccumulateScroll(event);
+		if (m_MouseFlushIntervalTicks == 0) {
+			FlushScroll();
+		}
+		return;
+	}
+	else {
+		/* Motion and scrolling must reach the host before anything queued
+		 * after them, or a click could land in the wrong place */
+		FlushMotion();
+		FlushScroll();
+
+		if (event.type == InputScroll) {
+			m_ScrollEventsReceived++;
+			m_ScrollPacketsSent++;
+		}
+	}
+
+	SendNow(event);
+}
+
+/* Rounds up so a timer never fires ahead of its send time */
+ULONGLONG InputSender::GetTimerTick(LONGLONG qpcTime) {
+	return (ULONGLONG)((qpcTime * 1000 + m_QpcFrequency.QuadPart - 1) / m_QpcFrequency.QuadPart);
+}
+
+/* Sends the event now or files it on the timer wheel if it isn't due yet */
+void InputSender::Dispatch(const InputEvent &event) {
+	if (event.sendTime != 0) {
+		LARGE_INTEGER now;
+
+		QueryPerformanceCounter(&now);
+		if (event.sendTime > now.QuadPart && m_Timers.Add(event, GetTimerTick(event.sendTime))) {
+			return;
+		}
+
+		/* If the wheel is full, sending early beats losing a release */
+	}
+
+	Send(event);
+}
+
+void InputSender::FireTimers(void) {
+	LARGE_INTEGER now;
+
+	if (m_Timers.GetCount() == 0) {
+		return;
+	}
+
+	QueryPerformanceCounter(&now);
+	m_Timers.Advance(now.QuadPart * 1000 / m_QpcFrequency.QuadPart, [this](InputEvent &event) {
+		/* Latency is measured from when the event was due */
+		event.captureTime = event.sendTime;
+		event.sendTime = 0;
+		Send(event);
+	});
+}
+
+/* Round up so we don't spin waking up a bit early */
+DWORD InputSender::GetDeadlineTimeout(LONGLONG deadline, LONGLONG now) {
+	if (now >= deadline) {
+		return 0;
+	}
+
+	return (DWORD)(((deadline - now) * 1000 + m_QpcFrequency.QuadPart - 1) / m_QpcFrequency.QuadPart);
+}
+
+/* How long the sender may sleep before pending motion, scrolling or a timer is due */
+DWORD InputSender::GetWaitTimeout(void) {
+	LARGE_INTEGER now;
+	ULONGLONG nextTimerTick;
+	DWORD timeout = INFINITE;
+
+	QueryPerformanceCounter(&now);
+
+	if (m_MotionPending) {
+		timeout = GetDeadlineTimeout(m_MotionFlushDeadline, now.QuadPart);
+	}
+
+	if (m_ScrollPending) {
+		DWORD scrollTimeout = GetDeadlineTimeout(m_ScrollFlushDeadline, now.QuadPart);
+
+		if (scrollTimeout < timeout) {
+			timeout = scrollTimeout;
+		}
+	}
+
+	if (m_Timers.GetNextDueTick(nextTimerTick)) {
+		ULONGLONG nowTick = now.QuadPart * 1000 / m_QpcFrequency.QuadPart;
+		DWORD timerTimeout = nextTimerTick > nowTick ? (DWORD)(nextTimerTick - nowTick) : 0;
+
+		if (timerTimeout < timeout) {
+			timeout = timerTimeout;
+		}
+	}
+
+	return timeout;
+}
+
+void InputSender::ThreadProc(void) {
+	InputEvent event;
+
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+
+	while (!m_Stopping) {
+		DWORD timeout;
+
+		while (m_Queue.TryDequeue(event)) {
+			Dispatch(event);
+		}
+
+		FireTimers();
+
+		timeout = GetWaitTimeout();
+		if (timeout == 0) {
+			LARGE_INTEGER now;
+
+			/* We may only be here for a timer, which the next pass fires */
+			QueryPerformanceCounter(&now);
+			if (m_MotionPending && now.QuadPart >= m_MotionFlushDeadline) {
+				FlushMotion();
+			}
+			if (m_ScrollPending && now.QuadPart >= m_ScrollFlushDeadline) {
+				FlushScroll();
+			}
+			continue;
+		}
+
+		/* Announce that we're going to sleep, then check once more so we
+		 * can't miss an event queued just before the flag was set */
+		m_Idle = true;
+		if (m_Queue.TryDequeue(event)) {
+			m_Idle = false;
+			Dispatch(event);
+			continue;
+		}
+
+		WaitForSingleObjectEx(m_WakeEvent, timeout, FALSE);
+	}
+}
+
+int InputSender::GetQueueDepth(void) {
+	return (int)m_Queue.GetDepth();
+}
+
+long long InputSender::GetEventsSent(void) {
+	return m_EventsSent;
+}
+
+long long InputSender::GetEventsDropped(void) {
+	return m_EventsDropped;
+}
+
+long long InputSender::GetAverageLatencyUs(void) {
+	long long sent = m_EventsSent;
+
+	return sent != 0 ? m_TotalLatencyUs / sent : 0;
+}
+
+long long InputSender::GetMaxLatencyUs(void) {
+	return m_MaxLatencyUs;
+}
+
+void InputSender::ResetMaxLatency(void) {
+	m_MaxLatencyUs = 0;
+}
+
+long long InputSender::GetMouseEventsCoalesced(void) {
+	return m_MouseEventsCoalesced;
+}
+
+long long InputSender::GetAverageMouseDelayUs(void) {
+	long long flushes = m_MotionFlushes;
+
+	return flushes != 0 ? m_TotalMouseDelayUs / flushes : 0;
+}
+
+long long InputSender::GetScrollEventsReceived(void) {
+	return m_ScrollEventsReceived;
+}
+
+long long InputSender::GetScrollPacketsSent(void) {
+	return m_ScrollPacketsSent;
+}
+
+int InputSender::TakeMousePacketRate(void) {
+	LARGE_INTEGER now;
+	long long packets = m_MousePacketsSent;
+	int rate = 0;
+
+	QueryPerformanceCounter(&now);
+	if (m_LastMousePacketRateTime != 0 && now.QuadPart > m_LastMousePacketRateTime) {
+		rate = (int)(((packets - m_LastMousePacketsSent) * m_QpcFrequency.QuadPart) /
+			(now.QuadPart - m_LastMousePacketRateTime));
+	}
+
+	m_LastMousePacketsSent = packets;
+	m_LastMousePacketRateTime = now.QuadPart;
+	return rate;
+}
+
+void InputSender::SetLatencyProbeEnabled(bool enabled) {
+	if (enabled && !m_ProbeEnabled) {
+		for (int i = 0; i < LatencyStageCount; i++) {
+			m_LatencyHistograms[i].Reset();
+		}
+
+		m_SlowestEventLatencyUs = 0;
+		m_SlowestEventSequence = 0;
+	}
+
+	m_ProbeEnabled = enabled;
+}
+
+InputTraceRecorder &InputSender::GetTraceRecorder(void) {
+	return m_TraceRecorder;
+}
+
+LatencyHistogram &InputSender::GetLatencyHistogram(LatencyStage stage) {
+	return m_LatencyHistograms[stage];
+}
+
+unsigned int InputSender::GetSlowestEventSequence(void) {
+	return m_SlowestEventSequence;
+}
+
+long long InputSender::GetSlowestEventLatencyUs(void) {
+	return m_SlowestEventLatencyUs;
+}
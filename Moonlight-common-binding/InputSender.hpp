@@ -0,0 +1,249 @@
+﻿#pragma once
+#include "LockFreeQueue.hpp"
+#include "TimerWheel.hpp"
+#include "LatencyHistogram.hpp"
+#include "InputTrace.hpp"
+#include "FlightRecorder.hpp"
+
+#include <Windows.h>
+#include <atomic>
+#include <thread>
+
+#define INPUT_QUEUE_SIZE 256
+
+#define MAX_GAMEPADS 4
+
+/* Scheduled events are kept on a wheel of 1 ms slots */
+#define INPUT_TIMER_WHEEL_SLOTS 256
+#define MAX_SCHEDULED_INPUT_EVENTS 64
+
+/* Relative mouse motion is summed and sent at most this often by default */
+#define DEFAULT_MOUSE_FLUSH_RATE_HZ 1000
+
+/* Raw wheel units in one scroll click */
+#define SCROLL_UNITS_PER_CLICK 120
+
+/* How long a click's release waits for room when it can't be scheduled */
+#define CLICK_RELEASE_TIMEOUT_MS 100
+
+namespace Moonlight_common_binding
+{
+	enum InputEventType {
+		InputMouseMove,
+		InputMouseButton,
+		InputKeyboard,
+		InputController,
+		InputMultiController,
+		InputMultiControllerBatch,
+		InputScroll,
+		InputScrollDelta
+	};
+
+	/* Stages timed by the latency probe */
+	enum LatencyStage {
+		LatencyQueueing,
+		LatencySend,
+		LatencyTotal,
+		LatencyStageCount
+	};
+
+	struct ControllerState
+	{
+		short controllerNumber;
+		short buttonFlags;
+		unsigned char leftTrigger;
+		unsigned char rightTrigger;
+		short leftStickX;
+		short leftStickY;
+		short rightStickX;
+		short rightStickY;
+	};
+
+	struct InputEvent
+	{
+		InputEventType type;
+
+		/* Assigned in the order events entered the binding */
+		unsigned int sequence;
+
+		/* QueryPerformanceCounter value when the event entered the binding */
+		LONGLONG captureTime;
+
+		/* QueryPerformanceCounter value the event should be sent at, or 0 to send it right away */
+		LONGLONG sendTime;
+
+		union {
+			struct {
+				short deltaX;
+				short deltaY;
+			} mouseMove;
+			struct {
+				char action;
+				int button;
+			} mouseButton;
+			struct {
+				short keyCode;
+				char keyAction;
+				char modifiers;
+			} keyboard;
+			ControllerState controller;
+			struct {
+				int count;
+				ControllerState states[MAX_GAMEPADS];
+			} controllerBatch;
+			struct {
+				signed char clicks;
+			} scroll;
+			struct {
+				short delta;
+				bool horizontal;
+				bool shiftHeld;
+			} scrollDelta;
+		};
+	};
+
+	/* Queues input events from the UI and pointer threads and sends them
+	 * to the host from a dedicated high-priority thread, so a slow send
+	 * never stalls input handling. */
+	class InputSender
+	{
+	public:
+		InputSender();
+		~InputSender();
+
+		void Start(void);
+		void Stop(void);
+
+		/* Stamps the event with its capture time and queues it. Returns
+		 * false if the queue is full. Safe to call from any thread. */
+		bool Enqueue(InputEvent &event);
+
+		/* Like Enqueue, but the event is held on the sender thread until
+		 * the delay has passed. The caller never waits. */
+		bool Schedule(InputEvent &event, int delayMs);
+
+		/* Like Enqueue, but waits up to timeoutMs for room instead of
+		 * dropping the event when the queue is full */
+		bool EnqueueWhenRoom(InputEvent &event, int timeoutMs);
+
+		/* Like Schedule, for events from a trace being replayed, which
+		 * aren't recorded into the trace. Given a cancel event, it waits
+		 * for room instead of dropping the event when the queue is full,
+		 * and returns false if the cancel event was signaled first. */
+		bool Replay(InputEvent &event, int delayMs, HANDLE cancelEvent);
+
+		int GetQueueDepth(void);
+		long long GetEventsSent(void);
+		long long GetEventsDropped(void);
+		long long GetAverageLatencyUs(void);
+
+		/* The worst capture-to-send latency since the last reset */
+		long long GetMaxLatencyUs(void);
+		void ResetMaxLatency(void);
+
+		/* Sets how often coalesced mouse motion is flushed. 0 sends every
+		 * motion event as it arrives. */
+		void SetMouseFlushRate(int rateHz);
+
+		/* The protocol has no horizontal scroll packet. Shift turns the wheel
+		 * sideways in most Windows apps, so horizontal scrolling is sent as
+		 * wheel clicks while the user holds Shift. With this enabled, Shift is
+		 * also pressed for them around the clicks, which games see as a real
+		 * key press. Otherwise horizontal scrolling without Shift is dropped. */
+		void SetHorizontalScrollShift(bool enabled);
+		long long GetMouseEventsCoalesced(void);
+		long long GetAverageMouseDelayUs(void);
+		long long GetScrollEventsReceived(void);
+		long long GetScrollPacketsSent(void);
+
+		/* Returns mouse motion packets per second since the last call.
+		 * Only one thread may call this. */
+		int TakeMousePacketRate(void);
+
+		/* The latency probe times how long each event spent queued and how
+		 * long handing it to Common took. Enabling it clears old results. */
+		void SetLatencyProbeEnabled(bool enabled);
+		LatencyHistogram &GetLatencyHistogram(LatencyStage stage);
+
+		InputTraceRecorder &GetTraceRecorder(void);
+
+		/* The slowest event seen by the probe */
+		unsigned int GetSlowestEventSequence(void);
+		long long GetSlowestEventLatencyUs(void);
+
+	private:
+		void ThreadProc(void);
+		void StampTimes(InputEvent &event, int delayMs);
+		bool TryPush(const InputEvent &event);
+		bool Push(const InputEvent &event);
+		void Dispatch(const InputEvent &event);
+		void FireTimers(void);
+		ULONGLONG GetTimerTick(LONGLONG qpcTime);
+		void Send(const InputEvent &event);
+		void SendNow(const InputEvent &event);
+		void RecordLatency(LONGLONG captureTime, LONGLONG sendStart, LONGLONG now, unsigned int sequence);
+		void AccumulateMotion(const InputEvent &event);
+		void FlushMotion(void);
+		void AccumulateScroll(const InputEvent &event);
+		void SendScrollClicks(int clicks);
+		void FlushScroll(void);
+		DWORD GetDeadlineTimeout(LONGLONG deadline, LONGLONG now);
+		DWORD GetWaitTimeout(void);
+		long long TicksToUs(LONGLONG ticks);
+
+		LockFreeQueue<InputEvent, INPUT_QUEUE_SIZE> m_Queue;
+
+		/* Events waiting for their send time, only touched by the sender thread */
+		TimerWheel<InputEvent, INPUT_TIMER_WHEEL_SLOTS, MAX_SCHEDULED_INPUT_EVENTS> m_Timers;
+
+		HANDLE m_WakeEvent;
+		std::thread m_Thread;
+		std::atomic<bool> m_Stopping;
+		std::atomic<bool> m_Idle;
+		LARGE_INTEGER m_QpcFrequency;
+
+		std::atomic<long long> m_EventsSent;
+		std::atomic<long long> m_EventsDropped;
+		std::atomic<long long> m_TotalLatencyUs;
+		std::atomic<long long> m_MaxLatencyUs;
+		std::atomic<unsigned int> m_NextSequence;
+		InputTraceRecorder m_TraceRecorder;
+
+		std::atomic<bool> m_ProbeEnabled;
+		LatencyHistogram m_LatencyHistograms[LatencyStageCount];
+		std::atomic<unsigned int> m_SlowestEventSequence;
+		std::atomic<long long> m_SlowestEventLatencyUs;
+
+		/* Pending relative motion, only touched by the sender thread. The
+		 * sums are wider than the packet fields and split on the way out. */
+		std::atomic<LONGLONG> m_MouseFlushIntervalTicks;
+		bool m_MotionPending;
+		int m_PendingDeltaX;
+		int m_PendingDeltaY;
+		LONGLONG m_PendingMotionCaptureTime;
+		unsigned int m_PendingMotionSequence;
+		LONGLONG m_MotionFlushDeadline;
+
+		std::atomic<long long> m_MouseEventsCoalesced;
+		std::atomic<long long> m_MousePacketsSent;
+		std::atomic<long long> m_TotalMouseDelayUs;
+		std::atomic<long long> m_MotionFlushes;
+
+		std::atomic<bool> m_HorizontalScrollShift;
+
+		/* Pending wheel movement in raw units, only touched by the sender
+		 * thread. Whatever is short of a full click carries over. */
+		bool m_ScrollPending;
+		int m_PendingScrollY;
+		int m_PendingScrollX;
+		bool m_ScrollShiftHeld;
+		LONGLONG m_PendingScrollCaptureTime;
+		unsigned int m_PendingScrollSequence;
+		LONGLONG m_ScrollFlushDeadline;
+
+		std::atomic<long long> m_ScrollEventsReceived;
+		std::atomic<long long> m_ScrollPacketsSent;
+		long long m_LastMousePacketsSent;
+		LONGLONG m_LastMousePacketRateTime;
+	};
+}
@@ -0,0 +1,377 @@
+/* Input trace recording and replay */
+#include "InputTrace.hpp"
+#include "InputSender.hpp"
+
+#include <limits.h>
+#include <string.h>
+
+/* A trace is the magic and version followed by records. Each record is
+ * a varint of microseconds since the previous record, a type byte, a
+ * varint delay in milliseconds if the type has TRACE_SCHEDULED_FLAG set,
+ * then the event fields in little endian. */
+#define TRACE_MAGIC "MLIT"
+#define TRACE_MAGIC_LENGTH 4
+#define TRACE_VERSION 1
+#define TRACE_HEADER_LENGTH (TRACE_MAGIC_LENGTH + 1)
+#define TRACE_SCHEDULED_FLAG 0x80
+
+/* Enough for a full controller batch with the largest varints */
+#define MAX_TRACE_RECORD_SIZE 128
+
+#define CONTROLLER_STATE_RECORD_SIZE 14
+
+#define SCROLL_DELTA_HORIZONTAL_FLAG 0x01
+#define SCROLL_DELTA_SHIFT_HELD_FLAG 0x02
+
+using namespace Moonlight_common_binding;
+
+InputTraceRecorder::InputTraceRecorder() :
+	m_Recording(false), m_LastRecordTime(0)
+{
+	QueryPerformanceFrequency(&m_QpcFrequency);
+}
+
+void InputTraceRecorder::Start(void) {
+	std::lock_guard<std::mutex> lock(m_Lock);
+	LARGE_INTEGER now;
+
+	m_Trace.clear();
+	m_Trace.insert(m_Trace.end(), TRACE_MAGIC, TRACE_MAGIC + TRACE_MAGIC_LENGTH);
+	m_Trace.push_back(TRACE_VERSION);
+
+	QueryPerformanceCounter(&now);
+	m_LastRecordTime = now.QuadPart;
+	m_Recording = true;
+}
+
+std::vector<unsigned char> InputTraceRecorder::Stop(void) {
+	std::lock_guard<std::mutex> lock(m_Lock);
+	std::vector<unsigned char> trace;
+
+	m_Recording = false;
+	trace.swap(m_Trace);
+	return trace;
+}
+
+void InputTraceRecorder::WriteVarint(unsigned long long value) {
+	while (value >= 0x80) {
+		m_Trace.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+
+	m_Trace.push_back((unsigned char)value);
+}
+
+void InputTraceRecorder::WriteShort(short value) {
+	m_Trace.push_back((unsigned char)value);
+	m_Trace.push_back((unsigned char)((unsigned short)value >> 8));
+}
+
+void InputTraceRecorder::Record(const InputEvent &event, int delayMs) {
+	unsigned long long deltaUs = 0;
+	unsigned char type = (unsigned char)event.type;
+
+	if (!m_Recording) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Lock);
+
+	if (!m_Recording || m_Trace.size() > MAX_INPUT_TRACE_SIZE - MAX_TRACE_RECORD_SIZE) {
+		return;
+	}
+
+	/* Events from different threads can be stamped slightly out of order */
+	if (event.captureTime > m_LastRecordTime) {
+		deltaUs = ((event.captureTime - m_LastRecordTime) * 1000000) / m_QpcFrequency.QuadPart;
+		m_LastRecordTime = event.captureTime;
+	}
+
+	WriteVarint(deltaUs);
+	if (delayMs > 0) {
+		m_Trace.push_back(type | TRACE_SCHEDULED_FLAG);
+		WriteVarint(delayMs);
+	}
+	else {
+		m_Trace.push_back(type);
+	}
+
+	switch (event.type) {
+	case InputMouseMove:
+		WriteShort(event.mouseMove.deltaX);
+		WriteShort(event.mouseMove.deltaY);
+		break;
+	case InputMouseButton:
+		m_Trace.push_back((unsigned char)event.mouseButton.action);
+		m_Trace.push_back((unsigned char)event.mouseButton.button);
+		break;
+	case InputKeyboard:
+		WriteShort(event.keyboard.keyCode);
+		m_Trace.push_back((unsigned char)event.keyboard.keyAction);
+		m_Trace.push_back((unsigned char)event.keyboard.modifiers);
+		break;
+	case InputController:
+	case InputMultiController:
+	case InputMultiControllerBatch:
+	{
+		const ControllerState *states = event.type == InputMultiControllerBatch ?
+			event.controllerBatch.states : &event.controller;
+		int count = event.type == InputMultiControllerBatch ? event.controllerBatch.count : 1;
+
+		if (event.type == InputMultiControllerBatch) {
+			m_Trace.push_back((unsigned char)count);
+		}
+
+		for (int i = 0; i < count; i++) {
+			WriteShort(states[i].controllerNumber);
+			WriteShort(states[i].buttonFlags);
+			m_Trace.push_back(states[i].leftTrigger);
+			m_Trace.push_back(states[i].rightTrigger);
+			WriteShort(states[i].leftStickX);
+			WriteShort(states[i].leftStickY);
+			WriteShort(states[i].rightStickX);
+			WriteShort(states[i].rightStickY);
+		}
+		break;
+	}
+	case InputScroll:
+		m_Trace.push_back((unsigned char)event.scroll.clicks);
+		break;
+	case InputScrollDelta:
+		WriteShort(event.scrollDelta.delta);
+		m_Trace.push_back((event.scrollDelta.horizontal ? SCROLL_DELTA_HORIZONTAL_FLAG : 0) |
+			(event.scrollDelta.shiftHeld ? SCROLL_DELTA_SHIFT_HELD_FLAG : 0));
+		break;
+	}
+}
+
+static bool ReadVarint(const unsigned char *&data, const unsigned char *end, unsigned long long &value) {
+	value = 0;
+
+	for (int shift = 0; shift < 64 && data < end; shift += 7) {
+		unsigned char b = *data++;
+
+		value |= (unsigned long long)(b & 0x7F) << shift;
+		if ((b & 0x80) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static short ReadShort(const unsigned char *&data) {
+	short value = (short)(data[0] | (data[1] << 8));
+
+	data += 2;
+	return value;
+}
+
+static void ReadControllerState(const unsigned char *&data, ControllerState &state) {
+	state.controllerNumber = ReadShort(data);
+	state.buttonFlags = ReadShort(data);
+	state.leftTrigger = *data++;
+	state.rightTrigger = *data++;
+	state.leftStickX = ReadShort(data);
+	state.leftStickY = ReadShort(data);
+	state.rightStickX = ReadShort(data);
+	state.rightStickY = ReadShort(data);
+}
+
+/* Returns false if the record is truncated or unknown */
+static bool ReadRecord(const unsigned char *&data, const unsigned char *end, unsigned long long &deltaUs,
+	int &delayMs, InputEvent &event)
+{
+	unsigned long long delay = 0;
+	unsigned char type;
+
+	if (!ReadVarint(data, end, deltaUs) || data == end) {
+		return false;
+	}
+
+	type = *data++;
+	if (type & TRACE_SCHEDULED_FLAG) {
+		if (!ReadVarint(data, end, delay) || delay > INT_MAX) {
+			return false;
+		}
+		type &= ~TRACE_SCHEDULED_FLAG;
+	}
+	delayMs = (int)delay;
+
+	event.type = (InputEventType)type;
+	switch (type) {
+	case InputMouseMove:
+		if (end - data < 4) {
+			return false;
+		}
+		event.mouseMove.deltaX = ReadShort(data);
+		event.mouseMove.deltaY = ReadShort(data);
+		return true;
+	case InputMouseButton:
+		if (end - data < 2) {
+			return false;
+		}
+		event.mouseButton.action = (char)*data++;
+		event.mouseButton.button = *data++;
+		return true;
+	case InputKeyboard:
+		if (end - data < 4) {
+			return false;
+		}
+		event.keyboard.keyCode = ReadShort(data);
+		event.keyboard.keyAction = (char)*data++;
+		event.keyboard.modifiers = (char)*data++;
+		return true;
+	case InputController:
+	case InputMultiController:
+		if (end - data < CONTROLLER_STATE_RECORD_SIZE) {
+			return false;
+		}
+		ReadControllerState(data, event.controller);
+		return true;
+	case InputMultiControllerBatch:
+		if (data == end) {
+			return false;
+		}
+		event.controllerBatch.count = *data++;
+		if (event.controllerBatch.count > MAX_GAMEPADS ||
+			end - data < event.controllerBatch.count * CONTROLLER_STATE_RECORD_SIZE) {
+			return false;
+		}
+		for (int i = 0; i < event.controllerBatch.count; i++) {
+			ReadControllerState(data, event.controllerBatch.states[i]);
+		}
+		return true;
+	case InputScroll:
+		if (data == end) {
+			return false;
+		}
+		event.scroll.clicks = (signed char)*data++;
+		return true;
+	case InputScrollDelta:
+		if (end - data < 3) {
+			return false;
+		}
+		event.scrollDelta.delta = ReadShort(data);
+		event.scrollDelta.horizontal = (*data & SCROLL_DELTA_HORIZONTAL_FLAG) != 0;
+		event.scrollDelta.shiftHeld = (*data & SCROLL_DELTA_SHIFT_HELD_FLAG) != 0;
+		data++;
+		return true;
+	default:
+		return false;
+	}
+}
+
+InputTraceReplayer::InputTraceReplayer(InputSender *inputSender) :
+	m_InputSender(inputSender), m_StopEvent(NULL), m_Speed(1.0)
+{
+	QueryPerformanceFrequency(&m_QpcFrequency);
+}
+
+InputTraceReplayer::~InputTraceReplayer()
+{
+	Stop();
+}
+
+bool InputTraceReplayer::Start(const unsigned char *trace, size_t length, double speed) {
+	const unsigned char *data = trace + TRACE_HEADER_LENGTH;
+	const unsigned char *end = trace + length;
+
+	if (length < TRACE_HEADER_LENGTH || memcmp(trace, TRACE_MAGIC, TRACE_MAGIC_LENGTH) != 0 ||
+		trace[TRACE_MAGIC_LENGTH] != TRACE_VERSION) {
+		return false;
+	}
+
+	/* Check the whole trace up front so a bad record can't stop a replay halfway */
+	while (data < end) {
+		unsigned long long deltaUs;
+		int delayMs;
+		InputEvent event;
+
+		if (!ReadRecord(data, end, deltaUs, delayMs, event)) {
+			return false;
+		}
+	}
+
+	Stop();
+
+	m_Trace.assign(trace + TRACE_HEADER_LENGTH, end);
+	m_Speed = speed > 0 ? speed : 0;
+	m_StopEvent = CreateEventEx(NULL, NULL, CREATE_EVENT_MANUAL_RESET, EVENT_ALL_ACCESS);
+	m_Thread = std::thread(&InputTraceReplayer::ThreadProc, this);
+	return true;
+}
+
+void InputTraceReplayer::Stop(void) {
+	if (!m_Thread.joinable()) {
+		return;
+	}
+
+	SetEvent(m_StopEvent);
+	m_Thread.join();
+
+	CloseHandle(m_StopEvent);
+	m_StopEvent = NULL;
+}
+
+void InputTraceReplayer::ThreadProc(void) {
+	const unsigned char *data = m_Trace.data();
+	const unsigned char *end = data + m_Trace.size();
+	unsigned long long offsetUs = 0;
+	LARGE_INTEGER start;
+
+	QueryPerformanceCounter(&start);
+
+	while (data < end) {
+		unsigned long long deltaUs;
+		int delayMs;
+		InputEvent event;
+
+		ReadRecord(data, end, deltaUs, delayMs, event);
+		offsetUs += deltaUs;
+
+		if (m_Speed > 0) {
+			if (!WaitUntil(start.QuadPart + (LONGLONG)((offsetUs / m_Speed) * m_QpcFrequency.QuadPart / 1000000))) {
+				return;
+			}
+
+			delayMs = (int)(delayMs / m_Speed);
+		}
+		else if (WaitForSingleObjectEx(m_StopEvent, 0, FALSE) == WAIT_OBJECT_0) {
+			return;
+		}
+
+		/* A timed replay drops events like live input would, but a flat-out
+		 * replay waits for room so it measures throughput, not the queue size */
+		if (m_Speed > 0) {
+			m_InputSender->Replay(event, delayMs, NULL);
+		}
+		else if (!m_InputSender->Replay(event, delayMs, m_StopEvent)) {
+			return;
+		}
+	}
+}
+
+/* Returns false if stopped first */
+bool InputTraceReplayer::WaitUntil(LONGLONG deadline) {
+	LARGE_INTEGER now;
+	LONGLONG wakeTime = deadline - m_QpcFrequency.QuadPart * INPUT_TRACE_REPLAY_SPIN_US / 1000000;
+	DWORD timeout = 0;
+
+	QueryPerformanceCounter(&now);
+	if (wakeTime > now.QuadPart) {
+		timeout = (DWORD)(((wakeTime - now.QuadPart) * 1000) / m_QpcFrequency.QuadPart);
+	}
+
+	if (WaitForSingleObjectEx(m_StopEvent, timeout, FALSE) == WAIT_OBJECT_0) {
+		return false;
+	}
+
+	for (;;) {
+		QueryPerformanceCounter(&now);
+		if (now.QuadPart >= deadline) {
+			return true;
+		}
+		YieldProcessor();
+	}
+}
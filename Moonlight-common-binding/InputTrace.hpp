@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Windows.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Recording stops growing the trace past this size */
+#define MAX_INPUT_TRACE_SIZE (16 * 1024 * 1024)
+
+/* The replayer's timed wait can overshoot by a timer tick, so it ends this
+ * far ahead of each event and spins on the clock after that */
+#define INPUT_TRACE_REPLAY_SPIN_US 2000
+
+namespace Moonlight_common_binding
+{
+	struct InputEvent;
+	class InputSender;
+
+	/* Records input events into a compact binary trace. Each record holds
+	 * the time since the previous one and the event's fields, so a typical
+	 * mouse move costs 6 or 7 bytes. */
+	class InputTraceRecorder
+	{
+	public:
+		InputTraceRecorder();
+
+		void Start(void);
+		std::vector<unsigned char> Stop(void);
+
+		/* Called for every event entering the sender. Does nothing unless
+		 * recording. delayMs is nonzero for scheduled events. */
+		void Record(const InputEvent &event, int delayMs);
+
+	private:
+		void WriteVarint(unsigned long long value);
+		void WriteShort(short value);
+
+		std::atomic<bool> m_Recording;
+		std::mutex m_Lock;
+		std::vector<unsigned char> m_Trace;
+		LONGLONG m_LastRecordTime;
+		LARGE_INTEGER m_QpcFrequency;
+	};
+
+	/* Feeds a recorded trace back into the input sender from its own
+	 * thread, keeping the original spacing scaled by a speed factor. */
+	class InputTraceReplayer
+	{
+	public:
+		InputTraceReplayer(InputSender *inputSender);
+		~InputTraceReplayer();
+
+		/* Returns false if the trace is malformed. A speed of 2 replays twice
+		 * as fast, and 0 replays as fast as the queue accepts events. */
+		bool Start(const unsigned char *trace, size_t length, double speed);
+		void Stop(void);
+
+	private:
+		void ThreadProc(void);
+		bool WaitUntil(LONGLONG deadline);
+
+		InputSender *m_InputSender;
+		HANDLE m_StopEvent;
+		std::thread m_Thread;
+		std::vector<unsigned char> m_Trace;
+		double m_Speed;
+		LARGE_INTEGER m_QpcFrequency;
+	};
+}
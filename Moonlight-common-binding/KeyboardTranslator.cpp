@@ -0,0 +1,208 @@
+/* Virtual key translation and modifier tracking */
+#include "KeyboardTranslator.hpp"
+
+#include <Limelight.h>
+#include <stddef.h>
+#include <utility>
+
+#define KEY_PREFIX 0x80
+
+/* Modifier keys, each with its generic, left and right virtual key */
+#define VIRTUAL_KEY_SHIFT 0x10
+#define VIRTUAL_KEY_CONTROL 0x11
+#define VIRTUAL_KEY_MENU 0x12
+#define VIRTUAL_KEY_LEFT_SHIFT 0xA0
+#define VIRTUAL_KEY_RIGHT_SHIFT 0xA1
+#define VIRTUAL_KEY_LEFT_CONTROL 0xA2
+#define VIRTUAL_KEY_RIGHT_CONTROL 0xA3
+#define VIRTUAL_KEY_LEFT_MENU 0xA4
+#define VIRTUAL_KEY_RIGHT_MENU 0xA5
+
+using namespace Moonlight_common_binding;
+
+namespace
+{
+	struct KeyMapping
+	{
+		int virtualKey;
+		int translated;
+	};
+
+	/* Keys outside the contiguous ranges handled in TranslateKey. A translated
+	 * value of 0 means unsupported, so nothing may map to 0. */
+	constexpr KeyMapping s_NamedKeys[] = {
+		{ 0x08, 0 }, /* Back isn't supported yet */
+		{ 0x09, 0x09 }, /* Tab */
+		{ 0x0C, 0x0C }, /* Clear */
+		{ 0x0D, 0x0D }, /* Enter */
+		{ VIRTUAL_KEY_SHIFT, 0x10 },
+		{ VIRTUAL_KEY_LEFT_SHIFT, 0x10 },
+		{ VIRTUAL_KEY_RIGHT_SHIFT, 0x10 },
+		{ VIRTUAL_KEY_CONTROL, 0x11 },
+		{ VIRTUAL_KEY_LEFT_CONTROL, 0x11 },
+		{ VIRTUAL_KEY_RIGHT_CONTROL, 0x11 },
+		{ VIRTUAL_KEY_MENU, 0x12 },
+		{ VIRTUAL_KEY_LEFT_MENU, 0x12 },
+		{ VIRTUAL_KEY_RIGHT_MENU, 0x12 },
+		{ 0x14, 0x14 }, /* Caps lock */
+		{ 0x1B, 0x1B }, /* Escape */
+		{ 0x20, 0x20 }, /* Space */
+		{ 0x21, 0x21 }, /* Page up */
+		{ 0x22, 0x22 }, /* Page down */
+		{ 0x23, 0x23 }, /* End */
+		{ 0x24, 0x24 }, /* Home */
+		{ 0x25, 0x25 }, /* Left */
+		{ 0x26, 0x26 }, /* Up */
+		{ 0x27, 0x27 }, /* Right */
+		{ 0x28, 0x28 }, /* Down */
+		{ 0x2C, 154 }, /* Print screen */
+		{ 0x2D, -1 }, /* Insert */
+		{ 0x2E, 46 }, /* Delete, which Nvidia maps to period */
+		{ 0x5B, 524 }, /* Left Windows */
+		{ 0x5C, 524 }, /* Right Windows */
+		{ 0x90, 0x90 }, /* Num lock */
+		{ 0x91, 0x91 }, /* Scroll lock */
+		{ 0xBA, 0xBA }, /* Semicolon */
+		{ 0xBB, 61 }, /* Equals */
+		{ 0xBC, 44 }, /* Comma */
+		{ 0xBD, 0xBD }, /* Minus */
+		{ 0xBE, 0xBE }, /* Period */
+		{ 0xBF, 0xBF }, /* Slash */
+		{ 0xC0, 0xC0 }, /* Grave */
+		{ 0xDB, 0xDB }, /* Left bracket */
+		{ 0xDC, 92 }, /* Backslash */
+		{ 0xDD, 0xDD }, /* Right bracket */
+		{ 0xDE, 0xDE }, /* Apostrophe */
+	};
+
+	constexpr int FindNamedKey(int virtualKey, size_t index) {
+		return index == sizeof(s_NamedKeys) / sizeof(s_NamedKeys[0]) ? 0 :
+			s_NamedKeys[index].virtualKey == virtualKey ? s_NamedKeys[index].translated :
+			FindNamedKey(virtualKey, index + 1);
+	}
+
+	constexpr short MakeKeyCode(int translated) {
+		return translated == 0 ? 0 : (short)((KEY_PREFIX << 8) | translated);
+	}
+
+	/* Digits, letters, the number pad and F1-F12 already match the host's codes */
+	constexpr short TranslateKey(int virtualKey) {
+		return (virtualKey >= 0x30 && virtualKey <= 0x39) ||
+			(virtualKey >= 0x41 && virtualKey <= 0x5A) ||
+			(virtualKey >= 0x60 && virtualKey <= 0x69) ||
+			(virtualKey >= 0x70 && virtualKey <= 0x7B) ?
+			MakeKeyCode(virtualKey) : MakeKeyCode(FindNamedKey(virtualKey, 0));
+	}
+
+	struct KeyTable
+	{
+		short keys[256];
+	};
+
+	template <size_t... VirtualKeys>
+	constexpr KeyTable MakeKeyTable(std::index_sequence<VirtualKeys...>) {
+		return KeyTable{ { TranslateKey((int)VirtualKeys)... } };
+	}
+
+	constexpr KeyTable s_KeyTable = MakeKeyTable(std::make_index_sequence<256>());
+
+	static_assert(s_KeyTable.keys['A'] == (short)0x8041, "Letters should pass through");
+	static_assert(s_KeyTable.keys[VIRTUAL_KEY_RIGHT_SHIFT] == (short)0x8010, "Sided modifiers should collapse");
+	static_assert(s_KeyTable.keys[0x08] == 0, "Unsupported keys should translate to 0");
+}
+
+short Moonlight_common_binding::TranslateVirtualKey(int virtualKey) {
+	if (virtualKey < 0 || virtualKey > 255) {
+		return 0;
+	}
+
+	return s_KeyTable.keys[virtualKey];
+}
+
+/* Each modifier gets three bits: generic, left and right */
+#define SHIFT_KEY_BITS 0x007
+#define CONTROL_KEY_BITS 0x038
+#define ALT_KEY_BITS 0x1C0
+#define GENERIC_KEY_BITS 0x049
+
+static unsigned int GetModifierKeyBit(int virtualKey) {
+	switch (virtualKey) {
+	case VIRTUAL_KEY_SHIFT:
+		return 0x001;
+	case VIRTUAL_KEY_LEFT_SHIFT:
+		return 0x002;
+	case VIRTUAL_KEY_RIGHT_SHIFT:
+		return 0x004;
+	case VIRTUAL_KEY_CONTROL:
+		return 0x008;
+	case VIRTUAL_KEY_LEFT_CONTROL:
+		return 0x010;
+	case VIRTUAL_KEY_RIGHT_CONTROL:
+		return 0x020;
+	case VIRTUAL_KEY_MENU:
+		return 0x040;
+	case VIRTUAL_KEY_LEFT_MENU:
+		return 0x080;
+	case VIRTUAL_KEY_RIGHT_MENU:
+		return 0x100;
+	default:
+		return 0;
+	}
+}
+
+static unsigned int GetModifierGroupBits(unsigned int keyBit) {
+	if (keyBit & SHIFT_KEY_BITS) {
+		return SHIFT_KEY_BITS;
+	}
+	else if (keyBit & CONTROL_KEY_BITS) {
+		return CONTROL_KEY_BITS;
+	}
+	else {
+		return ALT_KEY_BITS;
+	}
+}
+
+unsigned char ModifierTracker::Update(int virtualKey, bool down) {
+	unsigned int keyBit = GetModifierKeyBit(virtualKey);
+
+	if (keyBit != 0) {
+		if (down) {
+			m_KeysDown |= keyBit;
+		}
+		else {
+			unsigned int groupBits = GetModifierGroupBits(keyBit);
+
+			/* The generic key doesn't say which side went up, and a sided key
+			 * may have gone down as the generic one, so release conservatively */
+			if (keyBit & GENERIC_KEY_BITS) {
+				m_KeysDown &= ~groupBits;
+			}
+			else {
+				m_KeysDown &= ~(keyBit | (groupBits & GENERIC_KEY_BITS));
+			}
+		}
+	}
+
+	return GetModifiers();
+}
+
+unsigned char ModifierTracker::GetModifiers(void) {
+	unsigned int keysDown = m_KeysDown;
+	unsigned char modifiers = 0;
+
+	if (keysDown & SHIFT_KEY_BITS) {
+		modifiers |= MODIFIER_SHIFT;
+	}
+	if (keysDown & CONTROL_KEY_BITS) {
+		modifiers |= MODIFIER_CTRL;
+	}
+	if (keysDown & ALT_KEY_BITS) {
+		modifiers |= MODIFIER_ALT;
+	}
+
+	return modifiers;
+}
+
+void ModifierTracker::Reset(void) {
+	m_KeysDown = 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+
+namespace Moonlight_common_binding
+{
+	/* Translates a Windows virtual key to the key code the host expects,
+	 * or returns 0 if the key isn't supported. This is a single lookup
+	 * in a table built at compile time. */
+	short TranslateVirtualKey(int virtualKey);
+
+	/* Follows the Shift, Ctrl and Alt keys through the key events passed
+	 * to it, so the modifier flags for a keystroke don't need a query to
+	 * the OS. Left and right keys are tracked separately so releasing one
+	 * doesn't clear a modifier the other is still holding. */
+	class ModifierTracker
+	{
+	public:
+		ModifierTracker() : m_KeysDown(0) {}
+
+		/* Returns the modifier flags in effect after the key event */
+		unsigned char Update(int virtualKey, bool down);
+		unsigned char GetModifiers(void);
+
+		/* Forgets all held keys, for when key up events may have been missed */
+		void Reset(void);
+
+	private:
+		std::atomic<unsigned int> m_KeysDown;
+	};
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+
+/* Bucket i counts samples below 2^i microseconds that didn't fit in bucket i-1.
+ * The last bucket also takes everything longer. */
+#define LATENCY_HISTOGRAM_BUCKETS 24
+
+namespace Moonlight_common_binding
+{
+	/* Power-of-two latency histogram. Recording is a few instructions and a
+	 * relaxed increment, so it can sit on a hot path. */
+	class LatencyHistogram
+	{
+	public:
+		LatencyHistogram() {
+			Reset();
+		}
+
+		void Record(long long latencyUs) {
+			int bucket = 0;
+
+			while (bucket < LATENCY_HISTOGRAM_BUCKETS - 1 && latencyUs >= (1LL << bucket)) {
+				bucket++;
+			}
+
+			m_Buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void Reset(void) {
+			for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+				m_Buckets[i].store(0, std::memory_order_relaxed);
+			}
+		}
+
+		long long GetBucketCount(int bucket) {
+			return m_Buckets[bucket].load(std::memory_order_relaxed);
+		}
+
+		/* Upper bound of the bucket holding the given percentile, or 0 if
+		 * nothing has been recorded */
+		long long GetPercentileUs(int percent) {
+			long long counts[LATENCY_HISTOGRAM_BUCKETS];
+			long long total = 0;
+			long long target;
+
+			for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+				counts[i] = GetBucketCount(i);
+				total += counts[i];
+			}
+
+			if (total == 0) {
+				return 0;
+			}
+
+			target = (total * percent + 99) / 100;
+			for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+				target -= counts[i];
+				if (target <= 0) {
+					return 1LL << i;
+				}
+			}
+
+			return 1LL << (LATENCY_HISTOGRAM_BUCKETS - 1);
+		}
+
+	private:
+		std::atomic<long long> m_Buckets[LATENCY_HISTOGRAM_BUCKETS];
+	};
+}
@@ -0,0 +1,97 @@
+/* Annex B to length-prefixed conversion during frame assembly */
+#include "LengthPrefixWriter.hpp"
+
+#include <string.h>
+
+using namespace Moonlight_common_binding;
+
+void LengthPrefixWriter::Begin(unsigned char *output) {
+	m_Output = output;
+	m_Position = 0;
+	m_NalStart = -1;
+	m_ZeroRun = 0;
+}
+
+void LengthPrefixWriter::Append(const unsigned char *data, int length) {
+	int offset = 0;
+	int zeros = 0;
+	int startCode;
+	int startCodeLength;
+
+	/* A start code whose zeros ended the last fragment. Ones with at least
+	 * two zeros in this fragment are found by the scan below. */
+	while (zeros < length && zeros < 2 && data[zeros] == 0) {
+		zeros++;
+	}
+	if (zeros < 2 && zeros < length && data[zeros] == 1 && m_ZeroRun + zeros >= 2) {
+		Copy(data, zeros);
+		StartNalUnit();
+		offset = zeros + 1;
+	}
+
+	for (;;) {
+		startCode = FindStartCode(data, length, offset, startCodeLength);
+		Copy(data + offset, startCode - offset);
+		if (startCode == length) {
+			break;
+		}
+
+		StartNalUnit();
+		offset = startCode + startCodeLength;
+	}
+}
+
+int LengthPrefixWriter::Finish(void) {
+	if (m_NalStart < 0) {
+		return 0;
+	}
+
+	if (!FinishNalUnit()) {
+		return m_NalStart;
+	}
+	return m_Position;
+}
+
+void LengthPrefixWriter::Copy(const unsigned char *data, int length) {
+	int nonZeroEnd = length;
+
+	if (length == 0) {
+		return;
+	}
+
+	memcpy(&m_Output[m_Position], data, length);
+	m_Position += length;
+
+	while (nonZeroEnd > 0 && data[nonZeroEnd - 1] == 0) {
+		nonZeroEnd--;
+	}
+	m_ZeroRun = nonZeroEnd == 0 ? m_ZeroRun + length : length - nonZeroEnd;
+}
+
+void LengthPrefixWriter::StartNalUnit(void) {
+	if (m_NalStart < 0) {
+		/* Nothing before the first start code belongs to a NAL unit */
+		m_Position = 0;
+	}
+	else if (!FinishNalUnit()) {
+		/* Reuse the prefix of an empty NAL unit */
+		m_Position = m_NalStart;
+	}
+
+	m_NalStart = m_Position;
+	m_Position += NAL_LENGTH_PREFIX_SIZE;
+	m_ZeroRun = 0;
+}
+
+bool LengthPrefixWriter::FinishNalUnit(void) {
+	/* The zeros are trailing_zero_8bits or the first byte of a 4 byte
+	 * start code, not part of the NAL unit */
+	m_Position -= m_ZeroRun;
+	m_ZeroRun = 0;
+	if (m_Position == m_NalStart + NAL_LENGTH_PREFIX_SIZE) {
+		return false;
+	}
+
+	WriteNalLengthPrefix(&m_Output[m_NalStart], m_Position - m_NalStart - NAL_LENGTH_PREFIX_SIZE);
+	return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "NalParser.hpp"
+
+namespace Moonlight_common_binding
+{
+	/* The most a frame of annexBLength bytes can grow by when converted.
+	 * Each start code is at least 3 bytes and becomes a 4 byte prefix. */
+	inline int GetLengthPrefixedBound(int annexBLength) {
+		return annexBLength + annexBLength / 3 + NAL_LENGTH_PREFIX_SIZE;
+	}
+
+	/* Assembles an Annex B frame from its fragments straight into AVCC or
+	 * HVCC form, replacing each start code with a 4 byte big-endian length.
+	 * Each fragment is scanned for start codes and the data between them is
+	 * copied directly to its final place, so nothing is moved afterwards.
+	 * Start codes split across fragments are recognized, and the extra zero
+	 * of a 4 byte start code, along with any trailing zeros of the NAL unit
+	 * before it, is dropped. */
+	class LengthPrefixWriter
+	{
+	public:
+		/* The output needs room for GetLengthPrefixedBound() bytes */
+		void Begin(unsigned char *output);
+		void Append(const unsigned char *data, int length);
+
+		/* Returns the length of the converted frame */
+		int Finish(void);
+
+	private:
+		void Copy(const unsigned char *data, int length);
+		void StartNalUnit(void);
+
+		/* Returns false if the NAL unit turned out to be empty */
+		bool FinishNalUnit(void);
+
+		unsigned char *m_Output;
+		int m_Position;
+
+		/* Where the current NAL unit's length prefix is, or -1 before the
+		 * first start code */
+		int m_NalStart;
+
+		/* Zeros at the end of the output that may belong to a start code */
+		int m_ZeroRun;
+	};
+}
@@ -0,0 +1,271 @@
+/* Link measurement before connecting */
+#include "LinkProbe.hpp"
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <string.h>
+
+/* Marks our datagrams, so anything else arriving on the socket is ignored */
+#define LINK_PROBE_MAGIC 0x4D4C5042
+
+/* Echoes pile up while the burst is still being sent */
+#define LINK_PROBE_RECEIVE_BUFFER_SIZE (1024 * 1024)
+
+using namespace Moonlight_common_binding;
+
+struct LinkProbeHeader
+{
+	unsigned int magic;
+	unsigned int sequence;
+	LONGLONG sendTime;
+};
+
+struct BurstCounters
+{
+	int received;
+	long long bytesReceived;
+	LONGLONG firstReceive;
+	LONGLONG lastReceive;
+};
+
+static LONGLONG GetQpcTime(void) {
+	LARGE_INTEGER now;
+
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+static int SendProbe(SOCKET sock, char *buffer, int length, unsigned int sequence) {
+	LinkProbeHeader header;
+
+	header.magic = LINK_PROBE_MAGIC;
+	header.sequence = sequence;
+	header.sendTime = GetQpcTime();
+	memcpy(buffer, &header, sizeof(header));
+
+	return send(sock, buffer, length, 0) == SOCKET_ERROR ? WSAGetLastError() : 0;
+}
+
+/* Waits until the deadline for one of our datagrams to come back. Anything
+ * already queued is returned even if the deadline has passed. */
+static bool ReceiveProbe(SOCKET sock, char *buffer, LONGLONG deadline, LONGLONG frequency,
+	LinkProbeHeader &header, int &length, LONGLONG &receiveTime)
+{
+	struct timeval timeout;
+	fd_set readFds;
+	LONGLONG remainingUs;
+	LONGLONG now;
+
+	for (;;) {
+		now = GetQpcTime();
+		remainingUs = deadline > now ? (deadline - now) * 1000000 / frequency : 0;
+
+		FD_ZERO(&readFds);
+		FD_SET(sock, &readFds);
+		timeout.tv_sec = (long)(remainingUs / 1000000);
+		timeout.tv_usec = (long)(remainingUs % 1000000);
+		if (select(0, &readFds, NULL, NULL, &timeout) <= 0) {
+			return false;
+		}
+
+		/* This fails if the host said nothing listens on the port */
+		length = recv(sock, buffer, LINK_PROBE_BURST_PACKET_SIZE, 0);
+		receiveTime = GetQpcTime();
+		if (length == SOCKET_ERROR) {
+			return false;
+		}
+
+		if (length >= (int)sizeof(header)) {
+			memcpy(&header, buffer, sizeof(header));
+			if (header.magic == LINK_PROBE_MAGIC) {
+				return true;
+			}
+		}
+	}
+}
+
+static bool MeasureRtt(SOCKET sock, char *buffer, LONGLONG frequency, LinkProbeResult &result) {
+	LinkProbeHeader header;
+	LONGLONG receiveTime;
+	LONGLONG deadline;
+	LONGLONG rtt;
+	LONGLONG minRtt = -1;
+	LONGLONG previousRtt = -1;
+	LONGLONG rttChangeSum = 0;
+	int rttChanges = 0;
+	int length;
+
+	for (unsigned int i = 0; i < LINK_PROBE_PING_COUNT; i++) {
+		if (SendProbe(sock, buffer, LINK_PROBE_PING_SIZE, i) != 0) {
+			return false;
+		}
+
+		deadline = GetQpcTime() + frequency * LINK_PROBE_PING_TIMEOUT_MS / 1000;
+		while (ReceiveProbe(sock, buffer, deadline, frequency, header, length, receiveTime)) {
+			/* Late replies to earlier pings don't count */
+			if (header.sequence != i) {
+				continue;
+			}
+
+			rtt = receiveTime - header.sendTime;
+			if (minRtt < 0 || rtt < minRtt) {
+				minRtt = rtt;
+			}
+			if (previousRtt >= 0) {
+				rttChangeSum += rtt > previousRtt ? rtt - previousRtt : previousRtt - rtt;
+				rttChanges++;
+			}
+			previousRtt = rtt;
+			break;
+		}
+
+		if (minRtt < 0 && i + 1 >= LINK_PROBE_GIVE_UP_PINGS) {
+			return false;
+		}
+	}
+
+	if (minRtt < 0) {
+		return false;
+	}
+
+	result.rttUs = (int)(minRtt * 1000000 / frequency);
+	result.jitterUs = rttChanges != 0 ? (int)(rttChangeSum * 1000000 / frequency / rttChanges) : 0;
+	return true;
+}
+
+static void RecordEcho(const LinkProbeHeader &header, int length, LONGLONG receiveTime, BurstCounters &counters) {
+	if (header.sequence < LINK_PROBE_PING_COUNT) {
+		return;
+	}
+
+	/* The first echo only starts the clock */
+	if (counters.received == 0) {
+		counters.firstReceive = receiveTime;
+	}
+	else {
+		counters.bytesReceived += length;
+	}
+	counters.received++;
+	counters.lastReceive = receiveTime;
+}
+
+static bool MeasureThroughput(SOCKET sock, char *buffer, LONGLONG frequency, int rateKbps, LinkProbeResult &result) {
+	BurstCounters counters = {};
+	LinkProbeHeader header;
+	LONGLONG receiveTime;
+	LONGLONG deadline;
+	LONGLONG interval;
+	LONGLONG start;
+	int packets;
+	int sent = 0;
+	int length;
+
+	packets = (int)((long long)rateKbps * 1000 / 8 * LINK_PROBE_BURST_MS / 1000 / LINK_PROBE_BURST_PACKET_SIZE);
+	if (packets < 2) {
+		packets = 2;
+	}
+	interval = frequency * LINK_PROBE_BURST_MS / 1000 / packets;
+	result.burstRateKbps = rateKbps;
+
+	start = GetQpcTime();
+	while (sent < packets) {
+		/* Send whatever is due, catching up if the wait overslept */
+		while (sent < packets && GetQpcTime() >= start + sent * interval) {
+			if (SendProbe(sock, buffer, LINK_PROBE_BURST_PACKET_SIZE, LINK_PROBE_PING_COUNT + sent) != 0) {
+				return false;
+			}
+			sent++;
+		}
+
+		/* Collect echoes until the next one is due */
+		deadline = start + sent * interval;
+		while (ReceiveProbe(sock, buffer, deadline, frequency, header, length, receiveTime)) {
+			RecordEcho(header, length, receiveTime, counters);
+		}
+	}
+
+	deadline = GetQpcTime() + frequency * LINK_PROBE_DRAIN_MS / 1000;
+	while (ReceiveProbe(sock, buffer, deadline, frequency, header, length, receiveTime)) {
+		RecordEcho(header, length, receiveTime, counters);
+	}
+
+	/* An echo service that drops or throttles datagrams this big would
+	 * otherwise look like a link with no throughput at all */
+	if (counters.received < 2 || counters.lastReceive <= counters.firstReceive) {
+		return false;
+	}
+
+	result.throughputKbps = (int)(counters.bytesReceived * 8 * frequency /
+		(counters.lastReceive - counters.firstReceive) / 1000);
+	result.lossPercent = (sent - counters.received) * 100 / sent;
+	return true;
+}
+
+bool Moonlight_common_binding::ProbeLink(const char *host, int port, int maxBitrateKbps, LinkProbeResult &result) {
+	struct addrinfo hints;
+	struct addrinfo *address;
+	char buffer[LINK_PROBE_BURST_PACKET_SIZE];
+	LARGE_INTEGER frequency;
+	WSADATA wsaData;
+	SOCKET sock;
+	int receiveBufferSize = LINK_PROBE_RECEIVE_BUFFER_SIZE;
+	bool ok;
+
+	ZeroMemory(&result, sizeof(result));
+	QueryPerformanceFrequency(&frequency);
+
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+		return false;
+	}
+
+	ZeroMemory(&hints, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_protocol = IPPROTO_UDP;
+	if (getaddrinfo(host, NULL, &hints, &address) != 0) {
+		WSACleanup();
+		return false;
+	}
+	((struct sockaddr_in*)address->ai_addr)->sin_port = htons((u_short)port);
+
+	sock = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+	if (sock == INVALID_SOCKET) {
+		freeaddrinfo(address);
+		WSACleanup();
+		return false;
+	}
+
+	setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char*)&receiveBufferSize, sizeof(receiveBufferSize));
+	ok = connect(sock, address->ai_addr, (int)address->ai_addrlen) != SOCKET_ERROR;
+	freeaddrinfo(address);
+
+	ZeroMemory(buffer, sizeof(buffer));
+	ok = ok && MeasureRtt(sock, buffer, frequency.QuadPart, result) &&
+		MeasureThroughput(sock, buffer, frequency.QuadPart,
+			maxBitrateKbps * LINK_PROBE_BURST_HEADROOM_PERCENT / 100, result);
+
+	closesocket(sock);
+	WSACleanup();
+
+	return ok;
+}
+
+StreamMode Moonlight_common_binding::SuggestStreamMode(const LinkProbeResult &result, const StreamMode &maxMode) {
+	BitrateController controller;
+	StreamMode mode = maxMode;
+	int usableKbps;
+
+	/* The pacer would have to hold frames back that long anyway */
+	if (mode.fps > LINK_PROBE_FALLBACK_FPS &&
+		(long long)result.jitterUs * mode.fps * 100 > 1000000LL * LINK_PROBE_MAX_JITTER_PERCENT_OF_FRAME) {
+		mode.fps = LINK_PROBE_FALLBACK_FPS;
+	}
+
+	usableKbps = (int)((long long)result.throughputKbps * LINK_PROBE_USABLE_PERCENT / 100);
+	if ((long long)result.throughputKbps * 100 >= (long long)result.burstRateKbps * LINK_PROBE_SATURATED_PERCENT) {
+		usableKbps = usableKbps * (100 - result.lossPercent) / 100;
+	}
+
+	controller.Reset(mode, LINK_PROBE_MIN_BITRATE_KBPS, maxMode.bitrateKbps);
+	return controller.GetModeForBitrate(usableKbps);
+}
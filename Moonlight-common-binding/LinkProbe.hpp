@@ -0,0 +1,62 @@
+#pragma once
+#include "BitrateController.hpp"
+
+/* RTT is measured with this many small probes, each given this long to
+ * come back */
+#define LINK_PROBE_PING_COUNT 10
+#define LINK_PROBE_PING_SIZE 64
+#define LINK_PROBE_PING_TIMEOUT_MS 200
+
+/* Give up if none of the first this many pings came back, since most
+ * hosts won't have an echo service */
+#define LINK_PROBE_GIVE_UP_PINGS 3
+
+/* Throughput is measured with a burst this long, paced at the highest
+ * bitrate we'd stream at plus some headroom so the link can show it
+ * carries more */
+#define LINK_PROBE_BURST_MS 500
+#define LINK_PROBE_BURST_PACKET_SIZE 1024
+#define LINK_PROBE_BURST_HEADROOM_PERCENT 150
+
+/* How long to wait for stragglers once the burst has been sent */
+#define LINK_PROBE_DRAIN_MS 300
+
+/* The share of the measured throughput a stream is given, since the probe
+ * only sees a moment of the link and the echo shares it both ways */
+#define LINK_PROBE_USABLE_PERCENT 75
+
+/* A link that carried less than this share of the burst's rate was full,
+ * so its loss was the burst overflowing a queue rather than the link
+ * losing packets */
+#define LINK_PROBE_SATURATED_PERCENT 90
+
+/* Above this frame rate, jitter of more than this share of a frame
+ * interval means streaming at the fallback rate instead */
+#define LINK_PROBE_FALLBACK_FPS 30
+#define LINK_PROBE_MAX_JITTER_PERCENT_OF_FRAME 50
+
+#define LINK_PROBE_MIN_BITRATE_KBPS 1000
+
+namespace Moonlight_common_binding
+{
+	struct LinkProbeResult
+	{
+		int rttUs;
+		int jitterUs;
+		int throughputKbps;
+		int lossPercent;
+		int burstRateKbps;
+	};
+
+	/* Measures the link to a UDP echo service (RFC 862) at host:port, which
+	 * bounces every datagram back as it is. The RTT is the lowest over the
+	 * pings, and the jitter is the mean change in RTT between them. Throughput
+	 * is what came back of a burst paced at maxBitrateKbps plus headroom,
+	 * so it's limited by both directions. Returns false if nothing answered,
+	 * or if too little of the burst came back to measure. Blocks for about
+	 * a second. */
+	bool ProbeLink(const char *host, int port, int maxBitrateKbps, LinkProbeResult &result);
+
+	/* The best mode at or below maxMode that the measured link can carry */
+	StreamMode SuggestStreamMode(const LinkProbeResult &result, const StreamMode &maxMode);
+}
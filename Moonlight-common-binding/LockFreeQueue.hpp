@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CACHE_LINE_SIZE 64
+
+namespace Moonlight_common_binding
+{
+	/* Bounded multi-producer multi-consumer queue with a fixed number of
+	 * preallocated slots. Each slot carries a sequence number that says
+	 * whether it is ready to be written or read, so neither side ever
+	 * takes a lock or allocates. Enqueue fails instead of waiting when
+	 * the queue is full. */
+	template <typename T, size_t Capacity>
+	class LockFreeQueue
+	{
+		static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+
+	public:
+		LockFreeQueue() : m_EnqueuePos(0), m_DequeuePos(0) {
+			for (size_t i = 0; i < Capacity; i++) {
+				m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		bool TryEnqueue(const T &data) {
+			Cell *cell;
+			size_t pos = m_EnqueuePos.load(std::memory_order_relaxed);
+
+			for (;;) {
+				cell = &m_Cells[pos & (Capacity - 1)];
+				size_t sequence = cell->sequence.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+				if (diff == 0) {
+					if (m_EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				}
+				else if (diff < 0) {
+					/* Full */
+					return false;
+				}
+				else {
+					pos = m_EnqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+
+			cell->data = data;
+			cell->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		bool TryDequeue(T &data) {
+			Cell *cell;
+			size_t pos = m_DequeuePos.load(std::memory_order_relaxed);
+
+			for (;;) {
+				cell = &m_Cells[pos & (Capacity - 1)];
+				size_t sequence = cell->sequence.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+
+				if (diff == 0) {
+					if (m_DequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				}
+				else if (diff < 0) {
+					/* Empty */
+					return false;
+				}
+				else {
+					pos = m_DequeuePos.load(std::memory_order_relaxed);
+				}
+			}
+
+			data = cell->data;
+			cell->sequence.store(pos + Capacity, std::memory_order_release);
+			return true;
+		}
+
+		/* Approximate number of queued elements. Only exact when
+		 * no other thread is touching the queue. */
+		size_t GetDepth(void) {
+			size_t enqueuePos = m_EnqueuePos.load(std::memory_order_relaxed);
+			size_t dequeuePos = m_DequeuePos.load(std::memory_order_relaxed);
+
+			return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+		}
+
+		size_t GetCapacity(void) {
+			return Capacity;
+		}
+
+	private:
+		struct Cell
+		{
+			std::atomic<size_t> sequence;
+			T data;
+		};
+
+		/* Keep the producer and consumer positions on separate cache lines */
+		char m_Pad0[CACHE_LINE_SIZE];
+		Cell m_Cells[Capacity];
+		char m_Pad1[CACHE_LINE_SIZE];
+		std::atomic<size_t> m_EnqueuePos;
+		char m_Pad2[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+		std::atomic<size_t> m_DequeuePos;
+		char m_Pad3[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+	};
+}
@@ -1,5 +1,13 @@
 ﻿/* Binding between the main Moonlight app and Common */
 #include "Moonlight-common-binding.hpp"
+#include "StreamSession.hpp"
+#include "NativeRenderer.hpp"
+#include "InputSender.hpp"
+#include "GamepadPoller.hpp"
+#include "KeyboardTranslator.hpp"
+#include "PathMtuProbe.hpp"
+#include "LinkProbe.hpp"
+#include "FlightRecorder.hpp"
 
 #include <stdlib.h>
 #include <string.h>
@@ -7,8 +15,9 @@
 #include <winerror.h> 
 #include <Objbase.h> 
 #include <string>
-
-#include <opus.h>
+#include <memory>
+#include <atomic>
+#include <mutex>
 
 // Tell the linker to link using these libraries
 #pragma comment(lib, "ws2_32.lib")
@@ -16,120 +25,70 @@
 #pragma comment(lib, "celt.lib")
 #pragma comment(lib, "silk_common.lib")
 #pragma comment(lib, "silk_float.lib")
-
-static OpusDecoder *s_OpusDecoder;
+#pragma comment(lib, "xinputuap.lib")
+#pragma comment(lib, "dxgi.lib")
 
 using namespace Moonlight_common_binding;
 using namespace Platform;
 
-static MoonlightDecoderRenderer ^s_DrCallbacks;
-static MoonlightAudioRenderer ^s_ArCallbacks;
-static MoonlightConnectionListener ^s_ClCallbacks;
+/* Common only supports one connection per process, so there is
+ * at most one session at a time. */
+static std::shared_ptr<StreamSession> s_Session;
+static std::mutex s_SessionLock;
 
-#define INITIAL_FRAME_BUFFER_SIZE 1048576
-static int s_FrameBufferSize;
-static char* s_FrameBuffer;
+/* Input isn't tied to a session since Common's input functions are global */
+static InputSender s_InputSender;
+static GamepadPoller s_GamepadPoller(&s_InputSender);
+static XInputControllerSource s_XInputSource;
+static ModifierTracker s_ModifierTracker;
+static InputTraceReplayer s_InputReplayer(&s_InputSender);
 
-/* Each of these methods call into the appropriate Moonlight Common method */
-void DrShimSetup(int width, int height, int redrawRate, void* context, int drFlags) {
-	s_DrCallbacks->Setup(width, height, redrawRate, drFlags);
-}
-void DrShimCleanup(void) {
-	free(s_FrameBuffer);
-	s_FrameBufferSize = 0;
-	s_DrCallbacks->Cleanup();
-}
-int DrShimSubmitDecodeUnit(PDECODE_UNIT decodeUnit) {
-	PLENTRY entry;
-	int offset = 0;
+/* Applied to each new session when its video pipeline is set up */
+static std::atomic<FramePacingMode> s_FramePacingMode(FramePacingMode::Off);
+static std::atomic<BitstreamFormat> s_BitstreamFormat(BitstreamFormat::AnnexB);
 
-	/* Resize the frame buffer if the current frame is too big.
-	 * This is safe without locking because this function is
-	 * called only from a single thread. */
-	if (s_FrameBufferSize < decodeUnit->fullLength) {
-		s_FrameBufferSize = decodeUnit->fullLength;
-		s_FrameBuffer = (char*) malloc(s_FrameBufferSize);
-	}
+/* Outlives sessions so each connection's packet size can learn from the
+ * ones before it */
+static PacketizationStatistics s_Packetization;
 
-	if (s_FrameBuffer == NULL) {
-        s_FrameBufferSize = 0;
-		return DR_NEED_IDR;
-	}
+/* Installs a new session, stopping the previous one first since Common
+ * can only run one connection at a time, and starts it. */
+static int StartSession(std::shared_ptr<StreamSession> session) {
+	std::shared_ptr<StreamSession> previousSession;
 
-	entry = decodeUnit->bufferList;
-	while (entry != NULL)
 	{
-		memcpy(&s_FrameBuffer[offset], entry->data, entry->length);
-		offset += entry->length;
-		entry = entry->next;
+		std::lock_guard<std::mutex> lock(s_SessionLock);
+		previousSession = s_Session;
+		s_Session = session;
 	}
 
-	return s_DrCallbacks->SubmitDecodeUnit(Platform::ArrayReference<byte>((byte*)s_FrameBuffer, decodeUnit->fullLength));
-}
-
-#define MAX_OUTPUT_SHORTS_PER_CHANNEL 240
-#define CHANNEL_COUNT 2
-#define SAMPLE_RATE_HZ 48000
-
-void ArShimInit(void) {
-	int err;
-
-	s_OpusDecoder = opus_decoder_create(SAMPLE_RATE_HZ,
-		CHANNEL_COUNT,
-		&err);
-
-	s_ArCallbacks->Init();
-}
-void ArShimCleanup(void) {
-	if (s_OpusDecoder != NULL) {
-		opus_decoder_destroy(s_OpusDecoder);
-		s_OpusDecoder = NULL;
+	if (previousSession != nullptr) {
+		previousSession->Stop();
 	}
 
-	s_ArCallbacks->Cleanup();
-}
-void ArShimDecodeAndPlaySample(char* sampleData, int sampleLength) {
-	opus_int16 decodedBuffer[MAX_OUTPUT_SHORTS_PER_CHANNEL * CHANNEL_COUNT];
-	int decodedSamples;
-		
-	decodedSamples = opus_decode(s_OpusDecoder, (const unsigned char*)sampleData, sampleLength,
-		decodedBuffer, MAX_OUTPUT_SHORTS_PER_CHANNEL, 0);
-	if (decodedSamples > 0) {
-		s_ArCallbacks->PlaySample(Platform::ArrayReference<byte>((byte*)decodedBuffer,
-			decodedSamples * CHANNEL_COUNT * sizeof(opus_int16)));
-	}
+	s_ModifierTracker.Reset();
+	s_InputSender.Start();
+	session->SetFramePacingMode(s_FramePacingMode);
+	session->SetBitstreamFormat(s_BitstreamFormat);
+	session->SetPacketizationStatistics(&s_Packetization);
+	return session->Start();
 }
 
-void ClShimStageStarting(int stage) {
-	s_ClCallbacks->StageStarting(stage);
-}
-void ClShimStageComplete(int stage) {
-	s_ClCallbacks->StageComplete(stage);
-}
-void ClShimStageFailed(int stage, long errorCode) {
-	s_ClCallbacks->StageFailed(stage, errorCode);
-}
-void ClShimConnectionStarted(void) {
-	s_ClCallbacks->ConnectionStarted();
-}
-void ClShimConnectionTerminated(long errorCode) {
-	s_ClCallbacks->ConnectionTerminated(errorCode);
+/* Returns the current session, if any. The reference keeps it alive
+ * even if StopConnection runs concurrently. */
+static std::shared_ptr<StreamSession> GetSession(void) {
+	std::lock_guard<std::mutex> lock(s_SessionLock);
+	return s_Session;
 }
-void ClShimDisplayMessage(char *message) {
-	std::string stdStr = std::string(message);
-	std::wstring wStr = std::wstring(stdStr.begin(), stdStr.end());
-	const wchar_t* wChar = wStr.c_str();
-	Platform::String^ messageString = ref new Platform::String(wChar);
 
-	s_ClCallbacks->DisplayMessage(messageString); 
-}
-void ClShimDisplayTransientMessage(char *message) {
-	std::string stdStr = std::string(message);
-	std::wstring wStr = std::wstring(stdStr.begin(), stdStr.end());
-	const wchar_t* wChar = wStr.c_str();
-	Platform::String^ messageString = ref new Platform::String(wChar);
-
-	s_ClCallbacks->DisplayTransientMessage(messageString);
+int Moonlight_common_binding::StartNativeConnection(const std::string &host, const STREAM_CONFIGURATION &config,
+	int serverMajorVersion, MoonlightConnectionListener ^clCallbacks, IVideoRenderer *videoRenderer,
+	IAudioRenderer *audioRenderer, VideoCodec codec)
+{
+	std::shared_ptr<StreamSession> session = std::make_shared<StreamSession>(host, config, serverMajorVersion,
+		clCallbacks, videoRenderer, audioRenderer);
+	session->SetVideoCodec(codec);
+	return StartSession(session);
 }
 
 int MoonlightCommonRuntimeComponent::StartConnection(Platform::String^ host, MoonlightStreamConfiguration ^streamConfig,
@@ -137,9 +96,6 @@ int MoonlightCommonRuntimeComponent::StartConnection(Platform::String^ host, Moo
 	int serverMajorVersion)
 {
 	STREAM_CONFIGURATION config;
-	DECODER_RENDERER_CALLBACKS drShimCallbacks;
-	AUDIO_RENDERER_CALLBACKS arShimCallbacks;
-	CONNECTION_LISTENER_CALLBACKS clShimCallbacks;
 
     LiInitializeStreamConfiguration(&config);
 	config.width = streamConfig->GetWidth();
@@ -150,62 +106,515 @@ int MoonlightCommonRuntimeComponent::StartConnection(Platform::String^ host, Moo
 
 	memcpy(config.remoteInputAesKey, streamConfig->GetRiAesKey()->Data, sizeof(config.remoteInputAesKey));
 	memcpy(config.remoteInputAesIv, streamConfig->GetRiAesIv()->Data, sizeof(config.remoteInputAesIv));
-	
-	s_ClCallbacks = clCallbacks;
-	s_DrCallbacks = drCallbacks;
-	s_ArCallbacks = arCallbacks;
-
-    LiInitializeVideoCallbacks(&drShimCallbacks);
-	drShimCallbacks.setup = DrShimSetup;
-	drShimCallbacks.cleanup = DrShimCleanup;
-	drShimCallbacks.submitDecodeUnit = DrShimSubmitDecodeUnit;
-
-    LiInitializeAudioCallbacks(&arShimCallbacks);
-	arShimCallbacks.init = ArShimInit;
-	arShimCallbacks.cleanup = ArShimCleanup;
-	arShimCallbacks.decodeAndPlaySample = ArShimDecodeAndPlaySample;
-
-    LiInitializeConnectionCallbacks(&clShimCallbacks);
-	clShimCallbacks.stageStarting = ClShimStageStarting;
-	clShimCallbacks.stageComplete = ClShimStageComplete;
-	clShimCallbacks.stageFailed = ClShimStageFailed;
-	clShimCallbacks.connectionStarted = ClShimConnectionStarted;
-	clShimCallbacks.connectionTerminated = ClShimConnectionTerminated;
-	clShimCallbacks.displayMessage = ClShimDisplayMessage;
-	clShimCallbacks.displayTransientMessage = ClShimDisplayTransientMessage;
 
 	std::wstring hostW(host->Begin());
 	std::string hostA(hostW.begin(), hostW.end());
-	return LiStartConnection(hostA.c_str(), &config, &clShimCallbacks,
-		&drShimCallbacks, &arShimCallbacks, NULL, 0, serverMajorVersion);
+
+	std::shared_ptr<StreamSession> session = std::make_shared<StreamSession>(hostA, config, serverMajorVersion,
+		clCallbacks, drCallbacks, arCallbacks);
+	session->SetVideoCodec(streamConfig->GetCodec());
+	return StartSession(session);
 }
 
 void MoonlightCommonRuntimeComponent::StopConnection(void) {
-	LiStopConnection();
+	std::shared_ptr<StreamSession> session;
+
+	{
+		std::lock_guard<std::mutex> lock(s_SessionLock);
+		session = s_Session;
+		s_Session = nullptr;
+	}
+
+	/* Stop sending before the input stream goes away */
+	s_GamepadPoller.Stop();
+	s_InputReplayer.Stop();
+	s_InputSender.Stop();
+
+	if (session != nullptr) {
+		session->Stop();
+	}
+	else {
+		LiStopConnection();
+	}
+}
+
+void MoonlightCommonRuntimeComponent::EnableAutoReconnect(ClResumeSession ^resumeSession, int maxAttempts) {
+	std::shared_ptr<StreamSession> session = GetSession();
+
+	if (session != nullptr) {
+		session->EnableAutoReconnect(resumeSession, maxAttempts);
+	}
+}
+
+void MoonlightCommonRuntimeComponent::DisableAutoReconnect(void) {
+	std::shared_ptr<StreamSession> session = GetSession();
+
+	if (session != nullptr) {
+		session->DisableAutoReconnect();
+	}
+}
+
+void MoonlightCommonRuntimeComponent::EnableAdaptiveBitrate(int minBitrateKbps, int maxBitrateKbps) {
+	std::shared_ptr<StreamSession> session = GetSession();
+
+	if (session != nullptr) {
+		session->EnableAdaptiveBitrate(minBitrateKbps, maxBitrateKbps);
+	}
+}
+
+void MoonlightCommonRuntimeComponent::DisableAdaptiveBitrate(void) {
+	std::shared_ptr<StreamSession> session = GetSession();
+
+	if (session != nullptr) {
+		session->DisableAdaptiveBitrate();
+	}
+}
+
+/* Called by the app once the frame that was passed to DrSubmitDecodeUnit
+ * with receiveTime is on screen */
+void MoonlightCommonRuntimeComponent::ReportVideoFramePresented(long long receiveTime) {
+	std::shared_ptr<StreamSession> session = GetSession();
+
+	if (session != nullptr) {
+		session->GetAvSync().OnVideoPresented(receiveTime);
+		session->GetFramePacer().OnFramePresented(receiveTime);
+	}
+}
+
+/* Called by the audio renderer with the duration of audio it has queued
+ * but not played yet, in 100 ns units */
+void MoonlightCommonRuntimeComponent::ReportAudioOutputLatency(long long latency) {
+	std::shared_ptr<StreamSession> session = GetSession();
+
+	if (session != nullptr) {
+		session->GetAvSync().SetAudioOutputLatency(latency);
+	}
+}
+
+/* Takes effect on the next connection */
+void MoonlightCommonRuntimeComponent::SetFramePacingMode(FramePacingMode mode) {
+	s_FramePacingMode = mode;
+}
+
+/* Takes effect on the next connection */
+void MoonlightCommonRuntimeComponent::SetBitstreamFormat(BitstreamFormat format) {
+	s_BitstreamFormat = format;
+}
+
+void MoonlightCommonRuntimeComponent::SetAvSyncTolerance(int toleranceMs) {
+	std::shared_ptr<StreamSession> session = GetSession();
+
+	if (session != nullptr) {
+		session->GetAvSync().SetTolerance(toleranceMs);
+	}
+}
+
+/* Input calls only queue the event; the sender thread does the actual
+ * send. They return 0 once the event is queued or -1 if the queue is full. */
+static int QueueInputEvent(InputEvent &event) {
+	return s_InputSender.Enqueue(event) ? 0 : -1;
 }
 
 int MoonlightCommonRuntimeComponent::SendMouseMoveEvent(short deltaX, short deltaY) {
-	return LiSendMouseMoveEvent(deltaX, deltaY);
+	InputEvent event;
+
+	event.type = InputMouseMove;
+	event.mouseMove.deltaX = deltaX;
+	event.mouseMove.deltaY = deltaY;
+	return QueueInputEvent(event);
 }
 
 int MoonlightCommonRuntimeComponent::SendMouseButtonEvent(unsigned char action, int button) {
-	return LiSendMouseButtonEvent(action, button);
+	InputEvent event;
+
+	event.type = InputMouseButton;
+	event.mouseButton.action = action;
+	event.mouseButton.button = button;
+	return QueueInputEvent(event);
 }
 
 int MoonlightCommonRuntimeComponent::SendKeyboardEvent(short keyCode, unsigned char keyAction, unsigned char modifiers) {
-	return LiSendKeyboardEvent(keyCode, keyAction, modifiers);
+	InputEvent event;
+
+	event.type = InputKeyboard;
+	event.keyboard.keyCode = keyCode;
+	event.keyboard.keyAction = keyAction;
+	event.keyboard.modifiers = modifiers;
+	return QueueInputEvent(event);
+}
+
+/* Translates the key and works out the modifiers from the keys seen so
+ * far, so the caller doesn't need to ask the OS for either. Returns -1 if
+ * the host has no code for the key. */
+int MoonlightCommonRuntimeComponent::SendVirtualKeyEvent(int virtualKey, unsigned char keyAction) {
+	unsigned char modifiers = s_ModifierTracker.Update(virtualKey, keyAction == KEY_ACTION_DOWN);
+	short keyCode = TranslateVirtualKey(virtualKey);
+
+	if (keyCode == 0) {
+		return -1;
+	}
+
+	return SendKeyboardEvent(keyCode, keyAction, modifiers);
+}
+
+unsigned char MoonlightCommonRuntimeComponent::GetKeyboardModifiers(void) {
+	return s_ModifierTracker.GetModifiers();
+}
+
+void MoonlightCommonRuntimeComponent::ResetKeyboardModifiers(void) {
+	s_ModifierTracker.Reset();
+}
+
+/* Scheduled events are held on the sender thread until they're due,
+ * so synthesized clicks and repeats never block the caller */
+static int ScheduleInputEvent(InputEvent &event, int delayMs) {
+	return s_InputSender.Schedule(event, delayMs) ? 0 : -1;
+}
+
+int MoonlightCommonRuntimeComponent::ScheduleMouseButtonEvent(unsigned char action, int button, int delayMs) {
+	InputEvent event;
+
+	event.type = InputMouseButton;
+	event.mouseButton.action = action;
+	event.mouseButton.button = button;
+	return ScheduleInputEvent(event, delayMs);
+}
+
+int MoonlightCommonRuntimeComponent::ScheduleKeyboardEvent(short keyCode, unsigned char keyAction, unsigned char modifiers, int delayMs) {
+	InputEvent event;
+
+	event.type = InputKeyboard;
+	event.keyboard.keyCode = keyCode;
+	event.keyboard.keyAction = keyAction;
+	event.keyboard.modifiers = modifiers;
+	return ScheduleInputEvent(event, delayMs);
+}
+
+/* Presses the button now and releases it after holdMs */
+int MoonlightCommonRuntimeComponent::SendMouseClick(int button, int holdMs) {
+	InputEvent event;
+
+	if (SendMouseButtonEvent(BUTTON_ACTION_PRESS, button) != 0) {
+		return -1;
+	}
+
+	if (ScheduleMouseButtonEvent(BUTTON_ACTION_RELEASE, button, holdMs) == 0) {
+		return 0;
+	}
+
+	/* A button left down on the host is worse than a short click, so the
+	 * release goes now, still queued behind the press */
+	event.type = InputMouseButton;
+	event.mouseButton.action = BUTTON_ACTION_RELEASE;
+	event.mouseButton.button = button;
+	return s_InputSender.EnqueueWhenRoom(event, CLICK_RELEASE_TIMEOUT_MS) ? 0 : -1;
 }
 
 int MoonlightCommonRuntimeComponent::SendControllerInput(short buttonFlags, byte leftTrigger, byte rightTrigger, short leftStickX,
 	short leftStickY, short rightStickX, short rightStickY) {
-	return LiSendControllerEvent(buttonFlags, leftTrigger, rightTrigger, leftStickX, leftStickY, rightStickX, rightStickY);
+	InputEvent event;
+
+	event.type = InputController;
+	event.controller.controllerNumber = 0;
+	event.controller.buttonFlags = buttonFlags;
+	event.controller.leftTrigger = leftTrigger;
+	event.controller.rightTrigger = rightTrigger;
+	event.controller.leftStickX = leftStickX;
+	event.controller.leftStickY = leftStickY;
+	event.controller.rightStickX = rightStickX;
+	event.controller.rightStickY = rightStickY;
+	return QueueInputEvent(event);
 }
 
 int MoonlightCommonRuntimeComponent::SendMultiControllerInput(short controllerNumber, short buttonFlags, byte leftTrigger, byte rightTrigger, short leftStickX,
 	short leftStickY, short rightStickX, short rightStickY) {
-	return LiSendMultiControllerEvent(controllerNumber, buttonFlags, leftTrigger, rightTrigger, leftStickX, leftStickY, rightStickX, rightStickY);
+	InputEvent event;
+
+	event.type = InputMultiController;
+	event.controller.controllerNumber = controllerNumber;
+	event.controller.buttonFlags = buttonFlags;
+	event.controller.leftTrigger = leftTrigger;
+	event.controller.rightTrigger = rightTrigger;
+	event.controller.leftStickX = leftStickX;
+	event.controller.leftStickY = leftStickY;
+	event.controller.rightStickX = rightStickX;
+	event.controller.rightStickY = rightStickY;
+	return QueueInputEvent(event);
+}
+
+/* Sends the state of several controllers in one burst rather than
+ * one queued event each */
+int MoonlightCommonRuntimeComponent::SendMultiControllerInputBatch(const Platform::Array<MoonlightControllerState^> ^states) {
+	InputEvent event;
+
+	event.type = InputMultiControllerBatch;
+	event.controllerBatch.count = 0;
+
+	for (unsigned int i = 0; i < states->Length; i++) {
+		ControllerState &state = event.controllerBatch.states[event.controllerBatch.count++];
+
+		state.controllerNumber = states[i]->GetControllerNumber();
+		state.buttonFlags = states[i]->GetButtonFlags();
+		state.leftTrigger = states[i]->GetLeftTrigger();
+		state.rightTrigger = states[i]->GetRightTrigger();
+		state.leftStickX = states[i]->GetLeftStickX();
+		state.leftStickY = states[i]->GetLeftStickY();
+		state.rightStickX = states[i]->GetRightStickX();
+		state.rightStickY = states[i]->GetRightStickY();
+
+		/* Flush when the batch fills up or we run out of states */
+		if (event.controllerBatch.count == MAX_GAMEPADS || i + 1 == states->Length) {
+			if (QueueInputEvent(event) != 0) {
+				return -1;
+			}
+
+			event.controllerBatch.count = 0;
+		}
+	}
+
+	return 0;
 }
 
 int MoonlightCommonRuntimeComponent::SendScrollEvent(short scrollClicks) {
-	return LiSendScrollEvent((signed char) scrollClicks);
+	InputEvent event;
+
+	event.type = InputScroll;
+	event.scroll.clicks = (signed char) scrollClicks;
+	return QueueInputEvent(event);
+}
+
+/* Takes raw wheel deltas, 120 to a click. The sender sums them over each
+ * flush interval and keeps the remainder, so small touchpad deltas
+ * aren't lost and a fast wheel doesn't flood the host. */
+int MoonlightCommonRuntimeComponent::SendScrollDelta(short wheelDelta) {
+	InputEvent event;
+
+	event.type = InputScrollDelta;
+	event.scrollDelta.delta = wheelDelta;
+	event.scrollDelta.horizontal = false;
+	event.scrollDelta.shiftHeld = false;
+	return QueueInputEvent(event);
+}
+
+/* Positive deltas scroll right. This only reaches the host while Shift is
+ * held, unless SetHorizontalScrollShiftEnabled was called. */
+int MoonlightCommonRuntimeComponent::SendHorizontalScrollDelta(short wheelDelta) {
+	InputEvent event;
+
+	event.type = InputScrollDelta;
+	event.scrollDelta.delta = wheelDelta;
+	event.scrollDelta.horizontal = true;
+	event.scrollDelta.shiftHeld = (s_ModifierTracker.GetModifiers() & MODIFIER_SHIFT) != 0;
+	return QueueInputEvent(event);
+}
+
+MoonlightInputMetrics^ MoonlightCommonRuntimeComponent::GetInputMetrics(void) {
+	return ref new MoonlightInputMetrics(s_InputSender.GetQueueDepth(), s_InputSender.GetEventsSent(),
+		s_InputSender.GetEventsDropped(), s_InputSender.GetAverageLatencyUs(), s_InputSender.GetMaxLatencyUs(),
+		s_InputSender.TakeMousePacketRate(), s_InputSender.GetMouseEventsCoalesced(), s_InputSender.GetAverageMouseDelayUs(),
+		s_InputSender.GetScrollEventsReceived(), s_InputSender.GetScrollPacketsSent());
+}
+
+void MoonlightCommonRuntimeComponent::ResetInputMaxLatency(void) {
+	s_InputSender.ResetMaxLatency();
+}
+
+void MoonlightCommonRuntimeComponent::SetMouseMotionFlushRate(int rateHz) {
+	s_InputSender.SetMouseFlushRate(rateHz);
+}
+
+/* Sends horizontal scrolling with Shift pressed around it, which games
+ * see as a real key press */
+void MoonlightCommonRuntimeComponent::SetHorizontalScrollShiftEnabled(bool enabled) {
+	s_InputSender.SetHorizontalScrollShift(enabled);
+}
+
+void MoonlightCommonRuntimeComponent::SetInputLatencyProbeEnabled(bool enabled) {
+	s_InputSender.SetLatencyProbeEnabled(enabled);
+}
+
+/* Entry i counts events that took under 2^i microseconds at that stage
+ * but not under 2^(i-1) */
+Platform::Array<long long>^ MoonlightCommonRuntimeComponent::GetInputLatencyHistogram(InputLatencyStage stage) {
+	LatencyHistogram &histogram = s_InputSender.GetLatencyHistogram((LatencyStage)stage);
+	Platform::Array<long long>^ buckets = ref new Platform::Array<long long>(LATENCY_HISTOGRAM_BUCKETS);
+
+	for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+		buckets[i] = histogram.GetBucketCount(i);
+	}
+
+	return buckets;
+}
+
+long long MoonlightCommonRuntimeComponent::GetInputLatencyPercentileUs(InputLatencyStage stage, int percent) {
+	return s_InputSender.GetLatencyHistogram((LatencyStage)stage).GetPercentileUs(percent);
+}
+
+unsigned int MoonlightCommonRuntimeComponent::GetSlowestInputEventSequence(void) {
+	return s_InputSender.GetSlowestEventSequence();
+}
+
+long long MoonlightCommonRuntimeComponent::GetSlowestInputEventLatencyUs(void) {
+	return s_InputSender.GetSlowestEventLatencyUs();
+}
+
+/* Records every input call from here on into a binary trace */
+void MoonlightCommonRuntimeComponent::StartInputTrace(void) {
+	s_InputSender.GetTraceRecorder().Start();
+}
+
+Platform::Array<unsigned char>^ MoonlightCommonRuntimeComponent::StopInputTrace(void) {
+	std::vector<unsigned char> trace = s_InputSender.GetTraceRecorder().Stop();
+
+	return ref new Platform::Array<unsigned char>(trace.data(), (unsigned int)trace.size());
+}
+
+/* Replays a trace from StopInputTrace into the current connection. Returns
+ * -1 if the trace is malformed. */
+int MoonlightCommonRuntimeComponent::ReplayInputTrace(const Platform::Array<unsigned char> ^trace, double speed) {
+	return s_InputReplayer.Start(trace->Data, trace->Length, speed) ? 0 : -1;
+}
+
+void MoonlightCommonRuntimeComponent::StopInputReplay(void) {
+	s_InputReplayer.Stop();
+}
+
+void MoonlightCommonRuntimeComponent::StartControllerPolling(int rateHz) {
+	s_GamepadPoller.SetPollRate(rateHz);
+	s_GamepadPoller.Start(&s_XInputSource);
+}
+
+void MoonlightCommonRuntimeComponent::StopControllerPolling(void) {
+	s_GamepadPoller.Stop();
+}
+
+void MoonlightCommonRuntimeComponent::SetControllerStickFilter(int deadzone, int noiseThreshold) {
+	s_GamepadPoller.SetStickFilter(deadzone, noiseThreshold);
+}
+
+/* Cheap enough to poll every frame. Returns zeros when not connected. */
+MoonlightStreamStatistics^ MoonlightCommonRuntimeComponent::GetStatistics(void) {
+	std::shared_ptr<StreamSession> session = GetSession();
+	StatisticsSnapshot snapshot = {};
+
+	if (session != nullptr) {
+		session->GetStatistics().GetSnapshot(snapshot);
+	}
+
+	return ref new MoonlightStreamStatistics(snapshot.receivedFps, snapshot.receivedBitrateKbps,
+		snapshot.averageFrameSize, snapshot.maxFrameSize, snapshot.framesReceived, snapshot.framesDropped,
+		snapshot.idrRequests, snapshot.audioPacketsDecoded, snapshot.audioPacketsLost, s_InputSender.GetEventsSent(),
+		snapshot.arrivalJitterUs, snapshot.queueingDelayUs, snapshot.frameRate, snapshot.targetBitrateKbps,
+		session != nullptr ? session->GetAvSync().GetOffsetUs() : 0,
+		session != nullptr ? session->GetFramePacer().GetFrameTimeMeanUs() : 0,
+		session != nullptr ? session->GetFramePacer().GetFrameTimeStdDevUs() : 0,
+		snapshot.framesDroppedReference, snapshot.framesDroppedNonReference, snapshot.decoderResets,
+		snapshot.parameterSetsStripped);
+}
+
+/* Can block for up to half a second the first time a host is probed, so
+ * call this off the UI thread. Returns 0 if the path couldn't be probed. */
+int MoonlightCommonRuntimeComponent::ProbePathMtu(Platform::String^ host) {
+	std::wstring hostW(host->Begin());
+	std::string hostA(hostW.begin(), hostW.end());
+
+	return Moonlight_common_binding::ProbePathMtu(hostA.c_str());
+}
+
+/* The packet size to stream with over a path with this MTU, or with the
+ * default if pathMtu is 0, stepping down from sizes that earlier streams
+ * saw more loss at */
+int MoonlightCommonRuntimeComponent::RecommendPacketSize(int pathMtu) {
+	return s_Packetization.RecommendPacketSize(GetPacketSizeForPathMtu(pathMtu));
+}
+
+/* Entry i counts frames that arrived in under 2^i packets but not under
+ * 2^(i-1) */
+Platform::Array<long long>^ MoonlightCommonRuntimeComponent::GetFragmentCountHistogram(void) {
+	Platform::Array<long long>^ buckets = ref new Platform::Array<long long>(FRAGMENT_COUNT_BUCKETS);
+
+	for (int i = 0; i < FRAGMENT_COUNT_BUCKETS; i++) {
+		buckets[i] = s_Packetization.GetFragmentCountBucket(i);
+	}
+
+	return buckets;
+}
+
+/* Entry i counts packets with i * 128 to (i + 1) * 128 bytes of payload.
+ * The last entry also counts anything bigger. */
+Platform::Array<long long>^ MoonlightCommonRuntimeComponent::GetFragmentSizeHistogram(void) {
+	Platform::Array<long long>^ buckets = ref new Platform::Array<long long>(PACKET_SIZE_CLASSES);
+
+	for (int i = 0; i < PACKET_SIZE_CLASSES; i++) {
+		buckets[i] = s_Packetization.GetFragmentSizeBucket(i);
+	}
+
+	return buckets;
+}
+
+/* Entry i is the video losses per thousand frames while streaming with
+ * packet sizes from i * 128 to (i + 1) * 128 bytes, or -1 if too little
+ * was streamed with them to tell */
+Platform::Array<int>^ MoonlightCommonRuntimeComponent::GetLossPermilleByPacketSize(void) {
+	Platform::Array<int>^ loss = ref new Platform::Array<int>(PACKET_SIZE_CLASSES);
+
+	for (int i = 0; i < PACKET_SIZE_CLASSES; i++) {
+		loss[i] = s_Packetization.GetLossPermille(i);
+	}
+
+	return loss;
+}
+
+/* Measures the link to a UDP echo service at host:port and suggests the
+ * best settings up to the given ones. Blocks for about a second, so call
+ * this off the UI thread. Returns null if nothing answered, or if too
+ * little of the burst came back to measure. */
+MoonlightLinkProbeResult^ MoonlightCommonRuntimeComponent::ProbeLink(Platform::String^ host, int port, int maxWidth,
+	int maxHeight, int maxFps, int maxBitrateKbps)
+{
+	LinkProbeResult result;
+	StreamMode maxMode;
+	StreamMode mode;
+
+	std::wstring hostW(host->Begin());
+	std::string hostA(hostW.begin(), hostW.end());
+
+	if (!Moonlight_common_binding::ProbeLink(hostA.c_str(), port, maxBitrateKbps, result)) {
+		return nullptr;
+	}
+
+	maxMode.width = maxWidth;
+	maxMode.height = maxHeight;
+	maxMode.fps = maxFps;
+	maxMode.bitrateKbps = maxBitrateKbps;
+	mode = SuggestStreamMode(result, maxMode);
+
+	return ref new MoonlightLinkProbeResult(result.rttUs, result.jitterUs, result.throughputKbps, result.lossPercent,
+		mode.width, mode.height, mode.fps, mode.bitrateKbps);
+}
+
+/* Recording is on by default and costs a few atomic operations per event */
+void MoonlightCommonRuntimeComponent::SetFlightRecorderEnabled(bool enabled) {
+	Moonlight_common_binding::SetFlightRecorderEnabled(enabled);
+}
+
+/* The stream events from the last few seconds, in the format described in
+ * FlightRecorder.hpp */
+Platform::Array<unsigned char>^ MoonlightCommonRuntimeComponent::DumpFlightRecorder(int seconds) {
+	std::vector<unsigned char> dump = Moonlight_common_binding::DumpFlightRecorder(seconds);
+
+	return ref new Platform::Array<unsigned char>(dump.data(), (unsigned int)dump.size());
+}
+
+/* Writes the last 30 seconds of events to flight-recorder.bin in the app's
+ * local folder whenever the connection terminates, replacing the last one */
+void MoonlightCommonRuntimeComponent::SetFlightRecorderDumpOnTermination(bool enabled) {
+	std::wstring path;
+
+	if (enabled) {
+		path = Windows::Storage::ApplicationData::Current->LocalFolder->Path->Data();
+		path += L"\\flight-recorder.bin";
+	}
+
+	SetFlightRecorderTerminationPath(path);
 }
@@ -6,12 +6,19 @@ typedef unsigned char byte;
 
 namespace Moonlight_common_binding
 {
+	public enum class VideoCodec : int {
+		H264 = 0,
+		Hevc = 1
+	};
+
 	public ref class MoonlightStreamConfiguration sealed
 	{
 	public:
 		MoonlightStreamConfiguration(int width, int height, int fps, int bitrate, int packetSize,
-			const Platform::Array<unsigned char> ^riAesKey, const Platform::Array<unsigned char> ^riAesIv) :
-			m_Width(width), m_Height(height), m_Fps(fps), m_Bitrate(bitrate), m_PacketSize(packetSize)
+			const Platform::Array<unsigned char> ^riAesKey, const Platform::Array<unsigned char> ^riAesIv,
+			VideoCodec codec) :
+			m_Width(width), m_Height(height), m_Fps(fps), m_Bitrate(bitrate), m_PacketSize(packetSize),
+			m_Codec(codec)
 		{
 			memcpy(m_riAesKey, riAesKey->Data, sizeof(m_riAesKey));
 			memcpy(m_riAesIv, riAesIv->Data, sizeof(m_riAesIv));
@@ -32,6 +39,12 @@ namespace Moonlight_common_binding
 		int GetPacketSize(void) {
 			return m_PacketSize;
 		}
+
+		/* The codec the host must stream in. The renderer's decoder has to
+		 * be set up for the same one. */
+		VideoCodec GetCodec(void) {
+			return m_Codec;
+		}
 		Platform::Array<unsigned char>^ GetRiAesKey(void) {
 			return ref new Platform::Array<byte>(m_riAesKey, sizeof(m_riAesKey));
 		}
@@ -45,13 +58,16 @@ namespace Moonlight_common_binding
 		int m_Fps;
 		int m_Bitrate;
 		int m_PacketSize;
+		VideoCodec m_Codec;
 		byte m_riAesKey[16];
 		byte m_riAesIv[16];
 	};
 
 	public delegate void DrSetup(int width, int height, int redrawRate, int drFlags);
 	public delegate void DrCleanup(void);
-	public delegate int DrSubmitDecodeUnit(const Platform::Array<unsigned char> ^data);
+	/* receiveTime is a monotonic timestamp in 100 ns units taken when the
+	 * binding received the frame or audio packet */
+	public delegate int DrSubmitDecodeUnit(const Platform::Array<unsigned char> ^data, long long receiveTime);
 
 	public ref class MoonlightDecoderRenderer sealed
 	{
@@ -66,8 +82,8 @@ namespace Moonlight_common_binding
 		void Cleanup(void) {
 			m_DrCleanup();
 		}
-		int SubmitDecodeUnit(const Platform::Array<byte> ^dataArray) {
-			return m_DrSubmitDecodeUnit(dataArray);
+		int SubmitDecodeUnit(const Platform::Array<byte> ^dataArray, long long receiveTime) {
+			return m_DrSubmitDecodeUnit(dataArray, receiveTime);
 		}
 
 	private:
@@ -78,7 +94,7 @@ namespace Moonlight_common_binding
 
 	public delegate void ArInit(void);
 	public delegate void ArCleanup(void);
-	public delegate void ArPlaySample(const Platform::Array<unsigned char> ^data);
+	public delegate void ArPlaySample(const Platform::Array<unsigned char> ^data, long long receiveTime);
 
 	public ref class MoonlightAudioRenderer sealed
 	{
@@ -93,8 +109,8 @@ namespace Moonlight_common_binding
 		void Cleanup(void) {
 			m_ArCleanup();
 		}
-		void PlaySample(const Platform::Array<byte> ^dataArray) {
-			m_ArPlaySample(dataArray);
+		void PlaySample(const Platform::Array<byte> ^dataArray, long long receiveTime) {
+			m_ArPlaySample(dataArray, receiveTime);
 		}
 
 	private:
@@ -154,6 +170,12 @@ namespace Moonlight_common_binding
 		Moonlight_common_binding::ClDisplayTransientMessage ^m_ClDisplayTransientMessage;
 	};
 
+	/* Invoked from the reconnect thread to re-issue /resume with the freshly
+	 * generated remote input key and IV. Returns true if the host accepted it.
+	 * StopConnection waits for it to return, so it must give up on a host
+	 * that doesn't answer. */
+	public delegate bool ClResumeSession(const Platform::Array<unsigned char> ^riAesKey, const Platform::Array<unsigned char> ^riAesIv);
+
 	public enum class MouseButtonAction : int {
 		Press = 0x07,
 		Release = 0x08
@@ -194,6 +216,297 @@ namespace Moonlight_common_binding
 		Special = 0x0400
 	};
 
+	public enum class InputLatencyStage : int {
+		Queueing = 0,
+		Send = 1,
+		Total = 2
+	};
+
+	/* Off hands frames to the renderer as soon as they arrive */
+	public enum class FramePacingMode : int {
+		Off = 0,
+		LatencyFirst = 1,
+		SmoothnessFirst = 2
+	};
+
+	/* How NAL units are delimited in the frames given to the renderer.
+	 * LengthPrefixed replaces each start code with a 4 byte big-endian
+	 * length, as AVCC and HVCC decoders expect. */
+	public enum class BitstreamFormat : int {
+		AnnexB = 0,
+		LengthPrefixed = 1
+	};
+
+	public ref class MoonlightControllerState sealed
+	{
+	public:
+		MoonlightControllerState(short controllerNumber, short buttonFlags, byte leftTrigger, byte rightTrigger,
+			short leftStickX, short leftStickY, short rightStickX, short rightStickY) :
+			m_ControllerNumber(controllerNumber), m_ButtonFlags(buttonFlags), m_LeftTrigger(leftTrigger),
+			m_RightTrigger(rightTrigger), m_LeftStickX(leftStickX), m_LeftStickY(leftStickY),
+			m_RightStickX(rightStickX), m_RightStickY(rightStickY) {}
+
+		short GetControllerNumber(void) {
+			return m_ControllerNumber;
+		}
+		short GetButtonFlags(void) {
+			return m_ButtonFlags;
+		}
+		byte GetLeftTrigger(void) {
+			return m_LeftTrigger;
+		}
+		byte GetRightTrigger(void) {
+			return m_RightTrigger;
+		}
+		short GetLeftStickX(void) {
+			return m_LeftStickX;
+		}
+		short GetLeftStickY(void) {
+			return m_LeftStickY;
+		}
+		short GetRightStickX(void) {
+			return m_RightStickX;
+		}
+		short GetRightStickY(void) {
+			return m_RightStickY;
+		}
+
+	private:
+		short m_ControllerNumber;
+		short m_ButtonFlags;
+		byte m_LeftTrigger;
+		byte m_RightTrigger;
+		short m_LeftStickX;
+		short m_LeftStickY;
+		short m_RightStickX;
+		short m_RightStickY;
+	};
+
+	public ref class MoonlightInputMetrics sealed
+	{
+	public:
+		MoonlightInputMetrics(int queueDepth, long long eventsSent, long long eventsDropped,
+			long long averageLatencyUs, long long maxLatencyUs, int mousePacketsPerSecond,
+			long long mouseEventsCoalesced, long long averageMouseDelayUs, long long scrollEventsReceived,
+			long long scrollPacketsSent) :
+			m_QueueDepth(queueDepth), m_EventsSent(eventsSent), m_EventsDropped(eventsDropped),
+			m_AverageLatencyUs(averageLatencyUs), m_MaxLatencyUs(maxLatencyUs),
+			m_MousePacketsPerSecond(mousePacketsPerSecond), m_MouseEventsCoalesced(mouseEventsCoalesced),
+			m_AverageMouseDelayUs(averageMouseDelayUs), m_ScrollEventsReceived(scrollEventsReceived),
+			m_ScrollPacketsSent(scrollPacketsSent) {}
+
+		int GetQueueDepth(void) {
+			return m_QueueDepth;
+		}
+		long long GetEventsSent(void) {
+			return m_EventsSent;
+		}
+		long long GetEventsDropped(void) {
+			return m_EventsDropped;
+		}
+		long long GetAverageLatencyUs(void) {
+			return m_AverageLatencyUs;
+		}
+		long long GetMaxLatencyUs(void) {
+			return m_MaxLatencyUs;
+		}
+		int GetMousePacketsPerSecond(void) {
+			return m_MousePacketsPerSecond;
+		}
+		long long GetMouseEventsCoalesced(void) {
+			return m_MouseEventsCoalesced;
+		}
+		long long GetAverageMouseDelayUs(void) {
+			return m_AverageMouseDelayUs;
+		}
+		long long GetScrollEventsReceived(void) {
+			return m_ScrollEventsReceived;
+		}
+		long long GetScrollPacketsSent(void) {
+			return m_ScrollPacketsSent;
+		}
+
+	private:
+		int m_QueueDepth;
+		long long m_EventsSent;
+		long long m_EventsDropped;
+		long long m_AverageLatencyUs;
+		long long m_MaxLatencyUs;
+		int m_MousePacketsPerSecond;
+		long long m_MouseEventsCoalesced;
+		long long m_AverageMouseDelayUs;
+		long long m_ScrollEventsReceived;
+		long long m_ScrollPacketsSent;
+	};
+
+	public ref class MoonlightStreamStatistics sealed
+	{
+	public:
+		MoonlightStreamStatistics(double receivedFps, long long receivedBitrateKbps, int averageFrameSize,
+			int maxFrameSize, long long framesReceived, long long framesDropped, long long idrRequests,
+			long long audioPacketsDecoded, long long audioPacketsLost, long long inputEventsSent,
+			long long arrivalJitterUs, long long queueingDelayUs, int fps, int targetBitrateKbps, long long avOffsetUs,
+			long long frameTimeMeanUs, long long frameTimeStdDevUs, long long framesDroppedReference,
+			long long framesDroppedNonReference, long long decoderResets, long long parameterSetsStripped) :
+			m_ReceivedFps(receivedFps), m_ReceivedBitrateKbps(receivedBitrateKbps),
+			m_AverageFrameSize(averageFrameSize), m_MaxFrameSize(maxFrameSize),
+			m_FramesReceived(framesReceived), m_FramesDropped(framesDropped), m_IdrRequests(idrRequests),
+			m_AudioPacketsDecoded(audioPacketsDecoded), m_AudioPacketsLost(audioPacketsLost),
+			m_InputEventsSent(inputEventsSent), m_ArrivalJitterUs(arrivalJitterUs),
+			m_QueueingDelayUs(queueingDelayUs), m_Fps(fps), m_TargetBitrateKbps(targetBitrateKbps),
+			m_AvOffsetUs(avOffsetUs), m_FrameTimeMeanUs(frameTimeMeanUs), m_FrameTimeStdDevUs(frameTimeStdDevUs),
+			m_FramesDroppedReference(framesDroppedReference), m_FramesDroppedNonReference(framesDroppedNonReference),
+			m_DecoderResets(decoderResets), m_ParameterSetsStripped(parameterSetsStripped) {}
+
+		/* Rates and the average frame size cover the last second */
+		double GetReceivedFps(void) {
+			return m_ReceivedFps;
+		}
+		long long GetReceivedBitrateKbps(void) {
+			return m_ReceivedBitrateKbps;
+		}
+		int GetAverageFrameSize(void) {
+			return m_AverageFrameSize;
+		}
+		int GetMaxFrameSize(void) {
+			return m_MaxFrameSize;
+		}
+		long long GetFramesReceived(void) {
+			return m_FramesReceived;
+		}
+		long long GetFramesDropped(void) {
+			return m_FramesDropped;
+		}
+
+		/* Dropped frames by class. Non-reference frames are dropped first
+		 * when the renderer falls behind. Dropping a reference frame means
+		 * skipping to the next IDR frame. */
+		long long GetFramesDroppedReference(void) {
+			return m_FramesDroppedReference;
+		}
+		long long GetFramesDroppedNonReference(void) {
+			return m_FramesDroppedNonReference;
+		}
+		long long GetIdrRequests(void) {
+			return m_IdrRequests;
+		}
+
+		/* Times the renderer reported a decoder failure, after which the
+		 * parameter sets are sent again */
+		long long GetDecoderResets(void) {
+			return m_DecoderResets;
+		}
+
+		/* Unchanged parameter set copies kept away from the decoder */
+		long long GetParameterSetsStripped(void) {
+			return m_ParameterSetsStripped;
+		}
+		long long GetAudioPacketsDecoded(void) {
+			return m_AudioPacketsDecoded;
+		}
+		long long GetAudioPacketsLost(void) {
+			return m_AudioPacketsLost;
+		}
+		long long GetInputEventsSent(void) {
+			return m_InputEventsSent;
+		}
+		long long GetArrivalJitterUs(void) {
+			return m_ArrivalJitterUs;
+		}
+		long long GetQueueingDelayUs(void) {
+			return m_QueueingDelayUs;
+		}
+
+		/* The mode currently negotiated with the host */
+		int GetFps(void) {
+			return m_Fps;
+		}
+		int GetTargetBitrateKbps(void) {
+			return m_TargetBitrateKbps;
+		}
+
+		/* Positive when audio is playing behind video */
+		long long GetAvOffsetUs(void) {
+			return m_AvOffsetUs;
+		}
+
+		/* Time between frames shown by the frame pacer, or 0 when pacing is off */
+		long long GetFrameTimeMeanUs(void) {
+			return m_FrameTimeMeanUs;
+		}
+		long long GetFrameTimeStdDevUs(void) {
+			return m_FrameTimeStdDevUs;
+		}
+
+	private:
+		double m_ReceivedFps;
+		long long m_ReceivedBitrateKbps;
+		int m_AverageFrameSize;
+		int m_MaxFrameSize;
+		long long m_FramesReceived;
+		long long m_FramesDropped;
+		long long m_IdrRequests;
+		long long m_AudioPacketsDecoded;
+		long long m_AudioPacketsLost;
+		long long m_InputEventsSent;
+		long long m_ArrivalJitterUs;
+		long long m_QueueingDelayUs;
+		int m_Fps;
+		int m_TargetBitrateKbps;
+		long long m_AvOffsetUs;
+		long long m_FrameTimeMeanUs;
+		long long m_FrameTimeStdDevUs;
+		long long m_FramesDroppedReference;
+		long long m_FramesDroppedNonReference;
+		long long m_DecoderResets;
+		long long m_ParameterSetsStripped;
+	};
+
+	/* What a link probe measured, and the stream settings it suggests */
+	public ref class MoonlightLinkProbeResult sealed
+	{
+	public:
+		MoonlightLinkProbeResult(int rttUs, int jitterUs, int throughputKbps, int lossPercent,
+			int width, int height, int fps, int bitrateKbps) :
+			m_RttUs(rttUs), m_JitterUs(jitterUs), m_ThroughputKbps(throughputKbps), m_LossPercent(lossPercent),
+			m_Width(width), m_Height(height), m_Fps(fps), m_BitrateKbps(bitrateKbps) {}
+
+		int GetRttUs(void) {
+			return m_RttUs;
+		}
+		int GetJitterUs(void) {
+			return m_JitterUs;
+		}
+		int GetThroughputKbps(void) {
+			return m_ThroughputKbps;
+		}
+		int GetLossPercent(void) {
+			return m_LossPercent;
+		}
+		int GetWidth(void) {
+			return m_Width;
+		}
+		int GetHeight(void) {
+			return m_Height;
+		}
+		int GetFps(void) {
+			return m_Fps;
+		}
+		int GetBitrateKbps(void) {
+			return m_BitrateKbps;
+		}
+
+	private:
+		int m_RttUs;
+		int m_JitterUs;
+		int m_ThroughputKbps;
+		int m_LossPercent;
+		int m_Width;
+		int m_Height;
+		int m_Fps;
+		int m_BitrateKbps;
+	};
+
 	public ref class MoonlightCommonRuntimeComponent sealed
 	{
 	public:
@@ -202,13 +515,58 @@ namespace Moonlight_common_binding
 			int serverMajorVersion);
 
 		static void StopConnection(void);
+		static void EnableAutoReconnect(ClResumeSession ^resumeSession, int maxAttempts);
+		static void DisableAutoReconnect(void);
+		static void EnableAdaptiveBitrate(int minBitrateKbps, int maxBitrateKbps);
+		static void DisableAdaptiveBitrate(void);
+		static void ReportVideoFramePresented(long long receiveTime);
+		static void ReportAudioOutputLatency(long long latency);
+		static void SetAvSyncTolerance(int toleranceMs);
+		static void SetFramePacingMode(FramePacingMode mode);
+		static void SetBitstreamFormat(BitstreamFormat format);
 		static int SendMouseMoveEvent(short deltaX, short deltaY);
 		static int SendMouseButtonEvent(unsigned char action, int button);
 		static int SendKeyboardEvent(short keyCode, unsigned char keyAction, unsigned char modifiers);
+		static int SendVirtualKeyEvent(int virtualKey, unsigned char keyAction);
+		static unsigned char GetKeyboardModifiers(void);
+		static void ResetKeyboardModifiers(void);
+		static int ScheduleMouseButtonEvent(unsigned char action, int button, int delayMs);
+		static int ScheduleKeyboardEvent(short keyCode, unsigned char keyAction, unsigned char modifiers, int delayMs);
+		static int SendMouseClick(int button, int holdMs);
 		static int SendControllerInput(short buttonFlags, byte leftTrigger, byte rightTrigger, short leftStickX, 
 			short leftStickY, short rightStickX, short rightStickY);
 		static int SendMultiControllerInput(short controllerNumber, short buttonFlags, byte leftTrigger, byte rightTrigger, short leftStickX,
 			short leftStickY, short rightStickX, short rightStickY);
+		static int SendMultiControllerInputBatch(const Platform::Array<MoonlightControllerState^> ^states);
 		static int SendScrollEvent(short scrollClicks);
+		static int SendScrollDelta(short wheelDelta);
+		static int SendHorizontalScrollDelta(short wheelDelta);
+		static MoonlightInputMetrics^ GetInputMetrics(void);
+		static void ResetInputMaxLatency(void);
+		static void SetMouseMotionFlushRate(int rateHz);
+		static void SetHorizontalScrollShiftEnabled(bool enabled);
+		static void SetInputLatencyProbeEnabled(bool enabled);
+		static Platform::Array<long long>^ GetInputLatencyHistogram(InputLatencyStage stage);
+		static long long GetInputLatencyPercentileUs(InputLatencyStage stage, int percent);
+		static unsigned int GetSlowestInputEventSequence(void);
+		static long long GetSlowestInputEventLatencyUs(void);
+		static void StartInputTrace(void);
+		static Platform::Array<unsigned char>^ StopInputTrace(void);
+		static int ReplayInputTrace(const Platform::Array<unsigned char> ^trace, double speed);
+		static void StopInputReplay(void);
+		static void StartControllerPolling(int rateHz);
+		static void StopControllerPolling(void);
+		static void SetControllerStickFilter(int deadzone, int noiseThreshold);
+		static MoonlightStreamStatistics^ GetStatistics(void);
+		static int ProbePathMtu(Platform::String^ host);
+		static int RecommendPacketSize(int pathMtu);
+		static Platform::Array<long long>^ GetFragmentCountHistogram(void);
+		static Platform::Array<long long>^ GetFragmentSizeHistogram(void);
+		static Platform::Array<int>^ GetLossPermilleByPacketSize(void);
+		static MoonlightLinkProbeResult^ ProbeLink(Platform::String^ host, int port, int maxWidth, int maxHeight,
+			int maxFps, int maxBitrateKbps);
+		static void SetFlightRecorderEnabled(bool enabled);
+		static Platform::Array<unsigned char>^ DumpFlightRecorder(int seconds);
+		static void SetFlightRecorderDumpOnTermination(bool enabled);
 	};
 }
\ No newline at end of file
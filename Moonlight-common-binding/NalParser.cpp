@@ -0,0 +1,111 @@
+/* Annex B bitstream parsing */
+#include "NalParser.hpp"
+
+using namespace Moonlight_common_binding;
+
+int Moonlight_common_binding::FindStartCode(const unsigned char *data, int length, int offset, int &startCodeLength) {
+	int i;
+
+	for (i = offset; i + 2 < length; i++) {
+		/* Start codes are 00 00 01, so skip ahead whenever the third byte rules one out */
+		if (data[i + 2] > 1) {
+			i += 2;
+		}
+		else if (data[i + 2] == 1 && data[i + 1] == 0 && data[i] == 0) {
+			if (i > offset && data[i - 1] == 0) {
+				startCodeLength = 4;
+				return i - 1;
+			}
+
+			startCodeLength = 3;
+			return i;
+		}
+	}
+
+	startCodeLength = 0;
+	return length;
+}
+
+bool Moonlight_common_binding::FindNalUnit(const unsigned char *data, int length, NalPacking packing, int &offset,
+	NalUnit &nal) {
+	int startCodeLength;
+	unsigned int nalLength;
+
+	if (packing == NalPackingLengthPrefixed) {
+		if (length - offset <= NAL_LENGTH_PREFIX_SIZE) {
+			offset = length;
+			return false;
+		}
+
+		nalLength = ((unsigned int)data[offset] << 24) | ((unsigned int)data[offset + 1] << 16) |
+			((unsigned int)data[offset + 2] << 8) | data[offset + 3];
+		nal.startCodeOffset = offset;
+		nal.headerOffset = offset + NAL_LENGTH_PREFIX_SIZE;
+		if (nalLength == 0 || nalLength > (unsigned int)(length - nal.headerOffset)) {
+			offset = length;
+			return false;
+		}
+
+		nal.end = nal.headerOffset + (int)nalLength;
+		offset = nal.end;
+		return true;
+	}
+
+	nal.startCodeOffset = FindStartCode(data, length, offset, startCodeLength);
+	nal.headerOffset = nal.startCodeOffset + startCodeLength;
+	if (nal.headerOffset >= length) {
+		offset = length;
+		return false;
+	}
+
+	nal.end = length;
+	offset = nal.headerOffset;
+	return true;
+}
+
+bool Moonlight_common_binding::ReadNalUnit(const unsigned char *data, int length, NalPacking packing, int &offset,
+	NalUnit &nal) {
+	int startCodeLength;
+
+	if (!FindNalUnit(data, length, packing, offset, nal)) {
+		return false;
+	}
+
+	if (packing == NalPackingAnnexB) {
+		nal.end = FindStartCode(data, length, nal.headerOffset, startCodeLength);
+		offset = nal.end;
+	}
+	return true;
+}
+
+FrameClass Moonlight_common_binding::ClassifyFrame(NalFormat format, NalPacking packing, const unsigned char *data,
+	int length) {
+	NalUnit nal;
+	int offset = 0;
+	int header;
+	int nalType;
+
+	/* Only the headers matter, so don't look for where each NAL unit ends */
+	for (;;) {
+		if (!FindNalUnit(data, length, packing, offset, nal)) {
+			return FrameClassReference;
+		}
+
+		header = nal.headerOffset;
+		nalType = GetNalType(format, data[header]);
+		if (IsKeyframeNal(format, nalType)) {
+			return FrameClassIdr;
+		}
+		else if (IsSliceNal(format, nalType)) {
+			if (format == NalFormatHevc) {
+				/* The even types below the IRAP range are sub-layer non-reference
+				 * pictures, which nothing references with one temporal layer */
+				return nalType < HEVC_NAL_TYPE_IRAP_FIRST && (nalType & 1) == 0 ?
+					FrameClassNonReference : FrameClassReference;
+			}
+
+			/* nal_ref_idc is zero only if nothing will reference this picture */
+			return (data[header] & 0x60) != 0 ? FrameClassReference : FrameClassNonReference;
+		}
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+/* H.264 NAL unit types we care about */
+#define H264_NAL_TYPE_SLICE 1
+#define H264_NAL_TYPE_SLICE_PARTITION_C 4
+#define H264_NAL_TYPE_IDR 5
+#define H264_NAL_TYPE_SEI 6
+#define H264_NAL_TYPE_SPS 7
+#define H264_NAL_TYPE_PPS 8
+#define H264_NAL_TYPE_AUD 9
+
+/* HEVC NAL unit types. Types up to 31 are slices, and 16 through 23 are
+ * IRAP pictures that decoding can start from. */
+#define HEVC_NAL_TYPE_IRAP_FIRST 16
+#define HEVC_NAL_TYPE_IRAP_LAST 23
+#define HEVC_NAL_TYPE_VCL_LAST 31
+#define HEVC_NAL_TYPE_VPS 32
+#define HEVC_NAL_TYPE_SPS 33
+#define HEVC_NAL_TYPE_PPS 34
+#define HEVC_NAL_TYPE_AUD 35
+
+#define NAL_LENGTH_PREFIX_SIZE 4
+
+namespace Moonlight_common_binding
+{
+	enum NalFormat
+	{
+		NalFormatH264,
+		NalFormatHevc,
+	};
+
+	/* How NAL units are delimited: start codes, or the 4-byte big-endian
+	 * lengths of AVCC and HVCC */
+	enum NalPacking
+	{
+		NalPackingAnnexB,
+		NalPackingLengthPrefixed,
+	};
+
+	enum FrameClass
+	{
+		FrameClassIdr,
+		FrameClassReference,
+		FrameClassNonReference,
+	};
+
+	/* A NAL unit inside a frame. The payload starts with the NAL header and
+	 * runs up to the next start code or length prefix. */
+	struct NalUnit
+	{
+		/* Where the start code or length prefix begins */
+		int startCodeOffset;
+		int headerOffset;
+		int end;
+	};
+
+	/* Returns the offset of the next 3 or 4 byte start code at or after
+	 * offset, or length if there isn't one */
+	int FindStartCode(const unsigned char *data, int length, int offset, int &startCodeLength);
+
+	/* Finds the NAL unit whose start code or length prefix is at or after
+	 * offset without scanning for where an Annex B unit ends. Its end is
+	 * left at the end of the frame, and offset is moved to its header. */
+	bool FindNalUnit(const unsigned char *data, int length, NalPacking packing, int &offset, NalUnit &nal);
+
+	/* Reads the NAL unit whose start code or length prefix is at or after
+	 * offset and moves offset to its end. Returns false once there are no
+	 * more, or if a length prefix runs past the end of the frame. */
+	bool ReadNalUnit(const unsigned char *data, int length, NalPacking packing, int &offset, NalUnit &nal);
+
+	/* H.264 headers are one byte and HEVC headers are two, but the type is
+	 * always in the first */
+	inline int GetNalType(NalFormat format, unsigned char header) {
+		return format == NalFormatHevc ? (header >> 1) & 0x3F : header & 0x1F;
+	}
+
+	inline bool IsSliceNal(NalFormat format, int nalType) {
+		if (format == NalFormatHevc) {
+			return nalType <= HEVC_NAL_TYPE_VCL_LAST;
+		}
+		return nalType >= H264_NAL_TYPE_SLICE && nalType <= H264_NAL_TYPE_IDR;
+	}
+
+	/* IDR frames in H.264, and any IRAP picture in HEVC */
+	inline bool IsKeyframeNal(NalFormat format, int nalType) {
+		if (format == NalFormatHevc) {
+			return nalType >= HEVC_NAL_TYPE_IRAP_FIRST && nalType <= HEVC_NAL_TYPE_IRAP_LAST;
+		}
+		return nalType == H264_NAL_TYPE_IDR;
+	}
+
+	inline void WriteNalLengthPrefix(unsigned char *output, int length) {
+		output[0] = (unsigned char)(length >> 24);
+		output[1] = (unsigned char)(length >> 16);
+		output[2] = (unsigned char)(length >> 8);
+		output[3] = (unsigned char)length;
+	}
+
+	/* Classifies a frame from its first slice's NAL header, without
+	 * scanning past it. Frames without a recognizable slice are treated as
+	 * reference frames, since dropping one of those is never safe. */
+	FrameClass ClassifyFrame(NalFormat format, NalPacking packing, const unsigned char *data, int length);
+}
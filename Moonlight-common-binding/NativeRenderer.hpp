@@ -0,0 +1,102 @@
+#pragma once
+#include "Moonlight-common-binding.hpp"
+#include "RendererInterfaces.hpp"
+
+#include <atomic>
+#include <string>
+
+namespace Moonlight_common_binding
+{
+	/* Default sinks that forward to the managed delegates. These are final so
+	 * the session can call them without going through the vtable. */
+	class DelegateVideoRenderer final : public IVideoRenderer
+	{
+	public:
+		DelegateVideoRenderer(MoonlightDecoderRenderer ^callbacks) : m_Callbacks(callbacks) {}
+
+		void Setup(int width, int height, int redrawRate, int drFlags) override {
+			m_Callbacks->Setup(width, height, redrawRate, drFlags);
+		}
+		void Cleanup(void) override {
+			m_Callbacks->Cleanup();
+		}
+		int SubmitDecodeUnit(const unsigned char *data, int length, long long receiveTime) override {
+			return m_Callbacks->SubmitDecodeUnit(Platform::ArrayReference<byte>((byte*)data, length), receiveTime);
+		}
+
+	private:
+		MoonlightDecoderRenderer ^m_Callbacks;
+	};
+
+	class DelegateAudioRenderer final : public IAudioRenderer
+	{
+	public:
+		DelegateAudioRenderer(MoonlightAudioRenderer ^callbacks) : m_Callbacks(callbacks) {}
+
+		void Init(void) override {
+			m_Callbacks->Init();
+		}
+		void Cleanup(void) override {
+			m_Callbacks->Cleanup();
+		}
+		void PlaySample(const short *samples, int sampleCount, long long receiveTime) override {
+			m_Callbacks->PlaySample(Platform::ArrayReference<byte>((byte*)samples, sampleCount * sizeof(short)), receiveTime);
+		}
+
+	private:
+		MoonlightAudioRenderer ^m_Callbacks;
+	};
+
+	/* Sinks that throw away everything they are given but keep count of it.
+	 * These let a stream run without a display or audio device attached. */
+	class HeadlessVideoRenderer final : public IVideoRenderer
+	{
+	public:
+		HeadlessVideoRenderer() : m_FramesSubmitted(0), m_BytesSubmitted(0) {}
+
+		void Setup(int width, int height, int redrawRate, int drFlags) override {}
+		void Cleanup(void) override {}
+		int SubmitDecodeUnit(const unsigned char *data, int length, long long receiveTime) override {
+			m_FramesSubmitted++;
+			m_BytesSubmitted += length;
+			return DR_OK;
+		}
+
+		long long GetFramesSubmitted(void) {
+			return m_FramesSubmitted;
+		}
+		long long GetBytesSubmitted(void) {
+			return m_BytesSubmitted;
+		}
+
+	private:
+		std::atomic<long long> m_FramesSubmitted;
+		std::atomic<long long> m_BytesSubmitted;
+	};
+
+	class HeadlessAudioRenderer final : public IAudioRenderer
+	{
+	public:
+		HeadlessAudioRenderer() : m_SamplesPlayed(0) {}
+
+		void Init(void) override {}
+		void Cleanup(void) override {}
+		void PlaySample(const short *samples, int sampleCount, long long receiveTime) override {
+			m_SamplesPlayed += sampleCount;
+		}
+
+		long long GetSamplesPlayed(void) {
+			return m_SamplesPlayed;
+		}
+
+	private:
+		std::atomic<long long> m_SamplesPlayed;
+	};
+
+	/* Starts a connection that delivers video and audio straight to native
+	 * sinks with no managed transitions. The renderers are not owned and must
+	 * outlive the connection. */
+	int StartNativeConnection(const std::string &host, const STREAM_CONFIGURATION &config, int serverMajorVersion,
+		MoonlightConnectionListener ^clCallbacks, IVideoRenderer *videoRenderer, IAudioRenderer *audioRenderer,
+		VideoCodec codec = VideoCodec::H264);
+}
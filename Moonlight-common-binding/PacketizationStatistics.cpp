@@ -0,0 +1,101 @@
+/* Fragment and packet size statistics */
+#include "PacketizationStatistics.hpp"
+
+using namespace Moonlight_common_binding;
+
+static int GetSizeClass(int length) {
+	int sizeClass = length / PACKET_SIZE_CLASS_BYTES;
+
+	return sizeClass < PACKET_SIZE_CLASSES ? sizeClass : PACKET_SIZE_CLASSES - 1;
+}
+
+PacketizationStatistics::PacketizationStatistics() :
+	m_SizeClass(GetSizeClass(PACKET_SIZE_DEFAULT)), m_IdrExpected(true), m_MaxFragmentSize(0)
+{
+	for (int i = 0; i < FRAGMENT_COUNT_BUCKETS; i++) {
+		m_FragmentCounts[i].store(0, std::memory_order_relaxed);
+	}
+	for (int i = 0; i < PACKET_SIZE_CLASSES; i++) {
+		m_FragmentSizes[i].store(0, std::memory_order_relaxed);
+		m_ClassFrames[i].store(0, std::memory_order_relaxed);
+		m_ClassLosses[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+void PacketizationStatistics::BeginStream(int packetSize) {
+	m_SizeClass.store(GetSizeClass(packetSize), std::memory_order_relaxed);
+
+	/* Every connection starts with one */
+	m_IdrExpected = true;
+}
+
+void PacketizationStatistics::OnIdrRequested(void) {
+	m_IdrExpected = true;
+}
+
+void PacketizationStatistics::RecordFragment(int length) {
+	m_FragmentSizes[GetSizeClass(length)].fetch_add(1, std::memory_order_relaxed);
+	if (length > m_MaxFragmentSize.load(std::memory_order_relaxed)) {
+		m_MaxFragmentSize.store(length, std::memory_order_relaxed);
+	}
+}
+
+void PacketizationStatistics::RecordFrame(int fragmentCount, bool isIdr) {
+	int sizeClass = m_SizeClass.load(std::memory_order_relaxed);
+	int bucket = 0;
+
+	while (bucket < FRAGMENT_COUNT_BUCKETS - 1 && fragmentCount >= (1 << bucket)) {
+		bucket++;
+	}
+	m_FragmentCounts[bucket].fetch_add(1, std::memory_order_relaxed);
+
+	m_ClassFrames[sizeClass].fetch_add(1, std::memory_order_relaxed);
+	if (isIdr) {
+		/* Common lost part of a frame and is starting over */
+		if (!m_IdrExpected) {
+			m_ClassLosses[sizeClass].fetch_add(1, std::memory_order_relaxed);
+		}
+		m_IdrExpected = false;
+	}
+}
+
+int PacketizationStatistics::GetLossPermille(int sizeClass) {
+	long long frames = m_ClassFrames[sizeClass].load(std::memory_order_relaxed);
+
+	if (frames < PACKETIZATION_MIN_CLASS_FRAMES) {
+		return -1;
+	}
+
+	return (int)(m_ClassLosses[sizeClass].load(std::memory_order_relaxed) * 1000 / frames);
+}
+
+int PacketizationStatistics::RecommendPacketSize(int maxPacketSize) {
+	int baseline = -1;
+	int packetSize;
+	int loss;
+
+	for (int i = 0; i < PACKET_SIZE_CLASSES; i++) {
+		loss = GetLossPermille(i);
+		if (loss >= 0 && (baseline < 0 || loss < baseline)) {
+			baseline = loss;
+		}
+	}
+
+	packetSize = maxPacketSize > 0 ? maxPacketSize : PACKET_SIZE_DEFAULT;
+	if (packetSize > PACKET_SIZE_MAX) {
+		packetSize = PACKET_SIZE_MAX;
+	}
+	packetSize -= packetSize % PACKET_SIZE_ALIGNMENT;
+
+	/* Step below any class that loses noticeably more than the best one */
+	while (packetSize > PACKET_SIZE_MIN && baseline >= 0) {
+		loss = GetLossPermille(GetSizeClass(packetSize));
+		if (loss < 0 || loss <= baseline + PACKET_SIZE_LOSS_MARGIN_PERMILLE) {
+			break;
+		}
+
+		packetSize = GetSizeClass(packetSize) * PACKET_SIZE_CLASS_BYTES - PACKET_SIZE_ALIGNMENT;
+	}
+
+	return packetSize > PACKET_SIZE_MIN ? packetSize : PACKET_SIZE_MIN;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+
+/* Bucket i counts frames with fewer than 2^i fragments that didn't fit in
+ * bucket i-1. The last bucket also takes everything bigger. */
+#define FRAGMENT_COUNT_BUCKETS 16
+
+/* Fragment sizes, and the packet sizes that loss is tracked for, are
+ * grouped in classes this many bytes wide. The last class also takes
+ * everything bigger. */
+#define PACKET_SIZE_CLASS_BYTES 128
+#define PACKET_SIZE_CLASSES 12
+
+/* A packet size class needs this many frames before its loss counts */
+#define PACKETIZATION_MIN_CLASS_FRAMES 1800
+
+/* Packet sizes we'll recommend */
+#define PACKET_SIZE_MIN 512
+#define PACKET_SIZE_MAX 1392
+#define PACKET_SIZE_DEFAULT 1024
+#define PACKET_SIZE_ALIGNMENT 16
+
+/* Loss this far above the best packet size class suggests the packets are
+ * being fragmented */
+#define PACKET_SIZE_LOSS_MARGIN_PERMILLE 2
+
+namespace Moonlight_common_binding
+{
+	/* How the host's frames arrive: how many packets each takes, how big
+	 * they are, and how much is lost at each packet size that's been used.
+	 * Kept across connections so earlier streams inform the packet size of
+	 * later ones.
+	 *
+	 * Loss is counted from the IDR frames Common asks for on its own, which
+	 * it does when a frame can't be reassembled. That only sees the network,
+	 * unlike counting frames against the frame rate, which would also count
+	 * a host sending fewer frames because the picture isn't changing. */
+	class PacketizationStatistics
+	{
+	public:
+		PacketizationStatistics();
+
+		/* Call this while the decoder isn't running */
+		void BeginStream(int packetSize);
+
+		/* Decoder thread only. The binding asked for an IDR frame, so the
+		 * next one isn't a sign of loss. */
+		void OnIdrRequested(void);
+		void RecordFragment(int length);
+		void RecordFrame(int fragmentCount, bool isIdr);
+
+		long long GetFragmentCountBucket(int bucket) {
+			return m_FragmentCounts[bucket].load(std::memory_order_relaxed);
+		}
+		long long GetFragmentSizeBucket(int sizeClass) {
+			return m_FragmentSizes[sizeClass].load(std::memory_order_relaxed);
+		}
+		int GetMaxFragmentSize(void) {
+			return m_MaxFragmentSize.load(std::memory_order_relaxed);
+		}
+
+		/* Losses per thousand frames with packet sizes in this class, or -1
+		 * if there hasn't been enough streaming at them to say */
+		int GetLossPermille(int sizeClass);
+
+		/* The largest packet size up to maxPacketSize, or the default if
+		 * that's unknown, that hasn't shown more loss than smaller sizes */
+		int RecommendPacketSize(int maxPacketSize);
+
+	private:
+		std::atomic<int> m_SizeClass;
+
+		/* Decoder thread only */
+		bool m_IdrExpected;
+
+		std::atomic<long long> m_FragmentCounts[FRAGMENT_COUNT_BUCKETS];
+		std::atomic<long long> m_FragmentSizes[PACKET_SIZE_CLASSES];
+		std::atomic<int> m_MaxFragmentSize;
+		std::atomic<long long> m_ClassFrames[PACKET_SIZE_CLASSES];
+		std::atomic<long long> m_ClassLosses[PACKET_SIZE_CLASSES];
+	};
+}
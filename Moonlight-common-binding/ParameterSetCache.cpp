@@ -0,0 +1,264 @@
+/* Parameter set caching and deduplication */
+#include "ParameterSetCache.hpp"
+
+#include <string.h>
+
+#define FNV_OFFSET_BASIS 2166136261U
+#define FNV_PRIME 16777619U
+
+using namespace Moonlight_common_binding;
+
+static unsigned int HashParameterSet(const unsigned char *data, int length) {
+	unsigned int hash = FNV_OFFSET_BASIS;
+
+	for (int i = 0; i < length; i++) {
+		hash = (hash ^ data[i]) * FNV_PRIME;
+	}
+
+	return hash;
+}
+
+/* Slots are in the order the parameter sets must be sent in */
+static int GetParameterSetSlot(NalFormat format, int nalType) {
+	if (format == NalFormatHevc) {
+		switch (nalType) {
+		case HEVC_NAL_TYPE_VPS:
+			return 0;
+		case HEVC_NAL_TYPE_SPS:
+			return 1;
+		case HEVC_NAL_TYPE_PPS:
+			return 2;
+		default:
+			return -1;
+		}
+	}
+
+	switch (nalType) {
+	case H264_NAL_TYPE_SPS:
+		return 0;
+	case H264_NAL_TYPE_PPS:
+		return 1;
+	default:
+		return -1;
+	}
+}
+
+ParameterSetCache::ParameterSetCache()
+{
+	Reset(NalFormatH264, NalPackingAnnexB);
+}
+
+void ParameterSetCache::Reset(NalFormat format, NalPacking packing) {
+	m_Format = format;
+	m_Packing = packing;
+	for (int i = 0; i < PARAMETER_SET_SLOTS; i++) {
+		m_Sets[i].valid = false;
+	}
+	m_ResendPending = true;
+}
+
+void ParameterSetCache::OnDecoderReset(void) {
+	m_ResendPending = true;
+}
+
+bool ParameterSetCache::IsCached(int slot, const unsigned char *data, int length, unsigned int hash) {
+	/* The hash rules out almost every change without touching the cached bytes */
+	return m_Sets[slot].valid && m_Sets[slot].hash == hash && m_Sets[slot].length == length &&
+		memcmp(m_Sets[slot].data, data, length) == 0;
+}
+
+int ParameterSetCache::Process(unsigned char *buffer, int &offset, int &length) {
+	unsigned char *frame = buffer + offset;
+	NalUnit nals[FRAME_MAX_NAL_UNITS];
+	bool keep[FRAME_MAX_NAL_UNITS];
+	bool cached[FRAME_MAX_NAL_UNITS];
+	int slots[FRAME_MAX_NAL_UNITS];
+	bool present[PARAMETER_SET_SLOTS] = {};
+	int nalCount = 0;
+	int position = 0;
+	int firstSlice = -1;
+	int firstChanged = PARAMETER_SET_SLOTS;
+	int stripped = 0;
+	int firstMissing;
+	int insertAt;
+	int startCodeLength;
+	int end;
+	bool isIdr = false;
+
+	/* Anything before the first start code doesn't belong to a NAL unit we can move */
+	if (m_Packing == NalPackingAnnexB && FindStartCode(frame, length, 0, startCodeLength) != 0) {
+		return 0;
+	}
+
+	while (position < length) {
+		if (nalCount == FRAME_MAX_NAL_UNITS) {
+			return 0;
+		}
+		if (!FindNalUnit(frame, length, m_Packing, position, nals[nalCount])) {
+			break;
+		}
+
+		/* Parameter sets come before the slices, so everything from the
+		 * first slice on is kept as one unit without being scanned */
+		if (IsSliceNal(m_Format, GetNalType(m_Format, frame[nals[nalCount].headerOffset]))) {
+			nals[nalCount++].end = length;
+			break;
+		}
+
+		if (m_Packing == NalPackingAnnexB) {
+			nals[nalCount].end = FindStartCode(frame, length, nals[nalCount].headerOffset, startCodeLength);
+			position = nals[nalCount].end;
+		}
+		nalCount++;
+	}
+
+	/* A bad length prefix leaves part of the frame unaccounted for */
+	if (nalCount == 0 || nals[nalCount - 1].end != length) {
+		return 0;
+	}
+
+	for (int i = 0; i < nalCount; i++) {
+		const unsigned char *payload = frame + nals[i].headerOffset;
+		int payloadLength = nals[i].end - nals[i].headerOffset;
+		int nalType = GetNalType(m_Format, payload[0]);
+		int slot = GetParameterSetSlot(m_Format, nalType);
+		unsigned int hash;
+
+		keep[i] = true;
+		cached[i] = false;
+		slots[i] = slot;
+
+		if (IsSliceNal(m_Format, nalType)) {
+			if (firstSlice < 0) {
+				firstSlice = i;
+			}
+			if (IsKeyframeNal(m_Format, nalType)) {
+				isIdr = true;
+			}
+			continue;
+		}
+
+		if (slot < 0) {
+			continue;
+		}
+
+		present[slot] = true;
+		if (payloadLength > PARAMETER_SET_MAX_SIZE) {
+			m_Sets[slot].valid = false;
+			firstChanged = slot < firstChanged ? slot : firstChanged;
+			continue;
+		}
+
+		hash = HashParameterSet(payload, payloadLength);
+		if (IsCached(slot, payload, payloadLength, hash)) {
+			cached[i] = true;
+			continue;
+		}
+
+		/* A new or changed parameter set goes through and becomes the active one */
+		firstChanged = slot < firstChanged ? slot : firstChanged;
+		m_Sets[slot].valid = true;
+		m_Sets[slot].hash = hash;
+		m_Sets[slot].length = payloadLength;
+		memcpy(m_Sets[slot].data, payload, payloadLength);
+	}
+
+	/* Decoders throw away the sets that refer to one that was replaced, as
+	 * a PPS refers to its SPS, so once a set has changed the unchanged ones
+	 * after it in the slot order have to go through as well */
+	if (!m_ResendPending) {
+		for (int i = 0; i < nalCount; i++) {
+			if (cached[i] && slots[i] <= firstChanged) {
+				keep[i] = false;
+				stripped++;
+			}
+		}
+	}
+
+	if (m_ResendPending) {
+		if (isIdr) {
+			/* Missing sets go in front of the first set the host did send
+			 * that has to follow them, or else in front of the first slice */
+			for (firstMissing = 0; firstMissing < PARAMETER_SET_SLOTS; firstMissing++) {
+				if (m_Sets[firstMissing].valid && !present[firstMissing]) {
+					break;
+				}
+			}
+			insertAt = nals[firstSlice].startCodeOffset;
+			for (int i = 0; i < firstSlice; i++) {
+				if (slots[i] > firstMissing) {
+					insertAt = nals[i].startCodeOffset;
+					break;
+				}
+			}
+
+			InjectParameterSets(buffer, offset, length, insertAt, present);
+			m_ResendPending = false;
+		}
+		return 0;
+	}
+
+	if (stripped == 0) {
+		return 0;
+	}
+
+	/* Pack the kept NAL units against the end of the frame. The slices come
+	 * last and hold nearly all of the data, so usually only the few bytes
+	 * in front of them move. */
+	end = length;
+	for (int i = nalCount - 1; i >= 0; i--) {
+		int size = nals[i].end - nals[i].startCodeOffset;
+
+		if (!keep[i]) {
+			continue;
+		}
+
+		end -= size;
+		if (end != nals[i].startCodeOffset) {
+			memmove(frame + end, frame + nals[i].startCodeOffset, size);
+		}
+	}
+
+	offset += end;
+	length -= end;
+	return stripped;
+}
+
+void ParameterSetCache::InjectParameterSets(unsigned char *buffer, int &offset, int &length, int insertAt,
+	const bool *present) {
+	static const unsigned char startCode[] = { 0, 0, 0, 1 };
+	unsigned char *output;
+	int injectedLength = 0;
+
+	for (int i = 0; i < PARAMETER_SET_SLOTS; i++) {
+		if (m_Sets[i].valid && !present[i]) {
+			injectedLength += sizeof(startCode) + m_Sets[i].length;
+		}
+	}
+
+	if (injectedLength == 0) {
+		return;
+	}
+
+	/* Slide whatever precedes the first slice into the headroom and put the
+	 * parameter sets between it and the slice */
+	output = buffer + offset - injectedLength;
+	memmove(output, buffer + offset, insertAt);
+	output += insertAt;
+
+	for (int i = 0; i < PARAMETER_SET_SLOTS; i++) {
+		if (m_Sets[i].valid && !present[i]) {
+			if (m_Packing == NalPackingLengthPrefixed) {
+				WriteNalLengthPrefix(output, m_Sets[i].length);
+			}
+			else {
+				memcpy(output, startCode, sizeof(startCode));
+			}
+			memcpy(output + sizeof(startCode), m_Sets[i].data, m_Sets[i].length);
+			output += sizeof(startCode) + m_Sets[i].length;
+		}
+	}
+
+	offset -= injectedLength;
+	length += injectedLength;
+}
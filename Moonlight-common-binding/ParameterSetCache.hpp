@@ -0,0 +1,57 @@
+#pragma once
+#include "NalParser.hpp"
+
+/* Parameter sets larger than this aren't cached and are always passed through */
+#define PARAMETER_SET_MAX_SIZE 256
+#define PARAMETER_SET_SLOTS 3
+
+/* Frames with more NAL units than this are passed through untouched */
+#define FRAME_MAX_NAL_UNITS 32
+
+/* Room the caller reserves in front of each frame for re-injected
+ * parameter sets, including their start codes or length prefixes */
+#define PARAMETER_SET_HEADROOM (PARAMETER_SET_SLOTS * (PARAMETER_SET_MAX_SIZE + 4))
+
+namespace Moonlight_common_binding
+{
+	/* The host sends parameter sets (SPS and PPS, plus VPS for HEVC) in
+	 * front of every IDR frame, and some decoders reinitialize whenever they
+	 * see them, even if they're the same. This remembers the active
+	 * parameter sets, strips copies that haven't changed (unless a set they
+	 * refer to did), and makes sure the next IDR frame after a decoder
+	 * reset carries them again, re-injecting them if the host didn't. */
+	class ParameterSetCache
+	{
+	public:
+		ParameterSetCache();
+
+		/* Forgets the cached parameter sets */
+		void Reset(NalFormat format, NalPacking packing);
+
+		/* The decoder lost its state, so the next IDR frame needs parameter sets */
+		void OnDecoderReset(void);
+
+		/* Decoder thread only. Rewrites the frame at buffer + offset
+		 * in place, updating offset and length. PARAMETER_SET_HEADROOM bytes
+		 * before offset must be writable. Returns how many parameter sets
+		 * were stripped. */
+		int Process(unsigned char *buffer, int &offset, int &length);
+
+	private:
+		struct CachedParameterSet
+		{
+			bool valid;
+			unsigned int hash;
+			int length;
+			unsigned char data[PARAMETER_SET_MAX_SIZE];
+		};
+
+		bool IsCached(int slot, const unsigned char *data, int length, unsigned int hash);
+		void InjectParameterSets(unsigned char *buffer, int &offset, int &length, int insertAt, const bool *present);
+
+		NalFormat m_Format;
+		NalPacking m_Packing;
+		CachedParameterSet m_Sets[PARAMETER_SET_SLOTS];
+		bool m_ResendPending;
+	};
+}
@@ -0,0 +1,162 @@
+/* Path MTU discovery towards the host */
+#include "PathMtuProbe.hpp"
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <map>
+#include <mutex>
+#include <string>
+
+/* The discard port, since nothing has to answer the probes */
+#define PATH_MTU_PROBE_PORT "9"
+
+/* IPv4 and UDP headers */
+#define PATH_MTU_PROBE_OVERHEAD (20 + 8)
+
+using namespace Moonlight_common_binding;
+
+struct CachedPathMtu
+{
+	int mtu;
+	ULONGLONG probeTime;
+};
+
+static std::mutex s_CacheLock;
+static std::map<std::string, CachedPathMtu> s_Cache;
+
+static int SendProbe(SOCKET sock, char *buffer, int mtu) {
+	int error;
+
+	if (send(sock, buffer, mtu - PATH_MTU_PROBE_OVERHEAD, 0) == SOCKET_ERROR) {
+		error = WSAGetLastError();
+
+		/* The host saying nothing listens on the port fails the next
+		 * send instead of sending it */
+		if (error != WSAECONNRESET || send(sock, buffer, mtu - PATH_MTU_PROBE_OVERHEAD, 0) == SOCKET_ERROR) {
+			return WSAGetLastError();
+		}
+	}
+
+	return 0;
+}
+
+/* Sends a datagram this big twice, since the first send teaches the stack
+ * about a smaller MTU further along the path and it's the second that
+ * fails. Only the first needs time for the error to come back. Returns
+ * the Winsock error, or 0 if both were sent. */
+static int ProbeSize(SOCKET sock, char *buffer, int mtu) {
+	struct timeval timeout;
+	fd_set readFds;
+	int error;
+
+	error = SendProbe(sock, buffer, mtu);
+	if (error != 0) {
+		return error;
+	}
+
+	/* Nothing is read, but an ICMP error ends the wait early */
+	FD_ZERO(&readFds);
+	FD_SET(sock, &readFds);
+	timeout.tv_sec = 0;
+	timeout.tv_usec = PATH_MTU_PROBE_WAIT_MS * 1000;
+	select(0, &readFds, NULL, NULL, &timeout);
+
+	return SendProbe(sock, buffer, mtu);
+}
+
+static int ProbeUncachedPathMtu(const char *host) {
+	struct addrinfo hints;
+	struct addrinfo *result;
+	char buffer[PATH_MTU_MAX];
+	WSADATA wsaData;
+	SOCKET sock;
+	DWORD dontFragment = TRUE;
+	int low = PATH_MTU_MIN;
+	int high = PATH_MTU_MAX;
+	int mid;
+	int error;
+
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+		return 0;
+	}
+
+	ZeroMemory(&hints, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_protocol = IPPROTO_UDP;
+	if (getaddrinfo(host, PATH_MTU_PROBE_PORT, &hints, &result) != 0) {
+		WSACleanup();
+		return 0;
+	}
+
+	sock = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+	if (sock == INVALID_SOCKET) {
+		freeaddrinfo(result);
+		WSACleanup();
+		return 0;
+	}
+
+	if (connect(sock, result->ai_addr, (int)result->ai_addrlen) == SOCKET_ERROR ||
+		setsockopt(sock, IPPROTO_IP, IP_DONTFRAGMENT, (char*)&dontFragment, sizeof(dontFragment)) == SOCKET_ERROR) {
+		low = 0;
+	}
+	freeaddrinfo(result);
+
+	ZeroMemory(buffer, sizeof(buffer));
+
+	/* Most paths carry a full Ethernet frame, so try that before searching */
+	if (low != 0) {
+		error = ProbeSize(sock, buffer, high);
+		if (error == 0) {
+			low = high;
+		}
+		else if (error == WSAEMSGSIZE) {
+			high--;
+		}
+		else {
+			low = 0;
+		}
+	}
+
+	while (low != 0 && low < high) {
+		mid = (low + high + 1) / 2;
+		error = ProbeSize(sock, buffer, mid);
+		if (error == 0) {
+			low = mid;
+		}
+		else if (error == WSAEMSGSIZE) {
+			high = mid - 1;
+		}
+		else {
+			low = 0;
+		}
+	}
+
+	closesocket(sock);
+	WSACleanup();
+
+	return low;
+}
+
+int Moonlight_common_binding::ProbePathMtu(const char *host) {
+	ULONGLONG now = GetTickCount64();
+	int mtu;
+
+	{
+		std::lock_guard<std::mutex> lock(s_CacheLock);
+		auto cached = s_Cache.find(host);
+		if (cached != s_Cache.end() && now - cached->second.probeTime < PATH_MTU_CACHE_MS) {
+			return cached->second.mtu;
+		}
+	}
+
+	/* Failures aren't cached, since they're usually down to the network
+	 * not being up yet */
+	mtu = ProbeUncachedPathMtu(host);
+	if (mtu != 0) {
+		std::lock_guard<std::mutex> lock(s_CacheLock);
+		s_Cache[host] = { mtu, now };
+	}
+
+	return mtu;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+/* Video packets carry this much on top of the packet size: the IPv4 and
+ * UDP headers, and the RTP header */
+#define VIDEO_PACKET_OVERHEAD (20 + 8 + 16)
+
+/* The probe searches between these path MTUs. Every IPv4 path carries 576. */
+#define PATH_MTU_MIN 576
+#define PATH_MTU_MAX 1500
+
+/* How long to give a router to send back "fragmentation needed" before
+ * the probe size is tried again */
+#define PATH_MTU_PROBE_WAIT_MS 50
+
+/* How long a host's probed path MTU is reused for */
+#define PATH_MTU_CACHE_MS (10 * 60 * 1000)
+
+namespace Moonlight_common_binding
+{
+	/* Finds the largest datagram that reaches the host without being
+	 * fragmented, or returns 0 if it can't be probed. This relies on the
+	 * host's network stack learning the path MTU from the ICMP errors that
+	 * routers send back, so a path that drops them silently looks bigger
+	 * than it is. Paths that carry a full Ethernet frame are found with one
+	 * probe, others take up to half a second. The result is remembered for
+	 * each host, so reconnecting doesn't probe again. */
+	int ProbePathMtu(const char *host);
+
+	/* The largest packet size that fits in one datagram on this path */
+	inline int GetPacketSizeForPathMtu(int pathMtu) {
+		return pathMtu > 0 ? pathMtu - VIDEO_PACKET_OVERHEAD : 0;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+namespace Moonlight_common_binding
+{
+	/* Native video sink. All calls come from Common's decoder thread, except
+	 * that SubmitDecodeUnit comes from the frame pacer's thread when pacing
+	 * is on. The data passed to SubmitDecodeUnit is only valid for the
+	 * duration of the call.
+	 * receiveTime is when the binding got the frame, from GetReceiveTime. */
+	class IVideoRenderer
+	{
+	public:
+		virtual ~IVideoRenderer() {}
+
+		virtual void Setup(int width, int height, int redrawRate, int drFlags) = 0;
+		virtual void Cleanup(void) = 0;
+		virtual int SubmitDecodeUnit(const unsigned char *data, int length, long long receiveTime) = 0;
+	};
+
+	/* Native audio sink. PlaySample receives interleaved 16-bit PCM and
+	 * is called from Common's audio thread. Renderers that queue audio
+	 * should report the queued duration to the session's AvSyncEngine. */
+	class IAudioRenderer
+	{
+	public:
+		virtual ~IAudioRenderer() {}
+
+		virtual void Init(void) = 0;
+		virtual void Cleanup(void) = 0;
+		virtual void PlaySample(const short *samples, int sampleCount, long long receiveTime) = 0;
+	};
+}
@@ -0,0 +1,809 @@
+﻿/* Per-connection state and the Common callbacks that operate on it */
+#include "StreamSession.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Moonlight_common_binding;
+using namespace Platform;
+using namespace Windows::Security::Cryptography;
+
+#define RECONNECT_INITIAL_BACKOFF_MS 50
+#define RECONNECT_MAX_BACKOFF_MS 2000
+
+/* Reported if a restart to change the stream mode can't reconnect */
+#define RENEGOTIATION_FAILED_ERROR -1
+
+/* Returned by Start while another session is connected */
+#define SESSION_ALREADY_ACTIVE_ERROR -2
+
+#define MAX_OUTPUT_SHORTS_PER_CHANNEL 240
+#define CHANNEL_COUNT 2
+#define SAMPLE_RATE_HZ 48000
+
+/* Common only passes a context pointer to the decoder setup callback,
+ * so the rest of the callbacks find their session through this. Common
+ * keeps its connection state in globals anyway, so only one session can
+ * be connected at a time. */
+static std::atomic<StreamSession*> s_ActiveSession;
+
+StreamSession::StreamSession(const std::string &host, const STREAM_CONFIGURATION &config, int serverMajorVersion,
+	MoonlightConnectionListener ^clCallbacks, MoonlightDecoderRenderer ^drCallbacks,
+	MoonlightAudioRenderer ^arCallbacks) :
+	m_Host(host), m_ServerMajorVersion(serverMajorVersion), m_StreamConfig(config),
+	m_EventDispatcher(clCallbacks), m_DelegateVideoRenderer(drCallbacks), m_DelegateAudioRenderer(arCallbacks),
+	m_NativeVideoRenderer(NULL), m_NativeAudioRenderer(NULL),
+	m_FramePacingMode(FramePacingMode::Off), m_NalFormat(NalFormatH264), m_NalPacking(NalPackingAnnexB),
+	m_Packetization(NULL),
+	m_OpusDecoder(NULL), m_FrameBufferSize(0), m_FrameBuffer(NULL), m_DrActive(false), m_ArActive(false),
+	m_ResumeCallback(nullptr), m_ReconnectMaxAttempts(0), m_Reconnecting(false), m_ConnectionStarted(false),
+	m_StopRequested(false), m_HavePendingMode(false), m_AdaptiveBitrateStopEvent(NULL)
+{
+	m_Statistics.SetStreamMode(config.fps, config.bitrate);
+}
+
+StreamSession::StreamSession(const std::string &host, const STREAM_CONFIGURATION &config, int serverMajorVersion,
+	MoonlightConnectionListener ^clCallbacks, IVideoRenderer *videoRenderer,
+	IAudioRenderer *audioRenderer) :
+	m_Host(host), m_ServerMajorVersion(serverMajorVersion), m_StreamConfig(config),
+	m_EventDispatcher(clCallbacks), m_DelegateVideoRenderer(nullptr), m_DelegateAudioRenderer(nullptr),
+	m_NativeVideoRenderer(videoRenderer), m_NativeAudioRenderer(audioRenderer),
+	m_FramePacingMode(FramePacingMode::Off), m_NalFormat(NalFormatH264), m_NalPacking(NalPackingAnnexB),
+	m_Packetization(NULL),
+	m_OpusDecoder(NULL), m_FrameBufferSize(0), m_FrameBuffer(NULL), m_DrActive(false), m_ArActive(false),
+	m_ResumeCallback(nullptr), m_ReconnectMaxAttempts(0), m_Reconnecting(false), m_ConnectionStarted(false),
+	m_StopRequested(false), m_HavePendingMode(false), m_AdaptiveBitrateStopEvent(NULL)
+{
+	m_Statistics.SetStreamMode(config.fps, config.bitrate);
+}
+
+StreamSession::~StreamSession()
+{
+	Stop();
+}
+
+StreamSession* StreamSession::FromCallback(void) {
+	return s_ActiveSession;
+}
+
+/* Each of these methods call into the appropriate Moonlight Common method */
+void StreamSession::DrShimSetup(int width, int height, int redrawRate, void* context, int drFlags) {
+	StreamSession *session = (StreamSession*)context;
+
+	/* A new connection always starts with an IDR frame, so any backlog is gone */
+	session->m_FrameDropPolicy.Reset(redrawRate);
+
+	/* The renderer is still set up from before the connection dropped */
+	if (session->m_DrActive) {
+		return;
+	}
+
+	/* The new decoder hasn't seen any parameter sets */
+	session->m_ParameterSetCache.Reset(session->m_NalFormat, session->m_NalPacking);
+
+	session->m_DrActive = true;
+	session->WithVideoRenderer([&](auto &renderer) {
+		renderer.Setup(width, height, redrawRate, drFlags);
+	});
+
+	if (session->m_FramePacingMode != FramePacingMode::Off) {
+		session->StartFramePacer(redrawRate);
+	}
+}
+void StreamSession::DrShimCleanup(void) {
+	StreamSession *session = FromCallback();
+
+	if (session->m_Reconnecting) {
+		return;
+	}
+
+	session->TeardownVideoPipeline();
+}
+int StreamSession::DrShimSubmitDecodeUnit(PDECODE_UNIT decodeUnit) {
+	StreamSession *session = FromCallback();
+	long long receiveTime = GetReceiveTime();
+	PLENTRY entry;
+	int fragments = 0;
+	int offset = 0;
+	int frameOffset = PARAMETER_SET_HEADROOM;
+	int frameLength = decodeUnit->fullLength;
+	int frameCapacity = decodeUnit->fullLength;
+	int result;
+	int stripped;
+	FrameClass frameClass;
+	FrameDropDecision decision;
+	LARGE_INTEGER submitStart, submitEnd;
+
+	if (session->m_NalPacking == NalPackingLengthPrefixed) {
+		frameCapacity = GetLengthPrefixedBound(decodeUnit->fullLength);
+	}
+
+	/* Resize the frame buffer if the current frame is too big.
+	 * This is safe without locking because this function is
+	 * called only from a single thread. */
+	if (session->m_FrameBufferSize < frameCapacity) {
+		free(session->m_FrameBuffer);
+		session->m_FrameBufferSize = frameCapacity;
+		session->m_FrameBuffer = (char*) malloc(PARAMETER_SET_HEADROOM + session->m_FrameBufferSize);
+	}
+
+	if (session->m_FrameBuffer == NULL) {
+		session->m_FrameBufferSize = 0;
+		session->m_Statistics.RecordFrameDropped(FrameClassReference);
+		session->m_Statistics.RecordIdrRequest();
+		RecordFlightEvent(FlightFrameDropped, FrameClassReference, decodeUnit->fullLength);
+		RecordFlightEvent(FlightIdrRequested, 0, 0);
+		if (session->m_Packetization != NULL) {
+			session->m_Packetization->OnIdrRequested();
+		}
+		return DR_NEED_IDR;
+	}
+
+	entry = decodeUnit->bufferList;
+	if (session->m_NalPacking == NalPackingLengthPrefixed) {
+		/* Start codes are replaced as the fragments are copied */
+		session->m_LengthPrefixWriter.Begin((unsigned char*)&session->m_FrameBuffer[PARAMETER_SET_HEADROOM]);
+		while (entry != NULL)
+		{
+			session->m_LengthPrefixWriter.Append((const unsigned char*)entry->data, entry->length);
+			if (session->m_Packetization != NULL) {
+				session->m_Packetization->RecordFragment(entry->length);
+			}
+			fragments++;
+			entry = entry->next;
+		}
+		frameLength = session->m_LengthPrefixWriter.Finish();
+	}
+	else {
+		while (entry != NULL)
+		{
+			memcpy(&session->m_FrameBuffer[PARAMETER_SET_HEADROOM + offset], entry->data, entry->length);
+			offset += entry->length;
+			if (session->m_Packetization != NULL) {
+				session->m_Packetization->RecordFragment(entry->length);
+			}
+			fragments++;
+			entry = entry->next;
+		}
+	}
+
+	session->m_Statistics.RecordFrame(decodeUnit->fullLength);
+	RecordFlightEvent(FlightFrameReceived, fragments, decodeUnit->fullLength);
+
+	frameClass = ClassifyFrame(session->m_NalFormat, session->m_NalPacking,
+		(const unsigned char*)&session->m_FrameBuffer[frameOffset], frameLength);
+	if (session->m_Packetization != NULL) {
+		session->m_Packetization->RecordFrame(fragments, frameClass == FrameClassIdr);
+	}
+	decision = session->m_FrameDropPolicy.Decide(frameClass);
+	if (decision == FrameDrop) {
+		session->m_Statistics.RecordFrameDropped(frameClass);
+		RecordFlightEvent(FlightFrameDropped, frameClass, frameLength);
+		return DR_OK;
+	}
+	else if (decision == FrameDropAndRequestIdr) {
+		session->m_Statistics.RecordFrameDropped(frameClass);
+		session->m_Statistics.RecordIdrRequest();
+		RecordFlightEvent(FlightFrameDropped, frameClass, frameLength);
+		RecordFlightEvent(FlightIdrRequested, 0, 0);
+		if (session->m_Packetization != NULL) {
+			session->m_Packetization->OnIdrRequested();
+		}
+		return DR_NEED_IDR;
+	}
+
+	stripped = session->m_ParameterSetCache.Process((unsigned char*)session->m_FrameBuffer, frameOffset,
+		frameLength);
+	if (stripped != 0) {
+		session->m_Statistics.RecordParameterSetsStripped(stripped);
+	}
+
+	/* The pacer and the renderer both block while they're full */
+	QueryPerformanceCounter(&submitStart);
+	if (session->m_FramePacer.IsActive()) {
+		/* The pacer keeps this buffer and gives us another to assemble the next frame in */
+		result = session->m_FramePacer.Submit(session->m_FrameBuffer, session->m_FrameBufferSize, frameOffset,
+			frameLength, receiveTime);
+	}
+	else {
+		result = session->WithVideoRenderer([&](auto &renderer) {
+			return renderer.SubmitDecodeUnit((const unsigned char*)&session->m_FrameBuffer[frameOffset], frameLength,
+				receiveTime);
+		});
+	}
+	QueryPerformanceCounter(&submitEnd);
+	session->m_FrameDropPolicy.OnFrameSubmitted(submitEnd.QuadPart - submitStart.QuadPart);
+	RecordFlightEvent(FlightFrameSubmitted, result, submitEnd.QuadPart - submitStart.QuadPart);
+
+	if (result == DR_NEED_IDR) {
+		/* The decoder starts over, so it needs the parameter sets again */
+		session->m_ParameterSetCache.OnDecoderReset();
+		session->m_Statistics.RecordDecoderReset();
+		session->m_Statistics.RecordIdrRequest();
+		RecordFlightEvent(FlightDecoderReset, 0, 0);
+		RecordFlightEvent(FlightIdrRequested, 0, 0);
+		if (session->m_Packetization != NULL) {
+			session->m_Packetization->OnIdrRequested();
+		}
+	}
+
+	return result;
+}
+
+void StreamSession::ArShimInit(void) {
+	StreamSession *session = FromCallback();
+	int err;
+
+	/* Output latency starts over with the new audio stream */
+	session->m_AvSync.Reset();
+
+	/* Reuse the decoder from before the connection dropped, but don't let
+	 * it conceal across the gap using stale state */
+	if (session->m_ArActive) {
+		if (session->m_OpusDecoder != NULL) {
+			opus_decoder_ctl(session->m_OpusDecoder, OPUS_RESET_STATE);
+		}
+		return;
+	}
+
+	session->m_OpusDecoder = opus_decoder_create(SAMPLE_RATE_HZ,
+		CHANNEL_COUNT,
+		&err);
+
+	session->m_ArActive = true;
+	session->WithAudioRenderer([](auto &renderer) {
+		renderer.Init();
+	});
+}
+void StreamSession::ArShimCleanup(void) {
+	StreamSession *session = FromCallback();
+
+	if (session->m_Reconnecting) {
+		return;
+	}
+
+	session->TeardownAudioPipeline();
+}
+void StreamSession::ArShimDecodeAndPlaySample(char* sampleData, int sampleLength) {
+	StreamSession *session = FromCallback();
+	long long receiveTime = GetReceiveTime();
+	opus_int16 decodedBuffer[MAX_OUTPUT_SHORTS_PER_CHANNEL * CHANNEL_COUNT];
+	int decodedSamples;
+	AvSyncAction action = session->m_AvSync.OnAudioPacket();
+
+	if (action != AvSyncPlay) {
+		RecordFlightEvent(FlightAvSyncAdjusted, action, 0);
+	}
+	if (sampleData == NULL) {
+		RecordFlightEvent(FlightAudioConcealed, 0, 0);
+	}
+
+	/* Audio is ahead of video, so hold it back by one concealed packet */
+	if (action == AvSyncPad) {
+		decodedSamples = opus_decode(session->m_OpusDecoder, NULL, 0,
+			decodedBuffer, MAX_OUTPUT_SHORTS_PER_CHANNEL, 0);
+		if (decodedSamples > 0) {
+			session->WithAudioRenderer([&](auto &renderer) {
+				renderer.PlaySample(decodedBuffer, decodedSamples * CHANNEL_COUNT, receiveTime);
+			});
+		}
+	}
+
+	/* Dropped packets are still decoded to keep the decoder state continuous */
+	decodedSamples = opus_decode(session->m_OpusDecoder, (const unsigned char*)sampleData, sampleLength,
+		decodedBuffer, MAX_OUTPUT_SHORTS_PER_CHANNEL, 0);
+	session->m_AvSync.OnAudioDecoded(receiveTime, GetReceiveTime());
+
+	/* A missing sample means Common lost the packet and we're concealing it */
+	session->m_Statistics.RecordAudioPacket(sampleData != NULL && decodedSamples > 0);
+
+	if (decodedSamples > 0 && action != AvSyncDrop) {
+		session->WithAudioRenderer([&](auto &renderer) {
+			renderer.PlaySample(decodedBuffer, decodedSamples * CHANNEL_COUNT, receiveTime);
+		});
+	}
+}
+
+void StreamSession::ClShimStageStarting(int stage) {
+	StreamSession *session = FromCallback();
+
+	RecordFlightEvent(FlightStageStarting, stage, 0);
+
+	if (session->m_Reconnecting) {
+		return;
+	}
+
+	session->m_EventDispatcher.PostStageStarting(stage);
+}
+void StreamSession::ClShimStageComplete(int stage) {
+	StreamSession *session = FromCallback();
+
+	RecordFlightEvent(FlightStageComplete, stage, 0);
+
+	if (session->m_Reconnecting) {
+		return;
+	}
+
+	session->m_EventDispatcher.PostStageComplete(stage);
+}
+void StreamSession::ClShimStageFailed(int stage, long errorCode) {
+	StreamSession *session = FromCallback();
+
+	RecordFlightEvent(FlightStageFailed, stage, errorCode);
+
+	if (session->m_Reconnecting) {
+		return;
+	}
+
+	session->m_EventDispatcher.PostStageFailed(stage, errorCode);
+}
+void StreamSession::ClShimConnectionStarted(void) {
+	StreamSession *session = FromCallback();
+
+	RecordFlightEvent(FlightConnectionStarted, 0, 0);
+
+	if (session->m_Reconnecting) {
+		return;
+	}
+
+	session->m_ConnectionStarted = true;
+	session->m_EventDispatcher.PostConnectionStarted();
+}
+void StreamSession::ClShimConnectionTerminated(long errorCode) {
+	StreamSession *session = FromCallback();
+
+	/* Ends the dump before a reconnect starts adding events of its own.
+	 * The file itself is written in the background. */
+	RecordFlightEvent(FlightConnectionTerminated, 0, errorCode);
+	WriteFlightRecorderTerminationDump();
+
+	/* The reconnect thread handles failures of its own connection attempts */
+	if (session->m_Reconnecting || session->StartReconnect(errorCode)) {
+		return;
+	}
+
+	session->m_EventDispatcher.PostConnectionTerminated(errorCode);
+}
+void StreamSession::ClShimDisplayMessage(char *message) {
+	FromCallback()->m_EventDispatcher.PostDisplayMessage(message);
+}
+void StreamSession::ClShimDisplayTransientMessage(char *message) {
+	FromCallback()->m_EventDispatcher.PostDisplayTransientMessage(message);
+}
+
+void StreamSession::TeardownVideoPipeline(void) {
+	if (!m_DrActive) {
+		return;
+	}
+
+	m_DrActive = false;
+
+	/* The pacer may be in the middle of handing a frame to the renderer */
+	m_FramePacer.Stop();
+
+	free(m_FrameBuffer);
+	m_FrameBuffer = NULL;
+	m_FrameBufferSize = 0;
+	WithVideoRenderer([](auto &renderer) {
+		renderer.Cleanup();
+	});
+}
+
+void StreamSession::TeardownAudioPipeline(void) {
+	if (!m_ArActive) {
+		return;
+	}
+
+	m_ArActive = false;
+	if (m_OpusDecoder != NULL) {
+		opus_decoder_destroy(m_OpusDecoder);
+		m_OpusDecoder = NULL;
+	}
+	WithAudioRenderer([](auto &renderer) {
+		renderer.Cleanup();
+	});
+}
+
+/* Must be called with m_ConnectionLock held */
+int StreamSession::StartConnectionLocked(void) {
+	DECODER_RENDERER_CALLBACKS drShimCallbacks;
+	AUDIO_RENDERER_CALLBACKS arShimCallbacks;
+	CONNECTION_LISTENER_CALLBACKS clShimCallbacks;
+	StreamSession *activeSession = NULL;
+
+	/* Taking over would send the other session's callbacks here */
+	if (!s_ActiveSession.compare_exchange_strong(activeSession, this) && activeSession != this) {
+		return SESSION_ALREADY_ACTIVE_ERROR;
+	}
+
+	if (m_Packetization != NULL) {
+		m_Packetization->BeginStream(m_StreamConfig.packetSize);
+	}
+
+	LiInitializeVideoCallbacks(&drShimCallbacks);
+	drShimCallbacks.setup = DrShimSetup;
+	drShimCallbacks.cleanup = DrShimCleanup;
+	drShimCallbacks.submitDecodeUnit = DrShimSubmitDecodeUnit;
+
+	LiInitializeAudioCallbacks(&arShimCallbacks);
+	arShimCallbacks.init = ArShimInit;
+	arShimCallbacks.cleanup = ArShimCleanup;
+	arShimCallbacks.decodeAndPlaySample = ArShimDecodeAndPlaySample;
+
+	LiInitializeConnectionCallbacks(&clShimCallbacks);
+	clShimCallbacks.stageStarting = ClShimStageStarting;
+	clShimCallbacks.stageComplete = ClShimStageComplete;
+	clShimCallbacks.stageFailed = ClShimStageFailed;
+	clShimCallbacks.connectionStarted = ClShimConnectionStarted;
+	clShimCallbacks.connectionTerminated = ClShimConnectionTerminated;
+	clShimCallbacks.displayMessage = ClShimDisplayMessage;
+	clShimCallbacks.displayTransientMessage = ClShimDisplayTransientMessage;
+
+	return LiStartConnection(m_Host.c_str(), &m_StreamConfig, &clShimCallbacks,
+		&drShimCallbacks, &arShimCallbacks, this, 0, m_ServerMajorVersion);
+}
+
+int StreamSession::Start(void) {
+	{
+		std::lock_guard<std::mutex> lock(m_ReconnectLock);
+		m_StopRequested = false;
+	}
+	m_ConnectionStarted = false;
+
+	m_EventDispatcher.Start();
+
+	std::lock_guard<std::mutex> lock(m_ConnectionLock);
+	int err = StartConnectionLocked();
+
+	/* Callers expect the stage callbacks to have run by the time we return */
+	m_EventDispatcher.Flush();
+	return err;
+}
+
+void StreamSession::Stop(void) {
+	/* Mode changes would race the teardown */
+	DisableAdaptiveBitrate();
+
+	{
+		std::lock_guard<std::mutex> lock(m_ReconnectLock);
+
+		m_StopRequested = true;
+		m_ReconnectCond.notify_all();
+
+		/* The listener may call us from the reconnect thread when we give up */
+		if (m_ReconnectThread.joinable()) {
+			if (m_ReconnectThread.get_id() == std::this_thread::get_id()) {
+				m_ReconnectThread.detach();
+			}
+		}
+	}
+
+	if (m_ReconnectThread.joinable()) {
+		m_ReconnectThread.join();
+	}
+
+	std::lock_guard<std::mutex> lock(m_ConnectionLock);
+	if (s_ActiveSession == this) {
+		LiStopConnection();
+		s_ActiveSession = NULL;
+	}
+
+	/* Release anything left behind by a cancelled reconnect */
+	TeardownVideoPipeline();
+	TeardownAudioPipeline();
+
+	m_EventDispatcher.Stop();
+}
+
+void StreamSession::EnableAutoReconnect(ClResumeSession ^resumeSession, int maxAttempts) {
+	std::lock_guard<std::mutex> lock(m_ReconnectLock);
+
+	m_ResumeCallback = resumeSession;
+	m_ReconnectMaxAttempts = maxAttempts;
+}
+
+void StreamSession::DisableAutoReconnect(void) {
+	std::lock_guard<std::mutex> lock(m_ReconnectLock);
+
+	m_ResumeCallback = nullptr;
+}
+
+/* Generates a new remote input key and IV for the next /resume */
+static void GenerateRemoteInputKey(PSTREAM_CONFIGURATION config) {
+	Array<byte> ^random;
+
+	CryptographicBuffer::CopyToByteArray(CryptographicBuffer::GenerateRandom(sizeof(config->remoteInputAesKey)), &random);
+	memcpy(config->remoteInputAesKey, random->Data, sizeof(config->remoteInputAesKey));
+
+	/* GameStream only uses 4 bytes of the 16 byte IV */
+	memset(config->remoteInputAesIv, 0, sizeof(config->remoteInputAesIv));
+	CryptographicBuffer::CopyToByteArray(CryptographicBuffer::GenerateRandom(4), &random);
+	memcpy(config->remoteInputAesIv, random->Data, 4);
+}
+
+/* Waits for the backoff delay to elapse. Returns false if the wait
+ * was cut short by Stop. */
+bool StreamSession::WaitForReconnectBackoff(int delayMs) {
+	std::unique_lock<std::mutex> lock(m_ReconnectLock);
+
+	return !m_ReconnectCond.wait_for(lock, std::chrono::milliseconds(delayMs), [this] { return m_StopRequested; });
+}
+
+bool StreamSession::IsReconnectCancelled(void) {
+	std::lock_guard<std::mutex> lock(m_ReconnectLock);
+	return m_StopRequested;
+}
+
+void StreamSession::ReconnectThreadProc(long errorCode) {
+	ClResumeSession ^resumeCallback;
+	unsigned char remoteInputAesKey[sizeof(m_StreamConfig.remoteInputAesKey)];
+	unsigned char remoteInputAesIv[sizeof(m_StreamConfig.remoteInputAesIv)];
+	int maxAttempts;
+	int backoffMs = RECONNECT_INITIAL_BACKOFF_MS;
+	bool reconnected = false;
+	bool modeChanged = false;
+
+	/* Tear down the dead connection. The shims keep the decoder, frame
+	 * buffer and audio renderer alive while we're reconnecting. */
+	{
+		std::lock_guard<std::mutex> lock(m_ConnectionLock);
+		LiStopConnection();
+	}
+
+	for (int attempt = 0; ; attempt++) {
+		/* Auto-reconnect may be reconfigured while we're trying */
+		{
+			std::lock_guard<std::mutex> lock(m_ReconnectLock);
+			maxAttempts = m_ReconnectMaxAttempts;
+		}
+		if (attempt >= maxAttempts) {
+			break;
+		}
+
+		/* The first attempt is immediate since most drops are transient */
+		if (attempt != 0) {
+			if (!WaitForReconnectBackoff(backoffMs)) {
+				break;
+			}
+			backoffMs *= 2;
+			if (backoffMs > RECONNECT_MAX_BACKOFF_MS) {
+				backoffMs = RECONNECT_MAX_BACKOFF_MS;
+			}
+		}
+		else if (IsReconnectCancelled()) {
+			break;
+		}
+
+		/* A mode change can land while Common is stopped between attempts */
+		if (ApplyPendingMode()) {
+			modeChanged = true;
+		}
+
+		/* Skip straight to /resume with fresh input keys, unless
+		 * auto-reconnect was disabled during the backoff */
+		{
+			std::lock_guard<std::mutex> lock(m_ReconnectLock);
+			resumeCallback = m_ResumeCallback;
+			if (resumeCallback == nullptr) {
+				break;
+			}
+			GenerateRemoteInputKey(&m_StreamConfig);
+			memcpy(remoteInputAesKey, m_StreamConfig.remoteInputAesKey, sizeof(remoteInputAesKey));
+			memcpy(remoteInputAesIv, m_StreamConfig.remoteInputAesIv, sizeof(remoteInputAesIv));
+		}
+		if (!resumeCallback(ArrayReference<byte>((byte*)remoteInputAesKey, sizeof(remoteInputAesKey)),
+			ArrayReference<byte>((byte*)remoteInputAesIv, sizeof(remoteInputAesIv)))) {
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(m_ConnectionLock);
+		if (IsReconnectCancelled()) {
+			break;
+		}
+
+		if (StartConnectionLocked() == 0) {
+			reconnected = true;
+			break;
+		}
+
+		LiStopConnection();
+	}
+
+	m_Reconnecting = false;
+
+	if (reconnected) {
+		m_EventDispatcher.PostDisplayTransientMessage(modeChanged ? "Adjusted stream quality" : "Reconnected to host");
+		return;
+	}
+
+	/* We're giving up, so release everything we were holding on to */
+	TeardownVideoPipeline();
+	TeardownAudioPipeline();
+
+	if (!IsReconnectCancelled()) {
+		m_EventDispatcher.PostConnectionTerminated(errorCode);
+	}
+}
+
+/* Starts reconnecting after the connection dropped. Returns false if
+ * auto-reconnect isn't available and the termination should be
+ * delivered to the connection listener instead. */
+bool StreamSession::StartReconnect(long errorCode) {
+	std::unique_lock<std::mutex> lock(m_ReconnectLock);
+	std::thread previousThread;
+
+	if (m_ResumeCallback == nullptr || m_StopRequested || !m_ConnectionStarted) {
+		return false;
+	}
+
+	/* The reconnect already under way covers this one */
+	if (m_Reconnecting) {
+		return true;
+	}
+
+	m_Reconnecting = true;
+	RecordFlightEvent(FlightReconnecting, 0, errorCode);
+
+	/* Let the earlier reconnect thread finish exiting. This must be done
+	 * without the lock held since that thread takes it on the way out. */
+	previousThread = std::move(m_ReconnectThread);
+	lock.unlock();
+	if (previousThread.joinable()) {
+		if (previousThread.get_id() == std::this_thread::get_id()) {
+			previousThread.detach();
+		}
+		else {
+			previousThread.join();
+		}
+	}
+	lock.lock();
+
+	/* Stop may have come in while we were waiting */
+	if (m_StopRequested) {
+		m_Reconnecting = false;
+		return false;
+	}
+
+	m_ReconnectThread = std::thread(&StreamSession::ReconnectThreadProc, this, errorCode);
+	return true;
+}
+
+/* Copies a pending mode change into the stream configuration. Must be
+ * called while Common is stopped. Returns true if there was one. */
+bool StreamSession::ApplyPendingMode(void) {
+	bool videoChanged;
+
+	{
+		std::lock_guard<std::mutex> lock(m_ReconnectLock);
+
+		if (!m_HavePendingMode) {
+			return false;
+		}
+
+		videoChanged = m_PendingMode.width != m_StreamConfig.width || m_PendingMode.height != m_StreamConfig.height ||
+			m_PendingMode.fps != m_StreamConfig.fps;
+
+		m_StreamConfig.width = m_PendingMode.width;
+		m_StreamConfig.height = m_PendingMode.height;
+		m_StreamConfig.fps = m_PendingMode.fps;
+		m_StreamConfig.bitrate = m_PendingMode.bitrateKbps;
+		m_HavePendingMode = false;
+
+		m_Statistics.SetStreamMode(m_StreamConfig.fps, m_StreamConfig.bitrate);
+	}
+
+	/* Let the renderer set up again for the new resolution or frame rate.
+	 * This waits for the frame pacer and the renderer, so it's done with
+	 * the lock released; Stop takes it while this thread is running. */
+	if (videoChanged) {
+		TeardownVideoPipeline();
+	}
+
+	return true;
+}
+
+/* Leaves a mode change for the next reconnect to pick up */
+void StreamSession::DeferModeChange(const StreamMode &mode) {
+	std::lock_guard<std::mutex> lock(m_ReconnectLock);
+
+	m_PendingMode = mode;
+	m_HavePendingMode = true;
+}
+
+/* Restarts the stream through /resume so the host picks up the new mode.
+ * Returns false if the session can't resume. */
+bool StreamSession::Renegotiate(const StreamMode &mode) {
+	{
+		std::lock_guard<std::mutex> lock(m_ReconnectLock);
+
+		m_PendingMode = mode;
+		m_HavePendingMode = true;
+	}
+
+	if (!StartReconnect(RENEGOTIATION_FAILED_ERROR)) {
+		std::lock_guard<std::mutex> lock(m_ReconnectLock);
+
+		m_HavePendingMode = false;
+		return false;
+	}
+
+	return true;
+}
+
+void StreamSession::AdaptiveBitrateThreadProc(void) {
+	while (WaitForSingleObjectEx(m_AdaptiveBitrateStopEvent, ABR_EVALUATION_INTERVAL_MS, FALSE) == WAIT_TIMEOUT) {
+		StatisticsSnapshot snapshot;
+		StreamMode currentMode;
+		StreamMode nextMode;
+
+		/* Nothing useful can be measured while the stream is restarting */
+		if (m_Reconnecting) {
+			continue;
+		}
+
+		m_Statistics.GetSnapshot(snapshot);
+		if (!m_BitrateController.Evaluate(snapshot, nextMode)) {
+			continue;
+		}
+
+		/* Restarting the stream costs more than a stale bitrate, so only
+		 * a new resolution or frame rate is worth one */
+		currentMode = m_BitrateController.GetCurrentMode();
+		if (nextMode.width == currentMode.width && nextMode.height == currentMode.height &&
+			nextMode.fps == currentMode.fps) {
+			DeferModeChange(nextMode);
+			m_BitrateController.Commit(nextMode);
+		}
+		else if (Renegotiate(nextMode)) {
+			m_BitrateController.Commit(nextMode);
+		}
+	}
+}
+
+void StreamSession::EnableAdaptiveBitrate(int minBitrateKbps, int maxBitrateKbps) {
+	StreamMode mode;
+
+	DisableAdaptiveBitrate();
+
+	{
+		std::lock_guard<std::mutex> lock(m_ReconnectLock);
+
+		mode.width = m_StreamConfig.width;
+		mode.height = m_StreamConfig.height;
+		mode.fps = m_StreamConfig.fps;
+		mode.bitrateKbps = m_StreamConfig.bitrate;
+	}
+
+	m_BitrateController.Reset(mode, minBitrateKbps, maxBitrateKbps);
+	m_AdaptiveBitrateStopEvent = CreateEventEx(NULL, NULL, CREATE_EVENT_MANUAL_RESET, EVENT_ALL_ACCESS);
+	m_AdaptiveBitrateThread = std::thread(&StreamSession::AdaptiveBitrateThreadProc, this);
+}
+
+void StreamSession::DisableAdaptiveBitrate(void) {
+	if (!m_AdaptiveBitrateThread.joinable()) {
+		return;
+	}
+
+	SetEvent(m_AdaptiveBitrateStopEvent);
+	m_AdaptiveBitrateThread.join();
+
+	CloseHandle(m_AdaptiveBitrateStopEvent);
+	m_AdaptiveBitrateStopEvent = NULL;
+}
+
+/* Paces frames to the display's vsync, or to the stream's own frame
+ * rate if the display can't be waited on */
+void StreamSession::StartFramePacer(int redrawRate) {
+	DxgiVsyncSource *dxgiSource = new DxgiVsyncSource();
+
+	if (dxgiSource->Initialize()) {
+		m_VsyncSource.reset(dxgiSource);
+	}
+	else {
+		delete dxgiSource;
+		m_VsyncSource.reset(new SimulatedVsyncSource(redrawRate));
+	}
+
+	m_FramePacer.Start(m_NativeVideoRenderer != NULL ? m_NativeVideoRenderer : &m_DelegateVideoRenderer,
+		m_VsyncSource.get(), m_FramePacingMode == FramePacingMode::SmoothnessFirst ? PacingSmoothnessFirst : PacingLatencyFirst);
+}
@@ -0,0 +1,194 @@
+﻿#pragma once
+#include "Moonlight-common-binding.hpp"
+#include "NativeRenderer.hpp"
+#include "ConnectionEventDispatcher.hpp"
+#include "StreamStatistics.hpp"
+#include "BitrateController.hpp"
+#include "AvSyncEngine.hpp"
+#include "FramePacer.hpp"
+#include "FrameDropPolicy.hpp"
+#include "ParameterSetCache.hpp"
+#include "LengthPrefixWriter.hpp"
+#include "PacketizationStatistics.hpp"
+#include "FlightRecorder.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <string>
+
+#include <opus.h>
+
+namespace Moonlight_common_binding
+{
+	/* Owns all of the per-connection state of the binding: the managed
+	 * callbacks, the Opus decoder, the frame reassembly buffer and the
+	 * auto-reconnect machinery. Common keeps its own connection state in
+	 * globals and passes no context to most callbacks, so only one session
+	 * can be connected at a time and callbacks go to that one. */
+	class StreamSession
+	{
+	public:
+		StreamSession(const std::string &host, const STREAM_CONFIGURATION &config, int serverMajorVersion,
+			MoonlightConnectionListener ^clCallbacks, MoonlightDecoderRenderer ^drCallbacks,
+			MoonlightAudioRenderer ^arCallbacks);
+		StreamSession(const std::string &host, const STREAM_CONFIGURATION &config, int serverMajorVersion,
+			MoonlightConnectionListener ^clCallbacks, IVideoRenderer *videoRenderer,
+			IAudioRenderer *audioRenderer);
+		~StreamSession();
+
+		/* Fails while another session is connected. Stop that one first. */
+		int Start(void);
+		void Stop(void);
+		void EnableAutoReconnect(ClResumeSession ^resumeSession, int maxAttempts);
+		void DisableAutoReconnect(void);
+
+		/* Adapts the bitrate, and the resolution and frame rate if needed,
+		 * to network conditions. Common can't change the bitrate of a
+		 * running stream, so a bitrate change alone waits for the next
+		 * reconnect. A mode change is applied right away through /resume,
+		 * so auto-reconnect must be enabled for it to take effect. */
+		void EnableAdaptiveBitrate(int minBitrateKbps, int maxBitrateKbps);
+		void DisableAdaptiveBitrate(void);
+
+		/* Outlives reconnects, so the counters cover the whole stream */
+		StreamStatistics& GetStatistics(void) {
+			return m_Statistics;
+		}
+		AvSyncEngine& GetAvSync(void) {
+			return m_AvSync;
+		}
+		FramePacer& GetFramePacer(void) {
+			return m_FramePacer;
+		}
+
+		/* Takes effect when the video pipeline is next set up, so call
+		 * this before Start */
+		void SetFramePacingMode(FramePacingMode mode) {
+			m_FramePacingMode = mode;
+		}
+
+		/* Select how decode units are parsed and how they're handed to the
+		 * renderer. Call these before Start. */
+		void SetVideoCodec(VideoCodec codec) {
+			m_NalFormat = codec == VideoCodec::Hevc ? NalFormatHevc : NalFormatH264;
+		}
+		void SetBitstreamFormat(BitstreamFormat format) {
+			m_NalPacking = format == BitstreamFormat::LengthPrefixed ? NalPackingLengthPrefixed : NalPackingAnnexB;
+		}
+
+		/* Where to record how frames are packetized. It has to outlive the
+		 * session. Call this before Start. */
+		void SetPacketizationStatistics(PacketizationStatistics *statistics) {
+			m_Packetization = statistics;
+		}
+
+	private:
+		static StreamSession* FromCallback(void);
+
+		/* Invokes fn on the native renderer if one was plugged in, otherwise on
+		 * the delegate renderer. The delegate renderer's concrete type is known
+		 * here, so the default path is dispatched at compile time. Frames the
+		 * pacer releases are the exception; see FramePacer::Start. */
+		template <typename Fn> decltype(auto) WithVideoRenderer(Fn fn) {
+			if (m_NativeVideoRenderer != NULL) {
+				return fn(*m_NativeVideoRenderer);
+			}
+			return fn(m_DelegateVideoRenderer);
+		}
+		template <typename Fn> decltype(auto) WithAudioRenderer(Fn fn) {
+			if (m_NativeAudioRenderer != NULL) {
+				return fn(*m_NativeAudioRenderer);
+			}
+			return fn(m_DelegateAudioRenderer);
+		}
+
+		static void DrShimSetup(int width, int height, int redrawRate, void* context, int drFlags);
+		static void DrShimCleanup(void);
+		static int DrShimSubmitDecodeUnit(PDECODE_UNIT decodeUnit);
+		static void ArShimInit(void);
+		static void ArShimCleanup(void);
+		static void ArShimDecodeAndPlaySample(char* sampleData, int sampleLength);
+		static void ClShimStageStarting(int stage);
+		static void ClShimStageComplete(int stage);
+		static void ClShimStageFailed(int stage, long errorCode);
+		static void ClShimConnectionStarted(void);
+		static void ClShimConnectionTerminated(long errorCode);
+		static void ClShimDisplayMessage(char *message);
+		static void ClShimDisplayTransientMessage(char *message);
+
+		int StartConnectionLocked(void);
+		void TeardownVideoPipeline(void);
+		void TeardownAudioPipeline(void);
+		bool StartReconnect(long errorCode);
+		void ReconnectThreadProc(long errorCode);
+		bool WaitForReconnectBackoff(int delayMs);
+		bool IsReconnectCancelled(void);
+		bool ApplyPendingMode(void);
+		void DeferModeChange(const StreamMode &mode);
+		bool Renegotiate(const StreamMode &mode);
+		void AdaptiveBitrateThreadProc(void);
+		void StartFramePacer(int redrawRate);
+
+		std::string m_Host;
+		int m_ServerMajorVersion;
+		/* Written by the reconnect thread while Common is stopped, always
+		 * with m_ReconnectLock held */
+		STREAM_CONFIGURATION m_StreamConfig;
+
+		ConnectionEventDispatcher m_EventDispatcher;
+		DelegateVideoRenderer m_DelegateVideoRenderer;
+		DelegateAudioRenderer m_DelegateAudioRenderer;
+		IVideoRenderer *m_NativeVideoRenderer;
+		IAudioRenderer *m_NativeAudioRenderer;
+
+		StreamStatistics m_Statistics;
+		AvSyncEngine m_AvSync;
+
+		/* The pacer is declared after its vsync source so it is destroyed first */
+		FramePacingMode m_FramePacingMode;
+		std::unique_ptr<IVsyncSource> m_VsyncSource;
+		FramePacer m_FramePacer;
+
+		/* Decoder thread only */
+		NalFormat m_NalFormat;
+		NalPacking m_NalPacking;
+		LengthPrefixWriter m_LengthPrefixWriter;
+		FrameDropPolicy m_FrameDropPolicy;
+		ParameterSetCache m_ParameterSetCache;
+		PacketizationStatistics *m_Packetization;
+
+		OpusDecoder *m_OpusDecoder;
+		/* Frames are assembled PARAMETER_SET_HEADROOM bytes into the buffer,
+		 * which m_FrameBufferSize doesn't include. The frame pacer swaps the
+		 * buffer for one of its own with every frame it takes. */
+		int m_FrameBufferSize;
+		char* m_FrameBuffer;
+		bool m_DrActive;
+		bool m_ArActive;
+
+		/* While m_Reconnecting is set, the decoder and audio pipeline are
+		 * kept alive across LiStopConnection/LiStartConnection and the
+		 * managed connection listener is not told about the restart.
+		 * The callback and attempt limit are guarded by m_ReconnectLock. */
+		ClResumeSession ^m_ResumeCallback;
+		int m_ReconnectMaxAttempts;
+		std::atomic<bool> m_Reconnecting;
+		std::atomic<bool> m_ConnectionStarted;
+		bool m_StopRequested;
+		std::mutex m_ConnectionLock;
+		std::mutex m_ReconnectLock;
+		std::condition_variable m_ReconnectCond;
+		std::thread m_ReconnectThread;
+
+		/* A mode change waiting for the reconnect thread, guarded by m_ReconnectLock */
+		StreamMode m_PendingMode;
+		bool m_HavePendingMode;
+
+		BitrateController m_BitrateController;
+		HANDLE m_AdaptiveBitrateStopEvent;
+		std::thread m_AdaptiveBitrateThread;
+	};
+}
@@ -0,0 +1,221 @@
+/* Lock-free stream statistics */
+#include "StreamStatistics.hpp"
+
+using namespace Moonlight_common_binding;
+
+/* Smoothing shifts for the jitter (as in RFC 3550) and queueing delay estimates */
+#define JITTER_SMOOTHING_SHIFT 4
+#define QUEUEING_DELAY_SMOOTHING_SHIFT 3
+
+StreamStatistics::StreamStatistics() :
+	m_FrameIntervalQpc(0), m_FrameRate(0), m_TargetBitrateKbps(0), m_LastArrival(0), m_ExpectedArrival(0),
+	m_VideoSequence(0), m_FramesReceived(0), m_FramesDropped(0), m_FramesDroppedNonReference(0), m_IdrRequests(0), m_DecoderResets(0),
+	m_ParameterSetsStripped(0), m_MaxFrameSize(0),
+	m_ArrivalJitterUs(0), m_QueueingDelayUs(0),
+	m_AudioSequence(0), m_AudioPacketsDecoded(0), m_AudioPacketsLost(0)
+{
+	QueryPerformanceFrequency(&m_QpcFrequency);
+
+	for (int i = 0; i < STATISTICS_BUCKET_COUNT; i++) {
+		m_Buckets[i].index.store(-1, std::memory_order_relaxed);
+		m_Buckets[i].frames.store(0, std::memory_order_relaxed);
+		m_Buckets[i].bytes.store(0, std::memory_order_relaxed);
+	}
+}
+
+void StreamStatistics::SetStreamMode(int frameRate, int bitrateKbps) {
+	m_FrameIntervalQpc.store(frameRate > 0 ? m_QpcFrequency.QuadPart / frameRate : 0, std::memory_order_relaxed);
+	m_FrameRate.store(frameRate, std::memory_order_relaxed);
+	m_TargetBitrateKbps.store(bitrateKbps, std::memory_order_relaxed);
+}
+
+long long StreamStatistics::GetBucketIndex(LONGLONG now) {
+	return (now * 1000 / STATISTICS_BUCKET_MS) / m_QpcFrequency.QuadPart;
+}
+
+/* Jitter is the smoothed deviation of frame spacing from the frame
+ * interval. Queueing delay is how far frames run behind the schedule
+ * set by the earliest recent arrival, which grows as a bottleneck queue
+ * fills. Gaps of several intervals count as skipped frames, so frames
+ * the host didn't send or Common dropped don't look like delay.
+ * Called between BeginVideoWrite and EndVideoWrite. */
+void StreamStatistics::UpdateArrivalEstimates(LONGLONG now) {
+	LONGLONG interval = m_FrameIntervalQpc.load(std::memory_order_relaxed);
+	LONGLONG gap = now - m_LastArrival;
+
+	if (interval <= 0 || m_LastArrival == 0 ||
+		gap > m_QpcFrequency.QuadPart * STATISTICS_ARRIVAL_RESET_MS / 1000) {
+		m_LastArrival = now;
+		m_ExpectedArrival = now;
+		m_ArrivalJitterUs.store(0, std::memory_order_relaxed);
+		m_QueueingDelayUs.store(0, std::memory_order_relaxed);
+		return;
+	}
+
+	LONGLONG frames = (gap + interval / 2) / interval;
+	LONGLONG deviationUs = ((gap - interval) * 1000000) / m_QpcFrequency.QuadPart;
+	LONGLONG latenessUs;
+	long long jitterUs = m_ArrivalJitterUs.load(std::memory_order_relaxed);
+	long long queueingDelayUs = m_QueueingDelayUs.load(std::memory_order_relaxed);
+
+	if (deviationUs < 0) {
+		deviationUs = -deviationUs;
+	}
+
+	m_ExpectedArrival += (frames != 0 ? frames : 1) * interval;
+	if (m_ExpectedArrival > now) {
+		m_ExpectedArrival = now;
+	}
+	latenessUs = ((now - m_ExpectedArrival) * 1000000) / m_QpcFrequency.QuadPart;
+	m_LastArrival = now;
+
+	jitterUs += (deviationUs - jitterUs) >> JITTER_SMOOTHING_SHIFT;
+	queueingDelayUs += (latenessUs - queueingDelayUs) >> QUEUEING_DELAY_SMOOTHING_SHIFT;
+	m_ArrivalJitterUs.store(jitterUs, std::memory_order_relaxed);
+	m_QueueingDelayUs.store(queueingDelayUs, std::memory_order_relaxed);
+}
+
+/* The sequence is odd while the decoder thread is writing. Readers retry
+ * if it was odd or changed while they were copying. */
+void StreamStatistics::BeginVideoWrite(void) {
+	m_VideoSequence.store(m_VideoSequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+void StreamStatistics::EndVideoWrite(void) {
+	m_VideoSequence.store(m_VideoSequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void StreamStatistics::RecordFrame(int length) {
+	LARGE_INTEGER now;
+	long long index;
+
+	QueryPerformanceCounter(&now);
+	index = GetBucketIndex(now.QuadPart);
+
+	WindowBucket &bucket = m_Buckets[index % STATISTICS_BUCKET_COUNT];
+
+	BeginVideoWrite();
+	UpdateArrivalEstimates(now.QuadPart);
+
+	/* Reclaim a bucket left over from an earlier lap */
+	if (bucket.index.load(std::memory_order_relaxed) != index) {
+		bucket.frames.store(0, std::memory_order_relaxed);
+		bucket.bytes.store(0, std::memory_order_relaxed);
+		bucket.index.store(index, std::memory_order_relaxed);
+	}
+
+	bucket.frames.store(bucket.frames.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	bucket.bytes.store(bucket.bytes.load(std::memory_order_relaxed) + length, std::memory_order_relaxed);
+	m_FramesReceived.store(m_FramesReceived.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	if (length > m_MaxFrameSize.load(std::memory_order_relaxed)) {
+		m_MaxFrameSize.store(length, std::memory_order_relaxed);
+	}
+
+	EndVideoWrite();
+}
+
+void StreamStatistics::RecordFrameDropped(FrameClass frameClass) {
+	BeginVideoWrite();
+	m_FramesDropped.store(m_FramesDropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	if (frameClass == FrameClassNonReference) {
+		m_FramesDroppedNonReference.store(m_FramesDroppedNonReference.load(std::memory_order_relaxed) + 1,
+			std::memory_order_relaxed);
+	}
+	EndVideoWrite();
+}
+
+void StreamStatistics::RecordIdrRequest(void) {
+	BeginVideoWrite();
+	m_IdrRequests.store(m_IdrRequests.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	EndVideoWrite();
+}
+
+void StreamStatistics::RecordDecoderReset(void) {
+	BeginVideoWrite();
+	m_DecoderResets.store(m_DecoderResets.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	EndVideoWrite();
+}
+
+void StreamStatistics::RecordParameterSetsStripped(int count) {
+	BeginVideoWrite();
+	m_ParameterSetsStripped.store(m_ParameterSetsStripped.load(std::memory_order_relaxed) + count,
+		std::memory_order_relaxed);
+	EndVideoWrite();
+}
+
+void StreamStatistics::RecordAudioPacket(bool decoded) {
+	unsigned int sequence = m_AudioSequence.load(std::memory_order_relaxed);
+
+	m_AudioSequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	if (decoded) {
+		m_AudioPacketsDecoded.store(m_AudioPacketsDecoded.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+	else {
+		m_AudioPacketsLost.store(m_AudioPacketsLost.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	m_AudioSequence.store(sequence + 2, std::memory_order_release);
+}
+
+void StreamStatistics::GetSnapshot(StatisticsSnapshot &snapshot) {
+	LARGE_INTEGER now;
+	long long currentIndex;
+	long long windowFrames;
+	long long windowBytes;
+	unsigned int before, after;
+
+	QueryPerformanceCounter(&now);
+	currentIndex = GetBucketIndex(now.QuadPart);
+
+	/* Only completed buckets count, so the window is a full second that
+	 * lags by at most one bucket */
+	do {
+		before = m_VideoSequence.load(std::memory_order_acquire);
+
+		windowFrames = 0;
+		windowBytes = 0;
+		for (int i = 0; i < STATISTICS_BUCKET_COUNT; i++) {
+			long long index = m_Buckets[i].index.load(std::memory_order_relaxed);
+
+			if (index < currentIndex && index >= currentIndex - STATISTICS_WINDOW_BUCKETS) {
+				windowFrames += m_Buckets[i].frames.load(std::memory_order_relaxed);
+				windowBytes += m_Buckets[i].bytes.load(std::memory_order_relaxed);
+			}
+		}
+
+		snapshot.framesReceived = m_FramesReceived.load(std::memory_order_relaxed);
+		snapshot.framesDropped = m_FramesDropped.load(std::memory_order_relaxed);
+		snapshot.framesDroppedNonReference = m_FramesDroppedNonReference.load(std::memory_order_relaxed);
+		snapshot.idrRequests = m_IdrRequests.load(std::memory_order_relaxed);
+		snapshot.decoderResets = m_DecoderResets.load(std::memory_order_relaxed);
+		snapshot.parameterSetsStripped = m_ParameterSetsStripped.load(std::memory_order_relaxed);
+		snapshot.maxFrameSize = m_MaxFrameSize.load(std::memory_order_relaxed);
+		snapshot.arrivalJitterUs = m_ArrivalJitterUs.load(std::memory_order_relaxed);
+		snapshot.queueingDelayUs = m_QueueingDelayUs.load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		after = m_VideoSequence.load(std::memory_order_relaxed);
+	} while ((before & 1) != 0 || before != after);
+
+	/* Anything that isn't known to be a non-reference frame counts as a reference frame */
+	snapshot.framesDroppedReference = snapshot.framesDropped - snapshot.framesDroppedNonReference;
+
+	do {
+		before = m_AudioSequence.load(std::memory_order_acquire);
+
+		snapshot.audioPacketsDecoded = m_AudioPacketsDecoded.load(std::memory_order_relaxed);
+		snapshot.audioPacketsLost = m_AudioPacketsLost.load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		after = m_AudioSequence.load(std::memory_order_relaxed);
+	} while ((before & 1) != 0 || before != after);
+
+	snapshot.receivedFps = windowFrames * 1000.0 / (STATISTICS_WINDOW_BUCKETS * STATISTICS_BUCKET_MS);
+	snapshot.receivedBitrateKbps = windowBytes * 8 / (STATISTICS_WINDOW_BUCKETS * STATISTICS_BUCKET_MS);
+	snapshot.averageFrameSize = windowFrames != 0 ? (int)(windowBytes / windowFrames) : 0;
+	snapshot.frameRate = m_FrameRate.load(std::memory_order_relaxed);
+	snapshot.targetBitrateKbps = m_TargetBitrateKbps.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "LockFreeQueue.hpp"
+#include "NalParser.hpp"
+
+#include <Windows.h>
+#include <atomic>
+
+/* Rates are computed over the last second in 100 ms buckets */
+#define STATISTICS_BUCKET_MS 100
+#define STATISTICS_WINDOW_BUCKETS 10
+#define STATISTICS_BUCKET_COUNT 16
+
+/* Arrival gaps longer than this restart the jitter and queueing estimates */
+#define STATISTICS_ARRIVAL_RESET_MS 1000
+
+namespace Moonlight_common_binding
+{
+	struct StatisticsSnapshot
+	{
+		double receivedFps;
+		long long receivedBitrateKbps;
+		int averageFrameSize;
+		int maxFrameSize;
+		long long framesReceived;
+
+		/* Frames the binding dropped itself and the IDR requests it made
+		 * to recover. These say the decoder fell behind, not the network. */
+		long long framesDropped;
+		long long framesDroppedReference;
+		long long framesDroppedNonReference;
+		long long idrRequests;
+		long long decoderResets;
+		long long parameterSetsStripped;
+		long long audioPacketsDecoded;
+		long long audioPacketsLost;
+		long long arrivalJitterUs;
+		long long queueingDelayUs;
+		int frameRate;
+		int targetBitrateKbps;
+	};
+
+	/* Stream counters that the decoder and audio threads update without
+	 * locks. Each thread's counters sit on their own cache lines behind a
+	 * sequence counter, so a reader can take a consistent copy by retrying
+	 * if a write was in progress, and the writers never wait. */
+	class StreamStatistics
+	{
+	public:
+		StreamStatistics();
+
+		/* The mode currently negotiated with the host. The frame rate sets
+		 * the expected spacing of frames for the arrival estimates. */
+		void SetStreamMode(int frameRate, int bitrateKbps);
+
+		/* Decoder thread only */
+		void RecordFrame(int length);
+		void RecordFrameDropped(FrameClass frameClass);
+		void RecordIdrRequest(void);
+		void RecordDecoderReset(void);
+		void RecordParameterSetsStripped(int count);
+
+		/* Audio thread only */
+		void RecordAudioPacket(bool decoded);
+
+		/* Safe to call from any thread, as often as every frame */
+		void GetSnapshot(StatisticsSnapshot &snapshot);
+
+	private:
+		struct WindowBucket
+		{
+			std::atomic<long long> index;
+			std::atomic<long long> frames;
+			std::atomic<long long> bytes;
+		};
+
+		long long GetBucketIndex(LONGLONG now);
+		void UpdateArrivalEstimates(LONGLONG now);
+		void BeginVideoWrite(void);
+		void EndVideoWrite(void);
+
+		LARGE_INTEGER m_QpcFrequency;
+		std::atomic<LONGLONG> m_FrameIntervalQpc;
+		std::atomic<int> m_FrameRate;
+		std::atomic<int> m_TargetBitrateKbps;
+
+		/* Decoder thread only */
+		LONGLONG m_LastArrival;
+		LONGLONG m_ExpectedArrival;
+
+		char m_Pad0[CACHE_LINE_SIZE];
+		std::atomic<unsigned int> m_VideoSequence;
+		std::atomic<long long> m_FramesReceived;
+		std::atomic<long long> m_FramesDropped;
+		std::atomic<long long> m_FramesDroppedNonReference;
+		std::atomic<long long> m_IdrRequests;
+		std::atomic<long long> m_DecoderResets;
+		std::atomic<long long> m_ParameterSetsStripped;
+		std::atomic<int> m_MaxFrameSize;
+		std::atomic<long long> m_ArrivalJitterUs;
+		std::atomic<long long> m_QueueingDelayUs;
+		WindowBucket m_Buckets[STATISTICS_BUCKET_COUNT];
+
+		char m_Pad1[CACHE_LINE_SIZE];
+		std::atomic<unsigned int> m_AudioSequence;
+		std::atomic<long long> m_AudioPacketsDecoded;
+		std::atomic<long long> m_AudioPacketsLost;
+		char m_Pad2[CACHE_LINE_SIZE];
+	};
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace Moonlight_common_binding
+{
+	/* Hashed timer wheel for a single thread. Items are filed into the slot
+	 * for their due tick, so adding is constant time and advancing only
+	 * visits the slots that elapsed. Items due more than a full revolution
+	 * out share a slot with nearer ones and are skipped until their tick
+	 * comes around. Storage is a fixed pool, so nothing is allocated. */
+	template <typename T, size_t Slots, size_t Capacity>
+	class TimerWheel
+	{
+		static_assert(Slots >= 2 && (Slots & (Slots - 1)) == 0, "Slots must be a power of 2");
+
+	public:
+		TimerWheel() : m_CurrentTick(0) {
+			Clear();
+		}
+
+		void Clear(void) {
+			for (size_t i = 0; i < Slots; i++) {
+				m_SlotHead[i] = -1;
+				m_SlotTail[i] = -1;
+			}
+
+			for (size_t i = 0; i < Capacity; i++) {
+				m_Entries[i].next = (int)i + 1 < (int)Capacity ? (int)i + 1 : -1;
+			}
+
+			m_FreeHead = 0;
+			m_Count = 0;
+		}
+
+		/* Sets the current tick without firing anything. Only valid while empty. */
+		void Reset(unsigned long long tick) {
+			m_CurrentTick = tick;
+		}
+
+		/* Returns false if the pool is exhausted */
+		bool Add(const T &item, unsigned long long dueTick) {
+			int index = m_FreeHead;
+			size_t slot;
+
+			if (index < 0) {
+				return false;
+			}
+
+			/* Anything already due fires on the next advance */
+			if (dueTick <= m_CurrentTick) {
+				dueTick = m_CurrentTick + 1;
+			}
+
+			m_FreeHead = m_Entries[index].next;
+			m_Entries[index].item = item;
+			m_Entries[index].dueTick = dueTick;
+			m_Entries[index].next = -1;
+
+			/* Append so items due on the same tick fire in the order they were added */
+			slot = (size_t)(dueTick & (Slots - 1));
+			if (m_SlotTail[slot] < 0) {
+				m_SlotHead[slot] = index;
+			}
+			else {
+				m_Entries[m_SlotTail[slot]].next = index;
+			}
+			m_SlotTail[slot] = index;
+
+			m_Count++;
+			return true;
+		}
+
+		/* Fires everything due at or before the given tick, in tick order */
+		template <typename Fire>
+		void Advance(unsigned long long nowTick, Fire fire) {
+			unsigned long long steps;
+
+			if (nowTick <= m_CurrentTick) {
+				return;
+			}
+
+			steps = nowTick - m_CurrentTick;
+			if (steps > Slots) {
+				steps = Slots;
+			}
+
+			for (unsigned long long i = 1; i <= steps && m_Count != 0; i++) {
+				FireSlot((size_t)((m_CurrentTick + i) & (Slots - 1)), nowTick, fire);
+			}
+
+			m_CurrentTick = nowTick;
+		}
+
+		/* Gets the tick of the next item due within one revolution. Returns
+		 * false if nothing is scheduled. If everything is further out than
+		 * that, returns the end of the revolution so the caller checks back. */
+		bool GetNextDueTick(unsigned long long &dueTick) {
+			if (m_Count == 0) {
+				return false;
+			}
+
+			for (unsigned long long tick = m_CurrentTick + 1; tick <= m_CurrentTick + Slots; tick++) {
+				for (int index = m_SlotHead[tick & (Slots - 1)]; index >= 0; index = m_Entries[index].next) {
+					if (m_Entries[index].dueTick <= tick) {
+						dueTick = tick;
+						return true;
+					}
+				}
+			}
+
+			dueTick = m_CurrentTick + Slots;
+			return true;
+		}
+
+		size_t GetCount(void) {
+			return m_Count;
+		}
+
+	private:
+		struct Entry
+		{
+			T item;
+			unsigned long long dueTick;
+			int next;
+		};
+
+		template <typename Fire>
+		void FireSlot(size_t slot, unsigned long long nowTick, Fire &fire) {
+			int previous = -1;
+			int index = m_SlotHead[slot];
+
+			while (index >= 0) {
+				int next = m_Entries[index].next;
+
+				if (m_Entries[index].dueTick <= nowTick) {
+					T item = m_Entries[index].item;
+
+					if (previous < 0) {
+						m_SlotHead[slot] = next;
+					}
+					else {
+						m_Entries[previous].next = next;
+					}
+					if (m_SlotTail[slot] == index) {
+						m_SlotTail[slot] = previous;
+					}
+
+					m_Entries[index].next = m_FreeHead;
+					m_FreeHead = index;
+					m_Count--;
+
+					fire(item);
+				}
+				else {
+					previous = index;
+				}
+
+				index = next;
+			}
+		}
+
+		Entry m_Entries[Capacity];
+		int m_SlotHead[Slots];
+		int m_SlotTail[Slots];
+		int m_FreeHead;
+		size_t m_Count;
+		unsigned long long m_CurrentTick;
+	};
+}
@@ -22,6 +22,11 @@
 
         private const int MDNS_POLLING_INTERVAL = 5;
 
+        // The standard UDP echo port. GFE doesn't answer on it, so the link
+        // is only probed when the user says an echo service was set up on
+        // the host.
+        private const int LINK_PROBE_ECHO_PORT = 7;
+
         private DispatcherTimer mDnsTimer = new DispatcherTimer();
 
         private static List<Computer> computerList = new List<Computer>();
@@ -114,13 +119,46 @@
                 byte[] aesIv = new byte[16];
                 Array.ConstrainedCopy(aesRiIndex, 0, aesIv, 0, aesRiIndex.Length);
                 SettingsPage s = new SettingsPage();
+
+                // The largest packets that reach the host whole, unless
+                // earlier streams lost more frames at that size
+                string host = selected.IpAddress;
+                int packetSize = await Task.Run(() => MoonlightCommonRuntimeComponent.RecommendPacketSize(
+                    MoonlightCommonRuntimeComponent.ProbePathMtu(host)));
+
+                // If the host runs an echo service, scale the selected
+                // settings down to what the link can carry. Otherwise the
+                // probe would only wait out its timeout.
+                int width = s.GetStreamWidth();
+                int height = s.GetStreamHeight();
+                int fps = s.GetStreamFps();
+                int bitrate = 10000; // FIXME: Scale by resolution
+                MoonlightLinkProbeResult link = null;
+                if (s.GetProbeLink())
+                {
+                    link = await Task.Run(() => MoonlightCommonRuntimeComponent.ProbeLink(
+                        host, LINK_PROBE_ECHO_PORT, width, height, fps, bitrate));
+                }
+                if (link != null)
+                {
+                    Debug.WriteLine("Link probe: RTT " + link.GetRttUs() + " us, jitter " + link.GetJitterUs() +
+                        " us, " + link.GetThroughputKbps() + " Kbps, " + link.GetLossPercent() + "% loss");
+                    width = link.GetWidth();
+                    height = link.GetHeight();
+                    fps = link.GetFps();
+                    bitrate = link.GetBitrateKbps();
+                }
+
                 MoonlightStreamConfiguration config = new MoonlightStreamConfiguration(
-                    s.GetStreamWidth(),
-                    s.GetStreamHeight(),
-                    s.GetStreamFps(),
-                    10000, // FIXME: Scale by resolution
-                    1024,
-                    aesKey, aesIv);
+                    width,
+                    height,
+                    fps,
+                    bitrate,
+                    packetSize,
+                    aesKey, aesIv,
+                    // HEVC needs a host that was set up to stream it, since
+                    // the codec isn't negotiated during connection setup yet
+                    VideoCodec.H264);
 
                 StreamContext context = await ConnectionManager.StartStreaming(this.Dispatcher, selected, config);
                 if (context != null)
@@ -22,6 +22,7 @@
             settings.Values["optimize_settings"] = Optimize_Settings_Checkbox.IsChecked;
             settings.Values["pc_audio"] = PC_Audio_Checkbox.IsChecked;
             settings.Values["disable_warnings"] = Disable_Warnings_Checkbox.IsChecked; 
+            settings.Values["probe_link"] = Probe_Link_Checkbox.IsChecked;
         }
 
         /// <summary>
@@ -52,6 +53,10 @@
             {
                 Disable_Warnings_Checkbox.IsChecked = (bool)settings.Values["disable_warnings"];
             }
+            if (settings.Values.ContainsKey("probe_link"))
+            {
+                Probe_Link_Checkbox.IsChecked = (bool)settings.Values["probe_link"];
+            }
         }
         #endregion Persistent UI Settings
     }
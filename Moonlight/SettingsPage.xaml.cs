@@ -79,6 +79,15 @@ namespace Moonlight
                 return 30;
             }
         }
+
+        /// <summary>
+        /// Whether to measure the link before streaming
+        /// </summary>
+        /// <returns>True if the user set up an echo service on the PC</returns>
+        internal bool GetProbeLink()
+        {
+            return Probe_Link_Checkbox.IsChecked == true;
+        }
         #endregion Stream Settings
     }
 }
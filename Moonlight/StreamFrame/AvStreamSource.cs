@@ -4,6 +4,7 @@ using System;
 using System.Collections.Concurrent;
 using System.Diagnostics;
 using System.Runtime.InteropServices.WindowsRuntime;
+using Moonlight_common_binding;
 using Windows.Media.Core;
 
 namespace Moonlight
@@ -12,8 +13,25 @@ namespace Moonlight
     {
         #region Class Variables
 
-        private BlockingCollection<byte[]> pendingSamples = new BlockingCollection<byte[]>(1);
-        private DateTime videoStart = new DateTime(0);
+        // 16-bit stereo at 48 KHz
+        private const int AUDIO_BYTES_PER_FRAME = 4;
+        private const int AUDIO_SAMPLE_RATE = 48000;
+
+        private class PendingVideoSample
+        {
+            public byte[] Data;
+            public long ReceiveTime;
+        }
+
+        private class HandedOffSample
+        {
+            public long Timestamp;
+            public long ReceiveTime;
+        }
+
+        private BlockingCollection<PendingVideoSample> pendingSamples = new BlockingCollection<PendingVideoSample>(1);
+        private ConcurrentQueue<HandedOffSample> handedOffSamples = new ConcurrentQueue<HandedOffSample>();
+        private long videoStartTime = -1;
         private SourceVoice sourceVoice;
 
         #endregion Class Variables
@@ -37,11 +55,15 @@ namespace Moonlight
             pendingSamples.CompleteAdding();
         }
 
-        private MediaStreamSample CreateVideoSample(byte[] buf)
+        private MediaStreamSample CreateVideoSample(PendingVideoSample pending)
         {
-            if (videoStart.Ticks == 0)
+            byte[] buf = pending.Data;
+
+            // Timestamps follow the binding's receive times so frame spacing
+            // survives however late the decoder asks for the sample
+            if (videoStartTime < 0)
             {
-                videoStart = DateTime.Now;
+                videoStartTime = pending.ReceiveTime;
             }
 
             // Marshal this buffer so we can safely queue it without worrying about
@@ -50,7 +72,7 @@ namespace Moonlight
             Array.Copy(buf, bufCopy, buf.Length);
 
             MediaStreamSample sample = MediaStreamSample.CreateFromBuffer(bufCopy.AsBuffer(),
-                DateTime.Now - videoStart);
+                TimeSpan.FromTicks(pending.ReceiveTime - videoStartTime));
             sample.Duration = TimeSpan.Zero;
 
             // HACK: Marking all frames as keyframes seems
@@ -69,7 +91,7 @@ namespace Moonlight
         public void VideoSampleRequested(MediaStreamSourceSampleRequestedEventArgs args)
         {
             // Block until a sample is available from the queue
-            byte[] sample = pendingSamples.Take();
+            PendingVideoSample sample = pendingSamples.Take();
 
             if (sample == null)
             {
@@ -79,9 +101,38 @@ namespace Moonlight
 
             // Return the sample
             args.Request.Sample = CreateVideoSample(sample);
+
+            // The decoder holds on to the sample until the playback clock reaches
+            // its timestamp, so it isn't presented until ReportPlaybackPosition
+            // sees the clock get there
+            handedOffSamples.Enqueue(new HandedOffSample
+            {
+                Timestamp = args.Request.Sample.Timestamp.Ticks,
+                ReceiveTime = sample.ReceiveTime
+            });
         }
 
-        public void EnqueueVideoSample(byte[] buf)
+        // Called on the UI thread as each frame is composed, with the media
+        // element's playback position. Every sample at or before the position
+        // has been presented, and the newest of them is the one on screen.
+        public void ReportPlaybackPosition(TimeSpan position)
+        {
+            HandedOffSample presented = null;
+            HandedOffSample next;
+
+            while (handedOffSamples.TryPeek(out next) && next.Timestamp <= position.Ticks)
+            {
+                handedOffSamples.TryDequeue(out presented);
+            }
+
+            // Let the binding line audio up with this frame
+            if (presented != null)
+            {
+                MoonlightCommonRuntimeComponent.ReportVideoFramePresented(presented.ReceiveTime);
+            }
+        }
+
+        public void EnqueueVideoSample(byte[] buf, long receiveTime)
         {
             // This puts back-pressure in the DU queue in
             // common. It's needed so that we avoid our queue getting
@@ -96,7 +147,7 @@ namespace Moonlight
             // Try to queue the sample
             try
             {
-                pendingSamples.Add(buf);
+                pendingSamples.Add(new PendingVideoSample { Data = buf, ReceiveTime = receiveTime });
             }
             catch (InvalidOperationException)
             {
@@ -114,6 +165,10 @@ namespace Moonlight
             try
             {
                 sourceVoice.SubmitSourceBuffer(buffer, null);
+
+                // Tell the binding how far behind live our audio output is
+                long bufferTicks = (buf.Length / AUDIO_BYTES_PER_FRAME) * TimeSpan.TicksPerSecond / AUDIO_SAMPLE_RATE;
+                MoonlightCommonRuntimeComponent.ReportAudioOutputLatency(sourceVoice.State.BuffersQueued * bufferTicks);
             }
             catch (Exception e)
             {
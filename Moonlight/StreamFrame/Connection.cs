@@ -5,6 +5,7 @@
     using System;
     using System.Diagnostics;
     using System.Text.RegularExpressions;
+    using System.Threading;
     using System.Threading.Tasks;
     using Windows.UI.Core;
     using Windows.UI.Popups;
@@ -13,6 +14,11 @@
     public sealed partial class StreamFrame : Page
     {
         private int serverMajorVersion;
+        private NvHttp streamNvHttp;
+        private const int AUTO_RECONNECT_MAX_ATTEMPTS = 6;
+        private const int RESUME_TIMEOUT_MS = 10000;
+        private CancellationTokenSource resumeCancellation;
+        private const int ADAPTIVE_BITRATE_MIN_KBPS = 2000;
 
         #region Connection
 
@@ -36,15 +42,7 @@
 
             serverMajorVersion = Convert.ToInt32(versionString.Substring(0, 1));
 
-            byte[] aesIv = streamConfig.GetRiAesIv();
-            int riKeyId =
-                (int)(((aesIv[0] << 24) & 0xFF000000U) |
-                ((aesIv[1] << 16) & 0xFF0000U) |
-                ((aesIv[2] << 8) & 0xFF00U) |
-                (aesIv[3] & 0xFFU));
-            string riConfigString =
-                "&rikey=" + PairingCryptoHelpers.BytesToHex(streamConfig.GetRiAesKey()) +
-                "&rikeyid=" + riKeyId;
+            string riConfigString = GetRiConfigString(streamConfig.GetRiAesKey(), streamConfig.GetRiAesIv());
 
             // Launch a new game if nothing is running
             if (currentGameString == null || currentGameString.Equals("0"))
@@ -66,15 +64,63 @@
             {
                 // A game was already running, so resume it
                 // FIXME: Quit and relaunch if it's not the game we came to start
-                XmlQuery x = new XmlQuery(nv.BaseUrl + "/resume?uniqueid=" + nv.GetUniqueId() + riConfigString);
+                return await ResumeApp(nv, riConfigString);
+            }
+        }
 
-                string resumeStr = await x.ReadXmlElement("resume");
-                if (resumeStr == null || resumeStr.Equals("0"))
-                {
-                    return false;
-                }
+        /// <summary>
+        /// Build the remote input key parameters for a launch or resume request
+        /// </summary>
+        private static string GetRiConfigString(byte[] riAesKey, byte[] riAesIv)
+        {
+            int riKeyId =
+                (int)(((riAesIv[0] << 24) & 0xFF000000U) |
+                ((riAesIv[1] << 16) & 0xFF0000U) |
+                ((riAesIv[2] << 8) & 0xFF00U) |
+                (riAesIv[3] & 0xFFU));
 
-                return true;
+            return "&rikey=" + PairingCryptoHelpers.BytesToHex(riAesKey) +
+                "&rikeyid=" + riKeyId;
+        }
+
+        /// <summary>
+        /// Create resume HTTP request
+        /// </summary>
+        private static async Task<bool> ResumeApp(NvHttp nv, string riConfigString)
+        {
+            XmlQuery x = new XmlQuery(nv.BaseUrl + "/resume?uniqueid=" + nv.GetUniqueId() + riConfigString);
+
+            string resumeStr = await x.ReadXmlElement("resume");
+            if (resumeStr == null || resumeStr.Equals("0"))
+            {
+                return false;
+            }
+
+            return true;
+        }
+
+        /// <summary>
+        /// Auto-reconnect callback. Called by the binding on its reconnect thread
+        /// to resume the running app with a fresh remote input key.
+        /// </summary>
+        private bool ClResumeSession(byte[] riAesKey, byte[] riAesIv)
+        {
+            string riConfigString = GetRiConfigString(riAesKey, riAesIv);
+            Task<bool> resume = Task.Run(() => ResumeApp(streamNvHttp, riConfigString));
+
+            // Block the reconnect thread until the host answers, but not for so
+            // long that stopping the stream has to wait on an unresponsive host
+            try
+            {
+                return resume.Wait(RESUME_TIMEOUT_MS, resumeCancellation.Token) && resume.Result;
+            }
+            catch (OperationCanceledException)
+            {
+                return false;
+            }
+            catch (AggregateException)
+            {
+                return false;
             }
         }
 
@@ -127,6 +173,12 @@
             // Call into Common to start the connection
             Debug.WriteLine("Starting connection");
 
+            // Show frames in step with the display, favoring latency over smoothness
+            MoonlightCommonRuntimeComponent.SetFramePacingMode(FramePacingMode.LatencyFirst);
+
+            // Keep what led up to a dropped connection for stutter reports
+            MoonlightCommonRuntimeComponent.SetFlightRecorderDumpOnTermination(true);
+
             MoonlightCommonRuntimeComponent.StartConnection(serverIp, streamConfig, clCallbacks, drCallbacks, arCallbacks, serverMajorVersion);
 
             if (stageFailureText != null)
@@ -137,6 +189,14 @@
             }
             else
             {
+                // Let the binding recover from transient drops without tearing down the stream
+                streamNvHttp = nv;
+                resumeCancellation = new CancellationTokenSource();
+                MoonlightCommonRuntimeComponent.EnableAutoReconnect(ClResumeSession, AUTO_RECONNECT_MAX_ATTEMPTS);
+
+                // Back off on a congested network, but never above what the user picked
+                MoonlightCommonRuntimeComponent.EnableAdaptiveBitrate(ADAPTIVE_BITRATE_MIN_KBPS, streamConfig.GetBitrate());
+
                 ConnectionSuccess();
             }
         }
@@ -185,6 +245,13 @@
         /// </summary>
         private void Cleanup()
         {
+            // StopConnection waits for the reconnect thread, which may be waiting on a resume
+            if (resumeCancellation != null)
+            {
+                resumeCancellation.Cancel();
+            }
+
+            MoonlightCommonRuntimeComponent.DisableAutoReconnect();
             MoonlightCommonRuntimeComponent.StopConnection();
             hasMoved = false;
         }
@@ -23,9 +23,9 @@
 
         }
 
-        public int DrSubmitDecodeUnit(byte[] data)
+        public int DrSubmitDecodeUnit(byte[] data, long receiveTime)
         {
-            AvStream.EnqueueVideoSample(data);
+            AvStream.EnqueueVideoSample(data, receiveTime);
             return 0;
         }
 #endregion Decoder Renderer
@@ -41,7 +41,7 @@
 
         }
 
-        public void ArPlaySample(byte[] data)
+        public void ArPlaySample(byte[] data, long receiveTime)
         {
             AvStream.EnqueueAudioSample(data);
         }
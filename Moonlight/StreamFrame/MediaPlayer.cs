@@ -33,8 +33,16 @@
             this._streamSource = streamSource;
 
             // This code is based upon the MS FFmpegInterop project on GitHub
-            VideoEncodingProperties videoProps = VideoEncodingProperties.CreateH264();
-            videoProps.ProfileId = H264ProfileIds.High;
+            VideoEncodingProperties videoProps;
+            if (streamConfig.GetCodec() == VideoCodec.Hevc)
+            {
+                videoProps = VideoEncodingProperties.CreateHevc();
+            }
+            else
+            {
+                videoProps = VideoEncodingProperties.CreateH264();
+                videoProps.ProfileId = H264ProfileIds.High;
+            }
             videoProps.Width = (uint)streamConfig.GetWidth();
             videoProps.Height = (uint)streamConfig.GetHeight();
             videoProps.Bitrate = (uint)streamConfig.GetBitrate();
@@ -66,14 +74,24 @@
         {
             AvStream.Start();
             StreamDisplay.Play();
+            CompositionTarget.Rendering += CompositionTarget_Rendering;
         }
 
         private void StopMediaPlayer()
         {
+            CompositionTarget.Rendering -= CompositionTarget_Rendering;
             AvStream.Stop();
             StreamDisplay.Stop();
         }
 
+        /// <summary>
+        /// Called on the UI thread once for each composed frame
+        /// </summary>
+        private void CompositionTarget_Rendering(object sender, object e)
+        {
+            _streamSource.ReportPlaybackPosition(StreamDisplay.Position);
+        }
+
         /// <summary>
         /// Video stream source sample requested callback
         /// </summary>
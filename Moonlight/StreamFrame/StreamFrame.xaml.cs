@@ -3,7 +3,6 @@
     using Moonlight.Streaming;
     using Moonlight_common_binding;
     using System;
-    using System.Threading;
     using Windows.Devices.Input;
     using Windows.Graphics.Display;
     using Windows.UI.Core;
@@ -48,6 +47,7 @@
         private const int MOUSE_BUTTON_LEFT = 0x1;
         private const int MOUSE_BUTTON_MIDDLE = 0x2;
         private const int MOUSE_BUTTON_RIGHT = 0x4;
+        private const int TAP_CLICK_HOLD_MS = 100;
         private CoreCursor oldCursor;
         private bool capturingMouse;
 
@@ -92,6 +92,7 @@
 
             Window.Current.CoreWindow.KeyDown += WindowKeyDownHandler;
             Window.Current.CoreWindow.KeyUp += WindowKeyUpHandler;
+            Window.Current.CoreWindow.Activated += WindowActivatedHandler;
 
             // Add a callback for relative mouse movements
             MouseDevice.GetForCurrentView().MouseMoved += RelativeMouseMoved;
@@ -105,6 +106,7 @@
 
             StopMediaPlayer();
 
+            MoonlightCommonRuntimeComponent.DisableAutoReconnect();
             MoonlightCommonRuntimeComponent.StopConnection();
         }
 
@@ -181,10 +183,14 @@
             PointerPoint ptrPt = e.GetCurrentPoint(StreamDisplay);
             PointerPointProperties props = ptrPt.Properties;
 
-            // GameStream only supports vertical scrolling for now
-            if (!props.IsHorizontalMouseWheel)
+            // Pass the raw delta so partial clicks from touchpads add up
+            if (props.IsHorizontalMouseWheel)
             {
-                MoonlightCommonRuntimeComponent.SendScrollEvent((short) (props.MouseWheelDelta / 120));
+                MoonlightCommonRuntimeComponent.SendHorizontalScrollDelta((short)props.MouseWheelDelta);
+            }
+            else
+            {
+                MoonlightCommonRuntimeComponent.SendScrollDelta((short)props.MouseWheelDelta);
             }
         }
 
@@ -241,17 +247,9 @@
             {
                 if (!hasMoved)
                 {
-                    // We haven't moved so send a click
-                    MoonlightCommonRuntimeComponent.SendMouseButtonEvent((byte)MouseButtonAction.Press, (int)MouseButton.Left);
-
-                    // Sleep here because some games do input detection by polling
-                    using (EventWaitHandle tmpEvent = new ManualResetEvent(false))
-                    {
-                        tmpEvent.WaitOne(TimeSpan.FromMilliseconds(100));
-                    }
-
-                    // Raise the mouse button
-                    MoonlightCommonRuntimeComponent.SendMouseButtonEvent((byte)MouseButtonAction.Release, (int)MouseButton.Left);
+                    // We haven't moved so send a click. The release is held back
+                    // because some games do input detection by polling.
+                    MoonlightCommonRuntimeComponent.SendMouseClick((int)MouseButton.Left, TAP_CLICK_HOLD_MS);
                 }
             }
             else
@@ -324,8 +322,14 @@
 
         private void WindowKeyDownHandler(CoreWindow sender, KeyEventArgs args)
         {
+            // The binding translates the key and tracks the modifiers itself
+            if (MoonlightCommonRuntimeComponent.SendVirtualKeyEvent((int)args.VirtualKey, (byte)KeyAction.Down) == 0)
+            {
+                args.Handled = true;
+            }
+
             // Watch for Ctrl+Alt+Shift to toggle mouse binding
-            if ((KeyboardHelper.GetModifierFlags() & (byte)(Modifier.ModifierShift | Modifier.ModifierAlt | Modifier.ModifierCtrl)) ==
+            if ((MoonlightCommonRuntimeComponent.GetKeyboardModifiers() & (byte)(Modifier.ModifierShift | Modifier.ModifierAlt | Modifier.ModifierCtrl)) ==
                 (byte)(Modifier.ModifierShift | Modifier.ModifierAlt | Modifier.ModifierCtrl))
             {
                 if (capturingMouse)
@@ -337,26 +341,22 @@
                     CaptureMouse();
                 }
             }
+        }
 
-            short key = KeyboardHelper.TranslateVirtualKey(args.VirtualKey);
-            if (key != 0)
+        private void WindowKeyUpHandler(CoreWindow sender, KeyEventArgs args)
+        {
+            if (MoonlightCommonRuntimeComponent.SendVirtualKeyEvent((int)args.VirtualKey, (byte)KeyAction.Up) == 0)
             {
-                MoonlightCommonRuntimeComponent.SendKeyboardEvent(key, (byte)KeyAction.Down,
-                    KeyboardHelper.GetModifierFlags());
-
                 args.Handled = true;
             }
         }
 
-        private void WindowKeyUpHandler(CoreWindow sender, KeyEventArgs args)
+        private void WindowActivatedHandler(CoreWindow sender, WindowActivatedEventArgs args)
         {
-            short key = KeyboardHelper.TranslateVirtualKey(args.VirtualKey);
-            if (key != 0)
+            // Key releases are missed while we're in the background
+            if (args.WindowActivationState == CoreWindowActivationState.Deactivated)
             {
-                MoonlightCommonRuntimeComponent.SendKeyboardEvent(key, (byte)KeyAction.Up,
-                    KeyboardHelper.GetModifierFlags());
-
-                args.Handled = true;
+                MoonlightCommonRuntimeComponent.ResetKeyboardModifiers();
             }
         }
         #endregion Keyboard Events